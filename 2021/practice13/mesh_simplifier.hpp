@@ -0,0 +1,47 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Quadric error metric simplification (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics", 1997) by half-edge collapses:
+// a vertex is always moved onto one of its neighbours, so every level of
+// detail indexes a subset of the original vertex buffer and all levels can
+// share it.
+//
+// Vertices with equal positions are treated as one, so UV seams and hard
+// edges don't tear; such a vertex only moves along the seam. Open borders
+// only move along the border. Collapses that would flip a triangle are
+// skipped.
+//
+// Positions are passed as a pointer to the first vertex's three consecutive
+// floats and the byte stride between vertices.
+
+struct lod_level
+{
+    std::vector<std::uint32_t> indices;
+
+    // Largest area-weighted RMS distance from a collapsed vertex to the
+    // planes of the original triangles around it, in mesh units: the error
+    // a renderer can project to the screen to pick a level
+    float error = 0.f;
+};
+
+// Simplifies the mesh once, taking a snapshot whenever the triangle count
+// reaches the next target. Targets are triangle counts in decreasing order;
+// a level may have more triangles than asked for if no more collapses are
+// possible, and simplification stops early once the error would exceed
+// max_error.
+std::vector<lod_level> build_lod_chain(std::span<std::uint32_t const> indices, float const * positions,
+    std::size_t vertex_count, std::size_t stride, std::span<std::size_t const> target_triangle_counts,
+    float max_error = 1e30f);
+
+// One level with the given number of triangles at most
+lod_level simplify(std::span<std::uint32_t const> indices, float const * positions, std::size_t vertex_count,
+    std::size_t stride, std::size_t target_triangle_count, float max_error = 1e30f);
+
+// Pixels covered by the error of a level seen from the given distance with a
+// symmetric perspective projection
+float projected_error(float error, float distance, float fov_y, float viewport_height);
@@ -0,0 +1,96 @@
+// Offline generation of the bunny1..5 levels of detail from bunny0: the
+// full-resolution mesh is simplified once to the triangle counts of the
+// hand-made levels, halving at every step, and the error of each level is
+// printed.
+//
+// Usage: generate_lods [input.obj [output_prefix]]
+// Without arguments bunny0.obj is simplified and nothing is written. With an
+// output prefix, level i is written to <output_prefix>i.obj, vertices that
+// are no longer used being dropped.
+
+#include "mesh_utils.hpp"
+#include "mesh_simplifier.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+	constexpr std::size_t level_count = 6;
+
+	void write_obj(std::string const & path, std::string const & name, std::vector<vertex> const & vertices,
+		std::vector<std::uint32_t> const & indices)
+	{
+		std::ofstream output(path);
+		if (!output)
+			throw std::runtime_error("Failed to open " + path);
+
+		std::vector<std::uint32_t> remap(vertices.size(), 0);
+		std::uint32_t next = 0;
+		output << "o " << name << '\n';
+		for (auto index : indices)
+		{
+			if (remap[index] != 0)
+				continue;
+			remap[index] = ++next;
+			auto const & p = vertices[index].position;
+			output << "v " << p.x << ' ' << p.y << ' ' << p.z << '\n';
+		}
+
+		for (std::size_t i = 0; i < indices.size(); i += 3)
+			output << "f " << remap[indices[i]] << ' ' << remap[indices[i + 1]] << ' ' << remap[indices[i + 2]] << '\n';
+	}
+
+}
+
+int main(int argc, char ** argv) try
+{
+	std::string const input_path = argc > 1 ? argv[1] : PRACTICE_SOURCE_DIRECTORY "/bunny0.obj";
+
+	std::ifstream input(input_path);
+	if (!input)
+		throw std::runtime_error("Failed to open " + input_path);
+	auto const [vertices, indices] = load_obj(input);
+
+	std::vector<std::size_t> targets;
+	for (std::size_t count = indices.size() / 6; targets.size() + 1 < level_count; count /= 2)
+		targets.push_back(count);
+
+	auto start = std::chrono::steady_clock::now();
+	auto levels = build_lod_chain(indices, &vertices[0].position.x, vertices.size(), sizeof(vertex), targets);
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	levels.insert(levels.begin(), lod_level{indices, 0.f});
+
+	auto const [min, max] = bbox(vertices);
+	float const size = glm::length(max - min);
+
+	std::printf("%s: %zu vertices, %zu triangles, simplified in %.1f ms\n", input_path.c_str(), vertices.size(),
+		indices.size() / 3, seconds * 1e3);
+	for (std::size_t i = 0; i < levels.size(); ++i)
+		std::printf("    level %zu: %6zu triangles, error %.5f (%.3f%% of the bounding box diagonal)\n", i,
+			levels[i].indices.size() / 3, levels[i].error, 100.f * levels[i].error / size);
+
+	if (argc > 2)
+	{
+		for (std::size_t i = 1; i < levels.size(); ++i)
+		{
+			std::string const path = std::string(argv[2]) + std::to_string(i) + ".obj";
+			write_obj(path, std::filesystem::path(path).stem().string(), vertices, levels[i].indices);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,97 @@
+// Frustum culling of many boxes: the separating axis test main.cpp used,
+// aabb and intersect() against a frustum box by box, and cull_boxes on a
+// box_set. The boxes are random, of a few sizes, scattered around a camera
+// looking along -z with the game's projection. Also reports how many boxes
+// the two disagree on: cull_boxes must keep every box the exact test keeps,
+// and keeps a few outside ones near the frustum's edges.
+//
+// Usage: box_culling_benchmark [box count]
+// Without a count 100000 boxes are used.
+
+#include "box_culling.hpp"
+#include "simd_batch.hpp"
+#include "aabb.hpp"
+#include "frustum.hpp"
+#include "intersect.hpp"
+#include "measure.hpp"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr int repetitions = 20;
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::size_t const count = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+    std::default_random_engine random;
+    std::uniform_real_distribution<float> position(-60.f, 60.f);
+    std::uniform_real_distribution<float> size(0.05f, 2.f);
+
+    std::vector<glm::vec3> min(count), max(count);
+    box_set boxes;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 const center(position(random), position(random) * 0.25f, position(random));
+        glm::vec3 const extent(size(random), size(random), size(random));
+        min[i] = center - extent;
+        max[i] = center + extent;
+        boxes.add(min[i], max[i]);
+    }
+
+    glm::mat4 const projection = glm::perspective(glm::pi<float>() / 3.f, 16.f / 9.f, 0.1f, 100.f);
+    glm::mat4 const view = glm::rotate(glm::mat4(1.f), 0.3f, {0.f, 1.f, 0.f});
+    glm::mat4 const view_projection = projection * view;
+
+    std::vector<char> sat_visible(count);
+    double const sat_seconds = measure([&]{
+        for (int r = 0; r < repetitions; ++r)
+        {
+            frustum const f(view_projection);
+            for (std::size_t i = 0; i < count; ++i)
+                sat_visible[i] = intersect(aabb(min[i], max[i]), f);
+        }
+    });
+
+    visibility_bits bits;
+    double const simd_seconds = measure([&]{
+        for (int r = 0; r < repetitions; ++r)
+            cull_boxes(boxes, frustum_planes(view_projection), bits);
+    });
+
+    std::size_t sat_count = 0, simd_count = 0, missed = 0, extra = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        bool const simd = is_visible(bits, i);
+        sat_count += sat_visible[i];
+        simd_count += simd;
+        missed += sat_visible[i] && !simd;
+        extra += !sat_visible[i] && simd;
+    }
+
+    std::printf("%zu boxes, %zu lanes\n", count, simd_batch::size);
+    std::printf("    intersect()  %8.3f ms per frame, %zu visible\n", sat_seconds / repetitions * 1e3, sat_count);
+    std::printf("    cull_boxes   %8.3f ms per frame, %zu visible (%.1fx faster)\n", simd_seconds / repetitions * 1e3,
+        simd_count, sat_seconds / simd_seconds);
+    std::printf("    kept by cull_boxes only: %zu, by intersect() only: %zu\n", extra, missed);
+
+    return missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,234 @@
+// Load time and memory of glTF models: first the step load_gltf changed, the
+// document and the buffer, the old way (JSON parsed from a stream, the whole
+// .bin read into a std::vector) against the new one (JSON parsed in situ, the
+// .bin memory-mapped), then load_gltf itself on the .gltf and on a .glb
+// written from it into the temp directory.
+//
+// Usage: gltf_load_benchmark [file.gltf ...]
+// Without files the bowling alley is used. Every mode reads the whole buffer
+// afterwards, as glBufferData would, and runs in a child process so that its
+// peak RSS is measured in isolation. load_gltf expects this project's
+// materials; for the hw3 wolf, build with hw3 first on the include path.
+// POSIX only, the anonymous memory is read from /proc.
+
+#include "gltf_loader.hpp"
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+    constexpr int repetitions = 20;
+
+    // The same model with the buffer in a BIN chunk
+    std::filesystem::path write_glb(std::filesystem::path const & gltf_path)
+    {
+        auto const path = std::filesystem::temp_directory_path() / gltf_path.filename().replace_extension(".glb");
+
+        rapidjson::Document document;
+        {
+            std::ifstream input(gltf_path, std::ios::binary);
+            rapidjson::IStreamWrapper stream(input);
+            document.ParseStream(stream);
+        }
+
+        auto & buffer = document["buffers"][0];
+        auto const bin_path = gltf_path.parent_path() / buffer["uri"].GetString();
+        buffer.RemoveMember("uri");
+
+        rapidjson::StringBuffer json;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(json);
+        document.Accept(writer);
+
+        std::string json_chunk(json.GetString(), json.GetSize());
+        json_chunk.resize((json_chunk.size() + 3) / 4 * 4, ' ');
+
+        std::string bin_chunk(std::filesystem::file_size(bin_path), '\0');
+        std::ifstream(bin_path, std::ios::binary).read(bin_chunk.data(), bin_chunk.size());
+        bin_chunk.resize((bin_chunk.size() + 3) / 4 * 4, '\0');
+
+        std::ofstream output(path, std::ios::binary);
+        auto write_u32 = [&](std::uint32_t value) { output.write(reinterpret_cast<char const *>(&value), sizeof(value)); };
+        write_u32(0x46546C67);
+        write_u32(2);
+        write_u32(std::uint32_t(12 + 8 + json_chunk.size() + 8 + bin_chunk.size()));
+        write_u32(std::uint32_t(json_chunk.size()));
+        write_u32(0x4E4F534A);
+        output.write(json_chunk.data(), json_chunk.size());
+        write_u32(std::uint32_t(bin_chunk.size()));
+        write_u32(0x004E4942);
+        output.write(bin_chunk.data(), bin_chunk.size());
+
+        return path;
+    }
+
+    // Reads every byte, as the GL upload does
+    std::uint64_t checksum(std::span<char const> data)
+    {
+        std::uint64_t result = 0;
+        for (std::size_t i = 0; i + 8 <= data.size(); i += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data.data() + i, sizeof(word));
+            result = result * 31 + word;
+        }
+        return result;
+    }
+
+    // What load_gltf did before: the document parsed from a stream and the
+    // buffer copied into memory
+    std::uint64_t load_copying(std::filesystem::path const & path, std::vector<char> & buffer)
+    {
+        rapidjson::Document document;
+        {
+            std::ifstream input(path, std::ios::binary);
+            rapidjson::IStreamWrapper stream(input);
+            document.ParseStream(stream);
+        }
+
+        auto const buffer_path = path.parent_path() / document["buffers"][0]["uri"].GetString();
+        buffer.resize(std::filesystem::file_size(buffer_path));
+        std::ifstream(buffer_path, std::ios::binary).read(buffer.data(), buffer.size());
+        return checksum(buffer);
+    }
+
+    // What it does now for a .gltf
+    std::uint64_t load_mapped(std::filesystem::path const & path, std::unique_ptr<mapped_file> & buffer)
+    {
+        std::vector<char> json;
+        {
+            mapped_file file(path);
+            json.assign(file.data(), file.data() + file.size());
+            json.push_back('\0');
+        }
+        rapidjson::Document document;
+        document.ParseInsitu(json.data());
+
+        buffer = std::make_unique<mapped_file>(path.parent_path() / document["buffers"][0]["uri"].GetString());
+        return checksum({buffer->data(), buffer->size()});
+    }
+
+    // Resident anonymous memory, which is what a loader allocates; mapped
+    // file pages are shared with the page cache and can be dropped any time
+    long anonymous_rss_kb()
+    {
+        std::ifstream status("/proc/self/status");
+        for (std::string line; std::getline(status, line);)
+            if (line.rfind("RssAnon:", 0) == 0)
+                return std::stol(line.substr(8));
+        return -1;
+    }
+
+    template <typename Load>
+    void run(char const * name, Load && load)
+    {
+        long const anonymous_before = anonymous_rss_kb();
+
+        std::uint64_t sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repetitions; ++i)
+            sum += load();
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("    %-22s %8.3f ms per load, %6ld KB anonymous memory while loaded, checksum %016llx\n", name,
+            seconds / repetitions * 1e3, anonymous_rss_kb() - anonymous_before, (unsigned long long)(sum / repetitions));
+    }
+
+    template <typename Function>
+    long peak_rss_kb(Function && function)
+    {
+        std::cout.flush();
+
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("fork failed");
+
+        if (pid == 0)
+        {
+            int status = EXIT_SUCCESS;
+            try
+            {
+                function();
+            }
+            catch (std::exception const & e)
+            {
+                std::cerr << e.what() << std::endl;
+                status = EXIT_FAILURE;
+            }
+            std::fflush(stdout);
+            _exit(status);
+        }
+
+        int status = 0;
+        rusage usage{};
+        wait4(pid, &status, 0, &usage);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            throw std::runtime_error("benchmark child failed");
+        return usage.ru_maxrss;
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::filesystem::path> paths(argv + 1, argv + argc);
+    if (paths.empty())
+        paths.emplace_back(PROJECT_ROOT "/bowling_alley_mozilla_hubs_room/scene.gltf");
+
+    for (auto const & path : paths)
+    {
+        auto const glb_path = write_glb(path);
+        std::printf("%s: %ju KB, %s: %ju KB\n", path.filename().string().c_str(),
+            std::uintmax_t(std::filesystem::file_size(path) / 1024), glb_path.filename().string().c_str(),
+            std::uintmax_t(std::filesystem::file_size(glb_path) / 1024));
+
+        // The last load stays alive until the mode's memory is measured
+        long const copying_rss = peak_rss_kb([&]{
+            std::vector<char> buffer;
+            run("stream + copy", [&]{ return load_copying(path, buffer); });
+        });
+        long const mapped_rss = peak_rss_kb([&]{
+            std::unique_ptr<mapped_file> buffer;
+            run("in situ + mapped", [&]{ return load_mapped(path, buffer); });
+        });
+        long const gltf_rss = peak_rss_kb([&]{
+            gltf_model model;
+            run("load_gltf (.gltf)", [&]{
+                model = load_gltf(path);
+                return checksum(model.buffers[0].data);
+            });
+        });
+        long const glb_rss = peak_rss_kb([&]{
+            gltf_model model;
+            run("load_gltf (.glb)", [&]{
+                model = load_gltf(glb_path);
+                return checksum(model.buffers[0].data);
+            });
+        });
+
+        std::printf("    peak RSS: stream + copy %ld KB, in situ + mapped %ld KB, load_gltf .gltf %ld KB, .glb %ld KB\n",
+            copying_rss, mapped_rss, gltf_rss, glb_rss);
+    }
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <chrono>
+
+// Seconds the step takes, once
+template <typename Step>
+double measure(Step && step)
+{
+    auto start = std::chrono::steady_clock::now();
+    step();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,126 @@
+// Effect of every mesh_optimizer step on the simulated vertex cache, overdraw
+// and vertex fetch, with the time each step takes.
+//
+// Usage: mesh_optimizer_benchmark [--shuffle] [file.obj ...]
+// Without files the ball and pin meshes and the suzanne, cow and bunny_lowres
+// meshes from the practices are used. --shuffle randomizes the triangle order
+// first, which is close to what a careless exporter produces.
+
+#include "mesh_optimizer.hpp"
+#include "obj_parser.hpp"
+#include "measure.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace
+{
+
+    // Triangles as position triples, sorted, to check that a step only
+    // changed the order
+    std::vector<std::array<float, 9>> triangle_set(obj_data const & mesh)
+    {
+        std::vector<std::array<float, 9>> result;
+        for (std::size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            std::array<std::array<float, 3>, 3> corners;
+            for (int k = 0; k < 3; ++k)
+                corners[k] = mesh.vertices[mesh.indices[i + k]].position;
+
+            // Rotate the smallest corner first, keeping the winding
+            auto first = std::min_element(corners.begin(), corners.end()) - corners.begin();
+            std::rotate(corners.begin(), corners.begin() + first, corners.end());
+
+            auto & t = result.emplace_back();
+            for (int k = 0; k < 3; ++k)
+                std::copy(corners[k].begin(), corners[k].end(), t.begin() + 3 * k);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    void report(char const * step, obj_data const & mesh, double seconds)
+    {
+        auto const cache16 = analyze_vertex_cache(mesh.indices, mesh.vertices.size(), 16);
+        auto const cache32 = analyze_vertex_cache(mesh.indices, mesh.vertices.size(), 32);
+        auto const overdraw = analyze_overdraw(mesh.indices, mesh.vertices);
+        auto const fetch = analyze_vertex_fetch(mesh.indices, mesh.vertices.size(), sizeof(obj_data::vertex));
+
+        std::printf("    %-14s ACMR %.3f / %.3f  ATVR %.3f / %.3f  overdraw %.3f  overfetch %.3f  %8.3f ms\n",
+            step, cache16.acmr, cache32.acmr, cache16.atvr, cache32.atvr, overdraw.overdraw, fetch.overfetch, seconds * 1e3);
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    bool shuffle = false;
+    std::vector<std::filesystem::path> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--shuffle")
+            shuffle = true;
+        else
+            paths.emplace_back(argv[i]);
+    }
+
+    if (paths.empty())
+    {
+        paths.emplace_back(PROJECT_ROOT "/ball/ball.obj");
+        paths.emplace_back(PROJECT_ROOT "/pin/pin.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice7/suzanne.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice5/cow.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice4/bunny_lowres.obj");
+    }
+
+    bool ok = true;
+
+    std::cout << "ACMR and ATVR for 16 / 32 entry FIFO caches" << std::endl;
+
+    for (auto const & path : paths)
+    {
+        auto mesh = parse_obj(path);
+
+        if (shuffle)
+        {
+            std::vector<std::array<std::uint32_t, 3>> triangles(mesh.indices.size() / 3);
+            std::copy(mesh.indices.begin(), mesh.indices.end(), triangles.front().begin());
+            std::shuffle(triangles.begin(), triangles.end(), std::mt19937{42});
+            std::copy(triangles.front().begin(), triangles.front().begin() + mesh.indices.size(), mesh.indices.begin());
+        }
+
+        auto const triangles = triangle_set(mesh);
+
+        std::cout << path.filename().string() << ": " << mesh.vertices.size() << " vertices, "
+            << mesh.indices.size() / 3 << " triangles" << std::endl;
+
+        report("input", mesh, 0.0);
+
+        double t = measure([&]{ optimize_vertex_cache(mesh.indices, mesh.vertices.size()); });
+        report("vertex cache", mesh, t);
+
+        t = measure([&]{ optimize_overdraw(mesh.indices, mesh.vertices); });
+        report("overdraw", mesh, t);
+
+        t = measure([&]{ optimize_vertex_fetch(mesh.vertices, mesh.indices); });
+        report("vertex fetch", mesh, t);
+
+        if (triangle_set(mesh) != triangles)
+        {
+            std::cout << "    triangle set changed!" << std::endl;
+            ok = false;
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
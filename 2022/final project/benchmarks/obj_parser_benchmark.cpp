@@ -0,0 +1,252 @@
+// Throughput of parse_obj against the previous istringstream-per-line parser,
+// and of the parallel mode for increasing thread counts.
+//
+// Usage: obj_parser_benchmark [--synthetic <megabytes>] [file.obj ...]
+// Without files the bundled ball and pin meshes are used. --synthetic writes a
+// grid mesh of roughly the given size to the temp directory and adds it.
+// Finally the binary cache is timed cold (parse + write) and warm, on a copy of
+// every input in the temp directory, so that no .cache file is left next to
+// the inputs.
+
+#include "obj_parser.hpp"
+#include "obj_cache.hpp"
+#include "synthetic_obj.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace legacy
+{
+
+    obj_data parse_obj(std::filesystem::path const & path)
+    {
+        std::ifstream is(path);
+
+        std::vector<std::array<float, 3>> positions;
+        std::vector<std::array<float, 3>> normals;
+        std::vector<std::array<float, 2>> texcoords;
+
+        std::map<std::array<std::int32_t, 3>, std::uint32_t> index_map;
+
+        obj_data result;
+
+        std::string line;
+
+        while (std::getline(is >> std::ws, line))
+        {
+            if (line.empty()) continue;
+
+            if (line[0] == '#') continue;
+
+            std::istringstream ls(std::move(line));
+
+            std::string tag;
+            ls >> tag;
+
+            if (tag == "v")
+            {
+                auto & p = positions.emplace_back();
+                ls >> p[0] >> p[1] >> p[2];
+            }
+            else if (tag == "vn")
+            {
+                auto & n = normals.emplace_back();
+                ls >> n[0] >> n[1] >> n[2];
+            }
+            else if (tag == "vt")
+            {
+                auto & t = texcoords.emplace_back();
+                ls >> t[0] >> t[1];
+            }
+            else if (tag == "f")
+            {
+                std::vector<std::uint32_t> vertices;
+
+                while (ls)
+                {
+                    std::array<std::int32_t, 3> index{0, 0, 0};
+                    bool has_texcoord = false;
+                    bool has_normal = false;
+
+                    ls >> index[0];
+                    if (ls.eof()) break;
+
+                    if (!std::isspace(ls.peek()) && !ls.eof())
+                    {
+                        ls.get();
+                        if (ls.peek() != '/')
+                        {
+                            ls >> index[1];
+                            has_texcoord = true;
+                            if (!std::isspace(ls.peek()) && !ls.eof())
+                            {
+                                ls.get();
+                                ls >> index[2];
+                                has_normal = true;
+                            }
+                        }
+                        else
+                        {
+                            ls.get();
+                            ls >> index[2];
+                            has_normal = true;
+                        }
+                    }
+
+                    index[0] = (index[0] > 0) ? index[0] - 1 : positions.size() + index[0];
+                    index[1] = has_texcoord ? ((index[1] > 0) ? index[1] - 1 : texcoords.size() + index[1]) : -1;
+                    index[2] = has_normal ? ((index[2] > 0) ? index[2] - 1 : normals.size() + index[2]) : -1;
+
+                    auto it = index_map.find(index);
+                    if (it == index_map.end())
+                    {
+                        it = index_map.insert({index, result.vertices.size()}).first;
+
+                        auto & v = result.vertices.emplace_back();
+                        v.position = positions[index[0]];
+                        v.texcoord = (index[1] != -1) ? texcoords[index[1]] : std::array<float, 2>{0.f, 0.f};
+                        v.normal = (index[2] != -1) ? normals[index[2]] : std::array<float, 3>{0.f, 0.f, 0.f};
+                    }
+
+                    vertices.push_back(it->second);
+                }
+
+                for (std::size_t i = 1; i + 1 < vertices.size(); ++i)
+                {
+                    result.indices.push_back(vertices[0]);
+                    result.indices.push_back(vertices[i]);
+                    result.indices.push_back(vertices[i + 1]);
+                }
+            }
+        }
+
+        return result;
+    }
+
+}
+
+namespace
+{
+
+    bool same(obj_data const & a, obj_data const & b)
+    {
+        return a.indices == b.indices
+            && a.vertices.size() == b.vertices.size()
+            && std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(obj_data::vertex)) == 0;
+    }
+
+    template <typename Parser>
+    double throughput(Parser && parser, std::filesystem::path const & path, obj_data & out)
+    {
+        using clock = std::chrono::steady_clock;
+
+        double const megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+
+        // Repeat small files until at least ~64 MB went through the parser
+        int const runs = std::max(1, static_cast<int>(64.0 / std::max(megabytes, 1e-3)));
+
+        out = parser(path);
+
+        auto start = clock::now();
+        for (int i = 0; i < runs; ++i)
+            out = parser(path);
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        return megabytes * runs / seconds;
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::filesystem::path> paths;
+    std::size_t synthetic = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--synthetic" && i + 1 < argc)
+            synthetic = std::stoul(argv[++i]);
+        else
+            paths.emplace_back(argv[i]);
+    }
+
+    if (paths.empty())
+    {
+        paths.emplace_back(PROJECT_ROOT "/ball/ball.obj");
+        paths.emplace_back(PROJECT_ROOT "/pin/pin.obj");
+    }
+
+    if (synthetic > 0)
+        paths.push_back(generate_synthetic_obj(synthetic));
+
+    unsigned int const max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    bool ok = true;
+
+    for (auto const & path : paths)
+    {
+        obj_data old_result, new_result;
+
+        double old_speed = throughput(legacy::parse_obj, path, old_result);
+        double new_speed = throughput([](auto const & p){ return parse_obj(p); }, path, new_result);
+
+        bool match = same(old_result, new_result);
+        ok = ok && match;
+
+        std::cout << path.filename().string() << ": "
+            << new_result.vertices.size() << " vertices, " << new_result.indices.size() / 3 << " triangles\n"
+            << "    istringstream: " << old_speed << " MB/s\n"
+            << "    mmap:          " << new_speed << " MB/s (x" << new_speed / old_speed << ")\n"
+            << "    output " << (match ? "identical" : "DIFFERS") << std::endl;
+
+        for (unsigned int threads = 2; threads <= max_threads; threads *= 2)
+        {
+            obj_data parallel_result;
+            double parallel_speed = throughput([threads](auto const & p){ return parse_obj(p, {threads}); }, path, parallel_result);
+
+            bool parallel_match = same(new_result, parallel_result);
+            ok = ok && parallel_match;
+
+            std::cout << "    " << threads << " threads:" << std::string(threads < 10 ? 6 : 5, ' ')
+                << parallel_speed << " MB/s (x" << parallel_speed / new_speed << " over serial), output "
+                << (parallel_match ? "identical" : "DIFFERS") << std::endl;
+        }
+
+        {
+            obj_parse_options options;
+            options.use_cache = true;
+
+            auto const copy = std::filesystem::temp_directory_path() / ("obj_parser_benchmark_" + path.filename().string());
+            std::filesystem::copy_file(path, copy, std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::remove(obj_cache_path(copy));
+
+            auto start = std::chrono::steady_clock::now();
+            obj_data cold_result = parse_obj(copy, options);
+            double cold_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            obj_data warm_result;
+            double warm_speed = throughput([&options](auto const & p){ return parse_obj(p, options); }, copy, warm_result);
+
+            std::filesystem::remove(obj_cache_path(copy));
+            std::filesystem::remove(copy);
+
+            bool cache_match = same(new_result, cold_result) && same(new_result, warm_result);
+            ok = ok && cache_match;
+
+            std::cout << "    cache:         " << cold_ms << " ms cold, " << warm_speed << " MB/s warm (x"
+                << warm_speed / new_speed << " over parsing), output " << (cache_match ? "identical" : "DIFFERS") << std::endl;
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,137 @@
+// Peak resident memory of parse_obj against parse_obj_stream.
+//
+// Usage: obj_stream_benchmark [--synthetic <megabytes>] [--limit <megabytes>] [file.obj]
+// Defaults to a 2048 MB synthetic grid and a 64 MB stream limit. Each mode
+// runs in a child process so that its peak RSS is measured in isolation.
+// Both modes print a hash of the triangle soup (the vertex records of every
+// corner in order), which must agree since only the vertex numbering differs.
+// POSIX only.
+
+#include "obj_parser.hpp"
+#include "synthetic_obj.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+    struct soup_hash
+    {
+        std::uint64_t value = 0xcbf29ce484222325ull;
+
+        void add(obj_data::vertex const & v)
+        {
+            unsigned char bytes[sizeof(v)];
+            std::memcpy(bytes, &v, sizeof(v));
+            for (auto b : bytes)
+                value = (value ^ b) * 0x100000001b3ull;
+        }
+    };
+
+    void run_parse(std::filesystem::path const & path)
+    {
+        auto start = std::chrono::steady_clock::now();
+        obj_data data = parse_obj(path);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        soup_hash hash;
+        for (auto i : data.indices)
+            hash.add(data.vertices[i]);
+
+        std::cout << "parse_obj:        " << seconds << " s, " << data.vertices.size() << " vertices, "
+            << data.indices.size() / 3 << " triangles, hash " << std::hex << hash.value << std::dec << std::endl;
+    }
+
+    void run_stream(std::filesystem::path const & path, std::size_t limit)
+    {
+        soup_hash hash;
+
+        obj_stream_options options;
+        options.memory_limit = limit;
+
+        auto start = std::chrono::steady_clock::now();
+        auto stats = parse_obj_stream(path, [&](obj_chunk const & chunk){
+            for (auto i : chunk.indices)
+                hash.add(chunk.vertices[i - chunk.first_vertex]);
+        }, options);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "parse_obj_stream: " << seconds << " s, " << stats.vertex_count << " vertices, "
+            << stats.index_count / 3 << " triangles in " << stats.chunk_count << " chunks, hash "
+            << std::hex << hash.value << std::dec << std::endl;
+    }
+
+    template <typename Function>
+    long peak_rss_kb(Function && function)
+    {
+        std::cout.flush();
+
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("fork failed");
+
+        if (pid == 0)
+        {
+            int status = EXIT_SUCCESS;
+            try
+            {
+                function();
+            }
+            catch (std::exception const & e)
+            {
+                std::cerr << e.what() << std::endl;
+                status = EXIT_FAILURE;
+            }
+            std::cout.flush();
+            _exit(status);
+        }
+
+        int status = 0;
+        rusage usage{};
+        wait4(pid, &status, 0, &usage);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+            throw std::runtime_error("benchmark child failed");
+        return usage.ru_maxrss;
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::size_t synthetic = 2048;
+    std::size_t limit = 64;
+    std::filesystem::path path;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--synthetic" && i + 1 < argc)
+            synthetic = std::stoul(argv[++i]);
+        else if (arg == "--limit" && i + 1 < argc)
+            limit = std::stoul(argv[++i]);
+        else
+            path = arg;
+    }
+
+    if (path.empty())
+        path = generate_synthetic_obj(synthetic);
+
+    std::cout << path.string() << ": " << std::filesystem::file_size(path) / (1024 * 1024) << " MB" << std::endl;
+
+    long stream_rss = peak_rss_kb([&]{ run_stream(path, limit << 20); });
+    long parse_rss = peak_rss_kb([&]{ run_parse(path); });
+
+    std::cout << "peak RSS: parse_obj " << parse_rss / 1024 << " MB, parse_obj_stream (" << limit << " MB limit) "
+        << stream_rss / 1024 << " MB" << std::endl;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,262 @@
+// CPU cost of submitting the alley's meshes each frame, the shadow pass and
+// the main pass, without a GL context: GL calls are replaced by counters,
+// so the times are the renderer's own work and the counts tell how much it
+// hands the driver. The old way is draw_mesh as main.cpp had it, looping
+// over the meshes twice per pass (opaque, then transparent), building the
+// texture paths and looking them up by string, setting culling and blending
+// for every mesh. The new way resolves the materials to texture handles at
+// load time, as main.cpp does with texture_holder's array textures (three
+// uniforms each: sampler, layer and transform), then every frame pushes the
+// meshes into a render_queue, sorts it and submits it, only sending the
+// state that changes.
+//
+// Usage: render_queue_benchmark [file.gltf]
+// Without a file the bowling alley is used. Every mesh is taken as visible.
+
+#include "gltf_loader.hpp"
+#include "render_queue.hpp"
+#include "measure.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+    constexpr int frames = 2000;
+
+    // Stands in for the GL calls of a frame
+    struct gl_counter
+    {
+        std::size_t state = 0;
+        std::size_t uniforms = 0;
+        std::size_t draws = 0;
+        // What was sent, so that the compiler cannot drop the arguments
+        std::size_t checksum = 0;
+
+        void set_state(std::size_t value) { ++state; checksum += value; }
+        void set_uniform(std::size_t value) { ++uniforms; checksum += value; }
+        void draw(std::size_t value) { ++draws; checksum += value; }
+    };
+
+    // As in main.cpp
+    struct alley_material
+    {
+        std::optional<std::size_t> albedo_texture;
+        std::optional<std::size_t> normal_texture;
+        std::optional<std::size_t> roughness_texture;
+        glm::vec4 color{1.f};
+        bool two_sided = false;
+        bool transparent = false;
+
+        bool operator == (alley_material const &) const = default;
+    };
+
+    constexpr std::uint32_t no_material = -1;
+    constexpr std::uint32_t shadow_program = 1, alley_program = 2, alley_vao = 1;
+
+    // texture_holder's map from path to unit
+    using texture_units = std::unordered_map<std::string, int>;
+
+    int get_texture(texture_units const & units, std::string const & path)
+    {
+        return units.at(path);
+    }
+
+    void draw_mesh(gltf_model const & model, std::filesystem::path const & alley_path, texture_units const & units,
+        bool transparent, std::size_t index, gl_counter & gl)
+    {
+        auto const & mesh = model.meshes[index];
+        if (mesh.material.transparent != transparent)
+            return;
+
+        gl.set_state(mesh.material.two_sided);
+        gl.set_state(transparent);
+
+        if (mesh.material.ambient_texture)
+        {
+            auto ambient_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.ambient_texture;
+            gl.set_uniform(get_texture(units, ambient_path));
+            gl.set_uniform(1);
+        }
+        else if (mesh.material.color)
+        {
+            gl.set_uniform(0);
+            gl.set_uniform(std::size_t(mesh.material.color->x));
+        }
+        else
+            return;
+
+        if (mesh.material.normal_texture)
+        {
+            auto normal_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.normal_texture;
+            gl.set_uniform(get_texture(units, normal_path));
+        }
+        gl.set_uniform(mesh.material.normal_texture ? 1 : 0);
+        if (mesh.material.roughness_texture)
+        {
+            auto roughness_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.roughness_texture;
+            gl.set_uniform(get_texture(units, roughness_path));
+        }
+        gl.set_uniform(mesh.material.roughness_texture ? 1 : 0);
+
+        gl.draw(index);
+    }
+
+    // The sampler, layer and transform uniforms of an array texture
+    void bind_array_texture(std::size_t handle, gl_counter & gl)
+    {
+        gl.set_uniform(handle);
+        gl.set_uniform(handle);
+        gl.set_uniform(handle);
+    }
+
+    void submit(std::span<render_item const> items, material_table<alley_material> const & materials, bool bind_materials,
+        gl_counter & gl)
+    {
+        bool culling = true;
+        submit_render_items(items, [&](render_item const & item, unsigned changes)
+        {
+            render_key const key = render_key::unpack(item.key);
+            if (changes & render_program_changed)
+                gl.set_state(key.program);
+            if (changes & render_vertex_array_changed)
+                gl.set_state(key.vertex_array);
+            if (changes & render_blend_changed)
+            {
+                gl.set_state(key.blend);
+                gl.set_state(key.blend);
+            }
+            if (changes & render_material_changed)
+            {
+                auto const & material = materials[key.material];
+                if (material.two_sided == culling)
+                {
+                    culling = !material.two_sided;
+                    gl.set_state(culling);
+                }
+                if (bind_materials)
+                {
+                    if (material.albedo_texture)
+                    {
+                        bind_array_texture(*material.albedo_texture, gl);
+                        gl.set_uniform(1);
+                    }
+                    else
+                    {
+                        gl.set_uniform(0);
+                        gl.set_uniform(std::size_t(material.color.x));
+                    }
+                    if (material.normal_texture)
+                        bind_array_texture(*material.normal_texture, gl);
+                    gl.set_uniform(bool(material.normal_texture));
+                    if (material.roughness_texture)
+                        bind_array_texture(*material.roughness_texture, gl);
+                    gl.set_uniform(bool(material.roughness_texture));
+                }
+            }
+            gl.draw(item.draw);
+        });
+        gl.set_state(0);
+    }
+
+    void print(char const * name, double seconds, gl_counter const & gl)
+    {
+        std::printf("    %-14s %7.2f us per frame, per frame: %4zu state changes, %4zu uniforms, %3zu draws\n", name,
+            seconds / frames * 1e6, gl.state / frames, gl.uniforms / frames, gl.draws / frames);
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::filesystem::path const path = argc > 1 ? argv[1] : PROJECT_ROOT "/bowling_alley_mozilla_hubs_room/scene.gltf";
+    auto const model = load_gltf(path);
+    auto const directory = path.parent_path();
+
+    texture_units units;
+    auto const load_texture = [&](std::string const & texture_path)
+    {
+        return units.try_emplace(texture_path, 3 + int(units.size())).first->second;
+    };
+
+    material_table<alley_material> materials;
+    std::vector<std::uint32_t> mesh_materials;
+    for (auto const & mesh : model.meshes)
+    {
+        alley_material material;
+        material.two_sided = mesh.material.two_sided;
+        material.transparent = mesh.material.transparent;
+        if (mesh.material.ambient_texture)
+            material.albedo_texture = load_texture(directory / *mesh.material.ambient_texture);
+        else if (mesh.material.color)
+            material.color = *mesh.material.color;
+        else
+        {
+            mesh_materials.push_back(no_material);
+            continue;
+        }
+        if (mesh.material.normal_texture)
+            material.normal_texture = load_texture(directory / *mesh.material.normal_texture);
+        if (mesh.material.roughness_texture)
+            material.roughness_texture = load_texture(directory / *mesh.material.roughness_texture);
+        mesh_materials.push_back(materials.add(material));
+    }
+
+    std::printf("%zu meshes, %zu materials, %zu textures, %d frames of a shadow and a main pass\n", model.meshes.size(),
+        materials.size(), units.size(), frames);
+
+    gl_counter old_gl;
+    double const old_seconds = measure([&]{
+        for (int frame = 0; frame < frames; ++frame)
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                for (std::size_t i = 0; i < model.meshes.size(); ++i)
+                    draw_mesh(model, path, units, false, i, old_gl);
+                for (std::size_t i = 0; i < model.meshes.size(); ++i)
+                    draw_mesh(model, path, units, true, i, old_gl);
+            }
+    });
+
+    render_queue queue;
+    gl_counter queue_gl;
+    double build_seconds = 0.0, submit_seconds = 0.0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        build_seconds += measure([&]{
+            queue.clear();
+            for (std::size_t i = 0; i < model.meshes.size(); ++i)
+            {
+                std::uint32_t const handle = mesh_materials[i];
+                if (handle == no_material)
+                    continue;
+                bool const blend = materials[handle].transparent;
+                queue.push({0, blend, shadow_program, handle, alley_vao}, std::uint32_t(i));
+                queue.push({1, blend, alley_program, handle, alley_vao}, std::uint32_t(i));
+            }
+            queue.sort();
+        });
+        submit_seconds += measure([&]{
+            submit(queue.pass(0), materials, false, queue_gl);
+            submit(queue.pass(1), materials, true, queue_gl);
+        });
+    }
+
+    print("draw_mesh", old_seconds, old_gl);
+    print("render_queue", build_seconds + submit_seconds, queue_gl);
+    std::printf("    of which %.2f us building and sorting the queue, %.2f us submitting (%.1fx faster)\n",
+        build_seconds / frames * 1e6, submit_seconds / frames * 1e6, old_seconds / (build_seconds + submit_seconds));
+    std::printf("checksums %zu %zu\n", old_gl.checksum, queue_gl.checksum);
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+// Culling scenes of growing size with scene_bvh, against testing every box
+// with cull_boxes. The scenes are boxes scattered over a square of the same
+// density, so that a bigger scene is a wider one, around a camera turning
+// in place at its center with the game's projection and a far plane of 100:
+// about the same number of boxes is visible whatever the scene's size. Every
+// frame one box in a hundred, up to a thousand, moves a little and the tree
+// is refitted. Checks that both find the same boxes.
+//
+// Usage: scene_bvh_benchmark [box count ...]
+// Without counts 1000, 10000, 100000 and 1000000 boxes are culled.
+
+#include "scene_bvh.hpp"
+#include "simd_batch.hpp"
+#include "measure.hpp"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr int frames = 32;
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::size_t> counts;
+    for (int i = 1; i < argc; ++i)
+        counts.push_back(std::stoul(argv[i]));
+    if (counts.empty())
+        counts = {1000, 10000, 100000, 1000000};
+
+    glm::mat4 const projection = glm::perspective(glm::pi<float>() / 3.f, 16.f / 9.f, 0.1f, 100.f);
+
+    std::printf("%zu lanes, %d frames\n", simd_batch::size, frames);
+
+    for (std::size_t count : counts)
+    {
+        std::default_random_engine random;
+        float const half_side = std::sqrt(float(count)) * 2.f;
+        std::uniform_real_distribution<float> position(-half_side, half_side);
+        std::uniform_real_distribution<float> height(0.f, 4.f);
+        std::uniform_real_distribution<float> size(0.25f, 1.5f);
+        std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+        std::uniform_int_distribution<std::size_t> pick(0, count - 1);
+
+        box_set boxes;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            glm::vec3 const center(position(random), height(random), position(random));
+            glm::vec3 const extent(size(random), size(random), size(random));
+            boxes.add(center - extent, center + extent);
+        }
+
+        scene_bvh bvh;
+        double const build_seconds = measure([&]{ bvh.build(boxes); });
+
+        std::size_t const moving = std::min<std::size_t>(count / 100, 1000);
+        double refit_seconds = 0.0, bvh_seconds = 0.0, flat_seconds = 0.0;
+        std::size_t visible_total = 0, mismatches = 0;
+        std::vector<std::uint32_t> visible;
+        visibility_bits bits;
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            std::vector<std::size_t> moved(moving);
+            for (auto & object : moved)
+            {
+                object = pick(random);
+                glm::vec3 const offset(step(random), step(random), step(random));
+                boxes.center_x[object] += offset.x;
+                boxes.center_y[object] += offset.y;
+                boxes.center_z[object] += offset.z;
+            }
+
+            refit_seconds += measure([&]{
+                for (auto object : moved)
+                {
+                    glm::vec3 const center(boxes.center_x[object], boxes.center_y[object], boxes.center_z[object]);
+                    glm::vec3 const extent(boxes.extent_x[object], boxes.extent_y[object], boxes.extent_z[object]);
+                    bvh.update(object, center - extent, center + extent);
+                }
+                bvh.refit();
+            });
+
+            glm::mat4 view = glm::lookAt(glm::vec3(0.f, 2.f, 0.f),
+                glm::vec3(std::cos(frame * 0.2f), 2.f, std::sin(frame * 0.2f)), glm::vec3(0.f, 1.f, 0.f));
+            auto const planes = frustum_planes(projection * view);
+
+            bvh_seconds += measure([&]{ bvh.cull(planes, visible); });
+            flat_seconds += measure([&]{ cull_boxes(boxes, planes, bits); });
+
+            visible_total += visible.size();
+            std::size_t flat_visible = 0;
+            for (std::size_t i = 0; i < count; ++i)
+                flat_visible += is_visible(bits, i);
+            for (auto object : visible)
+                mismatches += !is_visible(bits, object);
+            mismatches += flat_visible - std::min(flat_visible, visible.size());
+        }
+
+        std::printf("%7zu boxes, %zu nodes, built in %.1f ms, %.0f visible\n", count, bvh.node_count(),
+            build_seconds * 1e3, double(visible_total) / frames);
+        std::printf("    refit %4zu moved  %8.3f ms per frame\n", moving, refit_seconds / frames * 1e3);
+        std::printf("    scene_bvh        %8.3f ms per frame\n", bvh_seconds / frames * 1e3);
+        std::printf("    cull_boxes       %8.3f ms per frame\n", flat_seconds / frames * 1e3);
+        if (mismatches != 0)
+        {
+            std::printf("    %zu boxes culled differently\n", mismatches);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Grid of quads with positions, texcoords and normals of roughly the given
+// size, written to the temp directory once and reused afterwards. Every other
+// row uses relative indices.
+inline std::filesystem::path generate_synthetic_obj(std::size_t megabytes)
+{
+    auto path = std::filesystem::temp_directory_path() / ("synthetic_" + std::to_string(megabytes) + "mb.obj");
+    if (std::filesystem::exists(path))
+        return path;
+
+    // ~155 bytes of text per grid vertex including its faces
+    std::size_t const side = static_cast<std::size_t>(std::sqrt(megabytes * 1024.0 * 1024.0 / 155.0)) + 2;
+
+    std::ofstream out(path);
+    out.precision(6);
+    out << std::fixed;
+    for (std::size_t y = 0; y < side; ++y)
+    {
+        for (std::size_t x = 0; x < side; ++x)
+        {
+            float u = x / float(side - 1), v = y / float(side - 1);
+            out << "v " << u << ' ' << std::sin(u * 17.f) * std::cos(v * 13.f) << ' ' << v << '\n';
+            out << "vt " << u << ' ' << v << '\n';
+            out << "vn 0.000000 1.000000 0.000000\n";
+        }
+        if (y == 0) continue;
+
+        for (std::size_t x = 1; x < side; ++x)
+        {
+            if (y % 2)
+            {
+                auto i = [&](std::size_t yy, std::size_t xx){ return yy * side + xx + 1; };
+                std::size_t a = i(y - 1, x - 1), b = i(y - 1, x), c = i(y, x), d = i(y, x - 1);
+                out << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b << '/' << b << ' '
+                    << c << '/' << c << '/' << c << ' ' << d << '/' << d << '/' << d << '\n';
+            }
+            else
+            {
+                auto r = [&](std::size_t yy, std::size_t xx){ return -std::int64_t((y - yy) * side + side - xx); };
+                auto a = r(y - 1, x - 1), b = r(y - 1, x), c = r(y, x), d = r(y, x - 1);
+                out << "f " << a << '/' << a << '/' << a << ' ' << b << '/' << b << '/' << b << ' '
+                    << c << '/' << c << '/' << c << ' ' << d << '/' << d << '/' << d << '\n';
+            }
+        }
+    }
+
+    return path;
+}
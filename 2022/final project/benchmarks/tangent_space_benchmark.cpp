@@ -0,0 +1,177 @@
+// Time compute_normals and compute_tangents take on a large torus, against a
+// plain scalar loop that scatters face normals into the vertices, for a few
+// thread counts. The results are checked against the scalar loop and the
+// analytic normals and tangents of the torus.
+//
+// Usage: tangent_space_benchmark [million_triangles]
+// The default is 10 million triangles, about 700 MB of memory at the peak.
+
+#include "tangent_space.hpp"
+#include "measure.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+    struct vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texcoord;
+    };
+
+    struct torus
+    {
+        std::vector<vertex> vertices;
+        std::vector<std::uint32_t> indices;
+
+        // Analytic values, for checking
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec3> tangents;
+    };
+
+    // Texcoord u goes around the tube's axis, v around the tube; the seams
+    // duplicate their vertices, as an exporter would
+    torus generate_torus(std::size_t triangles)
+    {
+        std::size_t const around = std::size_t(std::sqrt(triangles / 2.0 * 4.0));
+        std::size_t const tube = std::max<std::size_t>(3, triangles / 2 / around);
+        float const major = 1.f, minor = 0.3f;
+
+        torus result;
+        result.vertices.reserve((around + 1) * (tube + 1));
+        for (std::size_t i = 0; i <= around; ++i)
+        {
+            float const u = float(i) / around;
+            float const a = 2.f * glm::pi<float>() * u;
+            for (std::size_t j = 0; j <= tube; ++j)
+            {
+                float const v = float(j) / tube;
+                float const b = 2.f * glm::pi<float>() * v;
+                glm::vec3 const normal(std::cos(a) * std::cos(b), std::sin(b), std::sin(a) * std::cos(b));
+                glm::vec3 const center(std::cos(a) * major, 0.f, std::sin(a) * major);
+                result.vertices.push_back({center + normal * minor, glm::vec3(0.f), {u, v}});
+                result.normals.push_back(normal);
+                result.tangents.emplace_back(-std::sin(a), 0.f, std::cos(a));
+            }
+        }
+
+        result.indices.reserve(around * tube * 6);
+        for (std::size_t i = 0; i < around; ++i)
+        {
+            for (std::size_t j = 0; j < tube; ++j)
+            {
+                auto const i0 = std::uint32_t(i * (tube + 1) + j), i1 = i0 + 1;
+                auto const i2 = std::uint32_t(i0 + tube + 1), i3 = i2 + 1;
+                result.indices.insert(result.indices.end(), {i0, i1, i2, i2, i1, i3});
+            }
+        }
+
+        return result;
+    }
+
+    // The usual loop, as fill_normals in the 2021 practices
+    void reference_normals(std::vector<vertex> & vertices, std::vector<std::uint32_t> const & indices)
+    {
+        for (auto & v : vertices)
+            v.normal = glm::vec3(0.f);
+
+        for (std::size_t i = 0; i < indices.size(); i += 3)
+        {
+            auto & v0 = vertices[indices[i + 0]];
+            auto & v1 = vertices[indices[i + 1]];
+            auto & v2 = vertices[indices[i + 2]];
+
+            glm::vec3 const n = glm::cross(v1.position - v0.position, v2.position - v0.position);
+            v0.normal += n;
+            v1.normal += n;
+            v2.normal += n;
+        }
+
+        for (auto & v : vertices)
+            v.normal = glm::normalize(v.normal);
+    }
+
+    float angle_degrees(glm::vec3 const & a, glm::vec3 const & b)
+    {
+        return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::size_t const triangles = std::size_t((argc > 1 ? std::stod(argv[1]) : 10.0) * 1e6);
+
+    auto mesh = generate_torus(triangles);
+    auto & vertices = mesh.vertices;
+    std::printf("torus: %zu vertices, %zu triangles\n", vertices.size(), mesh.indices.size() / 3);
+#if defined(__AVX__)
+    std::printf("    AVX, 8 triangles per tangent batch\n");
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    std::printf("    SSE2, 4 triangles per tangent batch\n");
+#else
+    std::printf("    no SIMD\n");
+#endif
+
+    double const reference_seconds = measure([&]{ reference_normals(vertices, mesh.indices); });
+    std::printf("    %-24s %8.1f ms\n", "scalar scatter normals", reference_seconds * 1e3);
+    std::vector<glm::vec3> reference(vertices.size());
+    std::transform(vertices.begin(), vertices.end(), reference.begin(), [](vertex const & v){ return v.normal; });
+
+    std::vector<unsigned int> thread_counts{1, 2, 4};
+    if (unsigned int const hardware = std::thread::hardware_concurrency(); hardware > 4)
+        thread_counts.push_back(hardware);
+
+    std::vector<glm::vec4> tangents(vertices.size());
+    for (auto threads : thread_counts)
+    {
+        double const normal_seconds = measure([&]{
+            compute_normals(mesh.indices, &vertices[0].position.x, sizeof(vertex), vertices.size(),
+                &vertices[0].normal.x, sizeof(vertex), threads);
+        });
+        double const tangent_seconds = measure([&]{
+            compute_tangents(mesh.indices, &vertices[0].position.x, sizeof(vertex), &vertices[0].normal.x, sizeof(vertex),
+                &vertices[0].texcoord.x, sizeof(vertex), vertices.size(), &tangents[0].x, sizeof(glm::vec4), threads);
+        });
+        std::printf("    %2u thread%s  normals %8.1f ms (%.2fx)  tangents %8.1f ms\n", threads, threads > 1 ? "s" : " ",
+            normal_seconds * 1e3, reference_seconds / normal_seconds, tangent_seconds * 1e3);
+    }
+
+    float reference_error = 0.f, normal_error = 0.f, tangent_error = 0.f;
+    std::size_t mirrored = 0;
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        reference_error = std::max(reference_error, angle_degrees(vertices[i].normal, reference[i]));
+        normal_error = std::max(normal_error, angle_degrees(vertices[i].normal, mesh.normals[i]));
+        tangent_error = std::max(tangent_error, angle_degrees(glm::vec3(tangents[i]), mesh.tangents[i]));
+        mirrored += tangents[i].w < 0.f;
+    }
+
+    std::printf("    largest angle to the scalar normals %.6f, to the analytic normals %.4f and tangents %.4f degrees\n",
+        reference_error, normal_error, tangent_error);
+    std::printf("    %zu mirrored tangents\n", mirrored);
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
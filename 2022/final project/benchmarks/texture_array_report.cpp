@@ -0,0 +1,104 @@
+// How a scene's textures pack into texture arrays, as texture_holder's
+// build_arrays would do it: the arrays, their layers, and the texture units
+// taken with and without arrays. Then a synthetic set of small textures,
+// the case the alley does not have, to show how full the atlas pages get
+// and how long packing takes.
+//
+// Usage: texture_array_report [directory ...]
+// Without directories the alley, ball, pin and environment textures are
+// used. Images are only read up to their size.
+
+#include "texture_packer.hpp"
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr std::uint32_t rgba8 = 0;
+
+    int mip_levels(int width, int height)
+    {
+        int levels = 1;
+        while ((std::max(width, height) >> levels) > 0)
+            ++levels;
+        return levels;
+    }
+
+    void print_arrays(texture_layout const & layout)
+    {
+        for (auto const & array : layout.arrays)
+            std::printf("    %4dx%-4d x %3d layers, %2d levels%s\n", array.width, array.height, array.layers, array.levels,
+                array.atlas ? ", atlas" : "");
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::filesystem::path> directories(argv + 1, argv + argc);
+    if (directories.empty())
+    {
+        directories.emplace_back(PROJECT_ROOT "/bowling_alley_mozilla_hubs_room/textures");
+        directories.emplace_back(PROJECT_ROOT "/ball");
+        directories.emplace_back(PROJECT_ROOT "/pin");
+        directories.emplace_back(PROJECT_ROOT "/textures");
+    }
+
+    std::vector<texture_request> requests;
+    for (auto const & directory : directories)
+        for (auto const & entry : std::filesystem::directory_iterator(directory))
+        {
+            auto const extension = entry.path().extension();
+            if (extension != ".png" && extension != ".jpg" && extension != ".jpeg")
+                continue;
+
+            int width, height, channels;
+            if (!stbi_info(entry.path().string().c_str(), &width, &height, &channels))
+                throw std::runtime_error("Failed to read " + entry.path().string() + ": " + stbi_failure_reason());
+            requests.push_back({width, height, mip_levels(width, height), rgba8, true});
+        }
+
+    auto const scene = pack_textures(requests);
+    std::printf("%zu textures: %zu units one per texture, %zu with arrays\n", requests.size(), requests.size(),
+        scene.arrays.size());
+    print_arrays(scene);
+
+    std::default_random_engine random;
+    std::uniform_int_distribution<int> size(2, 32);
+    std::vector<texture_request> small(2000);
+    std::size_t texels = 0;
+    for (auto & request : small)
+    {
+        request.width = 8 * size(random);
+        request.height = 8 * size(random);
+        request.levels = mip_levels(request.width, request.height);
+        texels += std::size_t(request.width) * request.height;
+    }
+
+    texture_layout atlas;
+    auto const start = std::chrono::steady_clock::now();
+    atlas = pack_textures(small);
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::size_t page_texels = 0;
+    for (auto const & array : atlas.arrays)
+        page_texels += std::size_t(array.width) * array.height * array.layers;
+    std::printf("%zu small textures, 16x16 to 256x256: packed in %.2f ms, %.0f%% of the atlas texels used\n",
+        small.size(), seconds * 1e3, 100.0 * texels / page_texels);
+    print_arrays(atlas);
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
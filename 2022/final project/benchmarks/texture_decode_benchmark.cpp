@@ -0,0 +1,114 @@
+// Time to decode every texture of the scene and build its mip chain, on the
+// calling thread and with texture_decoder pools of a few sizes. This is the
+// part of texture loading the asynchronous texture_holder takes off the GL
+// thread; the uploads themselves need a context and are reported by the game
+// ("All textures ready ... ms after start"). Textures cooked by
+// texture_cooker skip all of it, their loading time is measured last.
+//
+// Usage: texture_decode_benchmark [directory ...]
+// Without directories the alley, ball, pin and environment textures are used.
+
+#include "texture_decoder.hpp"
+#include "cooked_texture.hpp"
+#include "measure.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+    std::size_t total_bytes(std::vector<decoded_image> const & images)
+    {
+        std::size_t result = 0;
+        for (auto const & image : images)
+        {
+            if (!image.error.empty())
+                throw std::runtime_error(image.error);
+            for (auto const & level : image.levels)
+                result += level.size();
+        }
+        return result;
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::filesystem::path> directories(argv + 1, argv + argc);
+    if (directories.empty())
+    {
+        directories.emplace_back(PROJECT_ROOT "/bowling_alley_mozilla_hubs_room/textures");
+        directories.emplace_back(PROJECT_ROOT "/ball");
+        directories.emplace_back(PROJECT_ROOT "/pin");
+        directories.emplace_back(PROJECT_ROOT "/textures");
+    }
+
+    std::vector<std::string> paths;
+    for (auto const & directory : directories)
+        for (auto const & entry : std::filesystem::directory_iterator(directory))
+            if (auto const extension = entry.path().extension(); extension == ".png" || extension == ".jpg" || extension == ".jpeg")
+                paths.push_back(entry.path().string());
+
+    std::vector<decoded_image> images;
+    double const serial_seconds = measure([&]{
+        for (auto const & path : paths)
+            images.push_back(decode_image(path, true));
+    });
+    std::printf("%zu images, %.1f MB with mips\n", paths.size(), total_bytes(images) / 1e6);
+    std::printf("    %-10s %8.1f ms\n", "serial", serial_seconds * 1e3);
+
+    std::vector<unsigned int> thread_counts{1, 2, 4};
+    if (unsigned int const hardware = std::thread::hardware_concurrency(); hardware > 4)
+        thread_counts.push_back(hardware);
+
+    for (auto threads : thread_counts)
+    {
+        std::size_t bytes = 0;
+        double const seconds = measure([&]{
+            texture_decoder decoder(threads);
+            for (auto const & path : paths)
+                decoder.submit(path);
+            bytes = total_bytes(decoder.wait());
+        });
+        std::printf("    %2u thread%s %8.1f ms (%.2fx)%s\n", threads, threads > 1 ? "s" : " ", seconds * 1e3,
+            serial_seconds / seconds, bytes == total_bytes(images) ? "" : ", size mismatch");
+    }
+
+    // Everything the upload would read is touched
+    std::size_t cooked_count = 0, cooked_bytes = 0;
+    long checksum = 0;
+    double const cooked_seconds = measure([&]{
+        for (auto const & path : paths)
+        {
+            auto const cooked = load_cooked_texture(path);
+            if (!cooked)
+                continue;
+
+            ++cooked_count;
+            for (auto const & level : cooked->levels)
+            {
+                cooked_bytes += level.size();
+                checksum = std::accumulate(level.begin(), level.end(), checksum);
+            }
+        }
+    });
+    if (cooked_count > 0)
+        std::printf("    %-10s %8.1f ms for %zu cooked textures, %.1f MB (checksum %ld)\n", "cooked", cooked_seconds * 1e3,
+            cooked_count, cooked_bytes / 1e6, checksum);
+    else
+        std::printf("    no cooked textures, run texture_cooker first\n");
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
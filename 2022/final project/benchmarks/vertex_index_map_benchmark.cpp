@@ -0,0 +1,180 @@
+// Face corner deduplication: std::map (the previous parse_obj index map)
+// against vertex_index_map.
+//
+// Usage: vertex_index_map_benchmark [--scale N] [file.obj ...]
+// Without files the suzanne, cow and bunny_lowres meshes from the practices are
+// used. Every mesh is scaled up by replaying its corner stream N times (default
+// 64) with indices shifted past the previous copies, so the number of distinct
+// keys grows with N like it would for a larger scan.
+
+#include "vertex_index_map.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+    using key_type = vertex_index_map::key_type;
+
+    struct corner_stream
+    {
+        std::vector<key_type> keys;
+        std::array<std::int32_t, 3> counts{0, 0, 0};
+    };
+
+    // Only what the bundled meshes use: absolute v, v/t, v//n and v/t/n corners
+    corner_stream read_corners(std::filesystem::path const & path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            throw std::runtime_error("Failed to open " + path.string());
+
+        corner_stream result;
+
+        for (std::string line; std::getline(in, line);)
+        {
+            if (line.rfind("v ", 0) == 0) ++result.counts[0];
+            else if (line.rfind("vt ", 0) == 0) ++result.counts[1];
+            else if (line.rfind("vn ", 0) == 0) ++result.counts[2];
+            else if (line.rfind("f ", 0) == 0)
+            {
+                char const * ptr = line.c_str() + 2;
+                while (*ptr)
+                {
+                    key_type key{-1, -1, -1};
+                    int consumed = 0;
+                    if (std::sscanf(ptr, " %d/%d/%d%n", &key[0], &key[1], &key[2], &consumed) == 3
+                        || (key = {-1, -1, -1}, std::sscanf(ptr, " %d//%d%n", &key[0], &key[2], &consumed) == 2)
+                        || (key = {-1, -1, -1}, std::sscanf(ptr, " %d/%d%n", &key[0], &key[1], &consumed) == 2)
+                        || (key = {-1, -1, -1}, std::sscanf(ptr, " %d%n", &key[0], &consumed) == 1))
+                    {
+                        for (auto & i : key)
+                            if (i > 0) --i;
+                        result.keys.push_back(key);
+                        ptr += consumed;
+                    }
+                    else
+                        break;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    corner_stream scale(corner_stream const & stream, int factor)
+    {
+        corner_stream result;
+        result.keys.reserve(stream.keys.size() * factor);
+        for (int copy = 0; copy < factor; ++copy)
+        {
+            for (auto key : stream.keys)
+            {
+                for (int i = 0; i < 3; ++i)
+                    if (key[i] >= 0)
+                        key[i] += copy * stream.counts[i];
+                result.keys.push_back(key);
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+            result.counts[i] = stream.counts[i] * factor;
+        return result;
+    }
+
+    template <typename Dedup>
+    double measure(Dedup && dedup, std::vector<key_type> const & keys, std::size_t & unique)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // Best of a few runs to hide allocator warm-up
+        double best = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < 5; ++run)
+        {
+            auto start = clock::now();
+            unique = dedup(keys);
+            best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+        }
+        return best;
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    int factor = 64;
+    std::vector<std::filesystem::path> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--scale" && i + 1 < argc)
+            factor = std::stoi(argv[++i]);
+        else
+            paths.emplace_back(argv[i]);
+    }
+
+    if (paths.empty())
+    {
+        paths.emplace_back(PROJECT_ROOT "/../practice7/suzanne.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice5/cow.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice4/bunny_lowres.obj");
+    }
+
+    auto tree = [](std::vector<key_type> const & keys)
+    {
+        std::map<key_type, std::uint32_t> index_map;
+        std::vector<std::uint32_t> indices;
+        indices.reserve(keys.size());
+        for (auto const & key : keys)
+        {
+            auto it = index_map.find(key);
+            if (it == index_map.end())
+                it = index_map.insert({key, index_map.size()}).first;
+            indices.push_back(it->second);
+        }
+        return index_map.size();
+    };
+
+    bool ok = true;
+
+    for (auto const & path : paths)
+    {
+        auto const stream = scale(read_corners(path), factor);
+
+        auto flat = [&stream](std::vector<key_type> const & keys)
+        {
+            vertex_index_map index_map(std::max({stream.counts[0], stream.counts[1], stream.counts[2]}));
+            std::vector<std::uint32_t> indices;
+            indices.reserve(keys.size());
+            for (auto const & key : keys)
+                indices.push_back(index_map.insert(key, index_map.size()).first);
+            return index_map.size();
+        };
+
+        std::size_t tree_unique = 0, flat_unique = 0;
+        double tree_time = measure(tree, stream.keys, tree_unique);
+        double flat_time = measure(flat, stream.keys, flat_unique);
+
+        ok = ok && (tree_unique == flat_unique);
+
+        std::cout << path.filename().string() << " x" << factor << ": "
+            << stream.keys.size() << " corners, " << flat_unique << " unique vertices\n"
+            << "    std::map:         " << tree_time * 1e3 << " ms, " << stream.keys.size() / tree_time / 1e6 << " M corners/s\n"
+            << "    vertex_index_map: " << flat_time * 1e3 << " ms, " << stream.keys.size() / flat_time / 1e6 << " M corners/s"
+            << " (x" << tree_time / flat_time << ")" << std::endl;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,76 @@
+// Vertex buffer sizes of the float and packed layouts, the measured packing
+// error and its bound, and the time packing takes.
+//
+// Usage: vertex_packing_report [file.obj | file.gltf | file.glb ...]
+// Without files the ball, pin and bowling alley meshes are used.
+
+#include "vertex_packing.hpp"
+#include "obj_parser.hpp"
+#include "measure.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+
+    void report(std::string const & name, std::size_t vertex_count, std::size_t float_size, std::size_t packed_size,
+        position_quantization const & quantization, packing_error const & error, double seconds)
+    {
+        std::printf("%s: %zu vertices\n", name.c_str(), vertex_count);
+        std::printf("    vertex buffer  %zu -> %zu bytes (%.1f%%), packed in %.3f ms\n",
+            vertex_count * float_size, vertex_count * packed_size, 100.0 * packed_size / float_size, seconds * 1e3);
+        std::printf("    position error %.3g (bound %.3g, %.3g of the mesh size)\n",
+            error.position, quantization.error_bound(), error.position / quantization.scale);
+        std::printf("    direction error %.4f degrees, texcoord error %.3g\n", error.direction, error.texcoord);
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::filesystem::path> paths(argv + 1, argv + argc);
+    if (paths.empty())
+    {
+        paths.emplace_back(PROJECT_ROOT "/ball/ball.obj");
+        paths.emplace_back(PROJECT_ROOT "/pin/pin.obj");
+        paths.emplace_back(PROJECT_ROOT "/bowling_alley_mozilla_hubs_room/scene.gltf");
+    }
+
+    for (auto const & path : paths)
+    {
+        auto const name = path.filename().string();
+
+        if (path.extension() == ".gltf" || path.extension() == ".glb")
+        {
+            auto const model = load_gltf(path);
+
+            packed_gltf packed;
+            double t = measure([&]{ packed = pack_gltf(model); });
+
+            // position, vec4 tangent, normal, texcoord
+            std::size_t const float_size = (3 + 4 + 3 + 2) * sizeof(float);
+            report(name, packed.vertices.size(), float_size, sizeof(packed_tangent_vertex), packed.quantization,
+                packed.error, t);
+        }
+        else
+        {
+            auto const mesh = parse_obj(path);
+
+            packed_mesh packed;
+            double t = measure([&]{ packed = pack_vertices(mesh.vertices, &obj_data::vertex::texcoord); });
+
+            report(name, packed.vertices.size(), sizeof(obj_data::vertex), sizeof(packed_vertex), packed.quantization,
+                packed.error, t);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,555 @@
+#include "block_compression.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+    constexpr int bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    template <int N>
+    using vec = glm::vec<N, float>;
+
+    template <int N>
+    std::array<vec<N>, 16> to_vectors(rgba_block const & texels)
+    {
+        std::array<vec<N>, 16> result;
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < N; ++c)
+                result[i][c] = texels[i][c];
+        return result;
+    }
+
+    // Endpoints at the extremes of the colors projected on their principal
+    // axis, found by power iteration on the covariance matrix
+    template <int N>
+    std::pair<vec<N>, vec<N>> principal_endpoints(std::array<vec<N>, 16> const & colors)
+    {
+        vec<N> mean(0.f), min(std::numeric_limits<float>::infinity()), max(-std::numeric_limits<float>::infinity());
+        for (auto const & c : colors)
+        {
+            mean += c / 16.f;
+            min = glm::min(min, c);
+            max = glm::max(max, c);
+        }
+
+        float covariance[N][N] = {};
+        for (auto const & c : colors)
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    covariance[i][j] += (c[i] - mean[i]) * (c[j] - mean[j]);
+
+        vec<N> axis = max - min;
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            vec<N> next(0.f);
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    next[i] += covariance[i][j] * axis[j];
+
+            float const length = glm::length(next);
+            if (length < 1e-6f)
+                break;
+            axis = next / length;
+        }
+
+        float const length = glm::length(axis);
+        if (length < 1e-6f)
+            return {mean, mean};
+        axis /= length;
+
+        float low = std::numeric_limits<float>::infinity(), high = -low;
+        for (auto const & c : colors)
+        {
+            float const t = glm::dot(c - mean, axis);
+            low = std::min(low, t);
+            high = std::max(high, t);
+        }
+        return {glm::clamp(mean + axis * high, 0.f, 255.f), glm::clamp(mean + axis * low, 0.f, 255.f)};
+    }
+
+    // Endpoints minimizing the squared error for fixed interpolation weights
+    // (of the second endpoint); false if the system is degenerate
+    template <int N>
+    bool least_squares_endpoints(std::array<vec<N>, 16> const & colors, std::array<float, 16> const & weights,
+        vec<N> & e0, vec<N> & e1)
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        vec<N> ax(0.f), bx(0.f);
+        for (int i = 0; i < 16; ++i)
+        {
+            float const b = weights[i], a = 1.f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * colors[i];
+            bx += b * colors[i];
+        }
+
+        float const determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+
+        e0 = glm::clamp((ax * bb - bx * ab) / determinant, 0.f, 255.f);
+        e1 = glm::clamp((bx * aa - ax * ab) / determinant, 0.f, 255.f);
+        return true;
+    }
+
+    template <int N>
+    float squared_distance(vec<N> const & a, vec<N> const & b)
+    {
+        auto const d = a - b;
+        return glm::dot(d, d);
+    }
+
+    void store_u16(std::uint8_t * output, std::uint16_t value)
+    {
+        output[0] = std::uint8_t(value);
+        output[1] = std::uint8_t(value >> 8);
+    }
+
+    std::uint16_t load_u16(std::uint8_t const * input)
+    {
+        return std::uint16_t(input[0] | (input[1] << 8));
+    }
+
+    // BC1 colors
+
+    std::uint16_t pack_565(glm::vec3 const & color)
+    {
+        auto const r = std::uint16_t(std::lround(color.r * 31.f / 255.f));
+        auto const g = std::uint16_t(std::lround(color.g * 63.f / 255.f));
+        auto const b = std::uint16_t(std::lround(color.b * 31.f / 255.f));
+        return std::uint16_t((r << 11) | (g << 5) | b);
+    }
+
+    std::array<int, 3> unpack_565(std::uint16_t value)
+    {
+        int const r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+    }
+
+    // The four-color palette, c0 > c1 is assumed
+    std::array<glm::vec3, 4> bc1_palette(std::uint16_t c0, std::uint16_t c1)
+    {
+        auto const p0 = unpack_565(c0), p1 = unpack_565(c1);
+        std::array<glm::vec3, 4> result;
+        for (int c = 0; c < 3; ++c)
+        {
+            result[0][c] = float(p0[c]);
+            result[1][c] = float(p1[c]);
+            result[2][c] = float((2 * p0[c] + p1[c]) / 3);
+            result[3][c] = float((p0[c] + 2 * p1[c]) / 3);
+        }
+        return result;
+    }
+
+    struct bc1_fit
+    {
+        std::uint16_t c0 = 0;
+        std::uint16_t c1 = 0;
+        std::uint32_t indices = 0;
+        float error = std::numeric_limits<float>::infinity();
+    };
+
+    bc1_fit fit_bc1(std::array<glm::vec3, 16> const & colors, glm::vec3 const & e0, glm::vec3 const & e1)
+    {
+        bc1_fit result;
+        result.c0 = pack_565(e0);
+        result.c1 = pack_565(e1);
+        if (result.c0 < result.c1)
+            std::swap(result.c0, result.c1);
+
+        // Equal endpoints would select the three-color mode; index 0 is the
+        // endpoint color there too
+        if (result.c0 == result.c1)
+        {
+            auto const palette = bc1_palette(result.c0, result.c1);
+            result.error = 0.f;
+            for (auto const & c : colors)
+                result.error += squared_distance(c, palette[0]);
+            return result;
+        }
+
+        auto const palette = bc1_palette(result.c0, result.c1);
+        result.error = 0.f;
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0;
+            float best_error = std::numeric_limits<float>::infinity();
+            for (int j = 0; j < 4; ++j)
+            {
+                float const error = squared_distance(colors[i], palette[j]);
+                if (error < best_error)
+                {
+                    best = j;
+                    best_error = error;
+                }
+            }
+            result.indices |= std::uint32_t(best) << (2 * i);
+            result.error += best_error;
+        }
+        return result;
+    }
+
+    void encode_bc1_colors(rgba_block const & texels, std::uint8_t * output)
+    {
+        auto const colors = to_vectors<3>(texels);
+        auto [e0, e1] = principal_endpoints(colors);
+        auto best = fit_bc1(colors, e0, e1);
+
+        constexpr float index_weights[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+        for (int iteration = 0; iteration < 2 && best.error > 0.f; ++iteration)
+        {
+            std::array<float, 16> weights;
+            for (int i = 0; i < 16; ++i)
+                weights[i] = index_weights[(best.indices >> (2 * i)) & 3];
+
+            if (!least_squares_endpoints(colors, weights, e0, e1))
+                break;
+
+            auto const refined = fit_bc1(colors, e0, e1);
+            if (refined.error >= best.error)
+                break;
+            best = refined;
+        }
+
+        store_u16(output, best.c0);
+        store_u16(output + 2, best.c1);
+        for (int i = 0; i < 4; ++i)
+            output[4 + i] = std::uint8_t(best.indices >> (8 * i));
+    }
+
+    // BC3 alpha
+
+    std::array<int, 8> bc3_alpha_palette(int a0, int a1)
+    {
+        std::array<int, 8> result{a0, a1};
+        if (a0 > a1)
+        {
+            for (int i = 2; i < 8; ++i)
+                result[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+        else
+        {
+            for (int i = 2; i < 6; ++i)
+                result[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+            result[6] = 0;
+            result[7] = 255;
+        }
+        return result;
+    }
+
+    void encode_bc3_alpha(rgba_block const & texels, std::uint8_t * output)
+    {
+        int low = 255, high = 0;
+        for (auto const & t : texels)
+        {
+            low = std::min<int>(low, t[3]);
+            high = std::max<int>(high, t[3]);
+        }
+
+        output[0] = std::uint8_t(high);
+        output[1] = std::uint8_t(low);
+        auto const palette = bc3_alpha_palette(high, low);
+
+        std::uint64_t indices = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0;
+            for (int j = 1; j < 8; ++j)
+                if (std::abs(palette[j] - texels[i][3]) < std::abs(palette[best] - texels[i][3]))
+                    best = j;
+            indices |= std::uint64_t(best) << (3 * i);
+        }
+
+        for (int i = 0; i < 6; ++i)
+            output[2 + i] = std::uint8_t(indices >> (8 * i));
+    }
+
+    // BC7 mode 6
+
+    struct bc7_fit
+    {
+        std::array<int, 4> e0{};
+        std::array<int, 4> e1{};
+        std::array<int, 16> indices{};
+        float error = std::numeric_limits<float>::infinity();
+    };
+
+    // Nearest 8-bit value whose low bit is the p-bit
+    int quantize_bc7(float value, int pbit)
+    {
+        int const q = std::clamp(int(std::lround((value - pbit) / 2.f)), 0, 127);
+        return (q << 1) | pbit;
+    }
+
+    int interpolate_bc7(int e0, int e1, int weight)
+    {
+        return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+    }
+
+    bc7_fit fit_bc7(std::array<glm::vec4, 16> const & colors, glm::vec4 const & e0, glm::vec4 const & e1)
+    {
+        bc7_fit best;
+        for (int p0 = 0; p0 < 2; ++p0)
+        {
+            for (int p1 = 0; p1 < 2; ++p1)
+            {
+                bc7_fit fit;
+                for (int c = 0; c < 4; ++c)
+                {
+                    fit.e0[c] = quantize_bc7(e0[c], p0);
+                    fit.e1[c] = quantize_bc7(e1[c], p1);
+                }
+
+                std::array<glm::vec4, 16> palette;
+                for (int j = 0; j < 16; ++j)
+                    for (int c = 0; c < 4; ++c)
+                        palette[j][c] = float(interpolate_bc7(fit.e0[c], fit.e1[c], bc7_weights[j]));
+
+                fit.error = 0.f;
+                for (int i = 0; i < 16; ++i)
+                {
+                    float best_error = std::numeric_limits<float>::infinity();
+                    for (int j = 0; j < 16; ++j)
+                    {
+                        float const error = squared_distance(colors[i], palette[j]);
+                        if (error < best_error)
+                        {
+                            fit.indices[i] = j;
+                            best_error = error;
+                        }
+                    }
+                    fit.error += best_error;
+                }
+
+                if (fit.error < best.error)
+                    best = fit;
+            }
+        }
+        return best;
+    }
+
+    struct bit_writer
+    {
+        std::uint8_t * output;
+        int position = 0;
+
+        void write(std::uint32_t value, int bits)
+        {
+            for (int i = 0; i < bits; ++i, ++position)
+                if ((value >> i) & 1)
+                    output[position / 8] |= std::uint8_t(1 << (position % 8));
+        }
+    };
+
+    struct bit_reader
+    {
+        std::uint8_t const * input;
+        int position = 0;
+
+        std::uint32_t read(int bits)
+        {
+            std::uint32_t result = 0;
+            for (int i = 0; i < bits; ++i, ++position)
+                result |= std::uint32_t((input[position / 8] >> (position % 8)) & 1) << i;
+            return result;
+        }
+    };
+
+}
+
+std::size_t block_size(block_format format)
+{
+    return format == block_format::bc1 ? 8 : 16;
+}
+
+std::size_t compressed_size(block_format format, int width, int height)
+{
+    return std::size_t((width + 3) / 4) * ((height + 3) / 4) * block_size(format);
+}
+
+void encode_bc1_block(rgba_block const & texels, std::uint8_t * output)
+{
+    encode_bc1_colors(texels, output);
+}
+
+void encode_bc3_block(rgba_block const & texels, std::uint8_t * output)
+{
+    encode_bc3_alpha(texels, output);
+    encode_bc1_colors(texels, output + 8);
+}
+
+void encode_bc7_block(rgba_block const & texels, std::uint8_t * output)
+{
+    auto const colors = to_vectors<4>(texels);
+    auto [e0, e1] = principal_endpoints(colors);
+    auto best = fit_bc7(colors, e0, e1);
+
+    for (int iteration = 0; iteration < 2 && best.error > 0.f; ++iteration)
+    {
+        std::array<float, 16> weights;
+        for (int i = 0; i < 16; ++i)
+            weights[i] = bc7_weights[best.indices[i]] / 64.f;
+
+        if (!least_squares_endpoints(colors, weights, e0, e1))
+            break;
+
+        auto const refined = fit_bc7(colors, e0, e1);
+        if (refined.error >= best.error)
+            break;
+        best = refined;
+    }
+
+    // The first index has an implicit zero top bit
+    if (best.indices[0] >= 8)
+    {
+        std::swap(best.e0, best.e1);
+        for (auto & index : best.indices)
+            index = 15 - index;
+    }
+
+    std::memset(output, 0, 16);
+    bit_writer writer{output};
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.write(std::uint32_t(best.e0[c] >> 1), 7);
+        writer.write(std::uint32_t(best.e1[c] >> 1), 7);
+    }
+    writer.write(std::uint32_t(best.e0[0] & 1), 1);
+    writer.write(std::uint32_t(best.e1[0] & 1), 1);
+    for (int i = 0; i < 16; ++i)
+        writer.write(std::uint32_t(best.indices[i]), i == 0 ? 3 : 4);
+}
+
+rgba_block decode_bc1_block(std::uint8_t const * input)
+{
+    std::uint16_t const c0 = load_u16(input), c1 = load_u16(input + 2);
+    auto const p0 = unpack_565(c0), p1 = unpack_565(c1);
+
+    std::array<std::array<int, 4>, 4> palette;
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[0][c] = p0[c];
+        palette[1][c] = p1[c];
+        palette[2][c] = c0 > c1 ? (2 * p0[c] + p1[c]) / 3 : (p0[c] + p1[c]) / 2;
+        palette[3][c] = c0 > c1 ? (p0[c] + 2 * p1[c]) / 3 : 0;
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = c0 > c1 ? 255 : 0;
+
+    rgba_block result;
+    for (int i = 0; i < 16; ++i)
+    {
+        int const index = (input[4 + i / 4] >> (2 * (i % 4))) & 3;
+        for (int c = 0; c < 4; ++c)
+            result[i][c] = std::uint8_t(palette[index][c]);
+    }
+    return result;
+}
+
+rgba_block decode_bc3_block(std::uint8_t const * input)
+{
+    auto result = decode_bc1_block(input + 8);
+    auto const palette = bc3_alpha_palette(input[0], input[1]);
+
+    std::uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= std::uint64_t(input[2 + i]) << (8 * i);
+    for (int i = 0; i < 16; ++i)
+        result[i][3] = std::uint8_t(palette[(indices >> (3 * i)) & 7]);
+    return result;
+}
+
+rgba_block decode_bc7_block(std::uint8_t const * input)
+{
+    rgba_block result{};
+    bit_reader reader{input};
+    if (reader.read(7) != (1 << 6))
+        return result;
+
+    std::array<int, 4> e0, e1;
+    for (int c = 0; c < 4; ++c)
+    {
+        e0[c] = int(reader.read(7)) << 1;
+        e1[c] = int(reader.read(7)) << 1;
+    }
+    int const p0 = int(reader.read(1)), p1 = int(reader.read(1));
+    for (int c = 0; c < 4; ++c)
+    {
+        e0[c] |= p0;
+        e1[c] |= p1;
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+        int const index = int(reader.read(i == 0 ? 3 : 4));
+        for (int c = 0; c < 4; ++c)
+            result[i][c] = std::uint8_t(interpolate_bc7(e0[c], e1[c], bc7_weights[index]));
+    }
+    return result;
+}
+
+std::vector<std::uint8_t> compress_image(block_format format, std::uint8_t const * pixels, int width, int height)
+{
+    std::vector<std::uint8_t> result(compressed_size(format, width, height));
+    auto * output = result.data();
+
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4, output += block_size(format))
+        {
+            rgba_block texels;
+            for (int y = 0; y < 4; ++y)
+            {
+                for (int x = 0; x < 4; ++x)
+                {
+                    int const sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+                    std::memcpy(texels[y * 4 + x].data(), pixels + (std::size_t(sy) * width + sx) * 4, 4);
+                }
+            }
+
+            switch (format)
+            {
+            case block_format::bc1: encode_bc1_block(texels, output); break;
+            case block_format::bc3: encode_bc3_block(texels, output); break;
+            case block_format::bc7: encode_bc7_block(texels, output); break;
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<std::uint8_t> decompress_image(block_format format, std::uint8_t const * blocks, int width, int height)
+{
+    std::vector<std::uint8_t> result(std::size_t(width) * height * 4);
+
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4, blocks += block_size(format))
+        {
+            rgba_block texels;
+            switch (format)
+            {
+            case block_format::bc1: texels = decode_bc1_block(blocks); break;
+            case block_format::bc3: texels = decode_bc3_block(blocks); break;
+            case block_format::bc7: texels = decode_bc7_block(blocks); break;
+            }
+
+            for (int y = 0; y < 4 && by + y < height; ++y)
+                for (int x = 0; x < 4 && bx + x < width; ++x)
+                    std::memcpy(result.data() + (std::size_t(by + y) * width + bx + x) * 4, texels[y * 4 + x].data(), 4);
+        }
+    }
+    return result;
+}
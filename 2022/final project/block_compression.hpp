@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU encoders for the block-compressed texture formats GL 3.3 hardware
+// samples directly. Every format stores 4x4 texel blocks, row-major within
+// the block and then within the image; blocks past the image edge repeat
+// its last row and column.
+//
+// BC1 (DXT1): RGB, 8 bytes per block, two RGB565 endpoints and four colors
+// on the line between them. For opaque color maps.
+// BC3 (DXT5): BC1's colors plus an 8-byte block of alpha, 16 bytes per block.
+// BC7: RGBA, 16 bytes per block. Only mode 6 is produced (one RGBA line with
+// 7-bit endpoints, a shared low bit per endpoint and 16 interpolation steps),
+// which already beats BC1 clearly on normal maps and gradients; a full BC7
+// encoder searching all eight modes and partitions is far slower.
+//
+// The endpoints come from the principal axis of the block's colors and are
+// then refitted by least squares to the chosen indices.
+
+enum class block_format : std::uint32_t
+{
+    bc1,
+    bc3,
+    bc7,
+};
+
+std::size_t block_size(block_format format);
+
+// Bytes of a width x height image in the format
+std::size_t compressed_size(block_format format, int width, int height);
+
+using rgba_block = std::array<std::array<std::uint8_t, 4>, 16>;
+
+void encode_bc1_block(rgba_block const & texels, std::uint8_t * output);
+void encode_bc3_block(rgba_block const & texels, std::uint8_t * output);
+void encode_bc7_block(rgba_block const & texels, std::uint8_t * output);
+
+// Decoders, for measuring the error; decode_bc7_block only knows mode 6
+rgba_block decode_bc1_block(std::uint8_t const * input);
+rgba_block decode_bc3_block(std::uint8_t const * input);
+rgba_block decode_bc7_block(std::uint8_t const * input);
+
+// Tightly packed RGBA8 pixels to blocks and back
+std::vector<std::uint8_t> compress_image(block_format format, std::uint8_t const * pixels, int width, int height);
+std::vector<std::uint8_t> decompress_image(block_format format, std::uint8_t const * blocks, int width, int height);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Frustum culling of many world-space bounding boxes at once. The boxes are
+// kept as centers and half extents, one array per component, and tested
+// against the six planes of the frustum in SIMD batches (8 boxes with AVX,
+// 4 with SSE2, see simd_batch.hpp); the result is a bitset that every pass
+// of the frame can read.
+//
+// A box is culled when it lies entirely behind one of the planes. Boxes
+// outside the frustum near one of its edges or corners, which no single
+// plane separates, are kept: the test is conservative where the separating
+// axis test of intersect.hpp is exact, but never culls a visible box.
+
+struct box_set
+{
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+
+    std::size_t size() const { return center_x.size(); }
+    void clear();
+
+    // Both return the index of the new box
+    std::size_t add(glm::vec3 const & min, glm::vec3 const & max);
+    // The box around an object-space box under transform
+    std::size_t add(glm::vec3 const & min, glm::vec3 const & max, glm::mat4 const & transform);
+
+    void set(std::size_t index, glm::vec3 const & min, glm::vec3 const & max);
+};
+
+// The min and max corners of the box around an object-space box under
+// transform
+std::pair<glm::vec3, glm::vec3> transform_box(glm::vec3 const & min, glm::vec3 const & max, glm::mat4 const & transform);
+
+// The planes of view_projection's clip volume as (normal, d), normals
+// pointing inwards and not normalized: p is on the inner side of a plane if
+// dot(normal, p) + d >= 0
+std::array<glm::vec4, 6> frustum_planes(glm::mat4 const & view_projection);
+
+// One bit per box, box i's is bit i % 64 of word i / 64
+using visibility_bits = std::vector<std::uint64_t>;
+
+inline bool is_visible(visibility_bits const & bits, std::size_t index)
+{
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+// Resizes bits to the boxes and sets those of the boxes not culled
+void cull_boxes(box_set const & boxes, std::array<glm::vec4, 6> const & planes, visibility_bits & bits);
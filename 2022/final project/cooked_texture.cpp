@@ -0,0 +1,167 @@
+#include "cooked_texture.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+
+    constexpr std::size_t level_alignment = 16;
+
+    std::int64_t source_mtime(std::filesystem::path const & source)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(source, ec);
+        return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+
+    std::size_t align(std::size_t offset)
+    {
+        return (offset + level_alignment - 1) / level_alignment * level_alignment;
+    }
+
+}
+
+std::optional<block_format> to_block_format(cooked_format format)
+{
+    switch (format)
+    {
+    case cooked_format::bc1: return block_format::bc1;
+    case cooked_format::bc3: return block_format::bc3;
+    case cooked_format::bc7: return block_format::bc7;
+    default: return std::nullopt;
+    }
+}
+
+std::size_t cooked_level_size(cooked_format format, int width, int height)
+{
+    if (auto const block = to_block_format(format))
+        return compressed_size(*block, width, height);
+    return std::size_t(width) * height * 4;
+}
+
+std::filesystem::path cooked_texture_path(std::filesystem::path const & source)
+{
+    auto result = source;
+    result += ".cooked";
+    return result;
+}
+
+std::optional<cooked_texture> load_cooked_texture(std::filesystem::path const & source)
+{
+    auto const path = cooked_texture_path(source);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+        return std::nullopt;
+
+    try
+    {
+        cooked_texture result{mapped_file(path)};
+        auto const & file = result.file;
+
+        cooked_texture_header header;
+        if (file.size() < sizeof(header))
+            return std::nullopt;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, cooked_texture_header::magic_value, sizeof(header.magic)) != 0
+            || header.version != cooked_texture_header::version_value
+            || header.byte_order != cooked_texture_header::byte_order_value
+            || header.format > cooked_format::bc7
+            || header.width == 0 || header.height == 0 || header.width > 1 << 16 || header.height > 1 << 16
+            || header.level_count == 0 || header.level_count > 17)
+            return std::nullopt;
+
+        // A texture shipped without its source is fine
+        if (std::filesystem::exists(source, ec)
+            && (header.source_size != std::filesystem::file_size(source, ec) || header.source_mtime != source_mtime(source)))
+            return std::nullopt;
+
+        std::size_t const table_size = header.level_count * 2 * sizeof(std::uint64_t);
+        if (file.size() < sizeof(header) + table_size)
+            return std::nullopt;
+
+        result.format = header.format;
+        result.width = int(header.width);
+        result.height = int(header.height);
+        for (std::uint32_t level = 0; level < header.level_count; ++level)
+        {
+            std::uint64_t entry[2];
+            std::memcpy(entry, file.data() + sizeof(header) + level * sizeof(entry), sizeof(entry));
+
+            int const width = std::max(result.width >> level, 1), height = std::max(result.height >> level, 1);
+            if (entry[1] != cooked_level_size(header.format, width, height) || entry[0] > file.size()
+                || entry[1] > file.size() - entry[0])
+                return std::nullopt;
+
+            result.levels.emplace_back(file.data() + entry[0], entry[1]);
+        }
+
+        return result;
+    }
+    catch (std::exception const &)
+    {
+        return std::nullopt;
+    }
+}
+
+void store_cooked_texture(std::filesystem::path const & source, decoded_image const & image, cooked_format format)
+{
+    auto const path = cooked_texture_path(source);
+    auto temp_path = path;
+    temp_path += ".tmp";
+
+    std::vector<std::vector<std::uint8_t>> levels;
+    for (std::size_t level = 0; level < image.levels.size(); ++level)
+    {
+        auto const & pixels = image.levels[level];
+        if (auto const block = to_block_format(format))
+            levels.push_back(compress_image(*block, pixels.data(), image.level_width(level), image.level_height(level)));
+        else
+            levels.emplace_back(pixels.begin(), pixels.end());
+    }
+
+    cooked_texture_header header{};
+    std::memcpy(header.magic, cooked_texture_header::magic_value, sizeof(header.magic));
+    header.version = cooked_texture_header::version_value;
+    header.byte_order = cooked_texture_header::byte_order_value;
+    header.format = format;
+    header.width = std::uint32_t(image.width);
+    header.height = std::uint32_t(image.height);
+    header.level_count = std::uint32_t(levels.size());
+    header.source_size = std::filesystem::file_size(source);
+    header.source_mtime = source_mtime(source);
+
+    std::vector<std::uint64_t> table;
+    std::size_t offset = sizeof(header) + levels.size() * 2 * sizeof(std::uint64_t);
+    for (auto const & level : levels)
+    {
+        offset = align(offset);
+        table.push_back(offset);
+        table.push_back(level.size());
+        offset += level.size();
+    }
+
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        out.write(reinterpret_cast<char const *>(table.data()), table.size() * sizeof(std::uint64_t));
+        for (std::size_t level = 0; level < levels.size(); ++level)
+        {
+            char const padding[level_alignment] = {};
+            out.write(padding, table[2 * level] - out.tellp());
+            out.write(reinterpret_cast<char const *>(levels[level].data()), levels[level].size());
+        }
+        if (!out)
+        {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    }
+
+    std::filesystem::rename(temp_path, path);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "block_compression.hpp"
+#include "mapped_file.hpp"
+#include "texture_decoder.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Sidecar (<image>.cooked) holding an image's whole mip chain, as RGBA8 or
+// block-compressed, ready to be handed to glTexImage2D or
+// glCompressedTexImage2D. Written offline by the texture_cooker tool, read by
+// texture_holder instead of decoding the image.
+//
+// Layout: cooked_texture_header, level_count (offset, size) std::uint64_t
+// pairs, then the levels, level 0 first, each 16-byte aligned, all in the
+// writer's native byte order. A cooked texture is used only if the magic,
+// version and byte order match, the levels fit the file and have the sizes
+// their format implies, and the source image, when it is there at all, still
+// has the recorded size and mtime.
+enum class cooked_format : std::uint32_t
+{
+    rgba8,
+    bc1,
+    bc3,
+    bc7,
+};
+
+struct cooked_texture_header
+{
+    static constexpr char magic_value[8] = {'T', 'E', 'X', 'C', 'O', 'O', 'K', 'D'};
+    static constexpr std::uint32_t version_value = 1;
+    static constexpr std::uint32_t byte_order_value = 0x01020304;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    cooked_format format;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t level_count;
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+};
+
+struct cooked_texture
+{
+    mapped_file file;
+    cooked_format format = cooked_format::rgba8;
+    int width = 0;
+    int height = 0;
+    // Level 0 first, pointing into the file
+    std::vector<std::span<char const>> levels = {};
+};
+
+std::optional<block_format> to_block_format(cooked_format format);
+
+// Bytes of one level
+std::size_t cooked_level_size(cooked_format format, int width, int height);
+
+std::filesystem::path cooked_texture_path(std::filesystem::path const & source);
+
+// Returns nothing if the cooked texture is missing, stale or damaged
+std::optional<cooked_texture> load_cooked_texture(std::filesystem::path const & source);
+
+// Compresses every level of the image, which must have its full mip chain;
+// throws if the file cannot be written
+void store_cooked_texture(std::filesystem::path const & source, decoded_image const & image, cooked_format format);
@@ -1,10 +1,12 @@
 #include "gltf_loader.hpp"
 
 #include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/error/en.h>
 
-#include <fstream>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
+#include <string_view>
 
 static unsigned int attribute_type_to_size(std::string const & type)
 {
@@ -16,59 +18,238 @@ static unsigned int attribute_type_to_size(std::string const & type)
     throw std::runtime_error("Unknown attribute type: " + type);
 }
 
-gltf_model load_gltf(std::filesystem::path const & path)
+namespace
 {
-    rapidjson::Document document;
 
+    constexpr std::uint32_t glb_magic = 0x46546C67; // "glTF"
+    constexpr std::uint32_t glb_json_chunk = 0x4E4F534A; // "JSON"
+    constexpr std::uint32_t glb_bin_chunk = 0x004E4942; // "BIN\0"
+
+    constexpr unsigned int gl_triangles = 4;
+
+    std::uint32_t read_u32(char const * data)
+    {
+        std::uint32_t result;
+        std::memcpy(&result, data, sizeof(result));
+        return result;
+    }
+
+    struct glb_chunks
+    {
+        std::string_view json;
+        std::span<char const> bin;
+    };
+
+    // The container is a 12-byte header (magic, version, length) followed by
+    // chunks of (length, type, data), the JSON one first
+    glb_chunks split_glb(std::filesystem::path const & path, std::string_view file)
+    {
+        if (file.size() < 12 || read_u32(file.data() + 4) != 2 || read_u32(file.data() + 8) > file.size())
+            throw std::runtime_error("Unsupported GLB file " + path.string());
+
+        glb_chunks result;
+        file = file.substr(0, read_u32(file.data() + 8));
+        for (std::size_t offset = 12; offset + 8 <= file.size();)
+        {
+            std::size_t const length = read_u32(file.data() + offset);
+            std::uint32_t const type = read_u32(file.data() + offset + 4);
+            offset += 8;
+            if (length > file.size() - offset)
+                throw std::runtime_error("Truncated GLB chunk in " + path.string());
+
+            if (type == glb_json_chunk && result.json.empty())
+                result.json = file.substr(offset, length);
+            else if (type == glb_bin_chunk && result.bin.empty())
+                result.bin = {file.data() + offset, length};
+
+            offset += length;
+        }
+
+        if (result.json.empty())
+            throw std::runtime_error("No JSON chunk in " + path.string());
+        return result;
+    }
+
+    // Relative uris are percent-encoded
+    std::string decode_uri(std::string_view uri)
+    {
+        auto hex = [](char c) -> int
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+
+        std::string result;
+        result.reserve(uri.size());
+        for (std::size_t i = 0; i < uri.size(); ++i)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && hex(uri[i + 1]) >= 0 && hex(uri[i + 2]) >= 0)
+            {
+                result.push_back(char(hex(uri[i + 1]) * 16 + hex(uri[i + 2])));
+                i += 2;
+            }
+            else
+                result.push_back(uri[i]);
+        }
+        return result;
+    }
+
+    // Buffers embedded as "data:[<mediatype>];base64,<data>"
+    std::vector<char> decode_data_uri(std::filesystem::path const & path, std::string_view uri)
     {
-        std::ifstream input(path, std::ios::binary);
-        rapidjson::IStreamWrapper stream(input);
-        document.ParseStream(stream);
+        auto const comma = uri.find(',');
+        if (comma == std::string_view::npos || !uri.substr(0, comma).ends_with(";base64"))
+            throw std::runtime_error("Unsupported data uri in " + path.string());
+
+        auto value = [](char c) -> int
+        {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+') return 62;
+            if (c == '/') return 63;
+            return -1;
+        };
+
+        std::vector<char> result;
+        result.reserve((uri.size() - comma) / 4 * 3);
+        std::uint32_t bits = 0;
+        int bit_count = 0;
+        for (char c : uri.substr(comma + 1))
+        {
+            if (c == '=')
+                break;
+            int const v = value(c);
+            if (v < 0)
+                throw std::runtime_error("Invalid base64 in a data uri in " + path.string());
+
+            bits = (bits << 6) | std::uint32_t(v);
+            bit_count += 6;
+            if (bit_count >= 8)
+            {
+                bit_count -= 8;
+                result.push_back(char((bits >> bit_count) & 0xFF));
+            }
+        }
+        return result;
     }
 
+}
+
+gltf_model load_gltf(std::filesystem::path const & path)
+{
     gltf_model result;
 
+    auto file = std::make_shared<mapped_file const>(path);
+    bool const is_glb = file->size() >= 4 && read_u32(file->data()) == glb_magic;
+
+    glb_chunks chunks;
+    if (is_glb)
+        chunks = split_glb(path, file->view());
+    else
+        chunks.json = file->view();
+
+    // Parsed in situ, which unescapes the strings in place: the text is
+    // copied, but only the JSON, the binary data stays in the mapping
+    std::vector<char> json(chunks.json.size() + 1, '\0');
+    std::copy(chunks.json.begin(), chunks.json.end(), json.begin());
+
+    rapidjson::Document document;
+    document.ParseInsitu(json.data());
+    if (document.HasParseError())
+        throw std::runtime_error("Failed to parse " + path.string() + ": " + rapidjson::GetParseError_En(document.GetParseError()));
+
     {
         auto buffers = document["buffers"].GetArray();
-        assert(buffers.Size() == 1);
+        result.buffers.reserve(buffers.Size());
 
-        auto const buffer_uri = buffers[0]["uri"].GetString();
+        for (unsigned int i = 0; i < buffers.Size(); ++i)
+        {
+            auto const & buffer = buffers[i];
+            auto & result_buffer = result.buffers.emplace_back();
 
-        auto const buffer_path = path.parent_path() / buffer_uri;
+            if (!buffer.HasMember("uri"))
+            {
+                // Only the first buffer of a .glb may refer to the BIN chunk
+                if (!is_glb || i != 0)
+                    throw std::runtime_error("Buffer without a uri in " + path.string());
+                result_buffer.data = chunks.bin;
+                result_buffer.storage = file;
+            }
+            else if (std::string_view uri = buffer["uri"].GetString(); uri.starts_with("data:"))
+            {
+                auto const data = std::make_shared<std::vector<char>>(decode_data_uri(path, uri));
+                result_buffer.data = *data;
+                result_buffer.storage = data;
+            }
+            else
+            {
+                auto const mapping = std::make_shared<mapped_file const>(path.parent_path() / decode_uri(uri));
+                result_buffer.data = {mapping->data(), mapping->size()};
+                result_buffer.storage = mapping;
+            }
 
-        result.buffer.resize(std::filesystem::file_size(buffer_path));
-        std::ifstream buffer(buffer_path, std::ios::binary);
-        buffer.read(result.buffer.data(), result.buffer.size());
+            if (result_buffer.data.size() < buffer["byteLength"].GetUint())
+                throw std::runtime_error("Buffer is shorter than its byteLength in " + path.string());
+        }
     }
 
+    auto optional_uint = [](auto const & object, char const * name, unsigned int default_value)
+    {
+        return object.HasMember(name) ? object[name].GetUint() : default_value;
+    };
+
     auto parse_buffer_view = [&](int index) -> gltf_model::buffer_view
     {
         auto view = document["bufferViews"].GetArray()[index].GetObject();
-        return {
-            view["byteOffset"].GetUint(),
+        gltf_model::buffer_view result_view{
+            view["buffer"].GetUint(),
+            optional_uint(view, "byteOffset", 0),
             view["byteLength"].GetUint(),
-            view["byteStride"].GetUint(),
-            view["target"].GetUint()
+            optional_uint(view, "byteStride", 0),
+            optional_uint(view, "target", 0)
         };
+
+        if (result_view.buffer >= result.buffers.size()
+            || std::size_t(result_view.offset) + result_view.size > result.buffers[result_view.buffer].data.size())
+            throw std::runtime_error("Buffer view " + std::to_string(index) + " is out of its buffer in " + path.string());
+        return result_view;
     };
 
     auto parse_accessor = [&](int index) -> gltf_model::accessor
     {
         auto accessor = document["accessors"].GetArray()[index].GetObject();
-        unsigned int offset = (accessor.FindMember("byteOffset") == accessor.end() ? 0 : accessor["byteOffset"].GetUint());
+        // Accessors without a view are zeros, possibly with sparse values
+        // on top, which nothing we load uses
+        if (!accessor.HasMember("bufferView"))
+            throw std::runtime_error("Accessor " + std::to_string(index) + " without a buffer view in " + path.string());
+
         return {
             parse_buffer_view(accessor["bufferView"].GetInt()),
             accessor["componentType"].GetUint(),
             attribute_type_to_size(accessor["type"].GetString()),
             accessor["count"].GetUint(),
-            offset,
+            optional_uint(accessor, "byteOffset", 0),
+            accessor.HasMember("normalized") && accessor["normalized"].GetBool(),
         };
     };
 
+    auto parse_optional_accessor = [&](auto const & attributes, char const * name) -> std::optional<gltf_model::accessor>
+    {
+        if (!attributes.HasMember(name))
+            return std::nullopt;
+        return parse_accessor(attributes[name].GetInt());
+    };
+
     auto parse_texture = [&](int index) -> std::string
     {
         auto const source_index = document["textures"].GetArray()[index]["source"].GetInt();
-        return document["images"].GetArray()[source_index]["uri"].GetString();
+        auto const & image = document["images"].GetArray()[source_index];
+        if (!image.HasMember("uri"))
+            throw std::runtime_error("Images inside buffers are not supported: " + path.string());
+        return decode_uri(image["uri"].GetString());
     };
 
     auto parse_color = [&](auto const & array)
@@ -99,39 +280,56 @@ gltf_model load_gltf(std::filesystem::path const & path)
         );
     };
 
-    for (auto const &mesh : document["meshes"].GetArray())
+    auto parse_material = [&](gltf_model::material & result_material, auto const & material)
     {
-        auto &result_mesh = result.meshes.emplace_back();
-        result_mesh.name = mesh["name"].GetString();
+        result_material.two_sided = material.HasMember("doubleSided") && material["doubleSided"].GetBool();
+        result_material.transparent = material.HasMember("alphaMode") && (material["alphaMode"].GetString() == std::string("BLEND"));
 
-        auto primitives = mesh["primitives"].GetArray();
-        assert(primitives.Size() == 1);
+        if (material.HasMember("normalTexture"))
+            result_material.normal_texture = parse_texture(material["normalTexture"]["index"].GetInt());
 
-        auto const &attributes = primitives[0]["attributes"];
+        if (!material.HasMember("pbrMetallicRoughness"))
+            return;
 
-        result_mesh.indices = parse_accessor(primitives[0]["indices"].GetInt());
-        result_mesh.position = parse_accessor(attributes["POSITION"].GetInt());
-        result_mesh.tangent = parse_accessor(attributes["TANGENT"].GetInt());
-        result_mesh.normal = parse_accessor(attributes["NORMAL"].GetInt());
-        result_mesh.texcoord = parse_accessor(attributes["TEXCOORD_0"].GetInt());
+        auto const &pbr = material["pbrMetallicRoughness"];
+        if (pbr.HasMember("baseColorTexture"))
+            result_material.ambient_texture = parse_texture(pbr["baseColorTexture"]["index"].GetInt());
+        else if (pbr.HasMember("baseColorFactor"))
+            result_material.color = parse_color(pbr["baseColorFactor"].GetArray());
 
-        std::tie(result_mesh.min, result_mesh.max) = parse_bounds(attributes["POSITION"].GetInt());
+        if (pbr.HasMember("metallicRoughnessTexture"))
+            result_material.roughness_texture = parse_texture(pbr["metallicRoughnessTexture"]["index"].GetInt());
+    };
 
-        auto const &material = document["materials"].GetArray()[primitives[0]["material"].GetInt()];
+    for (auto const &mesh : document["meshes"].GetArray())
+    {
+        std::string const name = mesh.HasMember("name") ? mesh["name"].GetString() : "";
 
-        result_mesh.material.two_sided = material.HasMember("doubleSided") && material["doubleSided"].GetBool();
-        result_mesh.material.transparent = material.HasMember("alphaMode") && (material["alphaMode"].GetString() == std::string("BLEND"));
+        for (auto const &primitive : mesh["primitives"].GetArray())
+        {
+            if (optional_uint(primitive, "mode", gl_triangles) != gl_triangles)
+                throw std::runtime_error("Only triangle primitives are supported, mesh " + name + " in " + path.string());
 
+            auto &result_mesh = result.meshes.emplace_back();
+            result_mesh.name = name;
 
-        result_mesh.material.normal_texture = parse_texture(material["normalTexture"]["index"].GetInt());
+            auto const &attributes = primitive["attributes"];
 
-        auto const &pbr = material["pbrMetallicRoughness"];
-        if (pbr.HasMember("baseColorTexture"))
-            result_mesh.material.ambient_texture = parse_texture(pbr["baseColorTexture"]["index"].GetInt());
-        else if (pbr.HasMember("baseColorFactor"))
-            result_mesh.material.color = parse_color(pbr["baseColorFactor"].GetArray());
+            if (primitive.HasMember("indices"))
+                result_mesh.indices = parse_accessor(primitive["indices"].GetInt());
+            result_mesh.position = parse_accessor(attributes["POSITION"].GetInt());
+            result_mesh.tangent = parse_optional_accessor(attributes, "TANGENT");
+            result_mesh.normal = parse_optional_accessor(attributes, "NORMAL");
+            result_mesh.texcoord = parse_optional_accessor(attributes, "TEXCOORD_0");
+
+            std::tie(result_mesh.min, result_mesh.max) = parse_bounds(attributes["POSITION"].GetInt());
 
-        result_mesh.material.roughness_texture = parse_texture(pbr["metallicRoughnessTexture"]["index"].GetInt());
+            // The default material is white and one-sided
+            if (primitive.HasMember("material"))
+                parse_material(result_mesh.material, document["materials"].GetArray()[primitive["material"].GetInt()]);
+            if (!result_mesh.material.ambient_texture && !result_mesh.material.color)
+                result_mesh.material.color = glm::vec4(1.f);
+        }
     }
     return result;
 }
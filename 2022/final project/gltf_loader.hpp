@@ -1,6 +1,8 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
 #include <optional>
@@ -14,10 +16,13 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/compatibility.hpp>
 
+#include "mapped_file.hpp"
+
 struct gltf_model
 {
     struct buffer_view
     {
+        unsigned int buffer;
         unsigned int offset;
         unsigned int size;
         unsigned int stride;
@@ -31,12 +36,13 @@ struct gltf_model
         unsigned int size;
         unsigned int count;
         unsigned int offset;
+        bool normalized;
     };
 
     struct material
     {
-        bool two_sided;
-        bool transparent;
+        bool two_sided = false;
+        bool transparent = false;
         std::optional<std::string> normal_texture;
         std::optional<std::string> roughness_texture;
         std::optional<std::string> ambient_texture;
@@ -72,26 +78,42 @@ struct gltf_model
         float max_time = 0.f;
     };
 
+    // One per primitive: a glTF mesh with several primitives, usually one
+    // per material, gives as many entries, all with the mesh's name
     struct mesh
     {
         std::string name;
         struct material material;
-        accessor indices;
+        // A mesh without indices is a plain triangle list
+        std::optional<accessor> indices;
         accessor position;
-        accessor tangent;
-        accessor normal;
-        accessor texcoord;
+        std::optional<accessor> tangent;
+        std::optional<accessor> normal;
+        std::optional<accessor> texcoord;
 
         glm::vec3 min;
         glm::vec3 max;
     };
 
-    std::vector<char> buffer;
+    // Straight from a memory mapping of a .bin file or of the .glb's BIN
+    // chunk, or decoded from a data uri; storage keeps either alive
+    struct buffer
+    {
+        std::span<char const> data;
+        std::shared_ptr<void const> storage;
+    };
+
+    std::vector<buffer> buffers;
+
     std::vector<mesh> meshes;
     std::vector<bone> bones;
     std::unordered_map<std::string, animation> animations;
 };
 
+// Loads a .gltf file, or a binary .glb container (recognized by its magic,
+// whatever the extension). Buffers can be external files, data uris or the
+// .glb's BIN chunk. Materials and the NORMAL, TANGENT and TEXCOORD_0
+// attributes are optional; only triangle primitives are supported.
 gltf_model load_gltf(std::filesystem::path const & path);
 
 template <>
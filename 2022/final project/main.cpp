@@ -38,9 +38,9 @@
 #include "utils.hpp"
 #include "reactphysics3d/reactphysics3d.h"
 
-#include "aabb.hpp"
-#include "frustum.hpp"
-#include "intersect.hpp"
+#include "scene_bvh.hpp"
+#include "shadow_cache.hpp"
+#include "render_queue.hpp"
 
 rp3d::Vector3 get_bbox_size(bounding_box bbox) {
     float x_bounds[2] = {std::numeric_limits<float>::infinity(),
@@ -77,13 +77,41 @@ std::vector<rp3d::Vector2> generate_pin_positions() {
     return res;
 }
 
-int main() try {
+// An alley material with its textures resolved to texture_holder's array
+// texture handles at load time, so that drawing does not look them up by path
+struct alley_material {
+    std::optional<std::size_t> albedo_texture;
+    std::optional<std::size_t> normal_texture;
+    std::optional<std::size_t> roughness_texture;
+    glm::vec4 color{1.f};
+    bool two_sided = false;
+    bool transparent = false;
+
+    bool operator==(const alley_material &) const = default;
+};
+
+// Meshes without a texture or a color are not drawn
+static constexpr std::uint32_t no_material = -1;
+
+enum render_pass : std::uint32_t {
+    shadow_pass,
+    main_pass,
+};
+
+// With --sync-textures every texture is decoded and uploaded before the first
+// frame, otherwise they are streamed in while rendering
+int main(int argc, char **argv) try {
+    auto const start_time = std::chrono::steady_clock::now();
+    bool const sync_textures = argc > 1 && std::string_view(argv[1]) == "--sync-textures";
+
     auto *window = create_window("Bowling");
     auto gl_context = create_context(window);
     int width, height;
     SDL_GetWindowSize(window, &width, &height);
 
-    texture_holder textures(3);
+    texture_holder textures = sync_textures ? texture_holder(3) : texture_holder(3, 0);
+    // Normal maps show a flat surface until they are ready
+    std::array<GLubyte, 4> const flat_normal{128, 128, 255, 255};
 
     const std::string project_root = PROJECT_ROOT;
     const std::string ball_dir = project_root + "/ball/";
@@ -100,10 +128,15 @@ int main() try {
     auto alley_program = create_program(alley_vertex_shader, alley_fragment_shader);
 
     GLuint alley_model_location = glGetUniformLocation(alley_program, "model");
+    GLuint alley_position_decode_location = glGetUniformLocation(alley_program, "position_decode");
     GLuint alley_view_location = glGetUniformLocation(alley_program, "view");
     GLuint alley_projection_location = glGetUniformLocation(alley_program, "projection");
     GLuint alley_albedo_location = glGetUniformLocation(alley_program, "albedo");
+    GLuint alley_albedo_layer_location = glGetUniformLocation(alley_program, "albedo_layer");
+    GLuint alley_albedo_transform_location = glGetUniformLocation(alley_program, "albedo_transform");
     GLuint alley_normal_location = glGetUniformLocation(alley_program, "normal_texture");
+    GLuint alley_normal_layer_location = glGetUniformLocation(alley_program, "normal_layer");
+    GLuint alley_normal_transform_location = glGetUniformLocation(alley_program, "normal_transform");
     GLuint alley_color_location = glGetUniformLocation(alley_program, "color");
     GLuint alley_use_texture_location = glGetUniformLocation(alley_program, "use_texture");
     GLuint alley_light_direction_location = glGetUniformLocation(alley_program, "light_direction");
@@ -111,45 +144,52 @@ int main() try {
     GLint alley_transform_location = glGetUniformLocation(alley_program, "transform");
     GLuint alley_camera_location = glGetUniformLocation(alley_program, "camera_position");
     GLuint alley_roughness_location = glGetUniformLocation(alley_program, "roughness_texture");
+    GLuint alley_roughness_layer_location = glGetUniformLocation(alley_program, "roughness_layer");
+    GLuint alley_roughness_transform_location = glGetUniformLocation(alley_program, "roughness_transform");
     GLuint alley_light_color_location = glGetUniformLocation(alley_program, "light_color");
+    GLuint alley_use_normal_texture_location = glGetUniformLocation(alley_program, "use_normal_texture");
+    GLuint alley_use_roughness_texture_location = glGetUniformLocation(alley_program, "use_roughness_texture");
 
     auto const alley_gltf_model = load_gltf(alley_path);
-    GLuint alley_vbo;
+    auto const alley_packed = pack_gltf(alley_gltf_model);
+
+    // All meshes live in the same two buffers and are drawn with
+    // glDrawElementsBaseVertex, so one VAO is enough
+    GLuint alley_vao, alley_vbo, alley_ebo;
+    glGenVertexArrays(1, &alley_vao);
+    glBindVertexArray(alley_vao);
     glGenBuffers(1, &alley_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, alley_vbo);
-    glBufferData(GL_ARRAY_BUFFER, alley_gltf_model.buffer.size(), alley_gltf_model.buffer.data(), GL_STATIC_DRAW);
-
-    std::vector<GLuint> alley_vaos;
-    for(const auto &mesh : alley_gltf_model.meshes)
-    {
-        GLuint vao;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, alley_vbo);
-
-        auto setup_attribute = [](int index, gltf_model::accessor const & accessor) {
-            glEnableVertexAttribArray(index);
-            glVertexAttribPointer(index, accessor.size, accessor.type, GL_FALSE, accessor.view.stride,
-                                  reinterpret_cast<void *>(accessor.offset + accessor.view.offset));
-        };
-
-        setup_attribute(0, mesh.position);
-        setup_attribute(1, mesh.tangent);
-        setup_attribute(2, mesh.normal);
-        setup_attribute(3, mesh.texcoord);
-        alley_vaos.push_back(vao);
-    }
-
-
+    glBufferData(GL_ARRAY_BUFFER, alley_packed.vertices.size() * sizeof(packed_tangent_vertex),
+                 alley_packed.vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &alley_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, alley_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, alley_packed.indices.size() * sizeof(std::uint32_t),
+                 alley_packed.indices.data(), GL_STATIC_DRAW);
+    setup_packed_tangent_vertex_attributes();
+    glm::mat4 alley_position_decode = alley_packed.quantization.decode_matrix();
+
+
+    material_table<alley_material> alley_materials;
+    std::vector<std::uint32_t> alley_mesh_materials;
     for (auto const &mesh : alley_gltf_model.meshes) {
-        if (!mesh.material.ambient_texture) continue;
-        auto ambient_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.ambient_texture;
-        textures.load_texture(ambient_path);
-        auto normal_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.normal_texture;
-        textures.load_texture(normal_path);
-        auto roughness_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.roughness_texture;
-        textures.load_texture(roughness_path);
+        auto const directory = std::filesystem::path(alley_path).parent_path();
+        alley_material material;
+        material.two_sided = mesh.material.two_sided;
+        material.transparent = mesh.material.transparent;
+        if (mesh.material.ambient_texture)
+            material.albedo_texture = textures.add_array_texture(directory / *mesh.material.ambient_texture);
+        else if (mesh.material.color)
+            material.color = *mesh.material.color;
+        else {
+            alley_mesh_materials.push_back(no_material);
+            continue;
+        }
+        if (mesh.material.normal_texture)
+            material.normal_texture = textures.add_array_texture(directory / *mesh.material.normal_texture, flat_normal);
+        if (mesh.material.roughness_texture)
+            material.roughness_texture = textures.add_array_texture(directory / *mesh.material.roughness_texture);
+        alley_mesh_materials.push_back(alley_materials.add(material));
     }
 
     glm::mat4 alley_model = glm::mat4(1.f);
@@ -226,13 +266,19 @@ int main() try {
     std::vector<tinyobj::shape_t> ball_shapes;
     std::vector<tinyobj::material_t> ball_materials;
     tinyobj::LoadObj(&ball_attrib, &ball_shapes, &ball_materials, nullptr, ball_path.c_str(), ball_dir.c_str());
-    std::vector<vertex> ball_vertices = get_vertices(ball_attrib, ball_shapes);
+    auto [ball_vertices, ball_indices] = get_indexed_vertices(ball_attrib, ball_shapes);
+    optimize_indexed_vertices(ball_vertices, ball_indices, ball_shapes);
+    auto ball_packed = pack_vertices(ball_vertices, &vertex::texcoords);
 
     for(auto &material : ball_materials) {
-        auto ambient_path = std::filesystem::path(ball_path).parent_path() / material.ambient_texname;
-        textures.load_texture(ambient_path);
-        auto normal_path = std::filesystem::path(ball_path).parent_path() / material.normal_texname;
-        textures.load_texture(normal_path);
+        if(!material.ambient_texname.empty()) {
+            auto ambient_path = std::filesystem::path(ball_path).parent_path() / material.ambient_texname;
+            textures.add_array_texture(ambient_path);
+        }
+        if(!material.normal_texname.empty()) {
+            auto normal_path = std::filesystem::path(ball_path).parent_path() / material.normal_texname;
+            textures.add_array_texture(normal_path, flat_normal);
+        }
     }
 
     auto ball_bounding_box = get_bounding_box(ball_vertices);
@@ -251,15 +297,24 @@ int main() try {
     std::vector<tinyobj::shape_t> pin_shapes;
     std::vector<tinyobj::material_t> pin_materials;
     tinyobj::LoadObj(&pin_attrib, &pin_shapes, &pin_materials, nullptr, pin_path.c_str(), pin_dir.c_str());
-    std::vector<vertex> pin_vertices = get_vertices(pin_attrib, pin_shapes);
+    auto [pin_vertices, pin_indices] = get_indexed_vertices(pin_attrib, pin_shapes);
+    optimize_indexed_vertices(pin_vertices, pin_indices, pin_shapes);
+    auto pin_packed = pack_vertices(pin_vertices, &vertex::texcoords);
 
     for(auto &material : pin_materials) {
-        auto ambient_path = std::filesystem::path(pin_path).parent_path() / material.ambient_texname;
-        textures.load_texture(ambient_path);
-        auto normal_path = std::filesystem::path(pin_path).parent_path() / material.normal_texname;
-        textures.load_texture(normal_path);
+        if(!material.ambient_texname.empty()) {
+            auto ambient_path = std::filesystem::path(pin_path).parent_path() / material.ambient_texname;
+            textures.add_array_texture(ambient_path);
+        }
+        if(!material.normal_texname.empty()) {
+            auto normal_path = std::filesystem::path(pin_path).parent_path() / material.normal_texname;
+            textures.add_array_texture(normal_path, flat_normal);
+        }
     }
 
+    // Every texture but the environment map is known by now
+    textures.build_arrays();
+
     auto pin_bounding_box = get_bounding_box(pin_vertices);
     auto pin_center = std::accumulate(pin_bounding_box.begin(), pin_bounding_box.end(), glm::vec3(0.f)) / 8.f;
     rp3d::Vector3 pin_size = get_bbox_size(ball_bounding_box);
@@ -280,40 +335,55 @@ int main() try {
     }
 
     glm::mat4 ball_model = glm::mat4(1.f);
-    ball_model = glm::translate(ball_model, -ball_center);
+    ball_model = glm::translate(ball_model, -ball_center) * ball_packed.quantization.decode_matrix();
     glm::mat4 pin_model = glm::mat4(1.f);
-    pin_model = glm::translate(pin_model, -pin_center);
+    pin_model = glm::translate(pin_model, -pin_center) * pin_packed.quantization.decode_matrix();
 
     glm::mat4 ball_transform = glm::mat4(1.f);
     std::vector<glm::mat4> pin_transforms(10, glm::mat4(1.f));
 
-    GLuint ball_vao, ball_vbo;
+    // The scene's objects: the alley's meshes, which stay put, then the ball
+    // and the pins, which are refitted after every physics update
+    auto spawn_transform = [](const rp3d::Vector3 &position) {
+        return glm::translate(glm::mat4(1.f), {position.x, position.y, position.z});
+    };
+    glm::vec3 ball_min = ball_bounding_box[0] - ball_center, ball_max = ball_bounding_box[7] - ball_center;
+    glm::vec3 pin_min = pin_bounding_box[0] - pin_center, pin_max = pin_bounding_box[7] - pin_center;
+    box_set scene_boxes;
+    for (auto const &mesh : alley_gltf_model.meshes)
+        scene_boxes.add(mesh.min, mesh.max, alley_model);
+    std::size_t ball_object = scene_boxes.add(ball_min, ball_max, spawn_transform(ball_spawn_position));
+    std::size_t first_pin_object = scene_boxes.size();
+    for(int i = 0; i < 10; i++)
+        scene_boxes.add(pin_min, pin_max, spawn_transform(pin_spawn_positions[i]));
+    scene_bvh scene;
+    scene.build(scene_boxes);
+    std::vector<std::uint32_t> scene_visible;
+    std::vector<bool> object_visible;
+
+    GLuint ball_vao, ball_vbo, ball_ebo;
     glGenVertexArrays(1, &ball_vao);
     glBindVertexArray(ball_vao);
     glGenBuffers(1, &ball_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, ball_vbo);
-    glBufferData(GL_ARRAY_BUFFER, ball_vertices.size() * sizeof(vertex), ball_vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, ball_packed.vertices.size() * sizeof(packed_vertex), ball_packed.vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &ball_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ball_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ball_indices.size() * sizeof(std::uint32_t), ball_indices.data(), GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, position));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, normal));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, texcoords));
+    setup_packed_vertex_attributes();
 
-    GLuint pin_vao, pin_vbo;
+    GLuint pin_vao, pin_vbo, pin_ebo;
     glGenVertexArrays(1, &pin_vao);
     glBindVertexArray(pin_vao);
     glGenBuffers(1, &pin_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, pin_vbo);
-    glBufferData(GL_ARRAY_BUFFER, pin_vertices.size() * sizeof(vertex), pin_vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, pin_packed.vertices.size() * sizeof(packed_vertex), pin_packed.vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &pin_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pin_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, pin_indices.size() * sizeof(std::uint32_t), pin_indices.data(), GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, position));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, normal));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, texcoords));
+    setup_packed_vertex_attributes();
 
     auto debug_vertex_shader = create_shader(GL_VERTEX_SHADER, project_root + "/shaders/debug.vert");
     auto debug_fragment_shader = create_shader(GL_FRAGMENT_SHADER, project_root + "/shaders/debug.frag");
@@ -362,6 +432,30 @@ int main() try {
     if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         throw std::runtime_error("Incomplete framebuffer!");
 
+    // The static casters' layer of the shadow map, only ever copied from, so
+    // it does not need to be a texture
+    GLuint static_shadow_color, static_shadow_depth, static_shadow_fbo;
+    glGenRenderbuffers(1, &static_shadow_color);
+    glGenRenderbuffers(1, &static_shadow_depth);
+    glGenFramebuffers(1, &static_shadow_fbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, static_shadow_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32F, shadow_map_resolution, shadow_map_resolution);
+    glBindRenderbuffer(GL_RENDERBUFFER, static_shadow_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, shadow_map_resolution, shadow_map_resolution);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_shadow_fbo);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, static_shadow_color);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, static_shadow_depth);
+    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Incomplete framebuffer!");
+
+    shadow_cache shadow_layers(shadow_map_resolution);
+
+    // GPU time of the shadow pass, read a frame later so as not to stall
+    GLuint shadow_queries[2];
+    glGenQueries(2, shadow_queries);
+    bool shadow_query_pending[2] = {false, false};
+    bool shadow_query_cached[2] = {false, false};
+
     auto shadow_debug_vertex_shader = create_shader(GL_VERTEX_SHADER, project_root + "/shaders/shadow_debug.vert");
     auto shadow_debug_fragment_shader = create_shader(GL_FRAGMENT_SHADER, project_root + "/shaders/shadow_debug.frag");
     auto shadow_debug_program = create_program(shadow_debug_vertex_shader, shadow_debug_fragment_shader);
@@ -388,6 +482,8 @@ int main() try {
     environment_rotation = glm::rotate(environment_rotation, -glm::pi<float>() / 10.f, {1.f, 0.f, 0.f});
 
     auto last_frame_start = std::chrono::high_resolution_clock::now();
+    bool first_frame = true, textures_streaming = true;
+    float longest_streaming_frame = 0.f;
     std::map<SDL_Keycode, bool> button_down;
     float time = 0.f, accumulated_time = 0.f;
     float time_per_update = 1.f / 60.f;
@@ -395,7 +491,7 @@ int main() try {
     float camera_angle = glm::pi<float>();
     float camera_elevation = glm::pi<float>() / 10.f;
     glm::vec3 light_direction = glm::normalize(glm::vec3(-3.f, 10.f, 3.f));
-    bool played = false, debug = false;
+    bool played = false, debug = false, cache_shadows = true;
     glm::vec3 ambient_color(0.6f);
 
     auto draw_obj = [bowling_color_location](
@@ -405,46 +501,88 @@ int main() try {
         for(auto &shape : shapes) {
             auto material = materials[shape.mesh.material_ids[0]];
             glUniform3fv(bowling_color_location, 1, material.ambient);
-            glDrawArrays(GL_TRIANGLES, current_block, (GLint)shape.mesh.indices.size());
+            glDrawElements(GL_TRIANGLES, (GLsizei)shape.mesh.indices.size(), GL_UNSIGNED_INT,
+                           (void *)(current_block * sizeof(std::uint32_t)));
             current_block += (GLint)shape.mesh.indices.size();
         }
     };
 
-    auto draw_mesh = [&](bool transparent, int index) {
-            auto const &mesh = alley_gltf_model.meshes[index];
-
-            if (mesh.material.transparent != transparent)
-                return;
-
-            if (mesh.material.two_sided)
-                glDisable(GL_CULL_FACE);
-            else
-                glEnable(GL_CULL_FACE);
-            if (transparent)
-                glEnable(GL_BLEND);
-            else
-                glDisable(GL_BLEND);
-
-            if (mesh.material.ambient_texture) {
-                auto ambient_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.ambient_texture;
-                glUniform1i(alley_albedo_location, textures.get_texture(ambient_path));
-                glUniform1i(alley_use_texture_location, 1);
-            } else if (mesh.material.color) {
-                glUniform1i(alley_use_texture_location, 0);
-                glUniform4fv(alley_color_location, 1, reinterpret_cast<const float *>(&(*mesh.material.color)));
-            } else return;
-
-            auto normal_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.normal_texture;
-            glUniform1i(alley_normal_location, textures.get_texture(normal_path));
-            auto roughness_path = std::filesystem::path(alley_path).parent_path() / *mesh.material.roughness_texture;
-            glUniform1i(alley_roughness_location, textures.get_texture(roughness_path));
-
-            glBindVertexArray(alley_vaos[index]);
-
-            glDrawElements(GL_TRIANGLES, mesh.indices.count, mesh.indices.type,
-                           reinterpret_cast<void *>(mesh.indices.offset + mesh.indices.view.offset));
+    auto push_mesh = [&](render_queue &queue, render_pass pass, GLuint program, int index) {
+        std::uint32_t handle = alley_mesh_materials[index];
+        if (handle == no_material) return;
+        queue.push({pass, alley_materials[handle].transparent, program, handle, alley_vao}, (std::uint32_t)index);
+    };
+
+    // Arrays stay bound to their units, a material only points the samplers at them
+    auto bind_array_texture = [&](GLint sampler_location, GLint layer_location, GLint transform_location, std::size_t handle) {
+        auto const &texture = textures.get_array_texture(handle);
+        glUniform1i(sampler_location, texture.unit);
+        glUniform1f(layer_location, (float)texture.layer);
+        glUniform4fv(transform_location, 1, texture.transform.data());
+    };
+
+    // Expects face culling enabled. Blended items are drawn without depth
+    // writes; the depth mask is restored afterwards. Material uniforms are
+    // only set in the main pass, the shadow pass only needs face culling
+    auto submit_meshes = [&](std::span<render_item const> items, bool bind_materials) {
+        bool culling = true;
+        submit_render_items(items, [&](const render_item &item, unsigned changes) {
+            render_key key = render_key::unpack(item.key);
+            if (changes & render_program_changed)
+                glUseProgram(key.program);
+            if (changes & render_vertex_array_changed)
+                glBindVertexArray(key.vertex_array);
+            if (changes & render_blend_changed) {
+                if (key.blend)
+                    glEnable(GL_BLEND);
+                else
+                    glDisable(GL_BLEND);
+                glDepthMask(key.blend ? GL_FALSE : GL_TRUE);
+            }
+            if (changes & render_material_changed) {
+                auto const &material = alley_materials[key.material];
+                if (material.two_sided == culling) {
+                    culling = !material.two_sided;
+                    if (culling)
+                        glEnable(GL_CULL_FACE);
+                    else
+                        glDisable(GL_CULL_FACE);
+                }
+                if (bind_materials) {
+                    if (material.albedo_texture) {
+                        bind_array_texture(alley_albedo_location, alley_albedo_layer_location,
+                                           alley_albedo_transform_location, *material.albedo_texture);
+                        glUniform1i(alley_use_texture_location, 1);
+                    } else {
+                        glUniform1i(alley_use_texture_location, 0);
+                        glUniform4fv(alley_color_location, 1, reinterpret_cast<const float *>(&material.color));
+                    }
+                    if (material.normal_texture)
+                        bind_array_texture(alley_normal_location, alley_normal_layer_location,
+                                           alley_normal_transform_location, *material.normal_texture);
+                    glUniform1i(alley_use_normal_texture_location, material.normal_texture ? 1 : 0);
+                    if (material.roughness_texture)
+                        bind_array_texture(alley_roughness_location, alley_roughness_layer_location,
+                                           alley_roughness_transform_location, *material.roughness_texture);
+                    glUniform1i(alley_use_roughness_texture_location, material.roughness_texture ? 1 : 0);
+                }
+            }
+
+            auto const &packed_mesh = alley_packed.meshes[item.draw];
+            glDrawElementsBaseVertex(GL_TRIANGLES, packed_mesh.index_count, GL_UNSIGNED_INT,
+                                     reinterpret_cast<void *>(packed_mesh.first_index * sizeof(std::uint32_t)),
+                                     packed_mesh.base_vertex);
+        });
+        glDepthMask(GL_TRUE);
     };
 
+    render_queue alley_queue;
+    float total_submission = 0.f, longest_submission = 0.f;
+    int frames = 0;
+    // Indexed by whether the shadows were cached
+    double total_shadow_time[2] = {0.0, 0.0};
+    int shadow_frames[2] = {0, 0};
+
     while (true)
     {
         bool running = true;
@@ -487,6 +625,10 @@ int main() try {
                     else if(event.key.keysym.sym == SDLK_d) {
                         debug = !debug;
                     }
+                    else if(event.key.keysym.sym == SDLK_c) {
+                        cache_shadows = !cache_shadows;
+                        shadow_layers.invalidate();
+                    }
                     break;
                 case SDL_KEYUP:
                     button_down[event.key.keysym.sym] = false;
@@ -502,6 +644,11 @@ int main() try {
         time += dt;
         accumulated_time += dt;
 
+        if (textures_streaming) {
+            longest_streaming_frame = std::max(longest_streaming_frame, dt);
+            textures.update(std::chrono::milliseconds(2));
+        }
+
         while(accumulated_time > time_per_update) {
             world->update(time_per_update);
             accumulated_time -= time_per_update;
@@ -511,6 +658,14 @@ int main() try {
         for(int i = 0; i < 10; i++)
             pins[i]->getTransform().getOpenGLMatrix(reinterpret_cast<float *>(&pin_transforms[i]));
 
+        auto [ball_world_min, ball_world_max] = transform_box(ball_min, ball_max, ball_transform);
+        scene.update(ball_object, ball_world_min, ball_world_max);
+        for(int i = 0; i < 10; i++) {
+            auto [pin_world_min, pin_world_max] = transform_box(pin_min, pin_max, pin_transforms[i]);
+            scene.update(first_pin_object + i, pin_world_min, pin_world_max);
+        }
+        scene.refit();
+
         if (button_down[SDLK_UP])
             camera_distance -= 4.f * dt;
         if (button_down[SDLK_DOWN])
@@ -538,7 +693,10 @@ int main() try {
         glm::mat4 projection = glm::perspective(glm::pi<float>() / 3.f, 1.f / aspect, near, far);
         glm::vec3 camera_position = (glm::inverse(view) * glm::vec4(0.f, 0.f, 0.f, 1.f)).xyz();
 
-        frustum f(projection * view);
+        scene.cull(frustum_planes(projection * view), scene_visible);
+        object_visible.assign(scene.size(), false);
+        for (auto object : scene_visible)
+            object_visible[object] = true;
         glm::mat4 view_projection_inverse = inverse(projection * view);
 
         glm::vec3 light_z = -light_direction;
@@ -560,10 +718,31 @@ int main() try {
             {floor_center.x, floor_center.y, floor_center.z, 1.f}
         }));
 
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_fbo);
-        glViewport(0, 0, shadow_map_resolution, shadow_map_resolution);
-        glClearColor(1.f, 1.f, 0.f, 0.f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // With cached shadows the alley, which never moves, is only drawn into
+        // the static layer when the light changes
+        bool draw_static_shadows = !cache_shadows || shadow_layers.begin_frame(shadow_transform);
+
+        // Every alley mesh casts a shadow when the static shadows are drawn,
+        // the visible ones are drawn
+        auto submission_start = std::chrono::steady_clock::now();
+        alley_queue.clear();
+        for (int i = 0; i < alley_gltf_model.meshes.size(); i++) {
+            if (draw_static_shadows)
+                push_mesh(alley_queue, shadow_pass, shadow_program, i);
+            if (object_visible[i])
+                push_mesh(alley_queue, main_pass, alley_program, i);
+        }
+        alley_queue.sort();
+        float submission_time = std::chrono::duration<float>(std::chrono::steady_clock::now() - submission_start).count();
+
+        int shadow_query = frames % 2;
+        if (shadow_query_pending[shadow_query]) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(shadow_queries[shadow_query], GL_QUERY_RESULT, &elapsed);
+            total_shadow_time[shadow_query_cached[shadow_query]] += elapsed / 1e9;
+            shadow_frames[shadow_query_cached[shadow_query]]++;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, shadow_queries[shadow_query]);
 
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_CULL_FACE);
@@ -571,15 +750,40 @@ int main() try {
         glDepthFunc(GL_LEQUAL);
 
         glUseProgram(shadow_program);
-        glUniformMatrix4fv(shadow_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&alley_model));
+        glm::mat4 alley_shadow_model = alley_model * alley_position_decode;
+        glUniformMatrix4fv(shadow_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&alley_shadow_model));
         glUniformMatrix4fv(shadow_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&shadow_transform));
 
-        for (int i = 0; i < alley_gltf_model.meshes.size(); i++)
-            draw_mesh(false, i);
-        glDepthMask(GL_FALSE);
-        for (int i = 0; i < alley_gltf_model.meshes.size(); i++)
-            draw_mesh(true, i);
-        glDepthMask(GL_TRUE);
+        if (draw_static_shadows) {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cache_shadows ? static_shadow_fbo : shadow_fbo);
+            glViewport(0, 0, shadow_map_resolution, shadow_map_resolution);
+            glClearColor(1.f, 1.f, 0.f, 0.f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            submission_start = std::chrono::steady_clock::now();
+            submit_meshes(alley_queue.pass(shadow_pass), false);
+            submission_time += std::chrono::duration<float>(std::chrono::steady_clock::now() - submission_start).count();
+        }
+
+        // The ball and the pins are drawn over a copy of the static layer,
+        // only where their shadows are now or were last frame
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_fbo);
+        glViewport(0, 0, shadow_map_resolution, shadow_map_resolution);
+        if (cache_shadows) {
+            shadow_layers.add_dynamic(ball_world_min, ball_world_max);
+            for(int i = 0; i < 10; i++) {
+                auto [pin_world_min, pin_world_max] = transform_box(pin_min, pin_max, pin_transforms[i]);
+                shadow_layers.add_dynamic(pin_world_min, pin_world_max);
+            }
+
+            texel_rect region = shadow_layers.region();
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, static_shadow_fbo);
+            glBlitFramebuffer(region.x0, region.y0, region.x1, region.y1, region.x0, region.y0, region.x1, region.y1,
+                              GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(region.x0, region.y0, region.width(), region.height());
+        }
 
         glBindVertexArray(ball_vao);
         glm::mat4 transform_model = ball_transform * ball_model;
@@ -593,6 +797,11 @@ int main() try {
             draw_obj(pin_shapes, pin_materials);
         }
 
+        glDisable(GL_SCISSOR_TEST);
+        glEndQuery(GL_TIME_ELAPSED);
+        shadow_query_pending[shadow_query] = true;
+        shadow_query_cached[shadow_query] = cache_shadows;
+
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
         glViewport(0, 0, width, height);
         glClearColor(0.8f, 0.8f, 1.f, 0.f);
@@ -618,6 +827,7 @@ int main() try {
 
         glUseProgram(alley_program);
         glUniformMatrix4fv(alley_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&alley_model));
+        glUniformMatrix4fv(alley_position_decode_location, 1, GL_FALSE, reinterpret_cast<float *>(&alley_position_decode));
         glUniformMatrix4fv(alley_view_location, 1, GL_FALSE, reinterpret_cast<float *>(&view));
         glUniformMatrix4fv(alley_projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
         glUniform3fv(alley_light_direction_location, 1, reinterpret_cast<float *>(&light_direction));
@@ -626,24 +836,12 @@ int main() try {
         glUniform1i(alley_shadow_map_location, 1);
         glUniformMatrix4fv(alley_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&shadow_transform));
 
-        for (int i = 0; i < alley_gltf_model.meshes.size(); i++) {
-            auto const &mesh = alley_gltf_model.meshes[i];
-            glm::vec3 min = (alley_model * glm::vec4(mesh.min, 1.0)).xyz();
-            glm::vec3 max = (alley_model * glm::vec4(mesh.max, 1.0)).xyz();
-            aabb box = aabb(min, max);
-            if (intersect(box, f))
-                draw_mesh(false, i);
-        }
-        glDepthMask(GL_FALSE);
-        for (int i = 0; i < alley_gltf_model.meshes.size(); i++) {
-            auto const &mesh = alley_gltf_model.meshes[i];
-            glm::vec3 min = (alley_model * glm::vec4(mesh.min, 1.0)).xyz();
-            glm::vec3 max = (alley_model * glm::vec4(mesh.max, 1.0)).xyz();
-            aabb box = aabb(min, max);
-            if (intersect(box, f))
-                draw_mesh(true, i);
-        }
-        glDepthMask(GL_TRUE);
+        submission_start = std::chrono::steady_clock::now();
+        submit_meshes(alley_queue.pass(main_pass), true);
+        submission_time += std::chrono::duration<float>(std::chrono::steady_clock::now() - submission_start).count();
+        total_submission += submission_time;
+        longest_submission = std::max(longest_submission, submission_time);
+        frames++;
 
         glUseProgram(bowling_program);
         glUniformMatrix4fv(bowling_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&ball_transform));
@@ -654,14 +852,18 @@ int main() try {
         glUniform3f(bowling_light_color_location, 0.8f, 0.8f, 0.8f);
         glUniform1i(bowling_shadow_map_location, 1);
 
-        glUniformMatrix4fv(bowling_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&ball_model));
-        glBindVertexArray(ball_vao);
         glUniformMatrix4fv(bowling_shadow_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&shadow_transform));
-        draw_obj(ball_shapes, ball_materials);
+        if (object_visible[ball_object]) {
+            glUniformMatrix4fv(bowling_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&ball_model));
+            glBindVertexArray(ball_vao);
+            draw_obj(ball_shapes, ball_materials);
+        }
 
         glUniformMatrix4fv(bowling_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&pin_model));
         glBindVertexArray(pin_vao);
         for(int i = 0; i < 10; i++) {
+            if (!object_visible[first_pin_object + i])
+                continue;
             glUniformMatrix4fv(bowling_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&pin_transforms[i]));
             draw_obj(pin_shapes, pin_materials);
         }
@@ -706,8 +908,29 @@ int main() try {
         }
 
         SDL_GL_SwapWindow(window);
+
+        auto since_start = [&] {
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        };
+        if (first_frame) {
+            std::cout << "First frame " << since_start() << " ms after start" << std::endl;
+            first_frame = false;
+        }
+        if (textures_streaming && textures.pending() == 0) {
+            std::cout << "All textures ready " << since_start() << " ms after start, longest frame meanwhile "
+                      << longest_streaming_frame * 1000.f << " ms" << std::endl;
+            textures_streaming = false;
+        }
     }
 
+    for(int cached = 0; cached < 2; cached++)
+        if (shadow_frames[cached] > 0)
+            std::cout << "Shadow pass (GPU, " << (cached ? "cached" : "full") << ") "
+                      << total_shadow_time[cached] / shadow_frames[cached] * 1000.0 << " ms per frame on average" << std::endl;
+    if (frames > 0)
+        std::cout << "Alley submission (CPU) " << total_submission / (float)frames * 1000.f << " ms per frame on average, "
+                  << longest_submission * 1000.f << " ms at most" << std::endl;
+
     SDL_GL_DeleteContext(gl_context);
     SDL_DestroyWindow(window);
 }
@@ -0,0 +1,175 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+    [[noreturn]] void map_fail(std::filesystem::path const & path, char const * what)
+    {
+        throw std::runtime_error(std::string("Failed to map file ") + path.string() + ": " + what);
+    }
+
+}
+
+#ifdef WIN32
+
+mapped_file::mapped_file(std::filesystem::path const & path)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        map_fail(path, "CreateFile");
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        reset();
+        map_fail(path, "GetFileSizeEx");
+    }
+    m_size = static_cast<std::size_t>(size.QuadPart);
+    if (m_size == 0)
+        return;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        reset();
+        map_fail(path, "CreateFileMapping");
+    }
+    m_mapping = mapping;
+
+    m_data = static_cast<char const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data)
+    {
+        reset();
+        map_fail(path, "MapViewOfFile");
+    }
+}
+
+void mapped_file::reset()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+}
+
+mapped_file::mapped_file(mapped_file && other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_file(std::exchange(other.m_file, nullptr))
+    , m_mapping(std::exchange(other.m_mapping, nullptr))
+{}
+
+mapped_file & mapped_file::operator = (mapped_file && other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_file = std::exchange(other.m_file, nullptr);
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+    }
+    return *this;
+}
+
+void mapped_file::discard(std::size_t offset, std::size_t size) const
+{
+    // Unmodified file-backed pages are trimmed by the system as needed
+    (void)offset;
+    (void)size;
+}
+
+#else
+
+mapped_file::mapped_file(std::filesystem::path const & path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        map_fail(path, "open");
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        map_fail(path, "fstat");
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size != 0)
+    {
+        void * data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            map_fail(path, "mmap");
+        }
+        ::madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<char const *>(data);
+    }
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+}
+
+void mapped_file::reset()
+{
+    if (m_data)
+        ::munmap(const_cast<char *>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+mapped_file::mapped_file(mapped_file && other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0))
+{}
+
+mapped_file & mapped_file::operator = (mapped_file && other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+void mapped_file::discard(std::size_t offset, std::size_t size) const
+{
+    long const page = ::sysconf(_SC_PAGESIZE);
+    std::size_t begin = (offset + page - 1) / page * page;
+    std::size_t end = std::min(offset + size, m_size) / page * page;
+    if (m_data && begin < end)
+        ::madvise(const_cast<char *>(m_data) + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif
+
+mapped_file::~mapped_file()
+{
+    reset();
+}
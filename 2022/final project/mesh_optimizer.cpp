@@ -0,0 +1,467 @@
+#include "mesh_optimizer.hpp"
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+
+    using vec3 = std::array<float, 3>;
+
+    vec3 sub(vec3 const & a, vec3 const & b)
+    {
+        return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+    }
+
+    vec3 cross(vec3 const & a, vec3 const & b)
+    {
+        return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+    }
+
+    float dot(vec3 const & a, vec3 const & b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    struct position_reader
+    {
+        char const * data;
+        std::size_t stride;
+
+        vec3 operator()(std::uint32_t index) const
+        {
+            vec3 result;
+            std::copy_n(reinterpret_cast<float const *>(data + index * stride), 3, result.begin());
+            return result;
+        }
+    };
+
+    // FIFO cache simulated with timestamps: an entry is cached iff it was
+    // inserted during the last 'size' misses
+    struct fifo_cache
+    {
+        std::vector<std::size_t> stamps;
+        std::size_t size;
+        std::size_t time;
+
+        fifo_cache(std::size_t entry_count, std::size_t size)
+            : stamps(entry_count, 0)
+            , size(size)
+            , time(size + 1)
+        {}
+
+        // Returns true on a miss
+        bool access(std::uint32_t entry)
+        {
+            if (time - stamps[entry] <= size)
+                return false;
+            stamps[entry] = time++;
+            return true;
+        }
+
+        void flush()
+        {
+            time += size;
+        }
+    };
+
+    // Triangles adjacent to every vertex, in compressed row storage
+    struct vertex_adjacency
+    {
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> triangles;
+
+        vertex_adjacency(std::span<std::uint32_t const> indices, std::size_t vertex_count)
+            : offsets(vertex_count + 1, 0)
+            , triangles(indices.size())
+        {
+            for (auto i : indices)
+                ++offsets[i + 1];
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+            std::vector<std::uint32_t> next(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < indices.size(); ++i)
+                triangles[next[indices[i]]++] = i / 3;
+        }
+
+        std::span<std::uint32_t const> operator[](std::uint32_t vertex) const
+        {
+            return {triangles.data() + offsets[vertex], offsets[vertex + 1] - offsets[vertex]};
+        }
+    };
+
+    constexpr std::size_t fetch_line_size = 64;
+    constexpr std::size_t fetch_cache_lines = 64;
+
+    constexpr int overdraw_resolution = 256;
+
+    // Counts the pixels of one view; depth is the coordinate along 'axis'
+    // multiplied by 'sign', smaller is closer
+    void rasterize_view(std::span<std::uint32_t const> indices, position_reader const & position,
+        vec3 const & min, vec3 const & max, int axis, float sign, overdraw_stats & stats)
+    {
+        int const u = (axis + 1) % 3;
+        int const v = (axis + 2) % 3;
+
+        float const extent = std::max({max[u] - min[u], max[v] - min[v], std::numeric_limits<float>::min()});
+        float const scale = (overdraw_resolution - 1) / extent;
+
+        std::vector<float> depth(overdraw_resolution * overdraw_resolution, std::numeric_limits<float>::infinity());
+
+        vec3 view{0.f, 0.f, 0.f};
+        view[axis] = sign;
+
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            vec3 p[3];
+            for (int k = 0; k < 3; ++k)
+                p[k] = position(indices[i + k]);
+
+            if (dot(cross(sub(p[1], p[0]), sub(p[2], p[0])), view) >= 0.f)
+                continue;
+
+            float x[3], y[3], z[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                x[k] = (p[k][u] - min[u]) * scale;
+                y[k] = (p[k][v] - min[v]) * scale;
+                z[k] = p[k][axis] * sign;
+            }
+
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (area == 0.f)
+                continue;
+            if (area < 0.f)
+            {
+                std::swap(x[1], x[2]);
+                std::swap(y[1], y[2]);
+                std::swap(z[1], z[2]);
+                area = -area;
+            }
+
+            int const x0 = std::max(0, static_cast<int>(std::ceil(std::min({x[0], x[1], x[2]}) - 0.5f)));
+            int const x1 = std::min(overdraw_resolution - 1, static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}) - 0.5f)));
+            int const y0 = std::max(0, static_cast<int>(std::ceil(std::min({y[0], y[1], y[2]}) - 0.5f)));
+            int const y1 = std::min(overdraw_resolution - 1, static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}) - 0.5f)));
+
+            for (int py = y0; py <= y1; ++py)
+            {
+                for (int px = x0; px <= x1; ++px)
+                {
+                    float const cx = px + 0.5f;
+                    float const cy = py + 0.5f;
+
+                    float const w0 = (x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1]);
+                    float const w1 = (x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2]);
+                    float const w2 = (x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0]);
+                    if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+                        continue;
+
+                    float const pz = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+
+                    float & d = depth[py * overdraw_resolution + px];
+                    if (pz < d)
+                    {
+                        if (d == std::numeric_limits<float>::infinity())
+                            ++stats.pixels_covered;
+                        d = pz;
+                        ++stats.pixels_shaded;
+                    }
+                }
+            }
+        }
+    }
+
+}
+
+vertex_cache_stats analyze_vertex_cache(std::span<std::uint32_t const> indices, std::size_t vertex_count,
+    std::size_t cache_size)
+{
+    vertex_cache_stats stats;
+
+    fifo_cache cache(vertex_count, cache_size);
+    std::vector<bool> referenced(vertex_count, false);
+    std::size_t referenced_count = 0;
+
+    for (auto i : indices)
+    {
+        if (cache.access(i))
+            ++stats.vertices_transformed;
+        if (!referenced[i])
+        {
+            referenced[i] = true;
+            ++referenced_count;
+        }
+    }
+
+    if (indices.size() >= 3)
+        stats.acmr = static_cast<float>(stats.vertices_transformed) / (indices.size() / 3);
+    if (referenced_count > 0)
+        stats.atvr = static_cast<float>(stats.vertices_transformed) / referenced_count;
+
+    return stats;
+}
+
+vertex_fetch_stats analyze_vertex_fetch(std::span<std::uint32_t const> indices, std::size_t vertex_count,
+    std::size_t vertex_size)
+{
+    vertex_fetch_stats stats;
+
+    fifo_cache vertex_cache(vertex_count, 16);
+    fifo_cache line_cache((vertex_count * vertex_size + fetch_line_size - 1) / fetch_line_size, fetch_cache_lines);
+    std::vector<bool> referenced(vertex_count, false);
+    std::size_t referenced_count = 0;
+
+    for (auto i : indices)
+    {
+        if (!referenced[i])
+        {
+            referenced[i] = true;
+            ++referenced_count;
+        }
+
+        if (!vertex_cache.access(i))
+            continue;
+
+        std::size_t const first_line = i * vertex_size / fetch_line_size;
+        std::size_t const last_line = ((i + 1) * vertex_size - 1) / fetch_line_size;
+        for (std::size_t line = first_line; line <= last_line; ++line)
+            if (line_cache.access(line))
+                stats.bytes_fetched += fetch_line_size;
+    }
+
+    if (referenced_count > 0)
+        stats.overfetch = static_cast<float>(stats.bytes_fetched) / (referenced_count * vertex_size);
+
+    return stats;
+}
+
+overdraw_stats analyze_overdraw(std::span<std::uint32_t const> indices, float const * positions, std::size_t stride)
+{
+    overdraw_stats stats;
+
+    if (indices.empty())
+        return stats;
+
+    position_reader const position{reinterpret_cast<char const *>(positions), stride};
+
+    vec3 min{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+    vec3 max{-min[0], -min[1], -min[2]};
+    for (auto i : indices)
+    {
+        auto const p = position(i);
+        for (int k = 0; k < 3; ++k)
+        {
+            min[k] = std::min(min[k], p[k]);
+            max[k] = std::max(max[k], p[k]);
+        }
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+        for (float sign : {-1.f, 1.f})
+            rasterize_view(indices, position, min, max, axis, sign, stats);
+
+    if (stats.pixels_covered > 0)
+        stats.overdraw = static_cast<float>(stats.pixels_shaded) / stats.pixels_covered;
+
+    return stats;
+}
+
+void optimize_vertex_cache(std::span<std::uint32_t> indices, std::size_t vertex_count, std::size_t cache_size)
+{
+    std::size_t const triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    vertex_adjacency const adjacency(indices, vertex_count);
+
+    // Triangles not emitted yet, per vertex
+    std::vector<std::uint32_t> live(vertex_count);
+    for (std::size_t v = 0; v < vertex_count; ++v)
+        live[v] = adjacency[v].size();
+
+    std::vector<std::size_t> cache_time(vertex_count, 0);
+    std::size_t time = cache_size + 1;
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<std::uint32_t> dead_end;
+    std::vector<std::uint32_t> candidates;
+
+    std::vector<std::uint32_t> result;
+    result.reserve(triangle_count * 3);
+
+    std::size_t cursor = 0;
+    auto next_from_cursor = [&]() -> std::int64_t {
+        while (cursor < vertex_count && live[cursor] == 0)
+            ++cursor;
+        return cursor < vertex_count ? static_cast<std::int64_t>(cursor) : -1;
+    };
+
+    for (std::int64_t fanning = next_from_cursor(); fanning >= 0;)
+    {
+        candidates.clear();
+
+        for (auto t : adjacency[fanning])
+        {
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+
+            for (std::size_t k = 0; k < 3; ++k)
+            {
+                std::uint32_t const v = indices[t * 3 + k];
+                result.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cache_time[v] > cache_size)
+                    cache_time[v] = time++;
+            }
+        }
+
+        // Prefer the oldest candidate that stays in the cache while its
+        // remaining triangles are emitted
+        std::int64_t next = -1;
+        std::int64_t best_priority = -1;
+        for (auto v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+
+            std::int64_t priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size)
+                priority = time - cache_time[v];
+
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next = v;
+            }
+        }
+
+        while (next < 0 && !dead_end.empty())
+        {
+            std::uint32_t const v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] > 0)
+                next = v;
+        }
+
+        if (next < 0)
+            next = next_from_cursor();
+
+        fanning = next;
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void optimize_overdraw(std::span<std::uint32_t> indices, float const * positions, std::size_t vertex_count,
+    std::size_t stride, float threshold, std::size_t cache_size)
+{
+    std::size_t const triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    position_reader const position{reinterpret_cast<char const *>(positions), stride};
+
+    float const target = analyze_vertex_cache(indices, vertex_count, cache_size).acmr * threshold;
+
+    // Cluster boundaries, in triangles
+    std::vector<std::size_t> clusters{0};
+    {
+        fifo_cache cache(vertex_count, cache_size);
+        std::size_t misses = 0;
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            for (std::size_t k = 0; k < 3; ++k)
+                misses += cache.access(indices[t * 3 + k]);
+
+            if (t + 1 < triangle_count && misses <= target * (t + 1 - clusters.back()))
+            {
+                clusters.push_back(t + 1);
+                cache.flush();
+                misses = 0;
+            }
+        }
+        clusters.push_back(triangle_count);
+    }
+
+    std::size_t const cluster_count = clusters.size() - 1;
+
+    // Area-weighted centroid and normal of every cluster
+    std::vector<vec3> centers(cluster_count, vec3{0.f, 0.f, 0.f});
+    std::vector<vec3> normals(cluster_count, vec3{0.f, 0.f, 0.f});
+    std::vector<float> areas(cluster_count, 0.f);
+    vec3 mesh_center{0.f, 0.f, 0.f};
+    float mesh_area = 0.f;
+
+    for (std::size_t c = 0; c < cluster_count; ++c)
+    {
+        for (std::size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            auto const p0 = position(indices[t * 3 + 0]);
+            auto const p1 = position(indices[t * 3 + 1]);
+            auto const p2 = position(indices[t * 3 + 2]);
+
+            auto const n = cross(sub(p1, p0), sub(p2, p0));
+            float const area = std::sqrt(dot(n, n));
+
+            for (int k = 0; k < 3; ++k)
+            {
+                centers[c][k] += (p0[k] + p1[k] + p2[k]) * area / 3.f;
+                normals[c][k] += n[k];
+            }
+            areas[c] += area;
+        }
+
+        for (int k = 0; k < 3; ++k)
+            mesh_center[k] += centers[c][k];
+        mesh_area += areas[c];
+
+        if (areas[c] > 0.f)
+            for (int k = 0; k < 3; ++k)
+                centers[c][k] /= areas[c];
+    }
+
+    if (mesh_area > 0.f)
+        for (int k = 0; k < 3; ++k)
+            mesh_center[k] /= mesh_area;
+
+    std::vector<float> keys(cluster_count);
+    for (std::size_t c = 0; c < cluster_count; ++c)
+    {
+        float const length = std::sqrt(dot(normals[c], normals[c]));
+        keys[c] = (length > 0.f) ? dot(sub(centers[c], mesh_center), normals[c]) / length : 0.f;
+    }
+
+    std::vector<std::uint32_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b){
+        return keys[a] > keys[b];
+    });
+
+    std::vector<std::uint32_t> result;
+    result.reserve(triangle_count * 3);
+    for (auto c : order)
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+std::vector<std::uint32_t> vertex_fetch_remap(std::span<std::uint32_t> indices, std::size_t vertex_count)
+{
+    std::vector<std::uint32_t> remap(vertex_count, unused_vertex);
+
+    std::uint32_t next = 0;
+    for (auto & i : indices)
+    {
+        if (remap[i] == unused_vertex)
+            remap[i] = next++;
+        i = remap[i];
+    }
+
+    return remap;
+}
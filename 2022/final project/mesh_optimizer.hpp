@@ -0,0 +1,110 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Reordering of indexed triangle lists for faster rendering. The usual
+// pipeline is optimize_vertex_cache, then optimize_overdraw, then
+// optimize_vertex_fetch; the analyze_* functions simulate the relevant part
+// of the GPU on the CPU, so every step can be measured without one.
+//
+// Index buffers are triangle lists with indices below vertex_count. Positions
+// are passed as a pointer to the first vertex's three consecutive floats and
+// the byte stride between vertices.
+
+struct vertex_cache_stats
+{
+    std::size_t vertices_transformed = 0;
+
+    // Transformed vertices per triangle: 3 without any reuse, about 0.5 for
+    // a long regular grid strip
+    float acmr = 0.f;
+
+    // Transformed vertices per referenced vertex: 1 is the best possible
+    float atvr = 0.f;
+};
+
+struct vertex_fetch_stats
+{
+    std::size_t bytes_fetched = 0;
+
+    // Fetched bytes per byte of referenced vertex data: 1 is the best possible
+    float overfetch = 0.f;
+};
+
+struct overdraw_stats
+{
+    std::size_t pixels_covered = 0;
+    std::size_t pixels_shaded = 0;
+
+    // Shaded pixels per covered pixel: 1 means no overdraw
+    float overdraw = 0.f;
+};
+
+// FIFO post-transform cache of cache_size vertices
+vertex_cache_stats analyze_vertex_cache(std::span<std::uint32_t const> indices, std::size_t vertex_count,
+    std::size_t cache_size = 16);
+
+// Vertices are fetched on post-transform cache misses through a FIFO cache
+// of 64 lines of 64 bytes
+vertex_fetch_stats analyze_vertex_fetch(std::span<std::uint32_t const> indices, std::size_t vertex_count,
+    std::size_t vertex_size);
+
+// Rasterizes the triangles in index order with back-face culling and an
+// early depth test, looking along the six axis directions at 256x256
+overdraw_stats analyze_overdraw(std::span<std::uint32_t const> indices, float const * positions, std::size_t stride);
+
+// Tipsify (Sander et al., "Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw", 2007): fans triangles around a vertex chosen among the
+// recently used ones, falling back to a dead-end stack. Linear time.
+void optimize_vertex_cache(std::span<std::uint32_t> indices, std::size_t vertex_count, std::size_t cache_size = 16);
+
+// Cuts a cache-optimized index buffer into clusters whose own ACMR (with a
+// cold cache) stays within threshold of the whole buffer's, then draws the
+// clusters that face outwards from the mesh center first. Larger thresholds
+// give smaller clusters: less overdraw, more vertex transforms.
+void optimize_overdraw(std::span<std::uint32_t> indices, float const * positions, std::size_t vertex_count,
+    std::size_t stride, float threshold = 1.05f, std::size_t cache_size = 16);
+
+// Numbers the vertices in order of first use and rewrites the indices to the
+// new numbers. Returns the new number of every old vertex, unreferenced ones
+// get unused_vertex.
+constexpr std::uint32_t unused_vertex = ~std::uint32_t(0);
+std::vector<std::uint32_t> vertex_fetch_remap(std::span<std::uint32_t> indices, std::size_t vertex_count);
+
+// Overloads for vertex types with a 'position' member of three floats
+
+template <typename Vertex>
+float const * vertex_positions(std::vector<Vertex> const & vertices)
+{
+    return vertices.empty() ? nullptr : reinterpret_cast<float const *>(&vertices.front().position);
+}
+
+template <typename Vertex>
+overdraw_stats analyze_overdraw(std::span<std::uint32_t const> indices, std::vector<Vertex> const & vertices)
+{
+    return analyze_overdraw(indices, vertex_positions(vertices), sizeof(Vertex));
+}
+
+template <typename Vertex>
+void optimize_overdraw(std::span<std::uint32_t> indices, std::vector<Vertex> const & vertices, float threshold = 1.05f)
+{
+    optimize_overdraw(indices, vertex_positions(vertices), vertices.size(), sizeof(Vertex), threshold);
+}
+
+// Reorders the vertices by first use and drops the unreferenced ones
+template <typename Vertex>
+void optimize_vertex_fetch(std::vector<Vertex> & vertices, std::span<std::uint32_t> indices)
+{
+    auto const remap = vertex_fetch_remap(indices, vertices.size());
+
+    std::vector<Vertex> result(vertices.size() - std::count(remap.begin(), remap.end(), unused_vertex));
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+        if (remap[i] != unused_vertex)
+            result[remap[i]] = vertices[i];
+
+    vertices = std::move(result);
+}
@@ -0,0 +1,279 @@
+#include "obj_cache.hpp"
+#include "mapped_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace
+{
+
+    std::uint64_t rotl(std::uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // Murmur3-style 64-bit hash, 8 bytes per step
+    std::uint64_t hash_bytes(char const * data, std::size_t size)
+    {
+        std::uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            w *= 0x87c37b91114253d5ull;
+            w = rotl(w, 31);
+            w *= 0x4cf5ad432745937full;
+            h ^= w;
+            h = rotl(h, 27) * 5 + 0x52dce729;
+        }
+
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, data + i, size - i);
+        h ^= tail * 0x87c37b91114253d5ull;
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    std::int64_t source_mtime(std::filesystem::path const & source)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(source, ec);
+        return ec ? 0 : static_cast<std::int64_t>(time.time_since_epoch().count());
+    }
+
+    std::uint64_t payload_hash(std::string_view vertices, std::string_view indices, std::string_view metadata)
+    {
+        return hash_bytes(vertices.data(), vertices.size())
+            ^ rotl(hash_bytes(indices.data(), indices.size()), 1)
+            ^ rotl(hash_bytes(metadata.data(), metadata.size()), 2);
+    }
+
+    std::uint32_t parse_flags(obj_parse_options const & options)
+    {
+        return options.sort_by_material ? obj_cache_header::sorted_by_material_flag : 0;
+    }
+
+    template <typename T>
+    void write_value(std::string & out, T const & value)
+    {
+        out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+    }
+
+    void write_string(std::string & out, std::string_view value)
+    {
+        write_value(out, static_cast<std::uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    std::string encode_metadata(obj_data const & data)
+    {
+        std::string out;
+        for (auto const & s : data.submeshes)
+        {
+            write_value(out, s.material);
+            write_value(out, s.first_index);
+            write_value(out, s.index_count);
+        }
+        for (auto const & library : data.material_libraries)
+            write_string(out, library);
+        for (auto const & material : data.materials)
+            write_string(out, material.name);
+        for (auto const & s : data.submeshes)
+            write_string(out, s.name);
+        return out;
+    }
+
+    // Bounds-checked reader over the metadata block
+    struct metadata_reader
+    {
+        std::string_view data;
+
+        template <typename T>
+        bool read(T & value)
+        {
+            if (data.size() < sizeof(value))
+                return false;
+            std::memcpy(&value, data.data(), sizeof(value));
+            data.remove_prefix(sizeof(value));
+            return true;
+        }
+
+        bool read(std::string & value)
+        {
+            std::uint32_t size;
+            if (!read(size) || data.size() < size)
+                return false;
+            value.assign(data.data(), size);
+            data.remove_prefix(size);
+            return true;
+        }
+    };
+
+    bool decode_metadata(std::string_view metadata, obj_cache_header const & header, obj_data & result)
+    {
+        // Every record takes at least four bytes
+        if (header.submesh_count > metadata.size() || header.material_count > metadata.size()
+            || header.library_count > metadata.size())
+            return false;
+
+        metadata_reader reader{metadata};
+
+        result.submeshes.resize(header.submesh_count);
+        for (auto & s : result.submeshes)
+            if (!reader.read(s.material) || !reader.read(s.first_index) || !reader.read(s.index_count))
+                return false;
+
+        result.material_libraries.resize(header.library_count);
+        for (auto & library : result.material_libraries)
+            if (!reader.read(library))
+                return false;
+
+        result.materials.resize(header.material_count);
+        for (auto & material : result.materials)
+            if (!reader.read(material.name))
+                return false;
+
+        for (auto & s : result.submeshes)
+        {
+            if (!reader.read(s.name))
+                return false;
+            if (s.material >= result.materials.size()
+                || std::uint64_t(s.first_index) + s.index_count > result.indices.size())
+                return false;
+        }
+
+        return reader.data.empty();
+    }
+
+}
+
+std::filesystem::path obj_cache_path(std::filesystem::path const & source)
+{
+    auto result = source;
+    result += ".cache";
+    return result;
+}
+
+std::optional<obj_data> load_obj_cache(std::filesystem::path const & source, std::string_view source_data,
+    obj_parse_options const & options)
+{
+    auto const path = obj_cache_path(source);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+        return std::nullopt;
+
+    try
+    {
+        mapped_file file(path);
+
+        obj_cache_header header;
+        if (file.size() < sizeof(header))
+            return std::nullopt;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, obj_cache_header::magic_value, sizeof(header.magic)) != 0
+            || header.version != obj_cache_header::version_value
+            || header.byte_order != obj_cache_header::byte_order_value
+            || header.vertex_size != sizeof(obj_data::vertex)
+            || header.flags != parse_flags(options))
+            return std::nullopt;
+
+        if (header.source_size != source_data.size())
+            return std::nullopt;
+
+        // A touched but unmodified source is still a hit
+        if (header.source_mtime != source_mtime(source)
+            && header.source_hash != hash_bytes(source_data.data(), source_data.size()))
+            return std::nullopt;
+
+        std::uint64_t const vertices_size = header.vertex_count * sizeof(obj_data::vertex);
+        std::uint64_t const indices_size = header.index_count * sizeof(std::uint32_t);
+        if (header.vertex_count > file.size() || header.index_count > file.size()
+            || header.metadata_size > file.size()
+            || file.size() != sizeof(header) + vertices_size + indices_size + header.metadata_size)
+            return std::nullopt;
+
+        std::string_view const vertices{file.data() + sizeof(header), vertices_size};
+        std::string_view const indices{vertices.data() + vertices_size, indices_size};
+        std::string_view const metadata{indices.data() + indices_size, header.metadata_size};
+
+        if (header.payload_hash != payload_hash(vertices, indices, metadata))
+            return std::nullopt;
+
+        obj_data result;
+        result.vertices.resize(header.vertex_count);
+        result.indices.resize(header.index_count);
+        std::memcpy(result.vertices.data(), vertices.data(), vertices_size);
+        std::memcpy(result.indices.data(), indices.data(), indices_size);
+
+        if (!decode_metadata(metadata, header, result))
+            return std::nullopt;
+
+        return result;
+    }
+    catch (std::exception const &)
+    {
+        return std::nullopt;
+    }
+}
+
+void store_obj_cache(std::filesystem::path const & source, std::string_view source_data,
+    obj_parse_options const & options, obj_data const & data)
+{
+    auto const path = obj_cache_path(source);
+    auto temp_path = path;
+    temp_path += ".tmp";
+
+    std::string_view const vertices{reinterpret_cast<char const *>(data.vertices.data()),
+        data.vertices.size() * sizeof(obj_data::vertex)};
+    std::string_view const indices{reinterpret_cast<char const *>(data.indices.data()),
+        data.indices.size() * sizeof(std::uint32_t)};
+    std::string const metadata = encode_metadata(data);
+
+    obj_cache_header header{};
+    std::memcpy(header.magic, obj_cache_header::magic_value, sizeof(header.magic));
+    header.version = obj_cache_header::version_value;
+    header.byte_order = obj_cache_header::byte_order_value;
+    header.vertex_size = sizeof(obj_data::vertex);
+    header.flags = parse_flags(options);
+    header.source_size = source_data.size();
+    header.source_mtime = source_mtime(source);
+    header.source_hash = hash_bytes(source_data.data(), source_data.size());
+    header.vertex_count = data.vertices.size();
+    header.index_count = data.indices.size();
+    header.submesh_count = data.submeshes.size();
+    header.material_count = data.materials.size();
+    header.library_count = data.material_libraries.size();
+    header.metadata_size = metadata.size();
+    header.payload_hash = payload_hash(vertices, indices, metadata);
+
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        out.write(vertices.data(), vertices.size());
+        out.write(indices.data(), indices.size());
+        out.write(metadata.data(), metadata.size());
+        if (!out)
+        {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return;
+        }
+    }
+
+    // Readers never see a half-written cache
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+        std::filesystem::remove(temp_path, ec);
+}
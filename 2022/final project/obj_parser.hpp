@@ -1,8 +1,10 @@
 #pragma once
 
 #include <array>
+#include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
 
 struct obj_data
 {
@@ -13,8 +15,97 @@ struct obj_data
         std::array<float, 2> texcoord;
     };
 
+    // A 'newmtl' block of an MTL library. Texture paths are kept as written
+    // in the library; faces without a 'usemtl' get a material with an empty
+    // name and default values.
+    struct material
+    {
+        std::string name;
+        std::array<float, 3> ambient{0.f, 0.f, 0.f};
+        std::array<float, 3> diffuse{0.f, 0.f, 0.f};
+        std::array<float, 3> specular{0.f, 0.f, 0.f};
+        float shininess = 1.f;
+        float dissolve = 1.f;
+        std::string ambient_texture;
+        std::string diffuse_texture;
+        std::string specular_texture;
+        std::string alpha_texture;
+        std::string normal_texture;
+    };
+
+    // Range of indices drawn with one material; name is the last 'o' or 'g'
+    // seen before the faces (the material name once sorted by material)
+    struct submesh
+    {
+        std::string name;
+        std::uint32_t material;
+        std::uint32_t first_index;
+        std::uint32_t index_count;
+    };
+
     std::vector<vertex> vertices;
     std::vector<std::uint32_t> indices;
+
+    // Materials are numbered in order of first use by 'usemtl'
+    std::vector<material> materials;
+    std::vector<submesh> submeshes;
+
+    // 'mtllib' paths as written in the file, relative to its directory
+    std::vector<std::string> material_libraries;
+};
+
+struct obj_parse_options
+{
+    // Threads used to tokenize the file, 0 means one per hardware thread.
+    // The result does not depend on the thread count.
+    unsigned int threads = 1;
+
+    // Load the result from a binary sidecar (see obj_cache.hpp) if it is still
+    // valid, and write one after parsing otherwise
+    bool use_cache = false;
+
+    // Reorder triangles so that every material is a single submesh, which
+    // makes the draw count equal to the material count
+    bool sort_by_material = false;
+};
+
+obj_data parse_obj(std::filesystem::path const & path, obj_parse_options const & options = {});
+
+// Piece of a mesh produced by parse_obj_stream. Indices are global (already
+// offset by first_vertex), so consecutive chunks can be copied straight into
+// sub-ranges of one vertex and one index buffer.
+struct obj_chunk
+{
+    std::size_t first_vertex;
+    std::size_t first_index;
+    std::vector<obj_data::vertex> const & vertices;
+    std::vector<std::uint32_t> const & indices;
+};
+
+struct obj_stream_options
+{
+    // Approximate bound on the output-side memory: chunk vertices, chunk
+    // indices and the deduplication table
+    std::size_t memory_limit = 64 << 20;
+
+    // The v/vt/vn arrays are not covered by memory_limit: faces may reference
+    // any earlier attribute, so they are kept in full, 12 bytes per position
+    // or normal and 8 per texcoord. They dominate the peak on large files
+    // (about 440 MB of 493 MB on a 2.2 GB one); parse_obj_stream throws once
+    // they take more than this.
+    std::size_t attribute_limit = std::size_t(1) << 30;
+};
+
+struct obj_stream_stats
+{
+    std::size_t vertex_count = 0;
+    std::size_t index_count = 0;
+    std::size_t chunk_count = 0;
 };
 
-obj_data parse_obj(std::filesystem::path const & path);
+// Parses the file front to back and calls the callback every time the chunk
+// buffers fill up, and once at the end. Vertices are deduplicated within a
+// chunk only, so a vertex shared by faces in different chunks is repeated.
+// Only geometry is streamed: material and group records are skipped.
+obj_stream_stats parse_obj_stream(std::filesystem::path const & path,
+    std::function<void(obj_chunk const &)> const & callback, obj_stream_options const & options = {});
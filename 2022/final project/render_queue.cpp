@@ -0,0 +1,110 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+namespace
+{
+
+    constexpr int vertex_array_shift = 0;
+    constexpr int material_shift = vertex_array_shift + render_key::vertex_array_bits;
+    constexpr int program_shift = material_shift + render_key::material_bits;
+    constexpr int blend_shift = program_shift + render_key::program_bits;
+    constexpr int pass_shift = blend_shift + 1;
+    static_assert(pass_shift + render_key::pass_bits == 64);
+
+    constexpr std::uint64_t field_mask(int bits, int shift)
+    {
+        return ((std::uint64_t(1) << bits) - 1) << shift;
+    }
+
+    std::uint64_t pack_field(std::uint32_t value, int bits, int shift, char const * name)
+    {
+        if (value >= (std::uint64_t(1) << bits))
+            throw std::runtime_error(std::string("Render key ") + name + " out of range: " + std::to_string(value));
+        return std::uint64_t(value) << shift;
+    }
+
+    std::uint32_t unpack_field(std::uint64_t key, int bits, int shift)
+    {
+        return std::uint32_t((key & field_mask(bits, shift)) >> shift);
+    }
+
+}
+
+std::uint64_t render_key::pack() const
+{
+    return pack_field(pass, pass_bits, pass_shift, "pass")
+        | (std::uint64_t(blend ? 1 : 0) << blend_shift)
+        | pack_field(program, program_bits, program_shift, "program")
+        | pack_field(material, material_bits, material_shift, "material")
+        | pack_field(vertex_array, vertex_array_bits, vertex_array_shift, "vertex array");
+}
+
+render_key render_key::unpack(std::uint64_t key)
+{
+    render_key result;
+    result.pass = unpack_field(key, pass_bits, pass_shift);
+    result.blend = (key >> blend_shift) & 1;
+    result.program = unpack_field(key, program_bits, program_shift);
+    result.material = unpack_field(key, material_bits, material_shift);
+    result.vertex_array = unpack_field(key, vertex_array_bits, vertex_array_shift);
+    return result;
+}
+
+unsigned render_changes(std::uint64_t previous, std::uint64_t key)
+{
+    std::uint64_t const difference = previous ^ key;
+    unsigned result = 0;
+    if (difference & field_mask(render_key::pass_bits, pass_shift))
+        result |= render_pass_changed;
+    if (difference & field_mask(1, blend_shift))
+        result |= render_blend_changed;
+    if (difference & field_mask(render_key::program_bits, program_shift))
+        result |= render_program_changed;
+    if (difference & field_mask(render_key::material_bits, material_shift))
+        result |= render_material_changed;
+    if (difference & field_mask(render_key::vertex_array_bits, vertex_array_shift))
+        result |= render_vertex_array_changed;
+    return result;
+}
+
+void render_queue::sort()
+{
+    std::size_t const size = m_items.size();
+    if (size < 2)
+        return;
+
+    // All eight histograms in one pass over the keys
+    std::uint32_t counts[8][256] = {};
+    for (auto const & item : m_items)
+        for (int byte = 0; byte < 8; ++byte)
+            ++counts[byte][(item.key >> (8 * byte)) & 0xff];
+
+    m_scratch.resize(size);
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        auto & count = counts[byte];
+        if (count[(m_items[0].key >> (8 * byte)) & 0xff] == size)
+            continue;
+
+        std::uint32_t offset = 0;
+        for (auto & c : count)
+            offset += std::exchange(c, offset);
+
+        for (auto const & item : m_items)
+            m_scratch[count[(item.key >> (8 * byte)) & 0xff]++] = item;
+        std::swap(m_items, m_scratch);
+    }
+}
+
+std::span<render_item const> render_queue::pass(std::uint32_t pass) const
+{
+    std::uint64_t const begin_key = std::uint64_t(pass) << pass_shift;
+    auto const begin = std::lower_bound(m_items.begin(), m_items.end(), begin_key,
+        [](render_item const & item, std::uint64_t key){ return item.key < key; });
+    auto const end = std::find_if(begin, m_items.end(),
+        [pass](render_item const & item){ return unpack_field(item.key, render_key::pass_bits, pass_shift) != pass; });
+    return {begin, end};
+}
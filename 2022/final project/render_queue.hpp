@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// Draw submission ordered by GL state. Every frame the renderer pushes one
+// item per draw, tagged with a 64-bit key holding the state it needs; the
+// queue sorts the items by key with a radix sort, so that draws sharing a
+// program, a material or a vertex array end up next to each other, and
+// submission only sends GL the state that differs from the previous draw.
+//
+// The key fields, most significant first: the pass, blending, the program,
+// the material handle and the vertex array. Blending sits above the program
+// so that within a pass every blended draw comes after every opaque one,
+// whatever their programs. Equal keys keep the order they were pushed in.
+//
+// Nothing here calls GL, the queue only orders the items and tells which
+// fields change between them; see submit_render_items.
+
+struct render_key
+{
+    static constexpr int pass_bits = 8;
+    static constexpr int program_bits = 12;
+    static constexpr int material_bits = 24;
+    static constexpr int vertex_array_bits = 19;
+
+    std::uint32_t pass = 0;
+    bool blend = false;
+    // GL names, or any small handles the renderer maps to them
+    std::uint32_t program = 0;
+    std::uint32_t material = 0;
+    std::uint32_t vertex_array = 0;
+
+    // Throws if a field does not fit its bits
+    std::uint64_t pack() const;
+    static render_key unpack(std::uint64_t key);
+};
+
+// What the caller needs to issue the draw, e.g. a mesh index
+struct render_item
+{
+    std::uint64_t key;
+    std::uint32_t draw;
+};
+
+// Fields that differ between two keys
+enum render_change : unsigned
+{
+    render_pass_changed = 1,
+    render_blend_changed = 2,
+    render_program_changed = 4,
+    render_material_changed = 8,
+    render_vertex_array_changed = 16,
+    render_all_changed = 31,
+};
+
+unsigned render_changes(std::uint64_t previous, std::uint64_t key);
+
+class render_queue
+{
+public:
+    void clear() { m_items.clear(); }
+    void push(render_key const & key, std::uint32_t draw) { m_items.push_back({key.pack(), draw}); }
+
+    // Stable LSD radix sort on the keys, a byte at a time, skipping the
+    // bytes all keys share. Does not allocate once the queue has held as
+    // many items
+    void sort();
+
+    std::span<render_item const> items() const { return m_items; }
+    // The items of one pass, once sorted
+    std::span<render_item const> pass(std::uint32_t pass) const;
+
+private:
+    std::vector<render_item> m_items;
+    std::vector<render_item> m_scratch;
+};
+
+// Calls submit(item, changes) for every item, changes holding the
+// render_change bits of the fields that differ from the previous item's;
+// all of them for the first item
+template <typename Submit>
+void submit_render_items(std::span<render_item const> items, Submit && submit)
+{
+    for (std::size_t i = 0; i < items.size(); ++i)
+        submit(items[i], i == 0 ? unsigned(render_all_changed) : render_changes(items[i - 1].key, items[i].key));
+}
+
+// Gives equal materials the same handle, in the order they first appear, so
+// that per-mesh materials loaded from a model can be resolved once, at load
+// time, to the handles render_key takes. Material needs operator ==; the
+// search is linear, scenes have a few dozen materials
+template <typename Material>
+class material_table
+{
+public:
+    std::uint32_t add(Material const & material)
+    {
+        for (std::size_t i = 0; i < m_materials.size(); ++i)
+            if (m_materials[i] == material)
+                return std::uint32_t(i);
+        if (m_materials.size() >= (std::size_t(1) << render_key::material_bits))
+            throw std::runtime_error("Too many materials for a render key");
+        m_materials.push_back(material);
+        return std::uint32_t(m_materials.size() - 1);
+    }
+
+    Material const & operator[](std::uint32_t handle) const { return m_materials[handle]; }
+    std::size_t size() const { return m_materials.size(); }
+
+private:
+    std::vector<Material> m_materials;
+};
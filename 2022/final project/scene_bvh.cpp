@@ -0,0 +1,231 @@
+#include "scene_bvh.hpp"
+#include "simd_batch.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+void scene_bvh::build(box_set const & boxes)
+{
+    if (boxes.size() > std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error("Too many objects for a scene BVH");
+
+    m_nodes.clear();
+    m_dirty.clear();
+    m_object.resize(boxes.size());
+    std::iota(m_object.begin(), m_object.end(), 0);
+    if (boxes.size() == 0)
+    {
+        m_boxes.clear();
+        m_slot.clear();
+        m_leaf.clear();
+        m_is_dirty.clear();
+        return;
+    }
+
+    build_node(boxes, 0, 0, boxes.size());
+
+    m_boxes.clear();
+    m_slot.resize(boxes.size());
+    m_leaf.resize(boxes.size());
+    for (std::uint32_t slot = 0; slot < m_object.size(); ++slot)
+    {
+        std::uint32_t const object = m_object[slot];
+        glm::vec3 const center(boxes.center_x[object], boxes.center_y[object], boxes.center_z[object]);
+        glm::vec3 const extent(boxes.extent_x[object], boxes.extent_y[object], boxes.extent_z[object]);
+        m_boxes.add(center - extent, center + extent);
+        m_slot[object] = slot;
+    }
+
+    // Children come after their parents
+    for (std::uint32_t index = m_nodes.size(); index-- > 0;)
+    {
+        if (m_nodes[index].right == 0)
+            for (std::uint32_t slot = m_nodes[index].begin; slot < m_nodes[index].end; ++slot)
+                m_leaf[slot] = index;
+        fit(index);
+    }
+    m_is_dirty.assign(m_nodes.size(), false);
+}
+
+std::uint32_t scene_bvh::build_node(box_set const & boxes, std::uint32_t parent, std::uint32_t begin, std::uint32_t end)
+{
+    std::uint32_t const index = m_nodes.size();
+    m_nodes.push_back({glm::vec3(0.f), begin, glm::vec3(0.f), end, 0, parent});
+    if (end - begin <= leaf_size)
+        return index;
+
+    glm::vec3 min(std::numeric_limits<float>::infinity());
+    glm::vec3 max(-std::numeric_limits<float>::infinity());
+    for (std::uint32_t slot = begin; slot < end; ++slot)
+    {
+        std::uint32_t const object = m_object[slot];
+        glm::vec3 const center(boxes.center_x[object], boxes.center_y[object], boxes.center_z[object]);
+        min = glm::min(min, center);
+        max = glm::max(max, center);
+    }
+
+    glm::vec3 const size = max - min;
+    auto const & centers = (size.x >= size.y && size.x >= size.z) ? boxes.center_x
+        : (size.y >= size.z) ? boxes.center_y : boxes.center_z;
+
+    std::uint32_t const middle = begin + (end - begin) / 2;
+    std::nth_element(m_object.begin() + begin, m_object.begin() + middle, m_object.begin() + end,
+        [&](std::uint32_t a, std::uint32_t b){ return centers[a] < centers[b]; });
+
+    build_node(boxes, index, begin, middle);
+    std::uint32_t const right = build_node(boxes, index, middle, end);
+    m_nodes[index].right = right;
+    return index;
+}
+
+void scene_bvh::fit(std::uint32_t index)
+{
+    node & n = m_nodes[index];
+
+    glm::vec3 min, max;
+    if (n.right == 0)
+    {
+        min = glm::vec3(std::numeric_limits<float>::infinity());
+        max = glm::vec3(-std::numeric_limits<float>::infinity());
+        for (std::uint32_t slot = n.begin; slot < n.end; ++slot)
+        {
+            glm::vec3 const center(m_boxes.center_x[slot], m_boxes.center_y[slot], m_boxes.center_z[slot]);
+            glm::vec3 const extent(m_boxes.extent_x[slot], m_boxes.extent_y[slot], m_boxes.extent_z[slot]);
+            min = glm::min(min, center - extent);
+            max = glm::max(max, center + extent);
+        }
+    }
+    else
+    {
+        node const & left = m_nodes[index + 1];
+        node const & right = m_nodes[n.right];
+        min = glm::min(left.center - left.extent, right.center - right.extent);
+        max = glm::max(left.center + left.extent, right.center + right.extent);
+    }
+
+    n.center = (min + max) * 0.5f;
+    n.extent = (max - min) * 0.5f;
+}
+
+void scene_bvh::update(std::size_t object, glm::vec3 const & min, glm::vec3 const & max)
+{
+    std::uint32_t const slot = m_slot[object];
+    m_boxes.set(slot, min, max);
+
+    std::uint32_t const leaf = m_leaf[slot];
+    if (!m_is_dirty[leaf])
+    {
+        m_is_dirty[leaf] = true;
+        m_dirty.push_back(leaf);
+    }
+}
+
+void scene_bvh::refit()
+{
+    for (std::uint32_t index : m_dirty)
+    {
+        m_is_dirty[index] = false;
+        fit(index);
+
+        // Ancestors above one whose bounds stay the same do not change
+        // either
+        while (index != 0)
+        {
+            index = m_nodes[index].parent;
+            glm::vec3 const center = m_nodes[index].center;
+            glm::vec3 const extent = m_nodes[index].extent;
+            fit(index);
+            if (m_nodes[index].center == center && m_nodes[index].extent == extent)
+                break;
+        }
+    }
+    m_dirty.clear();
+}
+
+void scene_bvh::cull(std::array<glm::vec4, 6> const & planes, std::vector<std::uint32_t> & visible) const
+{
+    visible.clear();
+    if (m_nodes.empty())
+        return;
+
+    std::array<glm::vec3, 6> abs_normals;
+    for (std::size_t p = 0; p < planes.size(); ++p)
+        abs_normals[p] = glm::abs(glm::vec3(planes[p]));
+
+    // A median split of 2^32 objects is less than 32 levels deep, and the
+    // stack holds at most one right child per level
+    struct entry
+    {
+        std::uint32_t node;
+        // The planes the node is not known to be inside of
+        std::uint32_t planes;
+    };
+    std::array<entry, 64> stack;
+    std::size_t stack_size = 0;
+    stack[stack_size++] = {0, (1u << planes.size()) - 1};
+
+    while (stack_size > 0)
+    {
+        auto [index, mask] = stack[--stack_size];
+        node const & n = m_nodes[index];
+
+        bool outside = false;
+        for (std::size_t p = 0; p < planes.size() && !outside; ++p)
+        {
+            if (!(mask & (1u << p)))
+                continue;
+            float const distance = glm::dot(glm::vec3(planes[p]), n.center) + planes[p].w;
+            float const radius = glm::dot(abs_normals[p], n.extent);
+            outside = distance + radius < 0.f;
+            if (distance - radius >= 0.f)
+                mask &= ~(1u << p);
+        }
+        if (outside)
+            continue;
+
+        if (mask == 0)
+        {
+            visible.insert(visible.end(), m_object.begin() + n.begin, m_object.begin() + n.end);
+            continue;
+        }
+
+        if (n.right != 0)
+        {
+            stack[stack_size++] = {n.right, mask};
+            stack[stack_size++] = {index + 1, mask};
+            continue;
+        }
+
+        for_lanes(n.begin, n.end, [&](auto batch, std::size_t i){
+            using Batch = decltype(batch);
+            Batch const cx = Batch::load(m_boxes.center_x.data() + i);
+            Batch const cy = Batch::load(m_boxes.center_y.data() + i);
+            Batch const cz = Batch::load(m_boxes.center_z.data() + i);
+            Batch const ex = Batch::load(m_boxes.extent_x.data() + i);
+            Batch const ey = Batch::load(m_boxes.extent_y.data() + i);
+            Batch const ez = Batch::load(m_boxes.extent_z.data() + i);
+
+            Batch furthest = Batch::broadcast(std::numeric_limits<float>::infinity());
+            for (std::size_t p = 0; p < planes.size(); ++p)
+            {
+                if (!(mask & (1u << p)))
+                    continue;
+                Batch const distance = cx * Batch::broadcast(planes[p].x) + cy * Batch::broadcast(planes[p].y)
+                    + cz * Batch::broadcast(planes[p].z) + Batch::broadcast(planes[p].w);
+                Batch const radius = ex * Batch::broadcast(abs_normals[p].x) + ey * Batch::broadcast(abs_normals[p].y)
+                    + ez * Batch::broadcast(abs_normals[p].z);
+                furthest = min(furthest, distance + radius);
+            }
+
+            unsigned int const outside = movemask(less(furthest, Batch::broadcast(0.f)));
+            for (std::size_t lane = 0; lane < Batch::size; ++lane)
+                if (!(outside & (1u << lane)))
+                    visible.push_back(m_object[i + lane]);
+        });
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "box_culling.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A bounding volume hierarchy over the boxes of a scene, for culling it as a
+// whole: a subtree whose bounds lie behind a plane of the frustum is skipped,
+// and one whose bounds lie inside every plane is accepted without testing its
+// objects, so the cost grows with the visible part of the scene and the
+// frustum's boundary rather than with the scene. The planes a node is inside
+// of are not tested again below it; the objects of leaves on the boundary are
+// tested in SIMD batches, as by cull_boxes(), whose result cull() matches.
+//
+// build() splits the boxes at the median of their centers along the longest
+// axis of the centers' bounds until at most leaf_size are left. Objects that
+// move are only refitted: update() stores the new box, and refit() recomputes
+// the bounds of the leaves holding updated objects and of their ancestors,
+// stopping at the first ancestor whose bounds did not change. The shape of the
+// tree is kept, so that objects straying far from where they were at build()
+// make it looser; call build() again then.
+class scene_bvh
+{
+public:
+    static constexpr std::size_t leaf_size = 8;
+
+    // Object i has box i; any previous tree is replaced
+    void build(box_set const & boxes);
+
+    std::size_t size() const { return m_slot.size(); }
+    std::size_t node_count() const { return m_nodes.size(); }
+
+    // Takes effect at the next refit()
+    void update(std::size_t object, glm::vec3 const & min, glm::vec3 const & max);
+    void refit();
+
+    // Replaces visible by the objects whose boxes are not culled, in no
+    // particular order
+    void cull(std::array<glm::vec4, 6> const & planes, std::vector<std::uint32_t> & visible) const;
+
+private:
+    struct node
+    {
+        glm::vec3 center;
+        // The node's objects are those of slots begin up to end
+        std::uint32_t begin;
+        glm::vec3 extent;
+        std::uint32_t end;
+        // The left child is the next node; leaves have no right child (0,
+        // which is the root)
+        std::uint32_t right;
+        std::uint32_t parent;
+    };
+
+    std::uint32_t build_node(box_set const & boxes, std::uint32_t parent, std::uint32_t begin, std::uint32_t end);
+    void fit(std::uint32_t index);
+
+    std::vector<node> m_nodes;
+    // The boxes in slot order, which keeps the objects of every subtree
+    // together
+    box_set m_boxes;
+    std::vector<std::uint32_t> m_object;
+    std::vector<std::uint32_t> m_slot;
+    // The leaf of every slot, and the leaves to refit
+    std::vector<std::uint32_t> m_leaf;
+    std::vector<std::uint32_t> m_dirty;
+    std::vector<bool> m_is_dirty;
+};
@@ -1,14 +1,25 @@
 #version 330 core
 
-uniform sampler2D albedo;
+// Layers of texture arrays; the transforms take texcoord to the texture's
+// region of the layer, as scale (xy) and offset (zw)
+uniform sampler2DArray albedo;
+uniform float albedo_layer;
+uniform vec4 albedo_transform;
 uniform vec3 light_color;
-uniform sampler2D normal_texture;
-uniform sampler2D roughness_texture;
+uniform sampler2DArray normal_texture;
+uniform float normal_layer;
+uniform vec4 normal_transform;
+uniform sampler2DArray roughness_texture;
+uniform float roughness_layer;
+uniform vec4 roughness_transform;
 uniform vec3 camera_position;
 uniform sampler2D shadow_map;
 uniform mat4 transform;
 uniform vec4 color;
 uniform int use_texture;
+// Materials without a normal or an occlusion-roughness texture
+uniform int use_normal_texture;
+uniform int use_roughness_texture;
 
 uniform vec3 light_direction;
 
@@ -17,14 +28,24 @@ layout (location = 0) out vec4 out_color;
 in vec3 position;
 in vec3 normal;
 in vec3 tangent;
+in float tangent_sign;
 in vec2 texcoord;
 
+// Atlased textures repeat within their region; the gradients are those of
+// the unwrapped coordinates, so that fract does not upset mip selection
+vec4 sample_layer(sampler2DArray array, float layer, vec4 transform, vec2 uv) {
+    vec2 region_uv = transform.zw + fract(uv) * transform.xy;
+    return textureGrad(array, vec3(region_uv, layer), dFdx(uv) * transform.xy, dFdy(uv) * transform.xy);
+}
+
 float diffuse(vec3 real_normal, vec3 direction) {
     return max(0.0, dot(real_normal, direction));
 }
 
 float specular(vec3 real_normal, vec3 direction) {
-    float roughness = texture(roughness_texture, texcoord).g;
+    if (use_roughness_texture == 0)
+    return 0.0;
+    float roughness = sample_layer(roughness_texture, roughness_layer, roughness_transform, texcoord).g;
     float power = 1.0 / pow(roughness, 2.0) - 1.0;
     vec3 reflected_direction = 2.0 * real_normal * dot(real_normal, direction) - direction;
     vec3 camera_direction = normalize(camera_position - position);
@@ -37,9 +58,12 @@ float phong(vec3 real_normal, vec3 direction) {
 }
 
 void main() {
-    vec3 bitangent = cross(tangent, normal);
+    // Mirrored texcoords flip the bitangent
+    vec3 bitangent = tangent_sign * cross(tangent, normal);
     mat3 tbn = mat3(tangent, bitangent, normal);
-    vec3 real_normal = normalize(tbn * (texture(normal_texture, texcoord).xyz * 2.0 - vec3(1.0)));
+    vec3 real_normal = normal;
+    if (use_normal_texture == 1)
+    real_normal = normalize(tbn * (sample_layer(normal_texture, normal_layer, normal_transform, texcoord).xyz * 2.0 - vec3(1.0)));
 
 
     vec4 shadow_pos = transform * vec4(position, 1.0);
@@ -77,11 +101,11 @@ void main() {
 
     vec4 albedo_color;
     if (use_texture == 1)
-    albedo_color = texture(albedo, vec2(texcoord.x, texcoord.y));
+    albedo_color = sample_layer(albedo, albedo_layer, albedo_transform, texcoord);
     else
     albedo_color = color;
 
-    float ambient = texture(roughness_texture, texcoord).r;
+    float ambient = (use_roughness_texture == 1) ? sample_layer(roughness_texture, roughness_layer, roughness_transform, texcoord).r : 1.0;
     //float koef = texture(roughness_texture, texcoord).b;
     vec3 light = vec3(ambient) + light_color * phong(real_normal, light_direction) * shadow_factor;
     out_color = vec4(albedo_color.rgb * light, albedo_color.a);
@@ -1,23 +1,38 @@
 #version 330 core
 
 uniform mat4 model;
+// Takes the quantized positions back to the model space
+uniform mat4 position_decode;
 uniform mat4 view;
 uniform mat4 projection;
 
-layout (location = 0) in vec3 in_position;
-layout (location = 1) in vec3 in_tangent;
-layout (location = 2) in vec3 in_normal;
+// w is the tangent's handedness, 0 for -1 and 1 for +1
+layout (location = 0) in vec4 in_position;
+layout (location = 1) in vec2 in_tangent;
+layout (location = 2) in vec2 in_normal;
 layout (location = 3) in vec2 in_texcoord;
 
 out vec3 position;
 out vec3 normal;
 out vec3 tangent;
+out float tangent_sign;
 out vec2 texcoord;
 
+vec3 decode_octahedral(vec2 value) {
+    vec2 p = value * 2.0 - 1.0;
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = projection * view * model * vec4(in_position, 1.0);
-    position = (model * vec4(in_position, 1.0)).xyz;
-    tangent = mat3(model) * in_tangent;
-    normal = normalize(mat3(model) * in_normal);
+    vec4 model_position = position_decode * vec4(in_position.xyz, 1.0);
+    gl_Position = projection * view * model * model_position;
+    position = (model * model_position).xyz;
+    tangent = mat3(model) * decode_octahedral(in_tangent);
+    tangent_sign = in_position.w * 2.0 - 1.0;
+    normal = normalize(mat3(model) * decode_octahedral(in_normal));
     texcoord = in_texcoord;
 }
\ No newline at end of file
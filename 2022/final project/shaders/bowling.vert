@@ -5,16 +5,25 @@ uniform mat4 view;
 uniform mat4 projection;
 
 layout (location = 0) in vec3 in_position;
-layout (location = 1) in vec3 in_normal;
+layout (location = 1) in vec2 in_normal;
 layout (location = 2) in vec2 in_tex_coord;
 
 out vec3 position;
 out vec3 normal;
 out vec2 tex_coord;
 
+vec3 decode_octahedral(vec2 value) {
+    vec2 p = value * 2.0 - 1.0;
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main() {
     gl_Position = projection * view * transform * model * vec4(in_position, 1.0);
     position = (transform * model * vec4(in_position, 1.0)).xyz;
-    normal = normalize(mat3(model) * in_normal);
+    normal = normalize(mat3(model) * decode_octahedral(in_normal));
     tex_coord = vec2(in_tex_coord[0], 1.f - in_tex_coord[1]);
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "shadow_cache.hpp"
+
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+texel_rect merge(texel_rect const & a, texel_rect const & b)
+{
+    if (a.empty())
+        return b;
+    if (b.empty())
+        return a;
+    return {std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1)};
+}
+
+shadow_cache::shadow_cache(int resolution, int margin)
+    : m_resolution(resolution)
+    , m_margin(margin)
+{}
+
+bool shadow_cache::begin_frame(glm::mat4 const & transform)
+{
+    m_previous = m_current;
+    m_current = {};
+
+    m_static_rendered = !m_valid || transform != m_transform;
+    m_transform = transform;
+    m_valid = true;
+    return m_static_rendered;
+}
+
+void shadow_cache::add_dynamic(glm::vec3 const & min, glm::vec3 const & max)
+{
+    m_current = merge(m_current, texels(min, max));
+}
+
+texel_rect shadow_cache::region() const
+{
+    if (m_static_rendered)
+        return {0, 0, m_resolution, m_resolution};
+    return merge(m_previous, m_current);
+}
+
+texel_rect shadow_cache::texels(glm::vec3 const & min, glm::vec3 const & max) const
+{
+    glm::vec2 low(std::numeric_limits<float>::infinity());
+    glm::vec2 high(-std::numeric_limits<float>::infinity());
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec3 const p((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+        glm::vec4 const clip = m_transform * glm::vec4(p, 1.f);
+        glm::vec2 const texel = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * float(m_resolution);
+        low = glm::min(low, texel);
+        high = glm::max(high, texel);
+    }
+
+    // Clamp in floats first, a box far outside the map may not fit an int
+    float const size = float(m_resolution);
+    low = glm::clamp(glm::floor(low) - float(m_margin), 0.f, size);
+    high = glm::clamp(glm::ceil(high) + float(m_margin), 0.f, size);
+    return {int(low.x), int(low.y), int(high.x), int(high.y)};
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+// The bookkeeping of a shadow map split into a static layer, rendered only
+// when the light or the static casters change, and the map the scene is
+// shaded with, rebuilt every frame from a copy of the static layer with the
+// dynamic casters drawn over it.
+//
+// Only the texels the dynamic casters may touch are rebuilt: those under
+// their boxes as the light sees them this frame, and those under last
+// frame's, whose shadows have to be erased. Nothing here calls GL; the
+// renderer copies region() from the static layer and draws the dynamic
+// casters scissored to it.
+
+// Texels x0 up to x1 and y0 up to y1
+struct texel_rect
+{
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+    int width() const { return empty() ? 0 : x1 - x0; }
+    int height() const { return empty() ? 0 : y1 - y0; }
+};
+
+texel_rect merge(texel_rect const & a, texel_rect const & b);
+
+class shadow_cache
+{
+public:
+    // margin texels are added around every caster, to cover the texels
+    // rasterization and the moments' derivatives reach beyond its box
+    explicit shadow_cache(int resolution, int margin = 2);
+
+    // Starts a frame lit with transform, which maps world space to the
+    // shadow map's clip space. Returns whether the static layer has to be
+    // rendered: on the first frame, when the transform changed, or after
+    // invalidate().
+    bool begin_frame(glm::mat4 const & transform);
+
+    // Makes the next begin_frame() render the static layer, e.g. when a
+    // static caster moved
+    void invalidate() { m_valid = false; }
+
+    // Adds the world-space box of a dynamic caster to this frame's region
+    void add_dynamic(glm::vec3 const & min, glm::vec3 const & max);
+
+    // The texels to rebuild this frame; the whole map after the static layer
+    // was rendered
+    texel_rect region() const;
+
+    // The texels under a world-space box, with the margin, clamped to the map
+    texel_rect texels(glm::vec3 const & min, glm::vec3 const & max) const;
+
+private:
+    int m_resolution;
+    int m_margin;
+    bool m_valid = false;
+    bool m_static_rendered = false;
+    glm::mat4 m_transform{1.f};
+    texel_rect m_previous;
+    texel_rect m_current;
+};
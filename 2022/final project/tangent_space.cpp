@@ -0,0 +1,471 @@
+#include "tangent_space.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include <cmath>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+    // The operations the triangle pass needs on a few lanes of floats.
+    // Comparisons return masks that only select() understands.
+    struct scalar_batch
+    {
+        static constexpr std::size_t size = 1;
+        float v;
+
+        static scalar_batch load(float const * p) { return {*p}; }
+        static scalar_batch broadcast(float x) { return {x}; }
+        void store(float * p) const { *p = v; }
+
+        friend scalar_batch operator + (scalar_batch a, scalar_batch b) { return {a.v + b.v}; }
+        friend scalar_batch operator - (scalar_batch a, scalar_batch b) { return {a.v - b.v}; }
+        friend scalar_batch operator * (scalar_batch a, scalar_batch b) { return {a.v * b.v}; }
+        friend scalar_batch operator / (scalar_batch a, scalar_batch b) { return {a.v / b.v}; }
+        friend scalar_batch sqrt(scalar_batch a) { return {std::sqrt(a.v)}; }
+        friend scalar_batch min(scalar_batch a, scalar_batch b) { return {std::min(a.v, b.v)}; }
+        friend scalar_batch max(scalar_batch a, scalar_batch b) { return {std::max(a.v, b.v)}; }
+        friend scalar_batch abs(scalar_batch a) { return {std::abs(a.v)}; }
+        friend scalar_batch less(scalar_batch a, scalar_batch b) { return {a.v < b.v ? 1.f : 0.f}; }
+        friend scalar_batch select(scalar_batch mask, scalar_batch a, scalar_batch b) { return mask.v != 0.f ? a : b; }
+    };
+
+#if defined(__AVX__)
+    struct simd_batch
+    {
+        static constexpr std::size_t size = 8;
+        __m256 v;
+
+        static simd_batch load(float const * p) { return {_mm256_loadu_ps(p)}; }
+        static simd_batch broadcast(float x) { return {_mm256_set1_ps(x)}; }
+        void store(float * p) const { _mm256_storeu_ps(p, v); }
+
+        friend simd_batch operator + (simd_batch a, simd_batch b) { return {_mm256_add_ps(a.v, b.v)}; }
+        friend simd_batch operator - (simd_batch a, simd_batch b) { return {_mm256_sub_ps(a.v, b.v)}; }
+        friend simd_batch operator * (simd_batch a, simd_batch b) { return {_mm256_mul_ps(a.v, b.v)}; }
+        friend simd_batch operator / (simd_batch a, simd_batch b) { return {_mm256_div_ps(a.v, b.v)}; }
+        friend simd_batch sqrt(simd_batch a) { return {_mm256_sqrt_ps(a.v)}; }
+        friend simd_batch min(simd_batch a, simd_batch b) { return {_mm256_min_ps(a.v, b.v)}; }
+        friend simd_batch max(simd_batch a, simd_batch b) { return {_mm256_max_ps(a.v, b.v)}; }
+        friend simd_batch abs(simd_batch a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v)}; }
+        friend simd_batch less(simd_batch a, simd_batch b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+        friend simd_batch select(simd_batch mask, simd_batch a, simd_batch b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+    };
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    struct simd_batch
+    {
+        static constexpr std::size_t size = 4;
+        __m128 v;
+
+        static simd_batch load(float const * p) { return {_mm_loadu_ps(p)}; }
+        static simd_batch broadcast(float x) { return {_mm_set1_ps(x)}; }
+        void store(float * p) const { _mm_storeu_ps(p, v); }
+
+        friend simd_batch operator + (simd_batch a, simd_batch b) { return {_mm_add_ps(a.v, b.v)}; }
+        friend simd_batch operator - (simd_batch a, simd_batch b) { return {_mm_sub_ps(a.v, b.v)}; }
+        friend simd_batch operator * (simd_batch a, simd_batch b) { return {_mm_mul_ps(a.v, b.v)}; }
+        friend simd_batch operator / (simd_batch a, simd_batch b) { return {_mm_div_ps(a.v, b.v)}; }
+        friend simd_batch sqrt(simd_batch a) { return {_mm_sqrt_ps(a.v)}; }
+        friend simd_batch min(simd_batch a, simd_batch b) { return {_mm_min_ps(a.v, b.v)}; }
+        friend simd_batch max(simd_batch a, simd_batch b) { return {_mm_max_ps(a.v, b.v)}; }
+        friend simd_batch abs(simd_batch a) { return {_mm_andnot_ps(_mm_set1_ps(-0.f), a.v)}; }
+        friend simd_batch less(simd_batch a, simd_batch b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+        friend simd_batch select(simd_batch mask, simd_batch a, simd_batch b)
+        {
+            return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+        }
+    };
+#else
+    using simd_batch = scalar_batch;
+#endif
+
+    template <typename Batch>
+    struct batch3
+    {
+        Batch x, y, z;
+
+        friend batch3 operator + (batch3 const & a, batch3 const & b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+        friend batch3 operator - (batch3 const & a, batch3 const & b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+        friend batch3 operator * (batch3 const & a, Batch s) { return {a.x * s, a.y * s, a.z * s}; }
+    };
+
+    template <typename Batch>
+    Batch dot(batch3<Batch> const & a, batch3<Batch> const & b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    template <typename Batch>
+    batch3<Batch> cross(batch3<Batch> const & a, batch3<Batch> const & b)
+    {
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+
+    // Abramowitz and Stegun 4.4.45, within 7e-5 radians of acos: corner
+    // angles only weight the tangents
+    template <typename Batch>
+    Batch fast_acos(Batch x)
+    {
+        Batch const a = abs(x);
+        Batch p = Batch::broadcast(-0.0187293f);
+        p = p * a + Batch::broadcast(0.0742610f);
+        p = p * a - Batch::broadcast(0.2121144f);
+        p = p * a + Batch::broadcast(1.5707288f);
+        Batch const r = sqrt(max(Batch::broadcast(1.f) - a, Batch::broadcast(0.f))) * p;
+        return select(less(x, Batch::broadcast(0.f)), Batch::broadcast(3.14159265f) - r, r);
+    }
+
+    template <typename Batch>
+    Batch corner_angle(batch3<Batch> const & a, batch3<Batch> const & b)
+    {
+        Batch const lengths = sqrt(max(dot(a, a) * dot(b, b), Batch::broadcast(1e-30f)));
+        Batch const cos = min(max(dot(a, b) / lengths, Batch::broadcast(-1.f)), Batch::broadcast(1.f));
+        return fast_acos(cos);
+    }
+
+    struct mesh_input
+    {
+        std::span<std::uint32_t const> indices;
+        char const * positions;
+        std::size_t position_stride;
+        char const * texcoords;
+        std::size_t texcoord_stride;
+    };
+
+    // Positions (and texcoords) of the corners of size triangles starting at
+    // first, as [corner][axis][lane]
+    template <typename Batch>
+    struct triangle_batch
+    {
+        float p[3][3][Batch::size];
+        float uv[3][2][Batch::size];
+
+        triangle_batch(mesh_input const & input, std::size_t first)
+        {
+            for (std::size_t lane = 0; lane < Batch::size; ++lane)
+            {
+                for (std::size_t k = 0; k < 3; ++k)
+                {
+                    std::uint32_t const index = input.indices[3 * (first + lane) + k];
+
+                    float position[3];
+                    std::memcpy(position, input.positions + index * input.position_stride, sizeof(position));
+                    for (std::size_t axis = 0; axis < 3; ++axis)
+                        p[k][axis][lane] = position[axis];
+
+                    if (input.texcoords)
+                    {
+                        float texcoord[2];
+                        std::memcpy(texcoord, input.texcoords + index * input.texcoord_stride, sizeof(texcoord));
+                        uv[k][0][lane] = texcoord[0];
+                        uv[k][1][lane] = texcoord[1];
+                    }
+                }
+            }
+        }
+
+        batch3<Batch> position(std::size_t k) const
+        {
+            return {Batch::load(p[k][0]), Batch::load(p[k][1]), Batch::load(p[k][2])};
+        }
+    };
+
+    unsigned int resolve_threads(unsigned int threads)
+    {
+        return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Below this many items per thread, starting a thread costs more than it
+    // saves
+    constexpr std::size_t min_chunk_size = 1 << 14;
+
+    // [begin, end) ranges of whole SIMD batches, at most one per thread
+    std::vector<std::pair<std::size_t, std::size_t>> split(std::size_t count, unsigned int threads)
+    {
+        std::size_t const chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads, count / min_chunk_size));
+        std::size_t const chunk_size = (count / chunks + simd_batch::size - 1) / simd_batch::size * simd_batch::size;
+
+        std::vector<std::pair<std::size_t, std::size_t>> result;
+        for (std::size_t i = 0; i < chunks; ++i)
+            result.emplace_back(std::min(count, i * chunk_size), i + 1 == chunks ? count : std::min(count, (i + 1) * chunk_size));
+        return result;
+    }
+
+    // Runs body(chunk, begin, end) for every range, the first one on the
+    // calling thread
+    template <typename Body>
+    void run_chunks(std::vector<std::pair<std::size_t, std::size_t>> const & chunks, Body const & body)
+    {
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < chunks.size(); ++i)
+            workers.emplace_back([&body, &chunks, i]{ body(i, chunks[i].first, chunks[i].second); });
+        body(0, chunks[0].first, chunks[0].second);
+        for (auto & w : workers)
+            w.join();
+    }
+
+    template <typename Body>
+    void parallel_for(std::size_t count, unsigned int threads, Body const & body)
+    {
+        run_chunks(split(count, threads), [&body](std::size_t, std::size_t begin, std::size_t end) { body(begin, end); });
+    }
+
+    constexpr std::uint32_t no_owner = ~std::uint32_t(0);
+    constexpr std::uint32_t shared_owner = no_owner - 1;
+
+    // Computes a contribution for every triangle, a batch of triangles at a
+    // time with compute(Batch{}, first_triangle, contributions), and adds it
+    // to its corners with apply(vertex, corner, contribution), in triangle
+    // order for every vertex. Batches are of simd_batch::size triangles, with
+    // the remainder computed one at a time, unless Batch is scalar_batch. Threads take contiguous triangle ranges and apply
+    // directly to the vertices only their range uses; the contributions to
+    // vertices used by several ranges are applied after all threads finish.
+    template <typename Contribution, typename Batch = simd_batch, typename Compute, typename Apply>
+    void scatter_corners(std::span<std::uint32_t const> indices, std::size_t vertex_count, unsigned int threads,
+        Compute const & compute, Apply const & apply)
+    {
+        auto const chunks = split(indices.size() / 3, threads);
+
+        std::unique_ptr<std::atomic<std::uint32_t>[]> owners;
+        if (chunks.size() > 1)
+        {
+            owners = std::make_unique<std::atomic<std::uint32_t>[]>(vertex_count);
+            parallel_for(vertex_count, threads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t v = begin; v < end; ++v)
+                    owners[v].store(no_owner, std::memory_order_relaxed);
+            });
+
+            // Neighbouring triangles mostly share their range, so this is
+            // nearly all loads
+            run_chunks(chunks, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+                for (std::size_t c = 3 * begin; c < 3 * end; ++c)
+                {
+                    auto & owner = owners[indices[c]];
+                    std::uint32_t current = owner.load(std::memory_order_relaxed);
+                    while (current != chunk && current != shared_owner)
+                    {
+                        std::uint32_t const desired = current == no_owner ? std::uint32_t(chunk) : shared_owner;
+                        if (owner.compare_exchange_weak(current, desired, std::memory_order_relaxed))
+                            break;
+                    }
+                }
+            });
+        }
+
+        struct deferred_corner
+        {
+            std::uint32_t vertex;
+            int corner;
+            Contribution contribution;
+        };
+
+        std::vector<std::vector<deferred_corner>> deferred(chunks.size());
+        run_chunks(chunks, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+            Contribution contributions[Batch::size];
+            auto emit = [&](std::size_t first, std::size_t count) {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        std::uint32_t const v = indices[3 * (first + i) + k];
+                        if (!owners || owners[v].load(std::memory_order_relaxed) == chunk)
+                            apply(v, k, contributions[i]);
+                        else
+                            deferred[chunk].push_back({v, k, contributions[i]});
+                    }
+                }
+            };
+
+            std::size_t t = begin;
+            for (; t + Batch::size <= end; t += Batch::size)
+            {
+                compute(Batch{}, t, contributions);
+                emit(t, Batch::size);
+            }
+            for (; t < end; ++t)
+            {
+                compute(scalar_batch{}, t, contributions);
+                emit(t, 1);
+            }
+        });
+
+        for (auto const & list : deferred)
+            for (auto const & d : list)
+                apply(d.vertex, d.corner, d.contribution);
+    }
+
+    // Attribute i of a strided stream. Typed float accesses instead of
+    // memcpy let the compiler keep everything else in registers
+    glm::vec3 read_vec3(float const * data, std::size_t stride, std::size_t i)
+    {
+        auto const p = reinterpret_cast<float const *>(reinterpret_cast<char const *>(data) + i * stride);
+        return {p[0], p[1], p[2]};
+    }
+
+    float * attribute(float * data, std::size_t stride, std::size_t i)
+    {
+        return reinterpret_cast<float *>(reinterpret_cast<char *>(data) + i * stride);
+    }
+
+    // Any unit vector perpendicular to a unit n (Duff et al., "Building an
+    // Orthonormal Basis, Revisited", 2017)
+    glm::vec3 perpendicular(glm::vec3 const & n)
+    {
+        float const sign = std::copysign(1.f, n.z);
+        float const a = -1.f / (sign + n.z);
+        return {1.f + sign * n.x * n.x * a, sign * n.x * n.y * a, -sign * n.x};
+    }
+
+    struct tangent_contribution
+    {
+        // Normalized direction of increasing u, zero for degenerate texcoords
+        glm::vec3 tangent;
+        float angle[3];
+        bool mirrored;
+    };
+
+    // Kept apart for triangles that keep and that mirror the texcoords
+    struct tangent_sum
+    {
+        glm::vec3 sum[2];
+        float weight[2];
+    };
+
+}
+
+void compute_normals(std::span<std::uint32_t const> indices, float const * positions, std::size_t position_stride,
+    std::size_t vertex_count, float * normals, std::size_t normal_stride, unsigned int threads)
+{
+    threads = resolve_threads(threads);
+
+    parallel_for(vertex_count, threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v)
+        {
+            auto const n = attribute(normals, normal_stride, v);
+            n[0] = n[1] = n[2] = 0.f;
+        }
+    });
+
+    // cross(p1 - p0, p2 - p0) is the triangle normal times twice its area.
+    // One cross product is too little work to pay for transposing the
+    // corners into SIMD batches, so this goes a triangle at a time
+    auto compute = [&](scalar_batch, std::size_t t, glm::vec3 * contribution) {
+        glm::vec3 const p0 = read_vec3(positions, position_stride, indices[3 * t + 0]);
+        glm::vec3 const p1 = read_vec3(positions, position_stride, indices[3 * t + 1]);
+        glm::vec3 const p2 = read_vec3(positions, position_stride, indices[3 * t + 2]);
+        *contribution = glm::cross(p1 - p0, p2 - p0);
+    };
+
+    auto apply = [normals, normal_stride](std::uint32_t v, int, glm::vec3 const & n) {
+        auto const sum = attribute(normals, normal_stride, v);
+        sum[0] += n.x;
+        sum[1] += n.y;
+        sum[2] += n.z;
+    };
+
+    scatter_corners<glm::vec3, scalar_batch>(indices, vertex_count, threads, compute, apply);
+
+    parallel_for(vertex_count, threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v)
+        {
+            auto const n = attribute(normals, normal_stride, v);
+            float const length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float const scale = length > 0.f ? 1.f / length : 0.f;
+            n[0] *= scale;
+            n[1] *= scale;
+            n[2] *= scale;
+        }
+    });
+}
+
+void compute_tangents(std::span<std::uint32_t const> indices, float const * positions, std::size_t position_stride,
+    float const * normals, std::size_t normal_stride, float const * texcoords, std::size_t texcoord_stride,
+    std::size_t vertex_count, float * tangents, std::size_t tangent_stride, unsigned int threads)
+{
+    threads = resolve_threads(threads);
+
+    auto sums = std::make_unique_for_overwrite<tangent_sum[]>(vertex_count);
+    parallel_for(vertex_count, threads, [&](std::size_t begin, std::size_t end) {
+        std::fill(sums.get() + begin, sums.get() + end, tangent_sum{{glm::vec3(0.f), glm::vec3(0.f)}, {0.f, 0.f}});
+    });
+
+    mesh_input const input{indices, reinterpret_cast<char const *>(positions), position_stride,
+        reinterpret_cast<char const *>(texcoords), texcoord_stride};
+
+    auto compute = [&input](auto batch, std::size_t first, tangent_contribution * contributions) {
+        using Batch = decltype(batch);
+        triangle_batch<Batch> const triangles(input, first);
+        auto const p0 = triangles.position(0), p1 = triangles.position(1), p2 = triangles.position(2);
+        auto const e1 = p1 - p0, e2 = p2 - p0;
+
+        float angle[3][Batch::size];
+        corner_angle(e1, e2).store(angle[0]);
+        corner_angle(p0 - p1, p2 - p1).store(angle[1]);
+        corner_angle(p0 - p2, p1 - p2).store(angle[2]);
+
+        Batch const u0 = Batch::load(triangles.uv[0][0]), v0 = Batch::load(triangles.uv[0][1]);
+        Batch const du1 = Batch::load(triangles.uv[1][0]) - u0, dv1 = Batch::load(triangles.uv[1][1]) - v0;
+        Batch const du2 = Batch::load(triangles.uv[2][0]) - u0, dv2 = Batch::load(triangles.uv[2][1]) - v0;
+
+        // Solving e1 = du1 T + dv1 B, e2 = du2 T + dv2 B for T, up to the
+        // positive scale 1 / |area|
+        Batch const area = du1 * dv2 - du2 * dv1;
+        Batch const zero = Batch::broadcast(0.f);
+        Batch const sign = select(less(area, zero), Batch::broadcast(-1.f), Batch::broadcast(1.f));
+        auto const t = (e1 * dv2 - e2 * dv1) * sign;
+
+        Batch const length = sqrt(dot(t, t));
+        Batch const valid = less(zero, length * abs(area));
+        Batch const scale = select(valid, Batch::broadcast(1.f) / max(length, Batch::broadcast(1e-30f)), zero);
+
+        float x[Batch::size], y[Batch::size], z[Batch::size], orientation[Batch::size];
+        (t.x * scale).store(x);
+        (t.y * scale).store(y);
+        (t.z * scale).store(z);
+        sign.store(orientation);
+        for (std::size_t lane = 0; lane < Batch::size; ++lane)
+            contributions[lane] = {{x[lane], y[lane], z[lane]}, {angle[0][lane], angle[1][lane], angle[2][lane]},
+                orientation[lane] < 0.f};
+    };
+
+    auto apply = [&](std::uint32_t v, int corner, tangent_contribution const & c) {
+        auto const normal = read_vec3(normals, normal_stride, v);
+        glm::vec3 const projected = c.tangent - normal * glm::dot(normal, c.tangent);
+        float const length = glm::length(projected);
+        if (length <= 1e-20f)
+            return;
+
+        auto & sum = sums[v];
+        sum.sum[c.mirrored] += projected * (c.angle[corner] / length);
+        sum.weight[c.mirrored] += c.angle[corner];
+    };
+
+    scatter_corners<tangent_contribution>(indices, vertex_count, threads, compute, apply);
+
+    parallel_for(vertex_count, threads, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v)
+        {
+            auto const & sum = sums[v];
+            int const side = sum.weight[1] > sum.weight[0];
+            float const length = glm::length(sum.sum[side]);
+            glm::vec3 const tangent = length > 0.f ? sum.sum[side] / length
+                : perpendicular(read_vec3(normals, normal_stride, v));
+            auto const t = attribute(tangents, tangent_stride, v);
+            t[0] = tangent.x;
+            t[1] = tangent.y;
+            t[2] = tangent.z;
+            t[3] = side ? -1.f : 1.f;
+        }
+    });
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+// Vertex normals and tangents for indexed triangle lists, for meshes that
+// come without them.
+//
+// Both functions first compute per-triangle data, then sum it per vertex.
+// Tangents are computed in batches of 8 (AVX) or 4 (SSE2) triangles,
+// whichever the build enables; normals, a cross product per triangle, a
+// triangle at a time.
+// Triangles are split into one range per thread. A first pass marks with
+// compare-and-swap which range owns every vertex: the only range whose
+// triangles use it, or none if several do. Each thread then adds its
+// corners of owned vertices directly, without locks, and defers those of
+// vertices on range borders, which are added serially afterwards in range
+// and triangle order. Either way every vertex sums its corners in triangle
+// order, as a serial loop would: the result does not depend on the thread
+// count.
+//
+// Attributes are passed as a pointer to the first vertex's consecutive
+// floats and the byte stride between vertices. Indices are below
+// vertex_count. threads = 0 means one per hardware thread.
+
+// Normalized sum of the normals of the triangles around every vertex, each
+// weighted by the triangle's area. Vertices are not welded: a vertex split by
+// a UV seam only sums its own side. Vertices without a non-degenerate
+// triangle get a zero normal. Writes three floats per vertex.
+void compute_normals(std::span<std::uint32_t const> indices, float const * positions, std::size_t position_stride,
+    std::size_t vertex_count, float * normals, std::size_t normal_stride, unsigned int threads = 0);
+
+// Tangents following the MikkTSpace rules (Mikkelsen, "Simulation of
+// Wrinkled Surfaces Revisited", 2008): the texcoord gradient of every
+// triangle is projected onto the plane of the vertex normal and weighted by
+// the corner angle, triangles with mirrored texcoords are not mixed with the
+// others, and the bitangent is w * cross(normal, tangent.xyz). Unlike
+// MikkTSpace, a vertex shared by mirrored and non-mirrored triangles is not
+// split, it takes the side with the larger angle sum. Writes four floats per
+// vertex, xyz and w = +1 or -1.
+void compute_tangents(std::span<std::uint32_t const> indices, float const * positions, std::size_t position_stride,
+    float const * normals, std::size_t normal_stride, float const * texcoords, std::size_t texcoord_stride,
+    std::size_t vertex_count, float * tangents, std::size_t tangent_stride, unsigned int threads = 0);
@@ -0,0 +1,137 @@
+#include "texture_decoder.hpp"
+
+#include "stb_image.h"
+
+#include <utility>
+
+namespace
+{
+
+    // Averages a 2x2 block, clamping the second row and column at the edge
+    void downsample(unsigned char const * source, int source_width, int source_height, unsigned char * target,
+        int target_width, int target_height)
+    {
+        for (int y = 0; y < target_height; ++y)
+        {
+            int const y0 = std::min(2 * y, source_height - 1);
+            int const y1 = std::min(2 * y + 1, source_height - 1);
+            for (int x = 0; x < target_width; ++x)
+            {
+                int const x0 = std::min(2 * x, source_width - 1);
+                int const x1 = std::min(2 * x + 1, source_width - 1);
+                for (int c = 0; c < 4; ++c)
+                {
+                    unsigned int const sum = source[(y0 * source_width + x0) * 4 + c] + source[(y0 * source_width + x1) * 4 + c]
+                        + source[(y1 * source_width + x0) * 4 + c] + source[(y1 * source_width + x1) * 4 + c];
+                    target[(y * target_width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+}
+
+decoded_image decode_image(std::string const & path, bool mipmaps)
+{
+    decoded_image result;
+    result.path = path;
+
+    int channels_in_file;
+    auto pixels = stbi_load(path.c_str(), &result.width, &result.height, &channels_in_file, 4);
+    if (!pixels)
+    {
+        // The reason is thread-local, see STBI_THREAD_LOCAL
+        result.error = "Failed to load texture " + path + ": " + stbi_failure_reason();
+        return result;
+    }
+
+    result.levels.emplace_back(pixels, pixels + std::size_t(result.width) * result.height * 4);
+    stbi_image_free(pixels);
+
+    if (mipmaps)
+        build_mipmaps(result);
+    return result;
+}
+
+void build_mipmaps(decoded_image & image)
+{
+    if (image.levels.empty())
+        return;
+
+    for (std::size_t level = image.levels.size(); image.level_width(level - 1) > 1 || image.level_height(level - 1) > 1; ++level)
+    {
+        int const width = image.level_width(level), height = image.level_height(level);
+        std::vector<unsigned char> pixels(std::size_t(width) * height * 4);
+        downsample(image.levels[level - 1].data(), image.level_width(level - 1), image.level_height(level - 1),
+            pixels.data(), width, height);
+        image.levels.push_back(std::move(pixels));
+    }
+}
+
+texture_decoder::texture_decoder(unsigned int threads, bool mipmaps)
+    : m_mipmaps(mipmaps)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < threads; ++i)
+        m_threads.emplace_back([this]{ work(); });
+}
+
+texture_decoder::~texture_decoder()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+        m_queue.clear();
+    }
+    m_queue_changed.notify_all();
+
+    for (auto & thread : m_threads)
+        thread.join();
+}
+
+void texture_decoder::submit(std::string path)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_queue.push_back(std::move(path));
+        ++m_in_flight;
+    }
+    m_queue_changed.notify_one();
+}
+
+std::vector<decoded_image> texture_decoder::poll()
+{
+    std::lock_guard lock(m_mutex);
+    return std::exchange(m_done, {});
+}
+
+std::vector<decoded_image> texture_decoder::wait()
+{
+    std::unique_lock lock(m_mutex);
+    m_image_done.wait(lock, [this]{ return m_in_flight == 0; });
+    return std::exchange(m_done, {});
+}
+
+void texture_decoder::work()
+{
+    std::unique_lock lock(m_mutex);
+    while (true)
+    {
+        m_queue_changed.wait(lock, [this]{ return m_stopping || !m_queue.empty(); });
+        if (m_stopping)
+            return;
+
+        auto path = std::move(m_queue.front());
+        m_queue.pop_front();
+
+        lock.unlock();
+        auto image = decode_image(path, m_mipmaps);
+        lock.lock();
+
+        m_done.push_back(std::move(image));
+        --m_in_flight;
+        m_image_done.notify_all();
+    }
+}
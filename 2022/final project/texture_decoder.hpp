@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The CPU side of texture loading, kept apart from GL so that it can run on
+// worker threads (see texture_holder's asynchronous mode) and be benchmarked
+// headless.
+
+// An RGBA8 image and, optionally, its mip chain down to 1x1
+struct decoded_image
+{
+    std::string path;
+    int width = 0;
+    int height = 0;
+    // Level 0 first, each level's rows tightly packed
+    std::vector<std::vector<unsigned char>> levels;
+    // Empty if the image was decoded
+    std::string error;
+
+    int level_width(std::size_t level) const { return std::max(width >> level, 1); }
+    int level_height(std::size_t level) const { return std::max(height >> level, 1); }
+};
+
+// Never throws, failures are reported in decoded_image::error
+decoded_image decode_image(std::string const & path, bool mipmaps);
+
+// Appends the levels below the last one, each texel the average of a 2x2
+// block of the level above (the last row or column repeated for odd sizes),
+// as glGenerateMipmap would
+void build_mipmaps(decoded_image & image);
+
+// A pool of threads decoding the submitted files, started in submission order
+class texture_decoder
+{
+public:
+    // threads = 0 means one per hardware thread
+    explicit texture_decoder(unsigned int threads = 0, bool mipmaps = true);
+    ~texture_decoder();
+
+    texture_decoder(texture_decoder const &) = delete;
+    texture_decoder & operator = (texture_decoder const &) = delete;
+
+    void submit(std::string path);
+
+    // The images decoded since the last call, in no particular order
+    std::vector<decoded_image> poll();
+
+    // Waits until every submitted image is decoded, then polls
+    std::vector<decoded_image> wait();
+
+private:
+    void work();
+
+    bool m_mipmaps;
+    bool m_stopping = false;
+    std::size_t m_in_flight = 0;
+    std::deque<std::string> m_queue;
+    std::vector<decoded_image> m_done;
+    std::mutex m_mutex;
+    std::condition_variable m_queue_changed;
+    std::condition_variable m_image_done;
+    std::vector<std::thread> m_threads;
+};
@@ -1,16 +1,93 @@
 #include <iostream>
+#include <stdexcept>
+#include <algorithm>
 #include "texture_holder.hpp"
 
-GLint texture_holder::load_texture(const std::string &path) {
-    GLint unit = m_first_unit + (GLint)m_textures.size();
+// Large enough for a whole level of most textures, small enough for a band
+// of a 4K level to upload in well under a millisecond
+static constexpr std::size_t upload_band_bytes = 1 << 20;
+
+// Block-compressed formats need extensions GL 3.3 does not guarantee; an
+// unsupported cooked texture falls back to its source image
+static GLenum compressed_internal_format(cooked_format format) {
+    switch(format) {
+        case cooked_format::bc1: return GLEW_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+        case cooked_format::bc3: return GLEW_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+        case cooked_format::bc7: return GLEW_ARB_texture_compression_bptc ? GL_COMPRESSED_RGBA_BPTC_UNORM : 0;
+        default: return 0;
+    }
+}
+
+// Bytes of a level of a texture array layer, for glCompressedTexImage3D
+static std::size_t compressed_level_size(GLenum internal_format, int width, int height) {
+    std::size_t blocks = (std::size_t)((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16);
+}
+
+// The levels of an image with a gutter of its own wrapped-around texels, the
+// gutter halving with every level, so that filtering an atlased texture
+// never reads its neighbours
+static void pad_levels(decoded_image &image, int gutter, int levels) {
+    image.levels.resize(std::min<std::size_t>(image.levels.size(), levels));
+    for(std::size_t level = 0; level < image.levels.size(); ++level) {
+        int g = gutter >> level;
+        int width = image.level_width(level), height = image.level_height(level);
+        int padded_width = width + 2 * g, padded_height = height + 2 * g;
+        const auto &source = image.levels[level];
+        std::vector<unsigned char> padded((std::size_t)padded_width * padded_height * 4);
+        for(int y = 0; y < padded_height; ++y) {
+            int source_y = ((y - g) % height + height) % height;
+            for(int x = 0; x < padded_width; ++x) {
+                int source_x = ((x - g) % width + width) % width;
+                std::copy_n(&source[((std::size_t)source_y * width + source_x) * 4], 4,
+                            &padded[((std::size_t)y * padded_width + x) * 4]);
+            }
+        }
+        image.levels[level] = std::move(padded);
+    }
+}
+
+// The whole mip chain straight from the mapping, no decoding
+static bool upload_cooked_texture(const cooked_texture &texture) {
+    GLenum internal_format = compressed_internal_format(texture.format);
+    if(texture.format != cooked_format::rgba8 && !internal_format) return false;
+
+    for(std::size_t level = 0; level < texture.levels.size(); ++level) {
+        int width = std::max(texture.width >> level, 1);
+        int height = std::max(texture.height >> level, 1);
+        const auto &data = texture.levels[level];
+        if(texture.format == cooked_format::rgba8)
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internal_format, width, height, 0,
+                                   (GLsizei)data.size(), data.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+    return true;
+}
+
+GLint texture_holder::load_texture(const std::string &path, const std::array<GLubyte, 4> &placeholder) {
     auto it = m_textures.find(path);
     if(it != m_textures.end()) return it->second.second;
+    GLint unit = m_next_unit++;
     glGenTextures(1, &m_textures[path].first);
     m_textures[path].second = unit;
     glActiveTexture(GL_TEXTURE0 + unit);
     glBindTexture(GL_TEXTURE_2D, m_textures[path].first);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Cooked by tools/texture_cooker, ready as soon as it is mapped
+    if(auto cooked = load_cooked_texture(path); cooked && upload_cooked_texture(*cooked))
+        return unit;
+
+    if(m_decoder) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+        m_decoder->submit(path);
+        ++m_pending;
+        return unit;
+    }
+
     int x, y, channels_in_file;
     auto pixels = stbi_load(path.c_str(), &x, &y, &channels_in_file, 4);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
@@ -26,4 +103,203 @@ GLint texture_holder::get_texture(const std::string &path) {
     else return it->second.second;
 }
 
-texture_holder::texture_holder(GLint first_unit) : m_first_unit(first_unit) {}
+std::size_t texture_holder::add_array_texture(const std::string &path, const std::array<GLubyte, 4> &placeholder) {
+    auto it = m_array_handles.find(path);
+    if(it != m_array_handles.end()) return it->second;
+    if(m_arrays_built)
+        throw std::runtime_error("Texture arrays are already built, cannot add " + path);
+
+    array_entry entry{path, placeholder};
+    if(auto cooked = load_cooked_texture(path)) {
+        GLenum internal_format = cooked->format == cooked_format::rgba8 ? GL_RGBA8 : compressed_internal_format(cooked->format);
+        if(internal_format) {
+            entry.request = {cooked->width, cooked->height, (int)cooked->levels.size(), internal_format, false};
+            entry.cooked = std::move(cooked);
+        }
+    }
+    if(!entry.cooked) {
+        int x, y, channels_in_file;
+        if(!stbi_info(path.c_str(), &x, &y, &channels_in_file))
+            throw std::runtime_error("Failed to load texture " + path + ": " + stbi_failure_reason());
+        // The decoder builds the whole mip chain
+        int levels = 1;
+        while((std::max(x, y) >> levels) > 0) ++levels;
+        entry.request = {x, y, levels, GL_RGBA8, true};
+    }
+
+    m_array_entries.push_back(std::move(entry));
+    m_array_handles[path] = m_array_entries.size() - 1;
+    return m_array_entries.size() - 1;
+}
+
+void texture_holder::build_arrays(texture_packing_settings settings) {
+    if(m_arrays_built)
+        throw std::runtime_error("Texture arrays are already built");
+    m_arrays_built = true;
+
+    GLint max_layers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    settings.max_layers = std::min(settings.max_layers, max_layers);
+
+    std::vector<texture_request> requests;
+    for(const auto &entry : m_array_entries)
+        requests.push_back(entry.request);
+    auto layout = pack_textures(requests, settings);
+
+    for(const auto &array : layout.arrays) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        GLint unit = m_next_unit++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Atlased textures repeat in the shader, within their gutters
+        GLint wrap = array.atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+        for(int level = 0; level < array.levels; ++level) {
+            int width = std::max(array.width >> level, 1);
+            int height = std::max(array.height >> level, 1);
+            if(array.format == GL_RGBA8)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, array.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            else
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.format, width, height, array.layers, 0,
+                                       (GLsizei)(compressed_level_size(array.format, width, height) * array.layers), nullptr);
+        }
+        m_arrays.push_back({texture, unit});
+        m_array_layouts.push_back(array);
+    }
+
+    for(std::size_t handle = 0; handle < m_array_entries.size(); ++handle) {
+        auto &entry = m_array_entries[handle];
+        entry.placement = layout.placements[handle];
+        const auto &array = m_array_layouts[entry.placement.array];
+        m_array_textures.push_back({m_arrays[entry.placement.array].second, entry.placement.layer, {
+            (float)entry.placement.width / array.width, (float)entry.placement.height / array.height,
+            (float)entry.placement.x / array.width, (float)entry.placement.y / array.height}});
+
+        if(entry.cooked) {
+            const auto &cooked = *entry.cooked;
+            glActiveTexture(GL_TEXTURE0 + m_arrays[entry.placement.array].second);
+            for(int level = 0; level < array.levels; ++level) {
+                int width = std::max(cooked.width >> level, 1);
+                int height = std::max(cooked.height >> level, 1);
+                const auto &data = cooked.levels[level];
+                if(array.format == GL_RGBA8)
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, entry.placement.layer, width, height, 1,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+                else
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, entry.placement.layer, width, height, 1,
+                                              array.format, (GLsizei)data.size(), data.data());
+            }
+            entry.cooked.reset();
+            continue;
+        }
+
+        if(m_decoder) {
+            fill_placeholder(entry);
+            m_decoder->submit(entry.path);
+            ++m_pending;
+            continue;
+        }
+
+        auto image = decode_image(entry.path, true);
+        if(!image.error.empty())
+            throw std::runtime_error(image.error);
+        auto current = array_upload(handle, std::move(image));
+        while(!upload_band(current)) {}
+    }
+}
+
+texture_holder::upload texture_holder::array_upload(std::size_t handle, decoded_image image) const {
+    const auto &entry = m_array_entries[handle];
+    const auto &placement = entry.placement;
+    int levels = m_array_layouts[placement.array].levels;
+    if(placement.gutter > 0)
+        pad_levels(image, placement.gutter, levels);
+    int level = std::min((int)image.levels.size(), levels) - 1;
+    return {std::move(image), m_arrays[placement.array].first, m_arrays[placement.array].second, level, 0,
+            placement.layer, placement.x, placement.y, placement.gutter};
+}
+
+void texture_holder::fill_placeholder(const array_entry &entry) {
+    const auto &placement = entry.placement;
+    const auto &array = m_array_layouts[placement.array];
+    glActiveTexture(GL_TEXTURE0 + m_arrays[placement.array].second);
+
+    std::vector<GLubyte> pixels;
+    for(int level = 0; level < array.levels; ++level) {
+        int gutter = placement.gutter >> level;
+        int width = std::max(placement.width >> level, 1) + 2 * gutter;
+        int height = std::max(placement.height >> level, 1) + 2 * gutter;
+        pixels.resize((std::size_t)width * height * 4);
+        for(std::size_t i = 0; i < pixels.size(); i += 4)
+            std::copy(entry.placeholder.begin(), entry.placeholder.end(), pixels.begin() + i);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, (placement.x >> level) - gutter, (placement.y >> level) - gutter,
+                        placement.layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+}
+
+bool texture_holder::upload_band(upload &current) {
+    int gutter = current.gutter >> current.level;
+    int width = current.image.level_width(current.level) + 2 * gutter;
+    int height = current.image.level_height(current.level) + 2 * gutter;
+    int rows = std::clamp((int)(upload_band_bytes / (width * 4)), 1, height - current.row);
+    const unsigned char *pixels = current.image.levels[current.level].data() + (std::size_t)current.row * width * 4;
+    glActiveTexture(GL_TEXTURE0 + current.unit);
+
+    if(current.layer < 0) {
+        glBindTexture(GL_TEXTURE_2D, current.texture);
+        if(current.row == 0)
+            glTexImage2D(GL_TEXTURE_2D, current.level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexSubImage2D(GL_TEXTURE_2D, current.level, 0, current.row, width, rows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    } else {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, current.texture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, current.level, (current.x >> current.level) - gutter,
+                        (current.y >> current.level) - gutter + current.row, current.layer, width, rows, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+    current.row += rows;
+    if(current.row < height) return false;
+
+    // The levels from this one down are complete, sample only them
+    if(current.layer < 0) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, current.level);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)current.image.levels.size() - 1);
+    }
+    current.row = 0;
+    return --current.level < 0;
+}
+
+void texture_holder::update(std::chrono::microseconds budget) {
+    if(!m_decoder) return;
+
+    auto start = std::chrono::steady_clock::now();
+    for(auto &image : m_decoder->poll()) {
+        if(!image.error.empty())
+            throw std::runtime_error(image.error);
+        if(auto it = m_array_handles.find(image.path); it != m_array_handles.end() && m_arrays_built) {
+            m_uploads.push_back(array_upload(it->second, std::move(image)));
+            continue;
+        }
+        auto const &[texture, unit] = m_textures.at(image.path);
+        int level = (int)image.levels.size() - 1;
+        m_uploads.push_back({std::move(image), texture, unit, level});
+    }
+
+    bool first = true;
+    while(!m_uploads.empty() && (first || std::chrono::steady_clock::now() - start < budget)) {
+        first = false;
+        if(upload_band(m_uploads.front())) {
+            m_uploads.pop_front();
+            --m_pending;
+        }
+    }
+}
+
+texture_holder::texture_holder(GLint first_unit) : m_next_unit(first_unit) {}
+
+texture_holder::texture_holder(GLint first_unit, unsigned int decode_threads)
+    : m_next_unit(first_unit), m_decoder(std::make_unique<texture_decoder>(decode_threads)) {}
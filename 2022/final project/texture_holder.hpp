@@ -2,6 +2,12 @@
 #define HW2_TEXTURE_HOLDER_HPP
 #include <unordered_map>
 #include <string>
+#include <array>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include <vector>
 #ifdef WIN32
 #include <SDL.h>
 #undef main
@@ -11,16 +17,103 @@
 
 #include <GL/glew.h>
 #include "stb_image.h"
+#include "texture_decoder.hpp"
+#include "cooked_texture.hpp"
+#include "texture_packer.hpp"
+
+// Every texture gets its own texture unit, starting from first_unit, and
+// stays bound to it. An image with a fresh <image>.cooked sidecar (see
+// cooked_texture.hpp) is uploaded from it right away, in either mode.
+//
+// By default load_texture decodes and uploads the image right away. In the
+// asynchronous mode it only binds a 1x1 placeholder and queues the file: the
+// decoding and the mip chain are done by worker threads, and update(), called
+// once per frame on the GL thread, uploads what is ready within a time
+// budget. Mip levels go up from the smallest one, in bands of rows, and the
+// texture's base level follows, so a texture sharpens over a few frames
+// instead of stalling one.
+//
+// Textures can also go into texture arrays (see texture_packer.hpp), which
+// take one unit per array rather than per texture: add_array_texture
+// registers them, build_arrays packs and loads them all. An array texture
+// shows its placeholder until its whole mip chain is uploaded, since array
+// layers cannot have base levels of their own.
+
+// Where an array texture went: the unit of its array, its layer, and the
+// scale (xy) and offset (zw) taking its texture coordinates to its region
+// of the layer, an identity unless it is atlased
+struct array_texture {
+    GLint unit;
+    GLint layer;
+    std::array<float, 4> transform;
+};
 
 class texture_holder {
 public:
     explicit texture_holder(GLint first_unit);
-    GLint load_texture(const std::string &path);
+    // decode_threads = 0 means one per hardware thread
+    texture_holder(GLint first_unit, unsigned int decode_threads);
+
+    GLint load_texture(const std::string &path, const std::array<GLubyte, 4> &placeholder = {128, 128, 128, 255});
     GLint get_texture(const std::string &path);
 
+    // Only reads the image's size; returns the texture's handle
+    std::size_t add_array_texture(const std::string &path, const std::array<GLubyte, 4> &placeholder = {128, 128, 128, 255});
+    // Packs every texture added so far into arrays, binds each array to the
+    // next free unit, then uploads the textures, or in the asynchronous mode
+    // queues them. Can only be called once
+    void build_arrays(texture_packing_settings settings = {});
+    const array_texture &get_array_texture(std::size_t handle) const { return m_array_textures.at(handle); }
+    std::size_t array_count() const { return m_arrays.size(); }
+
+    // Does nothing in the default mode. Uploads at least one band of rows
+    // when there is one, so that loading always makes progress; throws if an
+    // image failed to load
+    void update(std::chrono::microseconds budget);
+    // Textures still showing their placeholder or not fully uploaded
+    std::size_t pending() const { return m_pending; }
+
 private:
-    GLint m_first_unit;
+    struct upload {
+        decoded_image image;
+        GLuint texture;
+        GLint unit;
+        int level;
+        int row = 0;
+        // For array textures: the layer, the corner of the texture's region
+        // at level 0, and the gutter the image's levels were padded with
+        GLint layer = -1;
+        int x = 0;
+        int y = 0;
+        int gutter = 0;
+    };
+
+    struct array_entry {
+        std::string path;
+        std::array<GLubyte, 4> placeholder;
+        std::optional<cooked_texture> cooked = {};
+        texture_request request = {};
+        texture_placement placement = {};
+    };
+
+    // Uploads the next band of rows of the current level; returns true once
+    // the last level is done
+    bool upload_band(upload &current);
+    upload array_upload(std::size_t handle, decoded_image image) const;
+    void fill_placeholder(const array_entry &entry);
+
+    GLint m_next_unit;
     std::unordered_map<std::string, std::pair<GLuint, GLint>> m_textures;
+    std::vector<array_entry> m_array_entries;
+    std::unordered_map<std::string, std::size_t> m_array_handles;
+    std::vector<array_texture> m_array_textures;
+    // Texture and unit, and layout, of every array
+    std::vector<std::pair<GLuint, GLint>> m_arrays;
+    std::vector<texture_array_layout> m_array_layouts;
+    bool m_arrays_built = false;
+    std::unique_ptr<texture_decoder> m_decoder;
+    std::deque<upload> m_uploads;
+    std::size_t m_pending = 0;
 };
 
 
@@ -0,0 +1,122 @@
+#include "texture_packer.hpp"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace
+{
+
+    // Levels down to a one texel wide gutter
+    int atlas_levels(int gutter)
+    {
+        int levels = 1;
+        while ((gutter >> levels) > 0)
+            ++levels;
+        return levels;
+    }
+
+    bool atlased(texture_request const & request, texture_packing_settings const & settings)
+    {
+        return request.atlas_allowed
+            && request.width <= settings.atlas_max_size && request.height <= settings.atlas_max_size
+            && request.width % settings.atlas_gutter == 0 && request.height % settings.atlas_gutter == 0;
+    }
+
+}
+
+texture_layout pack_textures(std::span<texture_request const> requests, texture_packing_settings const & settings)
+{
+    int const gutter = settings.atlas_gutter;
+    if (gutter <= 0 || (gutter & (gutter - 1)) != 0)
+        throw std::runtime_error("Atlas gutter must be a power of two");
+    if (settings.max_layers <= 0)
+        throw std::runtime_error("Texture arrays need at least one layer");
+    if (settings.atlas_max_size + 2 * gutter > settings.atlas_page_size)
+        throw std::runtime_error("Atlased textures do not fit an atlas page");
+
+    texture_layout result;
+    result.placements.resize(requests.size());
+
+    // Whole-layer textures, grouped by size, mip count and format in the
+    // order the groups first appear
+    std::map<std::tuple<int, int, int, std::uint32_t>, std::size_t> open_arrays;
+    std::vector<std::size_t> atlas_requests;
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        auto const & request = requests[i];
+        if (request.width <= 0 || request.height <= 0 || request.levels <= 0)
+            throw std::runtime_error("Texture request of size " + std::to_string(request.width) + "x" + std::to_string(request.height));
+
+        if (atlased(request, settings))
+        {
+            atlas_requests.push_back(i);
+            continue;
+        }
+
+        auto const key = std::make_tuple(request.width, request.height, request.levels, request.format);
+        auto it = open_arrays.find(key);
+        if (it == open_arrays.end() || result.arrays[it->second].layers == settings.max_layers)
+        {
+            result.arrays.push_back({request.width, request.height, 0, request.levels, request.format, false});
+            it = open_arrays.insert_or_assign(key, result.arrays.size() - 1).first;
+        }
+
+        auto & array = result.arrays[it->second];
+        result.placements[i] = {it->second, array.layers++, 0, 0, request.width, request.height, 0};
+    }
+
+    if (atlas_requests.empty())
+        return result;
+
+    // Shelves, tallest textures first; one atlas array per format
+    std::stable_sort(atlas_requests.begin(), atlas_requests.end(), [&](std::size_t a, std::size_t b){
+        return std::tie(requests[a].format, requests[b].height) < std::tie(requests[b].format, requests[a].height);
+    });
+
+    int const page = settings.atlas_page_size;
+    std::size_t array = 0;
+    int shelf_y = 0, shelf_height = 0, cursor_x = 0;
+    for (std::size_t n = 0; n < atlas_requests.size(); ++n)
+    {
+        auto const & request = requests[atlas_requests[n]];
+        int const cell_width = request.width + 2 * gutter;
+        int const cell_height = request.height + 2 * gutter;
+
+        bool const new_array = (n == 0) || requests[atlas_requests[n - 1]].format != request.format;
+        bool new_page = new_array;
+        if (!new_page && cursor_x + cell_width > page)
+        {
+            // Next shelf
+            shelf_y += shelf_height;
+            shelf_height = 0;
+            cursor_x = 0;
+        }
+        if (!new_page && shelf_y + cell_height > page)
+            new_page = true;
+
+        if (new_array || (new_page && result.arrays[array].layers == settings.max_layers))
+        {
+            result.arrays.push_back({page, page, 0, std::min(atlas_levels(gutter), request.levels), request.format, true});
+            array = result.arrays.size() - 1;
+        }
+        if (new_page)
+        {
+            ++result.arrays[array].layers;
+            shelf_y = shelf_height = cursor_x = 0;
+        }
+
+        auto & layout = result.arrays[array];
+        layout.levels = std::min(layout.levels, request.levels);
+        result.placements[atlas_requests[n]] = {array, layout.layers - 1, cursor_x + gutter, shelf_y + gutter,
+            request.width, request.height, gutter};
+
+        // Sizes are multiples of the gutter, so cells stay aligned to it
+        cursor_x += cell_width;
+        shelf_height = std::max(shelf_height, cell_height);
+    }
+
+    return result;
+}
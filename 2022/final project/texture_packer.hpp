@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Plans how a scene's textures share a few GL_TEXTURE_2D_ARRAYs, so that
+// the renderer binds every array once, to a unit of its own, instead of
+// spending a unit per texture. Textures of the same size, format and mip
+// count become layers of one array. Small textures are packed into atlas
+// pages, which are layers of an array of their own: shelves of cells, each
+// cell the texture and a gutter around it that the uploader fills with the
+// texture's own wrapped-around texels, so that filtering and repeating
+// (done in the shader with fract) stay within the texture. Cells are
+// aligned to the gutter, which bounds the atlas' mip count: at the last
+// level the gutter is one texel wide.
+//
+// No GL here; texture_holder::build_arrays does the allocation and uploads.
+
+struct texture_request
+{
+    int width = 0;
+    int height = 0;
+    int levels = 1;
+    // Any value telling incompatible formats apart
+    std::uint32_t format = 0;
+    // Only uncompressed textures can be atlased, blocks do not fit the gutter
+    bool atlas_allowed = true;
+};
+
+struct texture_packing_settings
+{
+    // GL_MAX_ARRAY_TEXTURE_LAYERS is at least 256 in GL 3.3
+    int max_layers = 256;
+    // Textures no larger than this both ways, with sizes a multiple of the
+    // gutter, are atlased
+    int atlas_max_size = 256;
+    int atlas_page_size = 1024;
+    // A power of two
+    int atlas_gutter = 8;
+};
+
+struct texture_array_layout
+{
+    int width = 0;
+    int height = 0;
+    int layers = 0;
+    int levels = 1;
+    std::uint32_t format = 0;
+    bool atlas = false;
+};
+
+// Where one texture went. x and y are the texture's corner in texels, past
+// the gutter; both are zero for a whole layer
+struct texture_placement
+{
+    std::size_t array = 0;
+    int layer = 0;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    // Zero unless atlased
+    int gutter = 0;
+};
+
+struct texture_layout
+{
+    std::vector<texture_array_layout> arrays;
+    // In the order of the requests
+    std::vector<texture_placement> placements;
+};
+
+texture_layout pack_textures(std::span<texture_request const> requests, texture_packing_settings const & settings = {});
@@ -0,0 +1,168 @@
+// Cooks images into <image>.cooked sidecars with their whole mip chain (see
+// cooked_texture.hpp), which texture_holder then loads without decoding or
+// generating mipmaps. Prints the video memory each texture takes as RGBA8
+// with mips and cooked, and the error of the cooked level 0.
+//
+// Usage: texture_cooker [--format auto|rgba8|bc1|bc3|bc7] [image | directory ...]
+// Without images the alley, ball, pin and environment textures are cooked.
+// The auto format is BC7 for normal maps (a file name containing "normal"),
+// where BC1's 565 endpoints visibly band the lighting, BC3 for images with
+// alpha and BC1 for the rest.
+
+#include "cooked_texture.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    char const * format_name(cooked_format format)
+    {
+        switch (format)
+        {
+        case cooked_format::rgba8: return "rgba8";
+        case cooked_format::bc1: return "bc1";
+        case cooked_format::bc3: return "bc3";
+        case cooked_format::bc7: return "bc7";
+        }
+        return "?";
+    }
+
+    std::optional<cooked_format> parse_format(std::string const & name)
+    {
+        for (auto format : {cooked_format::rgba8, cooked_format::bc1, cooked_format::bc3, cooked_format::bc7})
+            if (name == format_name(format))
+                return format;
+        return std::nullopt;
+    }
+
+    bool is_image(std::filesystem::path const & path)
+    {
+        auto const extension = path.extension();
+        return extension == ".png" || extension == ".jpg" || extension == ".jpeg";
+    }
+
+    cooked_format choose_format(std::filesystem::path const & path, decoded_image const & image)
+    {
+        if (path.filename().string().find("normal") != std::string::npos)
+            return cooked_format::bc7;
+
+        auto const & pixels = image.levels[0];
+        for (std::size_t i = 3; i < pixels.size(); i += 4)
+            if (pixels[i] != 255)
+                return cooked_format::bc3;
+        return cooked_format::bc1;
+    }
+
+    // Of the channels the format keeps, over level 0
+    double psnr(decoded_image const & image, cooked_texture const & cooked)
+    {
+        auto const block = to_block_format(cooked.format);
+        if (!block)
+            return std::numeric_limits<double>::infinity();
+
+        auto const decoded = decompress_image(*block, reinterpret_cast<std::uint8_t const *>(cooked.levels[0].data()),
+            cooked.width, cooked.height);
+        int const channels = *block == block_format::bc1 ? 3 : 4;
+
+        double squared_error = 0.0;
+        auto const & pixels = image.levels[0];
+        for (std::size_t i = 0; i < pixels.size(); ++i)
+        {
+            if (int(i % 4) >= channels)
+                continue;
+            double const error = double(pixels[i]) - decoded[i];
+            squared_error += error * error;
+        }
+
+        double const mse = squared_error / (pixels.size() / 4 * channels);
+        return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::optional<cooked_format> format;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string const argument = argv[i];
+        if (argument == "--format" && i + 1 < argc)
+        {
+            std::string const name = argv[++i];
+            format = parse_format(name);
+            if (!format && name != "auto")
+                throw std::runtime_error("Unknown format " + name);
+        }
+        else
+            inputs.emplace_back(argument);
+    }
+
+    if (inputs.empty())
+    {
+        inputs.emplace_back(PROJECT_ROOT "/bowling_alley_mozilla_hubs_room/textures");
+        inputs.emplace_back(PROJECT_ROOT "/ball");
+        inputs.emplace_back(PROJECT_ROOT "/pin");
+        inputs.emplace_back(PROJECT_ROOT "/textures");
+    }
+
+    std::vector<std::filesystem::path> paths;
+    for (auto const & input : inputs)
+    {
+        if (std::filesystem::is_directory(input))
+        {
+            for (auto const & entry : std::filesystem::directory_iterator(input))
+                if (is_image(entry.path()))
+                    paths.push_back(entry.path());
+        }
+        else
+            paths.push_back(input);
+    }
+
+    std::size_t total_rgba = 0, total_cooked = 0;
+    for (auto const & path : paths)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        auto const image = decode_image(path.string(), true);
+        if (!image.error.empty())
+            throw std::runtime_error(image.error);
+
+        auto const image_format = format ? *format : choose_format(path, image);
+        store_cooked_texture(path, image, image_format);
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto const cooked = load_cooked_texture(path);
+        if (!cooked)
+            throw std::runtime_error("Failed to read back " + cooked_texture_path(path).string());
+
+        std::size_t rgba_size = 0, cooked_size = 0;
+        for (auto const & level : image.levels)
+            rgba_size += level.size();
+        for (auto const & level : cooked->levels)
+            cooked_size += level.size();
+        total_rgba += rgba_size;
+        total_cooked += cooked_size;
+
+        std::printf("%-56s %4dx%-4d %-5s %7zu -> %7zu KB, %5.1f dB, %6.0f ms\n", path.filename().string().c_str(),
+            image.width, image.height, format_name(image_format), rgba_size / 1024, cooked_size / 1024,
+            psnr(image, *cooked), seconds * 1e3);
+    }
+
+    std::printf("%zu textures, video memory %.1f -> %.1f MB (%.1f%%)\n", paths.size(), total_rgba / 1e6,
+        total_cooked / 1e6, total_rgba ? 100.0 * total_cooked / total_rgba : 0.0);
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -1,4 +1,7 @@
 #include "utils.hpp"
+#include "vertex_index_map.hpp"
+#include "mesh_optimizer.hpp"
+#include "tangent_space.hpp"
 #include <stdexcept>
 #include <fstream>
 
@@ -140,31 +143,99 @@ SDL_GLContext create_context(SDL_Window *window) {
     return gl_context;
 }
 
-std::vector<vertex> get_vertices(
+std::pair<std::vector<vertex>, std::vector<std::uint32_t>> get_indexed_vertices(
         const tinyobj::attrib_t &attrib,
         const std::vector<tinyobj::shape_t> &shapes) {
 
-    std::vector<vertex> res;
+    std::size_t index_count = 0;
+    for(auto &shape : shapes)
+        index_count += shape.mesh.indices.size();
+
+    std::vector<vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    vertices.reserve(attrib.vertices.size() / 3);
+    indices.reserve(index_count);
+
+    // Vertices of corners without a normal get one computed from the faces
+    std::vector<std::uint32_t> without_normal;
+
+    vertex_index_map index_map(attrib.vertices.size() / 3);
     for(auto &shape : shapes) {
         for (auto &i: shape.mesh.indices) {
+            auto [index, inserted] = index_map.insert({i.vertex_index, i.normal_index, i.texcoord_index},
+                                                      (std::uint32_t)vertices.size());
+            indices.push_back(index);
+            if(!inserted)
+                continue;
             glm::vec2 texcoord(0.f);
             if(i.texcoord_index >= 0) {
                 texcoord = glm::vec2(attrib.texcoords[2 * i.texcoord_index],
                                     attrib.texcoords[2 * i.texcoord_index + 1]);
             }
-            res.push_back({{
+            glm::vec3 normal(0.f);
+            if(i.normal_index >= 0) {
+                normal = glm::vec3(attrib.normals[3 * i.normal_index],
+                                   attrib.normals[3 * i.normal_index + 1],
+                                   attrib.normals[3 * i.normal_index + 2]);
+            } else {
+                without_normal.push_back(index);
+            }
+            vertices.push_back({{
                     attrib.vertices[3 * i.vertex_index],
                     attrib.vertices[3 * i.vertex_index + 1],
                     attrib.vertices[3 * i.vertex_index + 2]
-                }, {
-                    attrib.normals[3 * i.normal_index],
-                    attrib.normals[3 * i.normal_index + 1],
-                    attrib.normals[3 * i.normal_index + 2]
-                }, texcoord
+                }, normal, texcoord
             });
         }
     }
-    return res;
+    if(!without_normal.empty()) {
+        std::vector<glm::vec3> normals(vertices.size());
+        compute_normals(indices, &vertices[0].position.x, sizeof(vertex), vertices.size(),
+                        &normals[0].x, sizeof(glm::vec3));
+        for(auto index : without_normal)
+            vertices[index].normal = normals[index];
+    }
+    return {std::move(vertices), std::move(indices)};
+}
+
+void optimize_indexed_vertices(
+        std::vector<vertex> &vertices,
+        std::vector<std::uint32_t> &indices,
+        const std::vector<tinyobj::shape_t> &shapes) {
+    std::size_t first_index = 0;
+    for(auto &shape : shapes) {
+        std::span<std::uint32_t> range(indices.data() + first_index, shape.mesh.indices.size());
+        optimize_vertex_cache(range, vertices.size());
+        optimize_overdraw(range, vertices);
+        first_index += range.size();
+    }
+    optimize_vertex_fetch(vertices, indices);
+}
+
+void setup_packed_vertex_attributes(std::size_t base) {
+    auto offset = [base](std::size_t member) { return (void *)(base + member); };
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_vertex), offset(offsetof(packed_vertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_vertex), offset(offsetof(packed_vertex, normal)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(packed_vertex), offset(offsetof(packed_vertex, texcoord)));
+}
+
+void setup_packed_tangent_vertex_attributes(std::size_t base) {
+    auto offset = [base](std::size_t member) { return (void *)(base + member); };
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_tangent_vertex),
+                          offset(offsetof(packed_tangent_vertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_tangent_vertex),
+                          offset(offsetof(packed_tangent_vertex, tangent)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_tangent_vertex),
+                          offset(offsetof(packed_tangent_vertex, normal)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(packed_tangent_vertex),
+                          offset(offsetof(packed_tangent_vertex, texcoord)));
 }
 
 bounding_box get_bounding_box(const std::vector<obj_data::vertex> &scene) {
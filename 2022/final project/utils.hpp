@@ -26,6 +26,7 @@
 #include <glm/gtx/string_cast.hpp>
 #include <stdexcept>
 #include "obj_parser.hpp"
+#include "vertex_packing.hpp"
 
 struct vertex {
     glm::vec3 position;
@@ -68,9 +69,26 @@ GLuint create_program(Shaders ... shaders)
 
 SDL_Window *create_window(const std::string &window_title);
 SDL_GLContext create_context(SDL_Window *window);
-std::vector<vertex> get_vertices(
+// Shapes are kept in order, so the indices of a shape start where the
+// previous shape's end, as with the de-indexed layout; identical corners
+// (same position, normal and texcoord index) share one vertex. Corners
+// without a normal get the area-weighted normal of their vertex.
+std::pair<std::vector<vertex>, std::vector<std::uint32_t>> get_indexed_vertices(
         const tinyobj::attrib_t &attrib,
         const std::vector<tinyobj::shape_t> &shapes);
+// Reorders the triangles of every shape for the vertex cache and overdraw
+// (shape ranges stay where they were), then the vertices by first use
+void optimize_indexed_vertices(
+        std::vector<vertex> &vertices,
+        std::vector<std::uint32_t> &indices,
+        const std::vector<tinyobj::shape_t> &shapes);
+
+// glVertexAttribPointer setup for the packed layouts in the bound
+// GL_ARRAY_BUFFER, with the first vertex base bytes into it. Locations match
+// bowling.vert (position, normal, texcoord) and alley.vert (position,
+// tangent, normal, texcoord).
+void setup_packed_vertex_attributes(std::size_t base = 0);
+void setup_packed_tangent_vertex_attributes(std::size_t base = 0);
 
 bounding_box get_bounding_box(const std::vector<obj_data::vertex> &scene);
 bounding_box get_bounding_box(const std::vector<vertex> &scene);
@@ -0,0 +1,392 @@
+#include "vertex_packing.hpp"
+#include "tangent_space.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+    constexpr unsigned int gl_byte = 5120;
+    constexpr unsigned int gl_unsigned_byte = 5121;
+    constexpr unsigned int gl_short = 5122;
+    constexpr unsigned int gl_unsigned_short = 5123;
+    constexpr unsigned int gl_unsigned_int = 5125;
+    constexpr unsigned int gl_float = 5126;
+
+    struct strided_reader
+    {
+        char const * data;
+        std::size_t stride;
+
+        glm::vec3 vec3(std::size_t i) const
+        {
+            glm::vec3 result;
+            std::memcpy(&result, data + i * stride, sizeof(result));
+            return result;
+        }
+
+        glm::vec2 vec2(std::size_t i) const
+        {
+            glm::vec2 result;
+            std::memcpy(&result, data + i * stride, sizeof(result));
+            return result;
+        }
+    };
+
+    float angle_degrees(glm::vec3 const & a, glm::vec3 const & b)
+    {
+        // acos of the dot product loses everything below about 0.02 degrees
+        return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+    }
+
+    glm::vec2 abs_difference(glm::vec2 const & a, glm::vec2 const & b)
+    {
+        return glm::abs(a - b);
+    }
+
+    struct bounds
+    {
+        glm::vec3 min{std::numeric_limits<float>::infinity()};
+        glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+        void add(glm::vec3 const & p)
+        {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+    };
+
+    // Fills the fields shared by both packed layouts and accumulates the error
+    template <typename Vertex>
+    void pack_common(Vertex & result, position_quantization const & quantization, glm::vec3 const & position,
+        glm::vec3 const & normal, glm::vec2 const & texcoord, packing_error & error)
+    {
+        result.position = quantize_position(quantization, position);
+        result.normal = encode_octahedral(normal);
+        result.texcoord = encode_texcoord(texcoord);
+
+        error.position = std::max(error.position, glm::length(dequantize_position(quantization, result.position) - position));
+        error.direction = std::max(error.direction, angle_degrees(normal, decode_octahedral(result.normal)));
+
+        auto const texcoord_error = abs_difference(decode_texcoord(result.texcoord), texcoord);
+        error.texcoord = std::max({error.texcoord, texcoord_error.x, texcoord_error.y});
+    }
+
+    std::size_t component_size(unsigned int type)
+    {
+        switch (type)
+        {
+        case gl_byte:
+        case gl_unsigned_byte:
+            return 1;
+        case gl_short:
+        case gl_unsigned_short:
+            return 2;
+        case gl_unsigned_int:
+        case gl_float:
+            return 4;
+        }
+        throw std::runtime_error("Unknown component type: " + std::to_string(type));
+    }
+
+    // Normalized integers are decoded as the glTF spec says, other integers
+    // (KHR_mesh_quantization) keep their value
+    float read_component(char const * data, unsigned int type, bool normalized)
+    {
+        auto read = [data]<typename T>(T) {
+            T result;
+            std::memcpy(&result, data, sizeof(result));
+            return result;
+        };
+
+        switch (type)
+        {
+        case gl_byte:
+            return normalized ? std::max(read(std::int8_t{}) / 127.f, -1.f) : read(std::int8_t{});
+        case gl_unsigned_byte:
+            return normalized ? read(std::uint8_t{}) / 255.f : read(std::uint8_t{});
+        case gl_short:
+            return normalized ? std::max(read(std::int16_t{}) / 32767.f, -1.f) : read(std::int16_t{});
+        case gl_unsigned_short:
+            return normalized ? read(std::uint16_t{}) / 65535.f : read(std::uint16_t{});
+        case gl_unsigned_int:
+            return float(read(std::uint32_t{}));
+        case gl_float:
+            return read(float{});
+        }
+        throw std::runtime_error("Unknown component type: " + std::to_string(type));
+    }
+
+    // Start of the accessor's data, after checking that its last element
+    // ends inside its buffer view
+    char const * accessor_data(gltf_model const & model, gltf_model::accessor const & accessor, std::size_t stride)
+    {
+        std::size_t const element_size = accessor.size * component_size(accessor.type);
+        if (accessor.count > 0 && accessor.offset + (accessor.count - 1) * stride + element_size > accessor.view.size)
+            throw std::runtime_error("Accessor is out of its buffer view");
+
+        return model.buffers[accessor.view.buffer].data.data() + accessor.view.offset + accessor.offset;
+    }
+
+    template <int N>
+    std::vector<glm::vec<N, float>> read_attribute(gltf_model const & model, gltf_model::accessor const & accessor)
+    {
+        if (accessor.size < N)
+            throw std::runtime_error("Vertex attribute has fewer than " + std::to_string(N) + " components");
+
+        std::size_t const size = component_size(accessor.type);
+        std::size_t const stride = accessor.view.stride ? accessor.view.stride : accessor.size * size;
+        char const * data = accessor_data(model, accessor, stride);
+
+        std::vector<glm::vec<N, float>> result(accessor.count);
+        for (std::size_t i = 0; i < accessor.count; ++i)
+            for (int c = 0; c < N; ++c)
+                result[i][c] = read_component(data + i * stride + c * size, accessor.type, accessor.normalized);
+        return result;
+    }
+
+    std::uint32_t read_index(char const * data, unsigned int type, std::size_t i)
+    {
+        switch (type)
+        {
+        case gl_unsigned_byte:
+            return std::uint8_t(data[i]);
+        case gl_unsigned_short:
+        {
+            std::uint16_t result;
+            std::memcpy(&result, data + i * sizeof(result), sizeof(result));
+            return result;
+        }
+        case gl_unsigned_int:
+        {
+            std::uint32_t result;
+            std::memcpy(&result, data + i * sizeof(result), sizeof(result));
+            return result;
+        }
+        }
+        throw std::runtime_error("Unknown index type: " + std::to_string(type));
+    }
+
+    // A mesh without indices is a plain triangle list
+    std::vector<std::uint32_t> read_indices(gltf_model const & model, gltf_model::mesh const & mesh)
+    {
+        std::vector<std::uint32_t> result;
+        if (!mesh.indices)
+        {
+            result.resize(mesh.position.count);
+            std::iota(result.begin(), result.end(), 0u);
+        }
+        else
+        {
+            auto const & indices = *mesh.indices;
+            char const * data = accessor_data(model, indices, component_size(indices.type));
+            result.resize(indices.count);
+            for (std::size_t i = 0; i < indices.count; ++i)
+                result[i] = read_index(data, indices.type, i);
+        }
+
+        if (result.size() % 3 != 0)
+            throw std::runtime_error("Mesh " + mesh.name + " is not a triangle list");
+        for (auto index : result)
+            if (index >= mesh.position.count)
+                throw std::runtime_error("Index out of range in mesh " + mesh.name);
+        return result;
+    }
+
+}
+
+glm::mat4 position_quantization::decode_matrix() const
+{
+    return glm::scale(glm::translate(glm::mat4(1.f), offset), glm::vec3(scale));
+}
+
+float position_quantization::error_bound() const
+{
+    // Meshes far from the origin also lose a few float ulps when decoding
+    float const magnitude = std::max({std::abs(offset.x), std::abs(offset.y), std::abs(offset.z)}) + scale;
+    return std::sqrt(3.f) * (0.5f * scale / 65535.f + magnitude * std::numeric_limits<float>::epsilon());
+}
+
+position_quantization make_position_quantization(glm::vec3 const & min, glm::vec3 const & max)
+{
+    if (!(min.x <= max.x && min.y <= max.y && min.z <= max.z))
+        return {};
+
+    auto const extent = max - min;
+    float const scale = std::max({extent.x, extent.y, extent.z});
+    return {min, scale > 0.f ? scale : 1.f};
+}
+
+std::array<std::uint16_t, 4> quantize_position(position_quantization const & quantization, glm::vec3 const & position)
+{
+    auto const p = (position - quantization.offset) / quantization.scale;
+    return {glm::packUnorm1x16(p.x), glm::packUnorm1x16(p.y), glm::packUnorm1x16(p.z), 0};
+}
+
+glm::vec3 dequantize_position(position_quantization const & quantization, std::array<std::uint16_t, 4> const & value)
+{
+    glm::vec3 const p{glm::unpackUnorm1x16(value[0]), glm::unpackUnorm1x16(value[1]), glm::unpackUnorm1x16(value[2])};
+    return quantization.offset + p * quantization.scale;
+}
+
+std::array<std::uint16_t, 2> encode_octahedral(glm::vec3 const & direction)
+{
+    float const norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (norm == 0.f)
+        return {32768, 32768};
+
+    glm::vec2 p = glm::vec2(direction.x, direction.y) / norm;
+    if (direction.z < 0.f)
+    {
+        glm::vec2 const folded = 1.f - glm::abs(glm::vec2(p.y, p.x));
+        p = {p.x >= 0.f ? folded.x : -folded.x, p.y >= 0.f ? folded.y : -folded.y};
+    }
+
+    // [-1, 1] -> [0, 65535], then try both neighbours along each axis
+    p = glm::clamp((p * 0.5f + 0.5f) * 65535.f, 0.f, 65535.f);
+    auto const unit = glm::normalize(direction);
+
+    std::array<std::uint16_t, 2> best{};
+    float best_dot = -2.f;
+    for (float x : {std::floor(p.x), std::ceil(p.x)})
+    {
+        for (float y : {std::floor(p.y), std::ceil(p.y)})
+        {
+            std::array<std::uint16_t, 2> const candidate{std::uint16_t(x), std::uint16_t(y)};
+            float const d = glm::dot(decode_octahedral(candidate), unit);
+            if (d > best_dot)
+            {
+                best_dot = d;
+                best = candidate;
+            }
+        }
+    }
+    return best;
+}
+
+glm::vec3 decode_octahedral(std::array<std::uint16_t, 2> const & value)
+{
+    glm::vec2 const p = glm::vec2(glm::unpackUnorm1x16(value[0]), glm::unpackUnorm1x16(value[1])) * 2.f - 1.f;
+    glm::vec3 n{p.x, p.y, 1.f - std::abs(p.x) - std::abs(p.y)};
+    float const t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+std::array<std::uint16_t, 2> encode_texcoord(glm::vec2 const & texcoord)
+{
+    return {glm::packHalf1x16(texcoord.x), glm::packHalf1x16(texcoord.y)};
+}
+
+glm::vec2 decode_texcoord(std::array<std::uint16_t, 2> const & value)
+{
+    return {glm::unpackHalf1x16(value[0]), glm::unpackHalf1x16(value[1])};
+}
+
+packed_mesh pack_vertices(float const * positions, float const * normals, float const * texcoords,
+    std::size_t count, std::size_t stride)
+{
+    strided_reader const position_reader{reinterpret_cast<char const *>(positions), stride};
+    strided_reader const normal_reader{reinterpret_cast<char const *>(normals), stride};
+    strided_reader const texcoord_reader{reinterpret_cast<char const *>(texcoords), stride};
+
+    bounds box;
+    for (std::size_t i = 0; i < count; ++i)
+        box.add(position_reader.vec3(i));
+
+    packed_mesh result;
+    result.quantization = make_position_quantization(box.min, box.max);
+    result.vertices.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+        pack_common(result.vertices[i], result.quantization, position_reader.vec3(i), normal_reader.vec3(i),
+            texcoord_reader.vec2(i), result.error);
+
+    return result;
+}
+
+packed_gltf pack_gltf(gltf_model const & model)
+{
+    packed_gltf result;
+
+    std::size_t vertex_count = 0;
+    std::size_t index_count = 0;
+    bounds box;
+    for (auto const & mesh : model.meshes)
+    {
+        for (auto const & position : read_attribute<3>(model, mesh.position))
+            box.add(position);
+
+        vertex_count += mesh.position.count;
+        index_count += mesh.indices ? mesh.indices->count : mesh.position.count;
+    }
+
+    result.quantization = make_position_quantization(box.min, box.max);
+    result.vertices.reserve(vertex_count);
+    result.indices.reserve(index_count);
+    result.meshes.reserve(model.meshes.size());
+
+    for (auto const & mesh : model.meshes)
+    {
+        std::size_t const count = mesh.position.count;
+        auto const positions = read_attribute<3>(model, mesh.position);
+        auto const indices = read_indices(model, mesh);
+
+        auto const texcoords = mesh.texcoord ? read_attribute<2>(model, *mesh.texcoord) : std::vector<glm::vec2>(count);
+
+        std::vector<glm::vec3> normals;
+        if (mesh.normal)
+            normals = read_attribute<3>(model, *mesh.normal);
+        else
+        {
+            normals.resize(count);
+            compute_normals(indices, &positions.data()->x, sizeof(glm::vec3), count, &normals.data()->x, sizeof(glm::vec3));
+        }
+
+        // Generated in the MikkTSpace convention glTF asks for; without
+        // texcoords they are just some vector perpendicular to the normal
+        std::vector<glm::vec4> tangents;
+        if (mesh.tangent)
+            tangents = read_attribute<4>(model, *mesh.tangent);
+        else
+        {
+            tangents.resize(count);
+            compute_tangents(indices, &positions.data()->x, sizeof(glm::vec3), &normals.data()->x, sizeof(glm::vec3),
+                &texcoords.data()->x, sizeof(glm::vec2), count, &tangents.data()->x, sizeof(glm::vec4));
+        }
+
+        if (tangents.size() < count || normals.size() < count || texcoords.size() < count)
+            throw std::runtime_error("Vertex attributes of mesh " + mesh.name + " have different counts");
+
+        auto & packed = result.meshes.emplace_back();
+        packed.base_vertex = result.vertices.size();
+        packed.vertex_count = count;
+        packed.first_index = result.indices.size();
+        packed.index_count = indices.size();
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto & vertex = result.vertices.emplace_back();
+            pack_common(vertex, result.quantization, positions[i], normals[i], texcoords[i], result.error);
+
+            glm::vec3 const tangent(tangents[i]);
+            vertex.position[3] = tangents[i].w < 0.f ? 0 : 65535;
+            vertex.tangent = encode_octahedral(tangent);
+            result.error.direction = std::max(result.error.direction, angle_degrees(tangent, decode_octahedral(vertex.tangent)));
+        }
+
+        result.indices.insert(result.indices.end(), indices.begin(), indices.end());
+    }
+
+    return result;
+}
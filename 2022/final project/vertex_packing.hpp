@@ -0,0 +1,128 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+// Compact vertex layouts for static meshes. Positions are unorm16 inside a
+// cube around the mesh bounds, so decoding them is one uniform scale and
+// translation (see position_quantization::decode_matrix); normals and
+// tangents are octahedral unorm16 pairs; texcoords are half floats.
+//
+// All components are read with glVertexAttribPointer as normalized unsigned
+// shorts or GL_HALF_FLOAT, so the vertex shader only has to undo the
+// octahedral mapping (see decode_octahedral in the shaders).
+
+// 16 bytes instead of 32 for a float position/normal/texcoord vertex
+struct packed_vertex
+{
+    std::array<std::uint16_t, 4> position; // w is padding
+    std::array<std::uint16_t, 2> normal;
+    std::array<std::uint16_t, 2> texcoord;
+};
+
+// 20 bytes instead of 48 for a float glTF vertex with a vec4 tangent. The
+// tangent's handedness, the sign the bitangent is multiplied by, takes the
+// position's w: 0 for -1, 65535 for +1, so that it decodes to 0 or 1.
+struct packed_tangent_vertex
+{
+    std::array<std::uint16_t, 4> position; // w is the tangent's handedness
+    std::array<std::uint16_t, 2> tangent;
+    std::array<std::uint16_t, 2> normal;
+    std::array<std::uint16_t, 2> texcoord;
+};
+
+// Maps positions inside [offset, offset + scale]^3 to [0, 1]^3
+struct position_quantization
+{
+    glm::vec3 offset{0.f};
+    float scale = 1.f;
+
+    // Takes a decoded [0, 1]^3 position back to the mesh space, the model
+    // matrix can be multiplied by it
+    glm::mat4 decode_matrix() const;
+
+    // Largest distance between a position inside the bounds and its decoded
+    // value: half a quantization step along every axis, plus float rounding
+    float error_bound() const;
+};
+
+position_quantization make_position_quantization(glm::vec3 const & min, glm::vec3 const & max);
+
+std::array<std::uint16_t, 4> quantize_position(position_quantization const & quantization, glm::vec3 const & position);
+glm::vec3 dequantize_position(position_quantization const & quantization, std::array<std::uint16_t, 4> const & value);
+
+// Octahedral mapping of a unit vector to [0, 1]^2. Among the four roundings
+// of the mapped point the one decoding closest to the input is kept, which
+// bounds the error by about 0.01 degrees.
+std::array<std::uint16_t, 2> encode_octahedral(glm::vec3 const & direction);
+glm::vec3 decode_octahedral(std::array<std::uint16_t, 2> const & value);
+
+std::array<std::uint16_t, 2> encode_texcoord(glm::vec2 const & texcoord);
+glm::vec2 decode_texcoord(std::array<std::uint16_t, 2> const & value);
+
+// Largest measured differences between input and decoded vertices
+struct packing_error
+{
+    // In mesh units
+    float position = 0.f;
+    // Angle between the input and decoded normal or tangent, in degrees
+    float direction = 0.f;
+    float texcoord = 0.f;
+};
+
+struct packed_mesh
+{
+    std::vector<packed_vertex> vertices;
+    position_quantization quantization;
+    packing_error error;
+};
+
+// Attributes are read through pointers to the first vertex's floats and the
+// byte stride between vertices
+packed_mesh pack_vertices(float const * positions, float const * normals, float const * texcoords,
+    std::size_t count, std::size_t stride);
+
+template <typename Vertex, typename Texcoord>
+packed_mesh pack_vertices(std::vector<Vertex> const & vertices, Texcoord Vertex::* texcoord)
+{
+    if (vertices.empty())
+        return {};
+
+    auto const & first = vertices.front();
+    return pack_vertices(reinterpret_cast<float const *>(&first.position), reinterpret_cast<float const *>(&first.normal),
+        reinterpret_cast<float const *>(&(first.*texcoord)), vertices.size(), sizeof(Vertex));
+}
+
+// All meshes of a glTF model, whatever buffers they came from, in one vertex
+// buffer and one 32-bit index buffer, meant to be drawn from a single VAO
+// with glDrawElementsBaseVertex. Indices stay relative to the mesh, so a
+// mesh's attributes start at base_vertex; all meshes share one quantization.
+struct packed_gltf
+{
+    struct mesh
+    {
+        std::uint32_t base_vertex;
+        std::uint32_t vertex_count;
+        std::uint32_t first_index;
+        std::uint32_t index_count;
+    };
+
+    std::vector<packed_tangent_vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    std::vector<mesh> meshes;
+    position_quantization quantization;
+    packing_error error;
+};
+
+// Attributes can be floats or (normalized) integers. Missing normals and
+// tangents are generated (see tangent_space.hpp), missing texcoords are zero.
+// Throws on accessors out of their buffer views and indices out of range.
+packed_gltf pack_gltf(gltf_model const & model);
@@ -0,0 +1,143 @@
+// Fraction of triangles removed by meshlet frustum and normal cone culling
+// along scripted camera paths, with the size of the resulting draw list and
+// the time culling takes per frame.
+//
+// Usage: meshlet_culling_benchmark [file.obj ...]
+// Without files the house scene from the 2021 practices and the suzanne and
+// cow meshes are used. The paths are scaled to the bounding sphere of the
+// scene: an orbit around it like the one main.cpp starts with, a closer lower
+// orbit that keeps part of the scene behind the camera, and a straight flight
+// through its middle.
+
+#include "meshlet.hpp"
+#include "obj_parser.hpp"
+
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/scalar_constants.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+
+namespace
+{
+
+    constexpr int frames = 360;
+
+    struct camera
+    {
+        glm::mat4 view;
+        glm::vec3 position;
+    };
+
+    // Same construction as the camera in main.cpp
+    camera orbit_camera(glm::vec3 const & target, float distance, float elevation, float angle)
+    {
+        glm::mat4 view(1.f);
+        view = glm::translate(view, {0.f, 0.f, -distance});
+        view = glm::rotate(view, elevation, {1.f, 0.f, 0.f});
+        view = glm::rotate(view, angle, {0.f, 1.f, 0.f});
+        view = glm::translate(view, -target);
+        return {view, glm::vec3(glm::inverse(view) * glm::vec4(0.f, 0.f, 0.f, 1.f))};
+    }
+
+    void run_path(char const * name, obj_meshlets const & scene, glm::mat4 const & projection,
+        std::function<camera(float)> const & path)
+    {
+        meshlet_cull_stats total;
+        std::size_t ranges_total = 0;
+        double seconds = 0.0;
+
+        std::vector<index_range> ranges;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            auto const cam = path(float(frame) / frames);
+
+            auto start = std::chrono::steady_clock::now();
+            meshlet_culler const culler(projection * cam.view, cam.position);
+            ranges.clear();
+            for (std::size_t s = 0; s + 1 < scene.submesh_meshlets.size(); ++s)
+            {
+                auto const meshlets = std::span(scene.meshlets).subspan(scene.submesh_meshlets[s],
+                    scene.submesh_meshlets[s + 1] - scene.submesh_meshlets[s]);
+                cull_meshlets(culler, meshlets, ranges, total);
+            }
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ranges_total += ranges.size();
+        }
+
+        std::printf("    %-12s culled %5.1f%% (frustum %5.1f%%, back-facing %5.1f%%)  %7.1f visible meshlets  %7.1f draw ranges  %7.1f us\n",
+            name, 100.f * total.culled_fraction(), 100.f * total.frustum_culled_triangles / total.triangles,
+            100.f * total.back_facing_triangles / total.triangles, double(total.visible_meshlets) / frames,
+            double(ranges_total) / frames, seconds / frames * 1e6);
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::filesystem::path> paths(argv + 1, argv + argc);
+    if (paths.empty())
+    {
+        paths.emplace_back(PROJECT_ROOT "/../../2021/practice12/house.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice7/suzanne.obj");
+        paths.emplace_back(PROJECT_ROOT "/../practice5/cow.obj");
+    }
+
+    for (auto const & path : paths)
+    {
+        obj_parse_options options;
+        options.sort_by_material = true;
+        auto data = parse_obj(path, options);
+
+        auto start = std::chrono::steady_clock::now();
+        auto const scene = build_meshlets(data);
+        double const build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::size_t vertices = 0, with_cone = 0;
+        for (auto const & m : scene.meshlets)
+        {
+            vertices += m.vertex_count;
+            with_cone += m.cone_cos > 0.f;
+        }
+
+        std::printf("%s: %zu triangles, %zu submeshes, %zu meshlets built in %.1f ms\n",
+            path.filename().string().c_str(), data.indices.size() / 3, data.submeshes.size(), scene.meshlets.size(),
+            build_seconds * 1e3);
+        std::printf("    %.1f vertices and %.1f triangles per meshlet, %.1f%% with a usable normal cone\n",
+            double(vertices) / scene.meshlets.size(), double(data.indices.size() / 3) / scene.meshlets.size(),
+            100.0 * with_cone / scene.meshlets.size());
+
+        glm::vec3 min(std::numeric_limits<float>::infinity()), max(-std::numeric_limits<float>::infinity());
+        for (auto const & v : data.vertices)
+        {
+            min = glm::min(min, glm::vec3(v.position[0], v.position[1], v.position[2]));
+            max = glm::max(max, glm::vec3(v.position[0], v.position[1], v.position[2]));
+        }
+        glm::vec3 const center = (min + max) * 0.5f;
+        float const radius = glm::distance(min, max) * 0.5f;
+
+        auto const projection = glm::perspective(glm::pi<float>() / 2.f, 16.f / 9.f, radius * 1e-4f, radius * 10.f);
+
+        run_path("orbit", scene, projection, [&](float t) {
+            return orbit_camera(center, 1.5f * radius, glm::pi<float>() / 4.f, 2.f * glm::pi<float>() * t);
+        });
+        run_path("close orbit", scene, projection, [&](float t) {
+            return orbit_camera(center, 0.6f * radius, glm::pi<float>() / 8.f, 2.f * glm::pi<float>() * t);
+        });
+        run_path("fly-through", scene, projection, [&](float t) {
+            glm::vec3 const position = center + glm::vec3((1.6f * t - 0.8f) * radius, 0.f, 0.f);
+            return camera{glm::lookAt(position, position + glm::vec3(1.f, 0.f, 0.f), {0.f, 1.f, 0.f}), position};
+        });
+    }
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -1,6 +1,3 @@
-#define TINYOBJLOADER_IMPLEMENTATION
-//#include "tiny_obj_loader.h"
-
 #ifdef WIN32
 #include <SDL.h>
 #undef main
@@ -16,6 +13,7 @@
 #include <chrono>
 #include <vector>
 #include <set>
+#include <map>
 
 #include "obj_parser.hpp"
 #include "stb_image.h"
@@ -34,6 +32,8 @@
 #include "shaders.hpp"
 #include "utils.hpp"
 #include "texture_holder.hpp"
+#include "meshlet.hpp"
+#include "obj_upload.hpp"
 
 int main(int argc, char **argv) try {
     auto *window = create_window("Homework 2");
@@ -75,33 +75,67 @@ int main(int argc, char **argv) try {
     std::string obj_path = scene_dir + std::string(argv[2]);
 
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    tinyobj::LoadObj(&attrib, &shapes, &materials, nullptr, obj_path.c_str(), scene_dir.c_str());
+    // With --stream only the geometry is loaded, chunk by chunk straight into
+    // the GL buffers, for meshes too big to parse whole. It is drawn as one
+    // untextured submesh, without meshlet culling.
+    bool streamed = argc > 3 && std::string_view(argv[3]) == "--stream";
+    obj_data scene;
+    obj_meshlets scene_meshlets;
+    uploaded_obj upload;
+    bounding_box bounding_box;
+    if(streamed) {
+        upload = upload_obj_stream(obj_path);
+        scene.materials.emplace_back();
+        scene.submeshes.push_back({"", 0, 0, (std::uint32_t)upload.index_count});
+        for(int i = 0; i < 8; i++)
+            bounding_box[i] = glm::vec3((i & 1) ? upload.max.x : upload.min.x,
+                                        (i & 2) ? upload.max.y : upload.min.y,
+                                        (i & 4) ? upload.max.z : upload.min.z);
+    } else {
+        // One submesh per material, so the scene takes one draw call per material
+        obj_parse_options parse_options;
+        parse_options.threads = 0;
+        parse_options.use_cache = true;
+        parse_options.sort_by_material = true;
+        scene = parse_obj(obj_path, parse_options);
+        // Reorders the indices, so it has to happen before the upload
+        scene_meshlets = build_meshlets(scene);
+        bounding_box = get_bounding_box(scene.vertices);
+    }
+
+    auto texture_path = [&](const std::string &name) {
+        std::string path = scene_dir + name;
+        std::replace(path.begin(), path.end(), '\\', '/');
+        return path;
+    };
 
     texture_holder textures(2);
-    for(auto &material : materials) {
-        std::string texture_path = scene_dir + material.ambient_texname;
-        std::replace(texture_path.begin(), texture_path.end(), '\\', '/');
-        textures.load_texture(texture_path);
-    }
-    auto vertices = get_vertices(attrib, shapes);
-    auto bounding_box = get_bounding_box(vertices);
+    for(auto &material : scene.materials)
+        textures.load_texture(texture_path(material.ambient_texture));
     glm::vec3 c = std::accumulate(bounding_box.begin(), bounding_box.end(), glm::vec3(0.f)) / 8.f;
 
-    GLuint vao, vbo;
+    GLuint vao, vbo, ebo;
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertex), vertices.data(), GL_STATIC_DRAW);
+    if(streamed) {
+        vbo = upload.vertex_buffer;
+        ebo = upload.index_buffer;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    } else {
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, scene.vertices.size() * sizeof(obj_data::vertex), scene.vertices.data(), GL_STATIC_DRAW);
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, scene.indices.size() * sizeof(std::uint32_t), scene.indices.data(), GL_STATIC_DRAW);
+    }
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(0));
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(obj_data::vertex), (void*)(0));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*)(12));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(obj_data::vertex), (void*)(12));
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void*) 24);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(obj_data::vertex), (void*) 24);
 
     GLsizei shadow_map_resolution = 1024;
     GLuint shadow_map, render_buffer, shadow_fbo;
@@ -132,7 +166,10 @@ int main(int argc, char **argv) try {
     float camera_angle = glm::pi<float>() / 2.f;
     float view_elevation = glm::pi<float>() / 4.f;
 
-    bool running = true, paused = false;
+    bool running = true, paused = false, meshlet_culling = !streamed;
+    std::vector<index_range> visible_ranges;
+    std::vector<GLsizei> draw_counts;
+    std::vector<const void *> draw_offsets;
     while (true) {
         for (SDL_Event event; SDL_PollEvent(&event);)
             switch (event.type) {
@@ -151,6 +188,8 @@ int main(int argc, char **argv) try {
                     button_down[event.key.keysym.sym] = true;
                     if(event.key.keysym.sym == SDLK_SPACE)
                         paused = !paused;
+                    if(event.key.keysym.sym == SDLK_c && !streamed)
+                        meshlet_culling = !meshlet_culling;
                     break;
                 case SDL_KEYUP:
                     button_down[event.key.keysym.sym] = false;
@@ -214,15 +253,12 @@ int main(int argc, char **argv) try {
         glUniformMatrix4fv(shadow_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&transform));
         glBindVertexArray(vao);
 
-        GLint current_block = 0;
-        for(auto &shape : shapes) {
-            auto material = materials[shape.mesh.material_ids[0]];
-            std::string texture_path = scene_dir + material.alpha_texname;
-            std::replace(texture_path.begin(), texture_path.end(), '\\', '/');
-            glUniform1i(have_alpha_location, !material.alpha_texname.empty());
-            glUniform1i(alpha_texture_location, textures.get_texture(texture_path));
-            glDrawArrays(GL_TRIANGLES, current_block, (GLint)shape.mesh.indices.size());
-            current_block += (GLint)shape.mesh.indices.size();
+        for(auto &submesh : scene.submeshes) {
+            auto &material = scene.materials[submesh.material];
+            glUniform1i(have_alpha_location, !material.alpha_texture.empty());
+            glUniform1i(alpha_texture_location, textures.get_texture(texture_path(material.alpha_texture)));
+            glDrawElements(GL_TRIANGLES, (GLsizei)submesh.index_count, GL_UNSIGNED_INT,
+                           (void*)(submesh.first_index * sizeof(std::uint32_t)));
         }
 
         glBindTexture(GL_TEXTURE_2D, shadow_map);
@@ -262,21 +298,36 @@ int main(int argc, char **argv) try {
         //glUniform3fv(point_light_position_location, 1, reinterpret_cast<float *>(&point_light_position));
         glUniform1i(shadow_map_location, 1);
 
-        current_block = 0;
-        for(auto &shape : shapes) {
-            auto material = materials[shape.mesh.material_ids[0]];
-            std::string texture_path = scene_dir + material.ambient_texname;
-            std::replace(texture_path.begin(), texture_path.end(), '\\', '/');
+        meshlet_culler culler(projection * view * model, camera_position);
+        meshlet_cull_stats cull_stats;
+        for(std::size_t i = 0; i < scene.submeshes.size(); i++) {
+            auto &submesh = scene.submeshes[i];
+            visible_ranges.clear();
+            if(meshlet_culling) {
+                std::span<const meshlet> meshlets(scene_meshlets.meshlets.data() + scene_meshlets.submesh_meshlets[i],
+                                                  scene_meshlets.meshlets.data() + scene_meshlets.submesh_meshlets[i + 1]);
+                cull_meshlets(culler, meshlets, visible_ranges, cull_stats);
+            } else {
+                visible_ranges.push_back({submesh.first_index, submesh.index_count});
+            }
+            if(visible_ranges.empty())
+                continue;
+
+            auto &material = scene.materials[submesh.material];
             glUniform1f(power_location, material.shininess);
             glUniform1f(glossiness_location, material.specular[0]);
-            glUniform1i(texture_location, textures.get_texture(texture_path));
-            material = materials[shape.mesh.material_ids[0]];
-            texture_path = scene_dir + material.alpha_texname;
-            std::replace(texture_path.begin(), texture_path.end(), '\\', '/');
-            glUniform1i(_have_alpha_location, !material.alpha_texname.empty());
-            glUniform1i(_alpha_texture_location, textures.get_texture(texture_path));
-            glDrawArrays(GL_TRIANGLES, current_block, (GLint)shape.mesh.indices.size());
-            current_block += (GLint)shape.mesh.indices.size();
+            glUniform1i(texture_location, textures.get_texture(texture_path(material.ambient_texture)));
+            glUniform1i(_have_alpha_location, !material.alpha_texture.empty());
+            glUniform1i(_alpha_texture_location, textures.get_texture(texture_path(material.alpha_texture)));
+
+            draw_counts.clear();
+            draw_offsets.clear();
+            for(auto &range : visible_ranges) {
+                draw_counts.push_back((GLsizei)range.index_count);
+                draw_offsets.push_back((void*)(range.first_index * sizeof(std::uint32_t)));
+            }
+            glMultiDrawElements(GL_TRIANGLES, draw_counts.data(), GL_UNSIGNED_INT, draw_offsets.data(),
+                                (GLsizei)draw_counts.size());
         }
 
         SDL_GL_SwapWindow(window);
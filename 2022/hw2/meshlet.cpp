@@ -0,0 +1,413 @@
+#include "meshlet.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+
+    constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    struct position_reader
+    {
+        char const * data;
+        std::size_t stride;
+
+        glm::vec3 operator()(std::uint32_t vertex) const
+        {
+            glm::vec3 result;
+            std::memcpy(&result, data + vertex * stride, sizeof(result));
+            return result;
+        }
+    };
+
+    // Maps every vertex to the first vertex with the same position, so that
+    // flat shaded or UV-seamed triangles still count as neighbours
+    std::vector<std::uint32_t> position_remap(std::span<std::uint32_t const> indices, position_reader const & position,
+        std::size_t vertex_count)
+    {
+        struct position_hash
+        {
+            std::size_t operator()(glm::vec3 const & p) const
+            {
+                std::array<std::uint32_t, 3> bits;
+                std::memcpy(bits.data(), &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+
+        std::vector<std::uint32_t> result(vertex_count, none);
+        std::unordered_map<glm::vec3, std::uint32_t, position_hash> first;
+        for (auto v : indices)
+            if (result[v] == none)
+                result[v] = first.emplace(position(v), v).first->second;
+        return result;
+    }
+
+    // Triangles around each position, as one array split by offsets
+    struct vertex_triangles
+    {
+        std::vector<std::uint32_t> remap;
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> triangles;
+
+        vertex_triangles(std::span<std::uint32_t const> indices, position_reader const & position, std::size_t vertex_count)
+            : remap(position_remap(indices, position, vertex_count))
+            , offsets(vertex_count + 1, 0)
+            , triangles(indices.size())
+        {
+            for (auto index : indices)
+                ++offsets[remap[index] + 1];
+            for (std::size_t v = 0; v < vertex_count; ++v)
+                offsets[v + 1] += offsets[v];
+
+            auto fill = offsets;
+            for (std::size_t i = 0; i < indices.size(); ++i)
+                triangles[fill[remap[indices[i]]]++] = i / 3;
+        }
+
+        std::span<std::uint32_t const> operator[](std::uint32_t vertex) const
+        {
+            vertex = remap[vertex];
+            return {triangles.data() + offsets[vertex], triangles.data() + offsets[vertex + 1]};
+        }
+    };
+
+    // Interleaves the bits of three 10-bit coordinates
+    std::uint32_t morton_code(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+    {
+        auto spread = [](std::uint32_t v)
+        {
+            v = (v | (v << 16)) & 0x030000ffu;
+            v = (v | (v << 8)) & 0x0300f00fu;
+            v = (v | (v << 4)) & 0x030c30c3u;
+            v = (v | (v << 2)) & 0x09249249u;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+    }
+
+    void compute_bounds(meshlet & result, std::span<std::uint32_t const> vertices, std::span<std::uint32_t const> triangles,
+        std::span<std::uint32_t const> indices, position_reader const & position)
+    {
+        glm::vec3 min(std::numeric_limits<float>::infinity());
+        glm::vec3 max(-std::numeric_limits<float>::infinity());
+        for (auto v : vertices)
+        {
+            min = glm::min(min, position(v));
+            max = glm::max(max, position(v));
+        }
+
+        result.center = (min + max) * 0.5f;
+        result.radius = 0.f;
+        for (auto v : vertices)
+            result.radius = std::max(result.radius, glm::distance(result.center, position(v)));
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(triangles.size());
+        glm::vec3 sum(0.f);
+        for (auto t : triangles)
+        {
+            auto const a = position(indices[3 * t]);
+            auto const n = glm::cross(position(indices[3 * t + 1]) - a, position(indices[3 * t + 2]) - a);
+            float const length = glm::length(n);
+            if (length == 0.f)
+                continue;
+            normals.push_back(n / length);
+            sum += normals.back();
+        }
+
+        float const sum_length = glm::length(sum);
+        if (normals.empty() || sum_length < 1e-3f * normals.size())
+        {
+            result.cone_axis = {0.f, 0.f, 1.f};
+            result.cone_cos = -1.f;
+            result.cone_sin = 0.f;
+            return;
+        }
+
+        result.cone_axis = sum / sum_length;
+        result.cone_cos = 1.f;
+        for (auto const & n : normals)
+            result.cone_cos = std::min(result.cone_cos, glm::dot(result.cone_axis, n));
+        result.cone_sin = std::sqrt(std::max(0.f, 1.f - result.cone_cos * result.cone_cos));
+    }
+
+}
+
+std::vector<meshlet> build_meshlets(std::span<std::uint32_t> indices, float const * positions, std::size_t vertex_count,
+    std::size_t stride)
+{
+    position_reader const position{reinterpret_cast<char const *>(positions), stride};
+    std::size_t const triangle_count = indices.size() / 3;
+    vertex_triangles const adjacency(indices.first(triangle_count * 3), position, vertex_count);
+
+    // Marks hold the number of the meshlet being built, so they never need
+    // to be cleared
+    std::vector<std::uint32_t> vertex_mark(vertex_count, none);
+    std::vector<std::uint32_t> candidate_mark(triangle_count, none);
+    std::vector<bool> emitted(triangle_count, false);
+
+    std::vector<std::uint32_t> order;
+    order.reserve(triangle_count);
+
+    std::vector<meshlet> result;
+    std::vector<std::uint32_t> vertices;
+    std::vector<std::uint32_t> candidates;
+    glm::vec3 vertex_sum(0.f);
+    std::size_t first_triangle = 0;
+
+    auto centroid = [&](std::uint32_t t)
+    {
+        return (position(indices[3 * t]) + position(indices[3 * t + 1]) + position(indices[3 * t + 2])) / 3.f;
+    };
+
+    // New meshlets start from the first triangle left in Morton order of the
+    // centroids, so that disconnected pieces are visited near each other
+    std::vector<std::uint32_t> seeds(triangle_count);
+    {
+        glm::vec3 min(std::numeric_limits<float>::infinity());
+        glm::vec3 max(-std::numeric_limits<float>::infinity());
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            min = glm::min(min, centroid(t));
+            max = glm::max(max, centroid(t));
+        }
+        auto const scale = 1023.f / glm::max(max - min, glm::vec3(std::numeric_limits<float>::min()));
+
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> keys(triangle_count);
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            auto const cell = glm::uvec3((centroid(t) - min) * scale);
+            keys[t] = {morton_code(cell.x, cell.y, cell.z), t};
+        }
+        std::sort(keys.begin(), keys.end());
+        for (std::size_t t = 0; t < triangle_count; ++t)
+            seeds[t] = keys[t].second;
+    }
+    std::size_t next_seed = 0;
+
+    auto new_vertices = [&](std::uint32_t t)
+    {
+        std::uint32_t const id = result.size();
+        std::size_t count = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            auto const v = indices[3 * t + k];
+            // Degenerate triangles may repeat a vertex
+            bool const repeated = (k > 0 && indices[3 * t] == v) || (k > 1 && indices[3 * t + 1] == v);
+            if (vertex_mark[v] != id && !repeated)
+                ++count;
+        }
+        return count;
+    };
+
+    auto add_triangle = [&](std::uint32_t t)
+    {
+        std::uint32_t const id = result.size();
+        emitted[t] = true;
+        order.push_back(t);
+        for (int k = 0; k < 3; ++k)
+        {
+            auto const v = indices[3 * t + k];
+            if (vertex_mark[v] == id)
+                continue;
+            vertex_mark[v] = id;
+            vertices.push_back(v);
+            vertex_sum += position(v);
+            for (auto neighbour : adjacency[v])
+            {
+                if (emitted[neighbour] || candidate_mark[neighbour] == id)
+                    continue;
+                candidate_mark[neighbour] = id;
+                candidates.push_back(neighbour);
+            }
+        }
+    };
+
+    auto flush = [&]
+    {
+        auto & m = result.emplace_back();
+        m.first_index = first_triangle * 3;
+        m.index_count = (order.size() - first_triangle) * 3;
+        m.vertex_count = vertices.size();
+        compute_bounds(m, vertices, std::span(order).subspan(first_triangle), indices, position);
+
+        first_triangle = order.size();
+        vertices.clear();
+        candidates.clear();
+        vertex_sum = glm::vec3(0.f);
+    };
+
+    while (order.size() < triangle_count)
+    {
+        std::uint32_t best = none;
+        std::size_t best_new = 4;
+        float best_distance = std::numeric_limits<float>::infinity();
+
+        if (!vertices.empty())
+        {
+            auto const center = vertex_sum / float(vertices.size());
+
+            std::size_t kept = 0;
+            for (auto t : candidates)
+            {
+                if (emitted[t])
+                    continue;
+                candidates[kept++] = t;
+
+                auto const added = new_vertices(t);
+                if (vertices.size() + added > max_meshlet_vertices || added > best_new)
+                    continue;
+
+                auto const offset = centroid(t) - center;
+                float const distance = glm::dot(offset, offset);
+                if (added < best_new || distance < best_distance)
+                {
+                    best = t;
+                    best_new = added;
+                    best_distance = distance;
+                }
+            }
+            candidates.resize(kept);
+
+            // Nothing connected fits: take the next triangle in spatial order
+            // if it is close to the meshlet, or start a new one
+            if (best == none)
+            {
+                while (emitted[seeds[next_seed]])
+                    ++next_seed;
+
+                float spread = 0.f;
+                for (auto v : vertices)
+                    spread = std::max(spread, glm::distance(center, position(v)));
+
+                auto const seed = seeds[next_seed];
+                if (candidates.empty() && vertices.size() + new_vertices(seed) <= max_meshlet_vertices
+                    && glm::distance(centroid(seed), center) <= 2.f * spread)
+                {
+                    best = seed;
+                }
+                else
+                {
+                    flush();
+                    continue;
+                }
+            }
+        }
+        else
+        {
+            while (emitted[seeds[next_seed]])
+                ++next_seed;
+            best = seeds[next_seed];
+        }
+
+        add_triangle(best);
+        if (order.size() - first_triangle == max_meshlet_triangles)
+            flush();
+    }
+
+    if (!vertices.empty())
+        flush();
+
+    std::vector<std::uint32_t> reordered(triangle_count * 3);
+    for (std::size_t i = 0; i < triangle_count; ++i)
+        std::copy_n(indices.begin() + 3 * order[i], 3, reordered.begin() + 3 * i);
+    std::copy(reordered.begin(), reordered.end(), indices.begin());
+
+    return result;
+}
+
+obj_meshlets build_meshlets(obj_data & data)
+{
+    obj_meshlets result;
+    result.submesh_meshlets.push_back(0);
+
+    float const * positions = data.vertices.empty() ? nullptr : data.vertices.front().position.data();
+    for (auto const & submesh : data.submeshes)
+    {
+        auto meshlets = build_meshlets(std::span(data.indices).subspan(submesh.first_index, submesh.index_count),
+            positions, data.vertices.size(), sizeof(obj_data::vertex));
+
+        for (auto & m : meshlets)
+            m.first_index += submesh.first_index;
+
+        result.meshlets.insert(result.meshlets.end(), meshlets.begin(), meshlets.end());
+        result.submesh_meshlets.push_back(result.meshlets.size());
+    }
+
+    return result;
+}
+
+meshlet_culler::meshlet_culler(glm::mat4 const & view_projection, glm::vec3 const & camera_position)
+    : m_camera_position(camera_position)
+{
+    auto row = [&](int i) { return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+
+    // Gribb and Hartmann: -w <= x, y, z <= w
+    for (int i = 0; i < 3; ++i)
+    {
+        m_planes[2 * i] = row(3) + row(i);
+        m_planes[2 * i + 1] = row(3) - row(i);
+    }
+
+    for (auto & plane : m_planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool meshlet_culler::outside_frustum(meshlet const & m) const
+{
+    for (auto const & plane : m_planes)
+        if (glm::dot(glm::vec3(plane), m.center) + plane.w < -m.radius)
+            return true;
+    return false;
+}
+
+bool meshlet_culler::back_facing(meshlet const & m) const
+{
+    if (m.cone_cos <= 0.f)
+        return false;
+
+    // Every triangle faces away if dot(n, p - camera) >= 0 for all normals n
+    // in the cone and points p in the sphere. With d = center - camera at an
+    // angle a to the axis and the cone half-angle b, the smallest dot(n, d)
+    // is |d| cos(a + b), and p adds at most radius to it.
+    auto const d = m.center - m_camera_position;
+    float const along = glm::dot(d, m.cone_axis);
+    float const across = glm::length(glm::cross(d, m.cone_axis));
+    return along * m.cone_cos - across * m.cone_sin >= m.radius;
+}
+
+void cull_meshlets(meshlet_culler const & culler, std::span<meshlet const> meshlets, std::vector<index_range> & ranges,
+    meshlet_cull_stats & stats)
+{
+    for (auto const & m : meshlets)
+    {
+        std::size_t const triangles = m.index_count / 3;
+        ++stats.meshlets;
+        stats.triangles += triangles;
+
+        if (culler.outside_frustum(m))
+        {
+            stats.frustum_culled_triangles += triangles;
+            continue;
+        }
+        if (culler.back_facing(m))
+        {
+            stats.back_facing_triangles += triangles;
+            continue;
+        }
+
+        ++stats.visible_meshlets;
+        if (!ranges.empty() && ranges.back().first_index + ranges.back().index_count == m.first_index)
+            ranges.back().index_count += m.index_count;
+        else
+            ranges.push_back({m.first_index, m.index_count});
+    }
+}
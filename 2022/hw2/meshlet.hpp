@@ -0,0 +1,95 @@
+#pragma once
+
+#include "obj_parser.hpp"
+
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// Clusters of neighbouring triangles that are culled as a whole: against the
+// view frustum with their bounding sphere, and as back-facing with a cone
+// around their triangle normals. Meshlets keep using the mesh's vertex and
+// index buffers; building them only reorders the triangles so that every
+// meshlet is a contiguous index range.
+
+constexpr std::size_t max_meshlet_vertices = 64;
+constexpr std::size_t max_meshlet_triangles = 124;
+
+struct meshlet
+{
+    std::uint32_t first_index;
+    std::uint32_t index_count;
+    std::uint32_t vertex_count;
+
+    glm::vec3 center;
+    float radius;
+
+    // Every triangle normal is within the cone angle of cone_axis; the cone
+    // is not used for culling if it is 90 degrees or wider (cone_cos <= 0)
+    glm::vec3 cone_axis;
+    float cone_cos;
+    float cone_sin;
+};
+
+// Splits a triangle list into meshlets, growing each one over the triangles
+// sharing vertices with it and preferring those that add fewer new vertices,
+// then those closer to its center. The triangles are reordered in place;
+// first_index counts from the start of indices.
+std::vector<meshlet> build_meshlets(std::span<std::uint32_t> indices, float const * positions, std::size_t vertex_count,
+    std::size_t stride);
+
+// Meshlets of every submesh, in submesh order; first_index counts from the
+// start of data.indices. Submesh i has the meshlets
+// [submesh_meshlets[i], submesh_meshlets[i + 1]).
+struct obj_meshlets
+{
+    std::vector<meshlet> meshlets;
+    std::vector<std::uint32_t> submesh_meshlets;
+};
+
+obj_meshlets build_meshlets(obj_data & data);
+
+class meshlet_culler
+{
+public:
+    meshlet_culler(glm::mat4 const & view_projection, glm::vec3 const & camera_position);
+
+    bool outside_frustum(meshlet const & m) const;
+    bool back_facing(meshlet const & m) const;
+
+private:
+    // Normalized, pointing inside
+    std::array<glm::vec4, 6> m_planes;
+    glm::vec3 m_camera_position;
+};
+
+struct meshlet_cull_stats
+{
+    std::size_t meshlets = 0;
+    std::size_t visible_meshlets = 0;
+    std::size_t triangles = 0;
+    std::size_t frustum_culled_triangles = 0;
+    std::size_t back_facing_triangles = 0;
+
+    float culled_fraction() const
+    {
+        return triangles ? float(frustum_culled_triangles + back_facing_triangles) / triangles : 0.f;
+    }
+};
+
+struct index_range
+{
+    std::uint32_t first_index;
+    std::uint32_t index_count;
+};
+
+// Appends the index ranges of the visible meshlets, merging ranges that
+// follow each other, and adds to the stats
+void cull_meshlets(meshlet_culler const & culler, std::span<meshlet const> meshlets, std::vector<index_range> & ranges,
+    meshlet_cull_stats & stats);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "obj_parser.hpp"
+
+#include <optional>
+#include <string_view>
+
+// Binary sidecar (<file>.cache) holding the deduplicated vertices and indices
+// that parse_obj produced for an OBJ file, with its submeshes and the names
+// of its materials and material libraries. Material properties are not
+// cached: the MTL files are small and are read again on every load.
+//
+// Layout: obj_cache_header, vertex_count obj_data::vertex records, index_count
+// std::uint32_t indices, metadata_size bytes of metadata, all in the writer's
+// native byte order. The metadata is submesh_count (material, first_index,
+// index_count) std::uint32_t triples followed by the library paths, the
+// material names and the submesh names, each as a std::uint32_t length and
+// the characters. A cache is used only if the magic, version, byte order,
+// vertex layout and parse flags match, the payload checksum is intact, and
+// the source still has the recorded size and either the recorded mtime or
+// the recorded content hash.
+struct obj_cache_header
+{
+    static constexpr char magic_value[8] = {'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+    static constexpr std::uint32_t version_value = 2;
+    static constexpr std::uint32_t byte_order_value = 0x01020304;
+
+    // Options that change the parse result
+    static constexpr std::uint32_t sorted_by_material_flag = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t vertex_size;
+    std::uint32_t flags;
+    std::uint64_t source_size;
+    std::int64_t source_mtime;
+    std::uint64_t source_hash;
+    std::uint64_t vertex_count;
+    std::uint64_t index_count;
+    std::uint64_t submesh_count;
+    std::uint64_t material_count;
+    std::uint64_t library_count;
+    std::uint64_t metadata_size;
+    std::uint64_t payload_hash;
+};
+
+std::filesystem::path obj_cache_path(std::filesystem::path const & source);
+
+// Returns nothing if the cache is missing, stale or damaged
+std::optional<obj_data> load_obj_cache(std::filesystem::path const & source, std::string_view source_data,
+    obj_parse_options const & options);
+
+// Best effort: a cache that cannot be written is simply not written
+void store_obj_cache(std::filesystem::path const & source, std::string_view source_data,
+    obj_parse_options const & options, obj_data const & data);
@@ -1,10 +1,19 @@
 #include "obj_parser.hpp"
+#include "mapped_file.hpp"
+#include "obj_cache.hpp"
+#include "vertex_index_map.hpp"
 
 #include <string>
+#include <string_view>
 #include <sstream>
-#include <fstream>
 #include <stdexcept>
-#include <map>
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <optional>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
 
 namespace
 {
@@ -17,161 +26,371 @@ namespace
         return os.str();
     }
 
-}
+    // Thrown by the tokenizer with a line number relative to the scanned
+    // range; parse_obj turns it into the user-facing std::runtime_error
+    struct parse_error
+    {
+        std::size_t line;
+        std::string message;
+    };
 
-obj_data parse_obj(std::filesystem::path const & path)
-{
-    std::ifstream is(path);
+    bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Cursor over a single line of the mapped file; mirrors the subset of
+    // std::istream extraction semantics that the OBJ grammar needs
+    struct line_reader
+    {
+        char const * ptr;
+        char const * end;
 
-    std::vector<std::array<float, 3>> positions;
-    std::vector<std::array<float, 3>> normals;
-    std::vector<std::array<float, 2>> texcoords;
+        bool at_end() const { return ptr == end; }
 
-    std::map<std::array<std::int32_t, 3>, std::uint32_t> index_map;
+        char peek() const { return ptr == end ? '\0' : *ptr; }
 
-    obj_data result;
+        char get() { return ptr == end ? '\0' : *ptr++; }
+
+        void skip_space()
+        {
+            while (ptr != end && is_space(*ptr))
+                ++ptr;
+        }
+
+        std::string_view token()
+        {
+            skip_space();
+            char const * begin = ptr;
+            while (ptr != end && !is_space(*ptr))
+                ++ptr;
+            return {begin, static_cast<std::size_t>(ptr - begin)};
+        }
+
+        // Remainder of the line without surrounding whitespace; names in
+        // 'usemtl', 'newmtl', 'g' and 'o' records may contain spaces
+        std::string_view rest()
+        {
+            skip_space();
+            char const * last = end;
+            while (last != ptr && is_space(last[-1]))
+                --last;
+            std::string_view result{ptr, static_cast<std::size_t>(last - ptr)};
+            ptr = end;
+            return result;
+        }
 
-    std::string line;
-    std::size_t line_count = 0;
+        template <typename T>
+        bool read(T & value)
+        {
+            skip_space();
+            char const * begin = ptr;
+            if (begin != end && *begin == '+')
+                ++begin;
+            auto [next, error] = std::from_chars(begin, end, value);
+            if (error != std::errc{})
+                return false;
+            ptr = next;
+            return true;
+        }
+    };
 
-    auto fail = [&](auto const & ... args){
-        throw std::runtime_error(to_string("Error parsing OBJ data, line ", line_count, ": ", args...));
+    // Face corner exactly as written in the file (1-based or negative)
+    struct raw_corner
+    {
+        std::array<std::int32_t, 3> index{0, 0, 0};
+        bool has_texcoord = false;
+        bool has_normal = false;
     };
 
-    while (std::getline(is >> std::ws, line))
+    // Reads the next corner of an 'f' record; returns false at end of line
+    bool read_corner(line_reader & ls, raw_corner & c, std::size_t line)
+    {
+        ls.skip_space();
+        if (ls.at_end()) return false;
+
+        c = raw_corner{};
+
+        auto fail = [&](char const * message){
+            throw parse_error{line, message};
+        };
+
+        if (!ls.read(c.index[0]))
+            fail("expected position index");
+
+        if (!ls.at_end() && !is_space(ls.peek()))
+        {
+            if (ls.get() != '/')
+                fail("expected '/'");
+
+            if (ls.peek() != '/')
+            {
+                if (!ls.read(c.index[1]))
+                    fail("expected texcoord index");
+                c.has_texcoord = true;
+
+                if (!ls.at_end() && !is_space(ls.peek()))
+                {
+                    if (ls.get() != '/')
+                        fail("expected '/'");
+
+                    if (!ls.read(c.index[2]))
+                        fail("expected normal index");
+                    c.has_normal = true;
+                }
+            }
+            else
+            {
+                ls.get();
+
+                if (!ls.read(c.index[2]))
+                    fail("expected normal index");
+                c.has_normal = true;
+            }
+        }
+
+        return true;
+    }
+
+    // Calls the handler for every record in [begin, end); returns the number of lines
+    template <typename Handler>
+    std::size_t scan_lines(char const * begin, char const * end, Handler & handler)
+    {
+        std::size_t line_count = 0;
+
+        char const * ptr = begin;
+        while (ptr != end)
+        {
+            ++line_count;
+
+            auto eol = static_cast<char const *>(std::memchr(ptr, '\n', end - ptr));
+            if (!eol) eol = end;
+
+            line_reader ls{ptr, eol};
+            ptr = (eol == end) ? end : eol + 1;
+
+            ls.skip_space();
+
+            if (ls.at_end()) continue;
+
+            if (ls.peek() == '#') continue;
+
+            auto tag = ls.token();
+
+            if (tag == "v")
+            {
+                std::array<float, 3> p{0.f, 0.f, 0.f};
+                ls.read(p[0]) && ls.read(p[1]) && ls.read(p[2]);
+                handler.position(p);
+            }
+            else if (tag == "vn")
+            {
+                std::array<float, 3> n{0.f, 0.f, 0.f};
+                ls.read(n[0]) && ls.read(n[1]) && ls.read(n[2]);
+                handler.normal(n);
+            }
+            else if (tag == "vt")
+            {
+                std::array<float, 2> t{0.f, 0.f};
+                ls.read(t[0]) && ls.read(t[1]);
+                handler.texcoord(t);
+            }
+            else if (tag == "f")
+            {
+                handler.face(ls, line_count);
+            }
+            else if (tag == "usemtl")
+            {
+                handler.material(ls.rest());
+            }
+            else if (tag == "g" || tag == "o")
+            {
+                handler.group(ls.rest());
+            }
+            else if (tag == "mtllib")
+            {
+                for (auto name = ls.token(); !name.empty(); name = ls.token())
+                    handler.library(name);
+            }
+        }
+
+        return line_count;
+    }
+
+    // Attribute storage and vertex deduplication shared by the serial and the
+    // parallel paths; corners must be added in file order
+    struct mesh_builder
     {
-        ++line_count;
+        std::vector<std::array<float, 3>> positions;
+        std::vector<std::array<float, 3>> normals;
+        std::vector<std::array<float, 2>> texcoords;
 
-        if (line.empty()) continue;
+        vertex_index_map index_map;
 
-        if (line[0] == '#') continue;
+        obj_data result;
 
-        std::istringstream ls(std::move(line));
+        std::vector<std::uint32_t> vertices;
 
-        std::string tag;
-        ls >> tag;
+        // Material and group state; a new submesh starts at the first face
+        // after either of them changes
+        std::unordered_map<std::string, std::uint32_t> material_ids;
+        std::optional<std::uint32_t> current_material;
+        std::string current_name;
+        bool state_changed = true;
 
-        if (tag == "v")
+        void use_material(std::string_view name)
         {
-            auto & p = positions.emplace_back();
-            ls >> p[0] >> p[1] >> p[2];
+            auto [it, inserted] = material_ids.try_emplace(std::string(name), result.materials.size());
+            if (inserted)
+                result.materials.emplace_back().name = name;
+            current_material = it->second;
+            state_changed = true;
         }
-        else if (tag == "vn")
+
+        void set_name(std::string_view name)
         {
-            auto & n = normals.emplace_back();
-            ls >> n[0] >> n[1] >> n[2];
+            current_name = name;
+            state_changed = true;
         }
-        else if (tag == "vt")
+
+        void add_library(std::string_view path)
         {
-            auto & t = texcoords.emplace_back();
-            ls >> t[0] >> t[1];
+            auto & libraries = result.material_libraries;
+            if (std::find(libraries.begin(), libraries.end(), path) == libraries.end())
+                libraries.emplace_back(path);
         }
-        else if (tag == "f")
+
+        void begin_face()
         {
-            std::vector<std::uint32_t> vertices;
+            if (!state_changed)
+                return;
+
+            if (!current_material)
+                use_material({});
+
+            auto & submeshes = result.submeshes;
+            if (submeshes.empty() || submeshes.back().first_index != result.indices.size())
+                submeshes.emplace_back();
+
+            auto & s = submeshes.back();
+            s.name = current_name;
+            s.material = *current_material;
+            s.first_index = result.indices.size();
+            s.index_count = 0;
+
+            state_changed = false;
+        }
 
-            while (ls)
+        // Computes the submesh sizes, dropping empty ones and joining
+        // neighbours that ended up with the same material and name
+        void finish()
+        {
+            auto & submeshes = result.submeshes;
+            for (std::size_t i = 0; i < submeshes.size(); ++i)
             {
-                std::array<std::int32_t, 3> index{0, 0, 0};
-                bool has_texcoord = false;
-                bool has_normal = false;
+                std::size_t const end = (i + 1 < submeshes.size()) ? submeshes[i + 1].first_index : result.indices.size();
+                submeshes[i].index_count = end - submeshes[i].first_index;
+            }
 
-                ls >> index[0];
-                if (ls.eof()) break;
-                if (!ls)
-                    fail("expected position index");
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < submeshes.size(); ++i)
+            {
+                auto & s = submeshes[i];
+                if (s.index_count == 0)
+                    continue;
 
-                if (!std::isspace(ls.peek()) && !ls.eof())
+                if (count > 0)
                 {
-                    if (ls.get() != '/')
-                        fail("expected '/'");
-
-                    if (ls.peek() != '/')
-                    {
-                        ls >> index[1];
-                        if (!ls)
-                            fail("expected texcoord index");
-                        has_texcoord = true;
-
-                        if (!std::isspace(ls.peek()) && !ls.eof())
-                        {
-                            if (ls.get() != '/')
-                                fail("expected '/'");
-
-                            ls >> index[2];
-                            if (!ls)
-                                fail("expected normal index");
-                            has_normal = true;
-                        }
-                    }
-                    else
+                    auto & last = submeshes[count - 1];
+                    if (last.material == s.material && last.name == s.name)
                     {
-                        ls.get();
-
-                        ls >> index[2];
-                        if (!ls)
-                            fail("expected normal index");
-                        has_normal = true;
+                        last.index_count += s.index_count;
+                        continue;
                     }
                 }
 
-                if (index[0] > 0)
-                    --index[0];
-                else
-                    index[0] = positions.size() + index[0];
+                if (count != i)
+                    submeshes[count] = std::move(s);
+                ++count;
+            }
+            submeshes.resize(count);
+        }
 
-                if (has_texcoord)
-                {
-                    if (index[1] > 0)
-                        --index[1];
-                    else
-                        index[1] = texcoords.size() + index[1];
-                }
-                else
-                    index[1] = -1;
+        // Attribute counts are the ones visible at the face's line
+        std::uint32_t add_corner(raw_corner const & c, std::size_t position_count, std::size_t texcoord_count,
+            std::size_t normal_count, std::size_t line)
+        {
+            std::array<std::int32_t, 3> index = c.index;
 
-                if (has_normal)
-                {
-                    if (index[2] > 0)
-                        --index[2];
-                    else
-                        index[2] = normals.size() + index[2];
-                }
+            if (index[0] > 0)
+                --index[0];
+            else
+                index[0] = position_count + index[0];
+
+            if (c.has_texcoord)
+            {
+                if (index[1] > 0)
+                    --index[1];
                 else
-                    index[2] = -1;
+                    index[1] = texcoord_count + index[1];
+            }
+            else
+                index[1] = -1;
 
-                if (index[0] >= positions.size())
-                    fail("bad position index (", index[0], ")");
+            if (c.has_normal)
+            {
+                if (index[2] > 0)
+                    --index[2];
+                else
+                    index[2] = normal_count + index[2];
+            }
+            else
+                index[2] = -1;
 
-                if (index[1] != -1 && index[1] >= texcoords.size())
-                    fail("bad texcoord index (", index[1], ")");
+            auto fail = [&](auto const & ... args){
+                throw parse_error{line, to_string(args...)};
+            };
 
-                if (index[2] != -1 && index[2] >= normals.size())
-                    fail("bad normal index (", index[2], ")");
+            if (index[0] < 0 || std::size_t(index[0]) >= position_count)
+                fail("bad position index (", index[0], ")");
 
-                auto it = index_map.find(index);
-                if (it == index_map.end())
-                {
-                    it = index_map.insert({index, result.vertices.size()}).first;
+            if (index[1] != -1 && (index[1] < 0 || std::size_t(index[1]) >= texcoord_count))
+                fail("bad texcoord index (", index[1], ")");
 
-                    auto & v = result.vertices.emplace_back();
+            if (index[2] != -1 && (index[2] < 0 || std::size_t(index[2]) >= normal_count))
+                fail("bad normal index (", index[2], ")");
 
-                    v.position = positions[index[0]];
+            auto [vertex_index, inserted] = index_map.insert(index, result.vertices.size());
+            if (inserted)
+            {
+                auto & v = result.vertices.emplace_back();
 
-                    if (index[1] != -1)
-                        v.texcoord = texcoords[index[1]];
-                    else
-                        v.texcoord = {0.f, 0.f};
+                v.position = positions[index[0]];
 
-                    if (index[2] != -1)
-                        v.normal = normals[index[2]];
-                    else
-                        v.normal = {0.f, 0.f, 0.f};
-                }
+                if (index[1] != -1)
+                    v.texcoord = texcoords[index[1]];
+                else
+                    v.texcoord = {0.f, 0.f};
 
-                vertices.push_back(it->second);
+                if (index[2] != -1)
+                    v.normal = normals[index[2]];
+                else
+                    v.normal = {0.f, 0.f, 0.f};
             }
 
+            return vertex_index;
+        }
+
+        // Unique vertices are usually close to the largest attribute count
+        void reserve(std::size_t position_count, std::size_t texcoord_count, std::size_t normal_count)
+        {
+            std::size_t const estimate = std::max({position_count, texcoord_count, normal_count});
+            index_map.reserve(estimate);
+            result.vertices.reserve(estimate);
+        }
+
+        void triangulate()
+        {
             for (std::size_t i = 1; i + 1 < vertices.size(); ++i)
             {
                 result.indices.push_back(vertices[0]);
@@ -179,7 +398,512 @@ obj_data parse_obj(std::filesystem::path const & path)
                 result.indices.push_back(vertices[i + 1]);
             }
         }
+    };
+
+    struct serial_handler
+    {
+        mesh_builder & builder;
+
+        void position(std::array<float, 3> const & p) { builder.positions.push_back(p); }
+        void normal(std::array<float, 3> const & n) { builder.normals.push_back(n); }
+        void texcoord(std::array<float, 2> const & t) { builder.texcoords.push_back(t); }
+        void material(std::string_view name) { builder.use_material(name); }
+        void group(std::string_view name) { builder.set_name(name); }
+        void library(std::string_view path) { builder.add_library(path); }
+
+        void face(line_reader & ls, std::size_t line)
+        {
+            // Exporters write the attributes before the faces that use them, so
+            // the attribute counts at the first face are a good size estimate
+            if (builder.result.vertices.empty())
+                builder.reserve(builder.positions.size(), builder.texcoords.size(), builder.normals.size());
+
+            builder.begin_face();
+            builder.vertices.clear();
+            for (raw_corner c; read_corner(ls, c, line);)
+                builder.vertices.push_back(builder.add_corner(c, builder.positions.size(),
+                    builder.texcoords.size(), builder.normals.size(), line));
+            builder.triangulate();
+        }
+    };
+
+    // Hands the builder's output out in chunks of bounded size; indices are
+    // rebased to global vertex numbers before the callback sees them
+    struct stream_handler
+    {
+        mesh_builder & builder;
+        std::function<void(obj_chunk const &)> const & callback;
+
+        std::size_t vertex_limit;
+        std::size_t index_limit;
+        std::size_t attribute_limit;
+        std::size_t attribute_bytes = 0;
+
+        // Line numbers passed by scan_lines are relative to the current window
+        std::size_t line_offset = 0;
+
+        obj_stream_stats stats = {};
+
+        // Flushing happens between faces, so leave room for a large one
+        static constexpr std::size_t face_slack = 64;
+
+        void position(std::array<float, 3> const & p) { add_attribute(sizeof(p)); builder.positions.push_back(p); }
+        void normal(std::array<float, 3> const & n) { add_attribute(sizeof(n)); builder.normals.push_back(n); }
+        void texcoord(std::array<float, 2> const & t) { add_attribute(sizeof(t)); builder.texcoords.push_back(t); }
+        void material(std::string_view) {}
+        void group(std::string_view) {}
+        void library(std::string_view) {}
+
+        void face(line_reader & ls, std::size_t line)
+        {
+            line += line_offset;
+
+            builder.vertices.clear();
+            for (raw_corner c; read_corner(ls, c, line);)
+                builder.vertices.push_back(builder.add_corner(c, builder.positions.size(),
+                    builder.texcoords.size(), builder.normals.size(), line));
+            builder.triangulate();
+
+            if (builder.result.vertices.size() + face_slack > vertex_limit
+                || builder.result.indices.size() + 3 * face_slack > index_limit)
+                flush();
+        }
+
+        void add_attribute(std::size_t size)
+        {
+            attribute_bytes += size;
+            if (attribute_bytes > attribute_limit)
+                throw std::runtime_error(to_string("OBJ attributes take more than ", attribute_limit >> 20,
+                    " MB, the attribute limit of parse_obj_stream"));
+        }
+
+        void flush()
+        {
+            auto & vertices = builder.result.vertices;
+            auto & indices = builder.result.indices;
+
+            if (vertices.empty() && indices.empty())
+                return;
+
+            if (stats.vertex_count + vertices.size() > std::numeric_limits<std::uint32_t>::max())
+                throw std::runtime_error("OBJ data has too many vertices for 32-bit indices");
+
+            for (auto & i : indices)
+                i += stats.vertex_count;
+
+            callback({stats.vertex_count, stats.index_count, vertices, indices});
+
+            stats.vertex_count += vertices.size();
+            stats.index_count += indices.size();
+            ++stats.chunk_count;
+
+            vertices.clear();
+            indices.clear();
+            builder.index_map.clear();
+        }
+    };
+
+    // A line-aligned part of the file tokenized by one thread. Faces keep the
+    // raw indices and the local attribute counts so that relative indices and
+    // deduplication can be resolved in file order afterwards.
+    struct chunk
+    {
+        struct face_record
+        {
+            std::size_t line;
+            std::uint32_t first_corner;
+            std::uint32_t corner_count;
+            std::uint32_t position_count;
+            std::uint32_t texcoord_count;
+            std::uint32_t normal_count;
+        };
+
+        // 'usemtl', 'g'/'o' or 'mtllib' record seen before faces[face]
+        struct state_record
+        {
+            enum kind_type { material, group, library };
+
+            std::size_t face;
+            kind_type kind;
+            std::string value;
+        };
+
+        char const * begin;
+        char const * end;
+
+        std::vector<std::array<float, 3>> positions;
+        std::vector<std::array<float, 3>> normals;
+        std::vector<std::array<float, 2>> texcoords;
+
+        std::vector<raw_corner> corners;
+        std::vector<face_record> faces;
+        std::vector<state_record> states;
+
+        std::size_t line_count = 0;
+
+        // Tokenizer error; faces before it (and the corners of the failing
+        // face read so far) are kept so index errors are reported first
+        std::optional<parse_error> error;
+
+        void position(std::array<float, 3> const & p) { positions.push_back(p); }
+        void normal(std::array<float, 3> const & n) { normals.push_back(n); }
+        void texcoord(std::array<float, 2> const & t) { texcoords.push_back(t); }
+        void material(std::string_view name) { states.push_back({faces.size(), state_record::material, std::string(name)}); }
+        void group(std::string_view name) { states.push_back({faces.size(), state_record::group, std::string(name)}); }
+        void library(std::string_view path) { states.push_back({faces.size(), state_record::library, std::string(path)}); }
+
+        void face(line_reader & ls, std::size_t line)
+        {
+            auto & f = faces.emplace_back();
+            f.line = line;
+            f.first_corner = corners.size();
+            f.corner_count = 0;
+            f.position_count = positions.size();
+            f.texcoord_count = texcoords.size();
+            f.normal_count = normals.size();
+
+            for (raw_corner c; read_corner(ls, c, line);)
+            {
+                corners.push_back(c);
+                ++f.corner_count;
+            }
+        }
+
+        void parse()
+        {
+            try
+            {
+                line_count = scan_lines(begin, end, *this);
+            }
+            catch (parse_error & e)
+            {
+                error = std::move(e);
+            }
+        }
+    };
+
+    // Start of the first line beginning at or after ptr
+    char const * next_line(char const * ptr, char const * end)
+    {
+        if (ptr == end)
+            return end;
+        auto eol = static_cast<char const *>(std::memchr(ptr, '\n', end - ptr));
+        return eol ? eol + 1 : end;
     }
 
+    std::vector<chunk> split(char const * begin, char const * end, std::size_t count)
+    {
+        std::vector<chunk> chunks;
+
+        std::size_t const size = end - begin;
+        char const * ptr = begin;
+        for (std::size_t i = 1; i <= count && ptr != end; ++i)
+        {
+            char const * next = (i == count) ? end : begin + size * i / count;
+            if (next < ptr) next = ptr;
+            next = next_line(next, end);
+
+            auto & c = chunks.emplace_back();
+            c.begin = ptr;
+            c.end = next;
+            ptr = next;
+        }
+
+        return chunks;
+    }
+
+    // Below this size per thread the merge step costs more than it saves
+    constexpr std::size_t min_chunk_size = 1 << 20;
+
+    // Text processed by parse_obj_stream between releasing mapped pages
+    constexpr std::size_t stream_window_size = 16 << 20;
+
+    obj_data parse_parallel(char const * begin, char const * end, std::size_t thread_count)
+    {
+        auto chunks = split(begin, end, thread_count);
+
+        {
+            std::vector<std::thread> threads;
+            for (std::size_t i = 1; i < chunks.size(); ++i)
+                threads.emplace_back([&chunk = chunks[i]]{ chunk.parse(); });
+            chunks[0].parse();
+            for (auto & t : threads)
+                t.join();
+        }
+
+        mesh_builder builder;
+
+        std::size_t position_count = 0, texcoord_count = 0, normal_count = 0, corner_count = 0;
+        for (auto const & c : chunks)
+        {
+            position_count += c.positions.size();
+            texcoord_count += c.texcoords.size();
+            normal_count += c.normals.size();
+            corner_count += c.corners.size();
+        }
+
+        builder.positions.reserve(position_count);
+        builder.texcoords.reserve(texcoord_count);
+        builder.normals.reserve(normal_count);
+        builder.result.indices.reserve(corner_count);
+        builder.reserve(position_count, texcoord_count, normal_count);
+
+        std::size_t line_offset = 0;
+        for (auto & c : chunks)
+        {
+            std::size_t const position_base = builder.positions.size();
+            std::size_t const texcoord_base = builder.texcoords.size();
+            std::size_t const normal_base = builder.normals.size();
+
+            builder.positions.insert(builder.positions.end(), c.positions.begin(), c.positions.end());
+            builder.texcoords.insert(builder.texcoords.end(), c.texcoords.begin(), c.texcoords.end());
+            builder.normals.insert(builder.normals.end(), c.normals.begin(), c.normals.end());
+
+            auto state = c.states.begin();
+            auto apply_states = [&](std::size_t face){
+                for (; state != c.states.end() && state->face <= face; ++state)
+                {
+                    switch (state->kind)
+                    {
+                    case chunk::state_record::material: builder.use_material(state->value); break;
+                    case chunk::state_record::group: builder.set_name(state->value); break;
+                    case chunk::state_record::library: builder.add_library(state->value); break;
+                    }
+                }
+            };
+
+            for (std::size_t face = 0; face < c.faces.size(); ++face)
+            {
+                auto const & f = c.faces[face];
+                apply_states(face);
+                builder.begin_face();
+                builder.vertices.clear();
+                for (std::uint32_t i = 0; i < f.corner_count; ++i)
+                    builder.vertices.push_back(builder.add_corner(c.corners[f.first_corner + i],
+                        position_base + f.position_count, texcoord_base + f.texcoord_count,
+                        normal_base + f.normal_count, line_offset + f.line));
+                builder.triangulate();
+            }
+
+            if (c.error)
+                throw parse_error{line_offset + c.error->line, std::move(c.error->message)};
+
+            apply_states(c.faces.size());
+
+            line_offset += c.line_count;
+
+            c = chunk{};
+        }
+
+        builder.finish();
+        return std::move(builder.result);
+    }
+
+    // Texture statements may carry options ("-bm 0.5 normal.png"); the file
+    // name is always the last argument
+    std::string texture_path(line_reader & ls)
+    {
+        auto path = ls.rest();
+        if (!path.empty() && path.front() == '-')
+            path = path.substr(path.find_last_of(" \t") + 1);
+        return std::string(path);
+    }
+
+    void read_color(line_reader & ls, std::array<float, 3> & color)
+    {
+        ls.read(color[0]) && ls.read(color[1]) && ls.read(color[2]);
+    }
+
+    // Fills in the materials used by the faces from the 'mtllib' files. As in
+    // other OBJ readers a missing library is not an error, its materials just
+    // keep the default values.
+    void load_materials(std::filesystem::path const & directory, obj_data & data)
+    {
+        std::unordered_map<std::string_view, obj_data::material *> by_name;
+        for (auto & m : data.materials)
+            by_name[m.name] = &m;
+
+        for (auto const & library : data.material_libraries)
+        {
+            auto const path = directory / library;
+
+            std::error_code ec;
+            if (!std::filesystem::is_regular_file(path, ec))
+                continue;
+
+            mapped_file file(path);
+
+            obj_data::material * current = nullptr;
+
+            char const * ptr = file.data();
+            char const * const end = ptr + file.size();
+            while (ptr != end)
+            {
+                auto eol = static_cast<char const *>(std::memchr(ptr, '\n', end - ptr));
+                if (!eol) eol = end;
+
+                line_reader ls{ptr, eol};
+                ptr = (eol == end) ? end : eol + 1;
+
+                ls.skip_space();
+
+                if (ls.at_end() || ls.peek() == '#') continue;
+
+                auto tag = ls.token();
+
+                if (tag == "newmtl")
+                {
+                    auto it = by_name.find(ls.rest());
+                    current = (it == by_name.end()) ? nullptr : it->second;
+                    continue;
+                }
+
+                if (!current) continue;
+
+                if (tag == "Ka")
+                    read_color(ls, current->ambient);
+                else if (tag == "Kd")
+                    read_color(ls, current->diffuse);
+                else if (tag == "Ks")
+                    read_color(ls, current->specular);
+                else if (tag == "Ns")
+                    ls.read(current->shininess);
+                else if (tag == "d")
+                    ls.read(current->dissolve);
+                else if (tag == "Tr")
+                {
+                    float transparency;
+                    if (ls.read(transparency))
+                        current->dissolve = 1.f - transparency;
+                }
+                else if (tag == "map_Ka")
+                    current->ambient_texture = texture_path(ls);
+                else if (tag == "map_Kd")
+                    current->diffuse_texture = texture_path(ls);
+                else if (tag == "map_Ks")
+                    current->specular_texture = texture_path(ls);
+                else if (tag == "map_d")
+                    current->alpha_texture = texture_path(ls);
+                else if (tag == "map_Bump" || tag == "map_bump" || tag == "bump" || tag == "norm")
+                    current->normal_texture = texture_path(ls);
+            }
+        }
+    }
+
+    // Counting sort of the submeshes by material; file order is kept within
+    // a material
+    void sort_by_material(obj_data & data)
+    {
+        std::vector<std::uint32_t> offsets(data.materials.size() + 1, 0);
+        for (auto const & s : data.submeshes)
+            offsets[s.material + 1] += s.index_count;
+        for (std::size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+
+        std::vector<std::uint32_t> indices(data.indices.size());
+        auto next = offsets;
+        for (auto const & s : data.submeshes)
+        {
+            auto const first = data.indices.begin() + s.first_index;
+            std::copy(first, first + s.index_count, indices.begin() + next[s.material]);
+            next[s.material] += s.index_count;
+        }
+
+        data.indices = std::move(indices);
+
+        data.submeshes.clear();
+        for (std::uint32_t m = 0; m < data.materials.size(); ++m)
+            if (offsets[m + 1] > offsets[m])
+                data.submeshes.push_back({data.materials[m].name, m, offsets[m], offsets[m + 1] - offsets[m]});
+    }
+
+}
+
+obj_data parse_obj(std::filesystem::path const & path, obj_parse_options const & options)
+{
+    mapped_file file(path);
+
+    char const * const begin = file.data();
+    char const * const end = begin + file.size();
+
+    std::size_t thread_count = options.threads;
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = std::min(thread_count, std::max<std::size_t>(1, file.size() / min_chunk_size));
+
+    if (options.use_cache)
+        if (auto cached = load_obj_cache(path, file.view(), options))
+        {
+            load_materials(path.parent_path(), *cached);
+            return std::move(*cached);
+        }
+
+    obj_data result;
+
+    try
+    {
+        if (thread_count > 1)
+            result = parse_parallel(begin, end, thread_count);
+        else
+        {
+            mesh_builder builder;
+            serial_handler handler{builder};
+            scan_lines(begin, end, handler);
+            builder.finish();
+            result = std::move(builder.result);
+        }
+    }
+    catch (parse_error const & e)
+    {
+        throw std::runtime_error(to_string("Error parsing OBJ data, line ", e.line, ": ", e.message));
+    }
+
+    if (options.sort_by_material)
+        sort_by_material(result);
+
+    if (options.use_cache)
+        store_obj_cache(path, file.view(), options, result);
+
+    load_materials(path.parent_path(), result);
+
     return result;
 }
+
+obj_stream_stats parse_obj_stream(std::filesystem::path const & path,
+    std::function<void(obj_chunk const &)> const & callback, obj_stream_options const & options)
+{
+    mapped_file file(path);
+
+    // Vertices take ~96 bytes each with their table slots, indices get a quarter
+    std::size_t const vertex_limit = std::max<std::size_t>(options.memory_limit / 160, 1024);
+    std::size_t const index_limit = std::max<std::size_t>(options.memory_limit / 16, 3 * 1024);
+
+    // Reserved pages only become resident once written; the table grows on demand
+    mesh_builder builder;
+    builder.result.vertices.reserve(vertex_limit);
+    builder.result.indices.reserve(index_limit);
+
+    stream_handler handler{builder, callback, vertex_limit, index_limit, options.attribute_limit};
+
+    char const * const begin = file.data();
+    char const * const end = begin + file.size();
+
+    try
+    {
+        for (char const * ptr = begin; ptr != end;)
+        {
+            char const * next = next_line(ptr + std::min<std::size_t>(stream_window_size, end - ptr), end);
+            handler.line_offset += scan_lines(ptr, next, handler);
+            file.discard(ptr - begin, next - ptr);
+            ptr = next;
+        }
+
+        handler.flush();
+    }
+    catch (parse_error const & e)
+    {
+        throw std::runtime_error(to_string("Error parsing OBJ data, line ", e.line, ": ", e.message));
+    }
+
+    return handler.stats;
+}
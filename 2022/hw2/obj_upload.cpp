@@ -0,0 +1,82 @@
+#include "obj_upload.hpp"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+    // A GL buffer holding the first size bytes of its capacity
+    struct growing_buffer
+    {
+        GLuint name = 0;
+        std::size_t size = 0;
+        std::size_t capacity = 0;
+
+        void append(void const * data, std::size_t bytes)
+        {
+            if (size + bytes > capacity)
+                grow(std::max(size + bytes, 2 * capacity));
+
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, size, bytes, data);
+            size += bytes;
+        }
+
+        void grow(std::size_t new_capacity)
+        {
+            GLuint new_name;
+            glGenBuffers(1, &new_name);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, new_name);
+            glBufferData(GL_COPY_WRITE_BUFFER, new_capacity, nullptr, GL_STATIC_DRAW);
+
+            if (size > 0)
+            {
+                glBindBuffer(GL_COPY_READ_BUFFER, name);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+            }
+            if (name != 0)
+                glDeleteBuffers(1, &name);
+
+            name = new_name;
+            capacity = new_capacity;
+        }
+    };
+
+}
+
+uploaded_obj upload_obj_stream(std::filesystem::path const & path, obj_stream_options const & options)
+{
+    growing_buffer vertices, indices;
+    glm::vec3 min(std::numeric_limits<float>::infinity());
+    glm::vec3 max(-std::numeric_limits<float>::infinity());
+
+    auto stats = parse_obj_stream(path, [&](obj_chunk const & chunk){
+        vertices.append(chunk.vertices.data(), chunk.vertices.size() * sizeof(obj_data::vertex));
+        indices.append(chunk.indices.data(), chunk.indices.size() * sizeof(std::uint32_t));
+
+        for (auto const & v : chunk.vertices)
+        {
+            glm::vec3 const p(v.position[0], v.position[1], v.position[2]);
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+    }, options);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    uploaded_obj result;
+    result.vertex_buffer = vertices.name;
+    result.index_buffer = indices.name;
+    result.vertex_count = stats.vertex_count;
+    result.index_count = stats.index_count;
+    if (stats.vertex_count > 0)
+    {
+        result.min = min;
+        result.max = max;
+    }
+    return result;
+}
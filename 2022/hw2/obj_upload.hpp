@@ -0,0 +1,32 @@
+#pragma once
+
+#include "obj_parser.hpp"
+
+#include <GL/glew.h>
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <filesystem>
+
+// Geometry of an OBJ file uploaded to GL as parse_obj_stream produces it:
+// every chunk is copied into its sub-range of one vertex and one index
+// buffer with glBufferSubData and then dropped, so the mesh is never held in
+// memory as a whole. The final sizes are only known at the end, so the
+// buffers start small and double when a chunk does not fit, copying their
+// contents on the GPU.
+struct uploaded_obj
+{
+    GLuint vertex_buffer = 0;
+    GLuint index_buffer = 0;
+    std::size_t vertex_count = 0;
+    std::size_t index_count = 0;
+    // Bounds of the positions
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+};
+
+// The buffers hold obj_data::vertex records and 32-bit indices. Uses the
+// GL_COPY_READ_BUFFER and GL_COPY_WRITE_BUFFER bindings only, so the bound
+// vertex array and array buffer are left alone.
+uploaded_obj upload_obj_stream(std::filesystem::path const & path, obj_stream_options const & options = {});
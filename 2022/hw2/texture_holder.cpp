@@ -12,7 +12,12 @@ GLint texture_holder::load_texture(const std::string &path) {
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     int x, y, channels_in_file;
     auto pixels = stbi_load(path.c_str(), &x, &y, &channels_in_file, 4);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    // Missing textures (and materials without one) are plain white
+    const unsigned char white[4] = {255, 255, 255, 255};
+    if(pixels)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
     glGenerateMipmap(GL_TEXTURE_2D);
     stbi_image_free(pixels);
     return unit;
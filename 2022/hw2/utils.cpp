@@ -82,32 +82,7 @@ SDL_GLContext create_context(SDL_Window *window) {
     return gl_context;
 }
 
-std::vector<vertex> get_vertices(
-        const tinyobj::attrib_t &attrib,
-        const std::vector<tinyobj::shape_t> &shapes) {
-
-    std::vector<vertex> res;
-    for(auto &shape : shapes) {
-        for (auto &i: shape.mesh.indices) {
-            res.push_back({{
-                    attrib.vertices[3 * i.vertex_index],
-                    attrib.vertices[3 * i.vertex_index + 1],
-                    attrib.vertices[3 * i.vertex_index + 2]
-                }, {
-                    attrib.normals[3 * i.normal_index],
-                    attrib.normals[3 * i.normal_index + 1],
-                    attrib.normals[3 * i.normal_index + 2]
-                }, {
-                    attrib.texcoords[2 * i.texcoord_index],
-                    attrib.texcoords[2 * i.texcoord_index + 1]
-                }
-            });
-        }
-    }
-    return res;
-}
-
-bounding_box get_bounding_box(const std::vector<vertex> &scene) {
+bounding_box get_bounding_box(const std::vector<obj_data::vertex> &scene) {
     float x_bounds[2] = {std::numeric_limits<float>::infinity(),
                          -std::numeric_limits<float>::infinity()};
     float y_bounds[2] = {std::numeric_limits<float>::infinity(),
@@ -1,9 +1,6 @@
 #ifndef HW2_UTILS_HPP
 #define HW2_UTILS_HPP
 
-//#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
 #ifdef WIN32
 #include <SDL.h>
 #undef main
@@ -25,11 +22,7 @@
 #include <glm/ext/scalar_constants.hpp>
 #include <glm/gtx/string_cast.hpp>
 
-struct vertex {
-    std::array<float, 3> position;
-    std::array<float, 3> normal;
-    std::array<float, 2> texcoord;
-};
+#include "obj_parser.hpp"
 
 typedef std::array<glm::vec3, 8> bounding_box;
 
@@ -37,9 +30,6 @@ GLuint create_shader(GLenum type, const char *source);
 GLuint create_program(GLuint vertex_shader, GLuint fragment_shader);
 SDL_Window *create_window(const std::string &window_title);
 SDL_GLContext create_context(SDL_Window *window);
-std::vector<vertex> get_vertices(
-        const tinyobj::attrib_t &attrib,
-        const std::vector<tinyobj::shape_t> &shapes);
-bounding_box get_bounding_box(const std::vector<vertex> &scene);
+bounding_box get_bounding_box(const std::vector<obj_data::vertex> &scene);
 
 #endif //HW2_UTILS_HPP
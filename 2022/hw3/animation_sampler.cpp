@@ -0,0 +1,464 @@
+#include "animation_sampler.hpp"
+#include "simd_batch.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+
+    // Past this many keys since the previous sample, the cursor gives up
+    // stepping and searches the rest of the channel
+    constexpr std::uint32_t max_cursor_steps = 4;
+
+    // Key times of a compressed_clip are in units of duration / time_units
+    constexpr float time_units = 65535.f;
+
+    // Smallest three rotation components are stored as
+    // quantized * rotation_step - rotation_limit
+    constexpr float rotation_limit = 0.70710678f;
+    constexpr float rotation_step = 2.f * rotation_limit / 32767.f;
+
+    // The first key of a channel not before time, starting from the cursor's
+    // key unless restart is set. Time is in the units of the key times
+    template <typename Time>
+    std::uint32_t advance_cursor(Time const * first, Time const * last, std::uint32_t key, float time, bool restart)
+    {
+        if (restart)
+            return std::lower_bound(first, last, time) - first;
+
+        std::uint32_t const count = last - first;
+        for (std::uint32_t steps = 0; key < count && first[key] < time; ++key)
+        {
+            if (++steps == max_cursor_steps)
+                return std::lower_bound(first + key, last, time) - first;
+        }
+        return key;
+    }
+
+    // x, y, z, w of a packed smallest three rotation
+    std::array<float, 4> decode_rotation(std::uint16_t a, std::uint16_t b, std::uint16_t c)
+    {
+        int const largest = (a & 1) * 2 + (b & 1);
+        float const small[3] = {
+            (a >> 1) * rotation_step - rotation_limit,
+            (b >> 1) * rotation_step - rotation_limit,
+            c * rotation_step - rotation_limit,
+        };
+
+        std::array<float, 4> q;
+        for (int i = 0, j = 0; i < 4; ++i)
+            if (i != largest)
+                q[i] = small[j++];
+        q[largest] = std::sqrt(std::max(0.f, 1.f - small[0] * small[0] - small[1] * small[1] - small[2] * small[2]));
+        return q;
+    }
+
+    std::array<std::uint16_t, 3> encode_rotation(glm::quat const & rotation)
+    {
+        float q[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+        float const length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+        int largest = 0;
+        for (int i = 1; i < 4; ++i)
+            if (std::abs(q[i]) > std::abs(q[largest]))
+                largest = i;
+        // q and -q are the same rotation; the decoder assumes the largest is positive
+        float const sign = (q[largest] < 0.f) ? -1.f : 1.f;
+
+        std::uint16_t small[3];
+        for (int i = 0, j = 0; i < 4; ++i)
+        {
+            if (i == largest)
+                continue;
+            float const v = std::round((sign * q[i] / length + rotation_limit) / rotation_step);
+            small[j++] = std::uint16_t(std::clamp(v, 0.f, 32767.f));
+        }
+
+        return {
+            std::uint16_t((small[0] << 1) | (largest >> 1)),
+            std::uint16_t((small[1] << 1) | (largest & 1)),
+            small[2],
+        };
+    }
+
+    float rotation_angle(glm::quat const & a, glm::quat const & b)
+    {
+        // 4 asin(|a - b| / 2) along the shorter arc, which unlike acos of the
+        // dot product keeps its precision for small angles
+        float const d = glm::dot(a, b);
+        glm::quat const c = (d < 0.f) ? -b : b;
+        glm::quat const diff = a - c;
+        float const chord = std::sqrt(glm::dot(diff, diff));
+        return 4.f * std::asin(std::min(1.f, chord / 2.f));
+    }
+
+    // Indices of the keys of a channel to keep, found greedily from the first
+    // key: every kept key is followed by the furthest key such that
+    // interpolating between the two reproduces all keys in between.
+    // fits(i, j, k) tells whether interpolating between keys i and j
+    // reproduces key k within the tolerance
+    template <typename Fits>
+    std::vector<std::uint32_t> reduce_keys(std::uint32_t count, Fits && fits)
+    {
+        std::vector<std::uint32_t> kept{0};
+        std::uint32_t anchor = 0;
+        for (std::uint32_t end = 2; end < count; ++end)
+        {
+            bool all_fit = true;
+            for (std::uint32_t k = anchor + 1; k < end && all_fit; ++k)
+                all_fit = fits(anchor, end, k);
+            if (!all_fit)
+            {
+                anchor = end - 1;
+                kept.push_back(anchor);
+            }
+        }
+        if (count > 1)
+            kept.push_back(count - 1);
+        return kept;
+    }
+
+    // a * (1 - t) + b * t, the same expression glm::lerp evaluates
+    template <typename Batch>
+    void lerp_lanes(std::size_t i, float const * const a[3], float const * const b[3], float const * t, float * const result[3])
+    {
+        Batch const tt = Batch::load(t + i);
+        Batch const st = Batch::broadcast(1.f) - tt;
+        for (int c = 0; c < 3; ++c)
+            (Batch::load(a[c] + i) * st + Batch::load(b[c] + i) * tt).store(result[c] + i);
+    }
+
+    // Normalized lerp along the shorter arc, with t corrected to follow slerp
+    template <typename Batch>
+    void nlerp_lanes(std::size_t i, float const * const a[4], float const * const b[4], float const * t, float * const result[4])
+    {
+        Batch qa[4], qb[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            qa[c] = Batch::load(a[c] + i);
+            qb[c] = Batch::load(b[c] + i);
+        }
+
+        Batch const d = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2] + qa[3] * qb[3];
+        Batch const flip = less(d, Batch::broadcast(0.f));
+        for (int c = 0; c < 4; ++c)
+            qb[c] = select(flip, Batch::broadcast(0.f) - qb[c], qb[c]);
+
+        Batch const ct = slerp_parameter(abs(d), Batch::load(t + i));
+        Batch const st = Batch::broadcast(1.f) - ct;
+
+        Batch q[4];
+        for (int c = 0; c < 4; ++c)
+            q[c] = qa[c] * st + qb[c] * ct;
+        Batch const length = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int c = 0; c < 4; ++c)
+            (q[c] / length).store(result[c] + i);
+    }
+
+}
+
+animation_clip make_animation_clip(gltf_model::animation const & animation)
+{
+    animation_clip result;
+    result.bone_count = animation.bones.size();
+    result.duration = animation.max_time;
+    result.first_key.reserve(3 * result.bone_count + 1);
+
+    auto add_key = [&](float time, float x, float y, float z, float w)
+    {
+        result.times.push_back(time);
+        result.x.push_back(x);
+        result.y.push_back(y);
+        result.z.push_back(z);
+        result.w.push_back(w);
+    };
+
+    auto add_vec3_channel = [&](gltf_model::spline<glm::vec3> const & spline, glm::vec3 const & identity)
+    {
+        result.first_key.push_back(result.times.size());
+        if (spline.values.empty())
+            add_key(0.f, identity.x, identity.y, identity.z, 0.f);
+        for (std::size_t i = 0; i < spline.values.size(); ++i)
+            add_key(spline.timestamps[i], spline.values[i].x, spline.values[i].y, spline.values[i].z, 0.f);
+    };
+
+    for (auto const & bone : animation.bones)
+        add_vec3_channel(bone.translation, glm::vec3(0.f));
+    for (auto const & bone : animation.bones)
+        add_vec3_channel(bone.scale, glm::vec3(1.f));
+    for (auto const & bone : animation.bones)
+    {
+        result.first_key.push_back(result.times.size());
+        if (bone.rotation.values.empty())
+            add_key(0.f, 0.f, 0.f, 0.f, 1.f);
+        for (std::size_t i = 0; i < bone.rotation.values.size(); ++i)
+        {
+            auto const & q = bone.rotation.values[i];
+            add_key(bone.rotation.timestamps[i], q.x, q.y, q.z, q.w);
+        }
+    }
+    result.first_key.push_back(result.times.size());
+
+    return result;
+}
+
+compressed_clip compress_animation_clip(animation_clip const & clip, animation_tolerance const & tolerance)
+{
+    compressed_clip result;
+    result.bone_count = clip.bone_count;
+    result.duration = clip.duration;
+    result.first_key.reserve(clip.first_key.size());
+    result.minimum.reserve(2 * clip.bone_count);
+    result.step.reserve(2 * clip.bone_count);
+
+    std::size_t const vec3_channels = 2 * clip.bone_count;
+    float const time_scale = (clip.duration > 0.f) ? time_units / clip.duration : 0.f;
+
+    for (std::size_t c = 0; c < clip.channel_count(); ++c)
+    {
+        std::uint32_t const begin = clip.first_key[c];
+        std::uint32_t const count = clip.first_key[c + 1] - begin;
+        bool const is_rotation = c >= vec3_channels;
+        float const max_error = is_rotation ? tolerance.rotation
+            : (c < clip.bone_count) ? tolerance.translation : tolerance.scale;
+
+        auto const vec3_key = [&](std::uint32_t k)
+        {
+            return glm::vec3(clip.x[begin + k], clip.y[begin + k], clip.z[begin + k]);
+        };
+        auto const rotation_key = [&](std::uint32_t k)
+        {
+            return glm::quat(clip.w[begin + k], clip.x[begin + k], clip.y[begin + k], clip.z[begin + k]);
+        };
+        // The error at key k of interpolating between keys a and b at t
+        auto const error = [&](std::uint32_t a, std::uint32_t b, float t, std::uint32_t k)
+        {
+            if (is_rotation)
+                return rotation_angle(glm::slerp(rotation_key(a), rotation_key(b), t), rotation_key(k));
+            return glm::distance(glm::mix(vec3_key(a), vec3_key(b), t), vec3_key(k));
+        };
+
+        bool constant = true;
+        for (std::uint32_t k = 0; k + 1 < count && constant; ++k)
+            constant = error(count - 1, count - 1, 0.f, k) <= max_error;
+
+        std::vector<std::uint32_t> kept;
+        if (constant)
+            kept = {count - 1};
+        else
+        {
+            float const * times = clip.times.data() + begin;
+            kept = reduce_keys(count, [&](std::uint32_t a, std::uint32_t b, std::uint32_t k)
+            {
+                float const span = times[b] - times[a];
+                float const t = (span > 0.f) ? (times[k] - times[a]) / span : 0.f;
+                return error(a, b, t, k) <= max_error;
+            });
+        }
+
+        // Keys closer than a time unit would share a time; of those the later
+        // one wins, so that the last key survives
+        std::vector<std::uint32_t> keys;
+        std::vector<std::uint16_t> key_times;
+        for (std::uint32_t k : kept)
+        {
+            float const time = std::round(clip.times[begin + k] * time_scale);
+            std::uint16_t const key_time = std::uint16_t(std::clamp(time, 0.f, time_units));
+            if (!key_times.empty() && key_times.back() >= key_time)
+            {
+                keys.back() = k;
+                continue;
+            }
+            keys.push_back(k);
+            key_times.push_back(key_time);
+        }
+
+        result.first_key.push_back(result.times.size());
+        result.times.insert(result.times.end(), key_times.begin(), key_times.end());
+
+        if (is_rotation)
+        {
+            for (std::uint32_t k : keys)
+            {
+                auto const packed = encode_rotation(rotation_key(k));
+                result.x.push_back(packed[0]);
+                result.y.push_back(packed[1]);
+                result.z.push_back(packed[2]);
+            }
+        }
+        else
+        {
+            glm::vec3 minimum = vec3_key(keys.front());
+            glm::vec3 maximum = minimum;
+            for (std::uint32_t k : keys)
+            {
+                minimum = glm::min(minimum, vec3_key(k));
+                maximum = glm::max(maximum, vec3_key(k));
+            }
+            glm::vec3 const step = (maximum - minimum) / 65535.f;
+            result.minimum.push_back(minimum);
+            result.step.push_back(step);
+
+            auto const quantize = [](float value, float minimum, float step)
+            {
+                if (step <= 0.f)
+                    return std::uint16_t(0);
+                return std::uint16_t(std::clamp(std::round((value - minimum) / step), 0.f, 65535.f));
+            };
+
+            for (std::uint32_t k : keys)
+            {
+                glm::vec3 const value = vec3_key(k);
+                result.x.push_back(quantize(value.x, minimum.x, step.x));
+                result.y.push_back(quantize(value.y, minimum.y, step.y));
+                result.z.push_back(quantize(value.z, minimum.z, step.z));
+            }
+        }
+    }
+    result.first_key.push_back(result.times.size());
+
+    return result;
+}
+
+std::size_t compressed_clip::memory_size() const
+{
+    return first_key.size() * sizeof(std::uint32_t)
+        + (times.size() + x.size() + y.size() + z.size()) * sizeof(std::uint16_t)
+        + (minimum.size() + step.size()) * sizeof(glm::vec3);
+}
+
+void skeleton_pose::resize(std::size_t bone_count)
+{
+    for (auto * component : {&tx, &ty, &tz, &sx, &sy, &sz, &rx, &ry, &rz, &rw})
+        component->resize(bone_count);
+}
+
+bool animation_sampler::prepare(std::size_t channels, std::size_t bones, animation_cursor & cursor, float time, skeleton_pose & pose)
+{
+    bool const restart = cursor.keys.size() != channels || time < cursor.time;
+    if (cursor.keys.size() != channels)
+        cursor.keys.assign(channels, 0);
+    cursor.time = time;
+
+    for (auto * scratch : {&m_ax, &m_ay, &m_az, &m_aw, &m_bx, &m_by, &m_bz, &m_bw, &m_t})
+        if (scratch->size() < channels)
+            scratch->resize(channels);
+    pose.resize(bones);
+
+    return restart;
+}
+
+void animation_sampler::sample(animation_clip const & clip, animation_cursor & cursor, float time, skeleton_pose & pose)
+{
+    std::size_t const channels = clip.channel_count();
+    bool const restart = prepare(channels, clip.bone_count, cursor, time, pose);
+
+    // Moves the cursors and gathers the keys around the time
+    for (std::size_t c = 0; c < channels; ++c)
+    {
+        float const * first = clip.times.data() + clip.first_key[c];
+        float const * last = clip.times.data() + clip.first_key[c + 1];
+        std::uint32_t const count = last - first;
+
+        std::uint32_t const key = advance_cursor(first, last, cursor.keys[c], time, restart);
+        cursor.keys[c] = key;
+
+        std::size_t a, b;
+        if (key == 0 || key == count)
+        {
+            a = b = clip.first_key[c] + count - 1;
+            m_t[c] = 0.f;
+        }
+        else
+        {
+            a = clip.first_key[c] + key - 1;
+            b = a + 1;
+            m_t[c] = (time - first[key - 1]) / (first[key] - first[key - 1]);
+        }
+
+        m_ax[c] = clip.x[a]; m_ay[c] = clip.y[a]; m_az[c] = clip.z[a]; m_aw[c] = clip.w[a];
+        m_bx[c] = clip.x[b]; m_by[c] = clip.y[b]; m_bz[c] = clip.z[b]; m_bw[c] = clip.w[b];
+    }
+
+    interpolate(clip.bone_count, pose);
+}
+
+void animation_sampler::sample(compressed_clip const & clip, animation_cursor & cursor, float time, skeleton_pose & pose)
+{
+    std::size_t const channels = clip.channel_count();
+    std::size_t const vec3_channels = 2 * clip.bone_count;
+    bool const restart = prepare(channels, clip.bone_count, cursor, time, pose);
+
+    float const key_time = (clip.duration > 0.f) ? time * (time_units / clip.duration) : 0.f;
+
+    // The same as for an animation_clip, decoding the two keys
+    for (std::size_t c = 0; c < channels; ++c)
+    {
+        std::uint16_t const * first = clip.times.data() + clip.first_key[c];
+        std::uint16_t const * last = clip.times.data() + clip.first_key[c + 1];
+        std::uint32_t const count = last - first;
+
+        std::uint32_t const key = advance_cursor(first, last, cursor.keys[c], key_time, restart);
+        cursor.keys[c] = key;
+
+        std::size_t a, b;
+        if (key == 0 || key == count)
+        {
+            a = b = clip.first_key[c] + count - 1;
+            m_t[c] = 0.f;
+        }
+        else
+        {
+            a = clip.first_key[c] + key - 1;
+            b = a + 1;
+            m_t[c] = (key_time - first[key - 1]) / float(first[key] - first[key - 1]);
+        }
+
+        if (c < vec3_channels)
+        {
+            glm::vec3 const & minimum = clip.minimum[c];
+            glm::vec3 const & step = clip.step[c];
+            m_ax[c] = minimum.x + clip.x[a] * step.x; m_ay[c] = minimum.y + clip.y[a] * step.y; m_az[c] = minimum.z + clip.z[a] * step.z;
+            m_bx[c] = minimum.x + clip.x[b] * step.x; m_by[c] = minimum.y + clip.y[b] * step.y; m_bz[c] = minimum.z + clip.z[b] * step.z;
+        }
+        else
+        {
+            auto const qa = decode_rotation(clip.x[a], clip.y[a], clip.z[a]);
+            auto const qb = decode_rotation(clip.x[b], clip.y[b], clip.z[b]);
+            m_ax[c] = qa[0]; m_ay[c] = qa[1]; m_az[c] = qa[2]; m_aw[c] = qa[3];
+            m_bx[c] = qb[0]; m_by[c] = qb[1]; m_bz[c] = qb[2]; m_bw[c] = qb[3];
+        }
+    }
+
+    interpolate(clip.bone_count, pose);
+}
+
+void animation_sampler::interpolate(std::size_t bones, skeleton_pose & pose)
+{
+    // Interpolates all channels of a kind at once
+    float const * const a[4] = {m_ax.data(), m_ay.data(), m_az.data(), m_aw.data()};
+    float const * const b[4] = {m_bx.data(), m_by.data(), m_bz.data(), m_bw.data()};
+
+    float * const translation[3] = {pose.tx.data(), pose.ty.data(), pose.tz.data()};
+    for_lanes(0, bones, [&](auto batch, std::size_t i){
+        lerp_lanes<decltype(batch)>(i, a, b, m_t.data(), translation);
+    });
+
+    float const * const scale_a[3] = {a[0] + bones, a[1] + bones, a[2] + bones};
+    float const * const scale_b[3] = {b[0] + bones, b[1] + bones, b[2] + bones};
+    float * const scale[3] = {pose.sx.data(), pose.sy.data(), pose.sz.data()};
+    for_lanes(0, bones, [&](auto batch, std::size_t i){
+        lerp_lanes<decltype(batch)>(i, scale_a, scale_b, m_t.data() + bones, scale);
+    });
+
+    float const * const rotation_a[4] = {a[0] + 2 * bones, a[1] + 2 * bones, a[2] + 2 * bones, a[3] + 2 * bones};
+    float const * const rotation_b[4] = {b[0] + 2 * bones, b[1] + 2 * bones, b[2] + 2 * bones, b[3] + 2 * bones};
+    float * const rotation[4] = {pose.rx.data(), pose.ry.data(), pose.rz.data(), pose.rw.data()};
+    for_lanes(0, bones, [&](auto batch, std::size_t i){
+        nlerp_lanes<decltype(batch)>(i, rotation_a, rotation_b, m_t.data() + 2 * bones, rotation);
+    });
+}
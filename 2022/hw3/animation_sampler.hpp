@@ -0,0 +1,143 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keyframe sampling of a whole skeleton at once, for the per-frame animation
+// update. gltf_model::spline finds the keys around the time with a binary
+// search on every call, three times per bone and clip. An animation_clip
+// keeps the keys of all channels in flat structure-of-arrays form, and an
+// animation_cursor remembers the key every channel stopped at, so that
+// playback going forward in time, the usual case, only steps over the keys
+// it passed since the previous frame.
+//
+// animation_sampler works in two passes over the channels: a scalar one
+// moving the cursors and gathering the two keys around the time into
+// contiguous arrays, then a SIMD one (8 lanes with AVX, 4 with SSE2)
+// interpolating all of them. Translations and scales are lerped exactly as
+// by gltf_model::spline. Rotations use a normalized lerp with a corrected
+// parameter (Kapoulkine, "Approximating slerp", 2015) in place of slerp,
+// which has no cheap SIMD form; on the wolf's clips it stays within 1e-4
+// radians of glm::slerp (see animation_sampler_benchmark).
+//
+// Like gltf_model::spline, a time at or before a channel's first key, or
+// after its last one, gives the last key, which matches looped clips.
+
+// The keys of one animation for every bone of the model
+struct animation_clip
+{
+    std::size_t bone_count = 0;
+    float duration = 0.f;
+
+    // Channels are ordered all translations, all scales, then all rotations,
+    // each in bone order. Channel c has the keys first_key[c] up to
+    // first_key[c + 1]; a channel without keys gets a single identity key
+    std::vector<std::uint32_t> first_key;
+    std::vector<float> times;
+    // Key values, one array per component; w is only set for rotations
+    std::vector<float> x, y, z, w;
+
+    std::size_t channel_count() const { return first_key.size() - 1; }
+};
+
+animation_clip make_animation_clip(gltf_model::animation const & animation);
+
+// How far compress_animation_clip may move a channel from the original keys
+// when it drops keys, in the channel's own units: distance for translations
+// and scales, radians for rotations. Quantization adds its own error on top,
+// at most 1e-4 radians for rotations and half a step of a channel's
+// 16-bit range for translations and scales.
+struct animation_tolerance
+{
+    float translation = 1e-4f;
+    float rotation = 1e-3f;
+    float scale = 1e-4f;
+};
+
+// An animation_clip with fewer, quantized keys, sampled by the same
+// animation_sampler, which decodes the keys it needs on the fly.
+//
+// Keys a channel can do without, because interpolating between the kept
+// keys reproduces them within the tolerance, are dropped; a channel that
+// never leaves the tolerance around its last key keeps only that key. Key
+// times are 16-bit fractions of the duration. Translations and scales are
+// 16 bits per component within their channel's bounding box. Rotations are
+// stored in 48 bits as their three smallest components, 15 bits each in
+// [-1/sqrt(2), 1/sqrt(2)], and the index of the dropped largest one, which
+// is recomputed from the unit length.
+struct compressed_clip
+{
+    std::size_t bone_count = 0;
+    float duration = 0.f;
+
+    // Channels and first_key as in animation_clip
+    std::vector<std::uint32_t> first_key;
+    // In units of duration / 65535
+    std::vector<std::uint16_t> times;
+    // Per key, three quantized components, or the packed smallest three of
+    // a rotation: the index of the largest component is (x & 1) * 2 + (y & 1)
+    std::vector<std::uint16_t> x, y, z;
+    // Per translation and scale channel, value = minimum + quantized * step
+    std::vector<glm::vec3> minimum, step;
+
+    std::size_t channel_count() const { return first_key.size() - 1; }
+
+    // Bytes taken by the keys and the tables
+    std::size_t memory_size() const;
+};
+
+compressed_clip compress_animation_clip(animation_clip const & clip, animation_tolerance const & tolerance = {});
+
+// The playback position of one instance in one clip
+struct animation_cursor
+{
+    // The time of the previous sample; going backwards in time, as a looped
+    // clip does when it wraps, restarts every channel with a binary search
+    float time = 0.f;
+    // For every channel, the first key not before time, relative to the
+    // channel's first key; empty until the first sample
+    std::vector<std::uint32_t> keys;
+};
+
+// Local bone transforms, one array per component, indexed by bone
+struct skeleton_pose
+{
+    std::vector<float> tx, ty, tz;
+    std::vector<float> sx, sy, sz;
+    std::vector<float> rx, ry, rz, rw;
+
+    void resize(std::size_t bone_count);
+    std::size_t size() const { return tx.size(); }
+
+    glm::vec3 translation(std::size_t bone) const { return {tx[bone], ty[bone], tz[bone]}; }
+    glm::vec3 scale(std::size_t bone) const { return {sx[bone], sy[bone], sz[bone]}; }
+    glm::quat rotation(std::size_t bone) const { return glm::quat(rw[bone], rx[bone], ry[bone], rz[bone]); }
+};
+
+// Holds the scratch arrays of the gathering pass, so that sampling does not
+// allocate once they have grown to the largest clip; one per thread
+class animation_sampler
+{
+public:
+    // Samples every bone of the clip at time, which must lie within
+    // [0, clip.duration] to behave like gltf_model::spline, and moves the
+    // cursor there. Resizes the pose to the clip's bone count
+    void sample(animation_clip const & clip, animation_cursor & cursor, float time, skeleton_pose & pose);
+    void sample(compressed_clip const & clip, animation_cursor & cursor, float time, skeleton_pose & pose);
+
+private:
+    // Grows the scratch arrays and the pose, and resets the cursor if needed;
+    // returns whether the cursors must be searched from scratch
+    bool prepare(std::size_t channels, std::size_t bones, animation_cursor & cursor, float time, skeleton_pose & pose);
+    // The SIMD pass over the gathered keys
+    void interpolate(std::size_t bones, skeleton_pose & pose);
+
+    // Per channel: the components of the keys before and after the time,
+    // and the interpolation parameter between them
+    std::vector<float> m_ax, m_ay, m_az, m_aw;
+    std::vector<float> m_bx, m_by, m_bz, m_bw;
+    std::vector<float> m_t;
+};
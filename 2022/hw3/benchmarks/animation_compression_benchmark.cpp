@@ -0,0 +1,168 @@
+// Memory and cost of compressed clips. For every clip of the model: the
+// bytes taken by the gltf_model splines, by an animation_clip and by a
+// compressed_clip, the keys kept, the largest difference between the poses
+// sampled from the compressed and from the uncompressed clip at 60 frames
+// per second, and the sampling throughput of both, in bones sampled per
+// millisecond, for a crowd of instances each playing the clip from its own
+// starting time.
+//
+// Usage: animation_compression_benchmark [file.gltf [translation rotation scale]]
+// Without a file the wolf is used; the tolerances default to
+// animation_tolerance's.
+
+#include "animation_sampler.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr int frames = 600;
+    constexpr float frame_time = 1.f / 60.f;
+    constexpr std::size_t instances = 256;
+
+    template <typename Step>
+    double measure(Step && step)
+    {
+        auto start = std::chrono::steady_clock::now();
+        step();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::size_t spline_size(gltf_model::animation const & animation)
+    {
+        std::size_t result = 0;
+        for (auto const & bone : animation.bones)
+        {
+            result += (bone.translation.timestamps.size() + bone.rotation.timestamps.size() + bone.scale.timestamps.size()) * sizeof(float);
+            result += (bone.translation.values.size() + bone.scale.values.size()) * sizeof(glm::vec3);
+            result += bone.rotation.values.size() * sizeof(glm::quat);
+        }
+        return result;
+    }
+
+    std::size_t clip_size(animation_clip const & clip)
+    {
+        return clip.first_key.size() * sizeof(std::uint32_t)
+            + (clip.times.size() + clip.x.size() + clip.y.size() + clip.z.size() + clip.w.size()) * sizeof(float);
+    }
+
+    // The angle of the rotation between two unit quaternions, from the chord
+    // between them, as in animation_sampler_benchmark
+    float rotation_angle(glm::quat const & a, glm::quat b)
+    {
+        if (glm::dot(a, b) < 0.f)
+            b = -b;
+        glm::vec4 const chord(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w);
+        return 4.f * std::asin(std::min(1.f, glm::length(chord) / 2.f));
+    }
+
+    // Samples every instance at every frame, returning the seconds taken
+    template <typename Clip>
+    double measure_sampling(Clip const & clip, std::vector<float> const & start_times, float & sum)
+    {
+        animation_sampler sampler;
+        skeleton_pose pose;
+        std::vector<animation_cursor> cursors(start_times.size());
+        return measure([&]{
+            for (int frame = 0; frame < frames; ++frame)
+                for (std::size_t i = 0; i < start_times.size(); ++i)
+                {
+                    float const time = std::fmod(start_times[i] + frame * frame_time, clip.duration);
+                    sampler.sample(clip, cursors[i], time, pose);
+                    sum += pose.tx[0] + pose.sx[0] + pose.rw[0];
+                }
+        });
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::string const path = argc > 1 ? argv[1] : PROJECT_ROOT "/wolf/Wolf-Blender-2.82a.gltf";
+    animation_tolerance tolerance;
+    if (argc > 4)
+    {
+        tolerance.translation = std::stof(argv[2]);
+        tolerance.rotation = std::stof(argv[3]);
+        tolerance.scale = std::stof(argv[4]);
+    }
+
+    auto const model = load_gltf(path);
+    if (model.animations.empty())
+        throw std::runtime_error(path + " has no animations");
+
+    std::printf("%zu bones, tolerance: translation %g, rotation %g radians, scale %g\n", model.bones.size(),
+        tolerance.translation, tolerance.rotation, tolerance.scale);
+
+    std::default_random_engine random;
+    std::size_t total_splines = 0, total_clips = 0, total_compressed = 0;
+    for (auto const & [name, animation] : model.animations)
+    {
+        auto const clip = make_animation_clip(animation);
+        auto const compressed = compress_animation_clip(clip, tolerance);
+
+        std::size_t const splines_bytes = spline_size(animation);
+        std::size_t const clip_bytes = clip_size(clip);
+        std::size_t const compressed_bytes = compressed.memory_size();
+        total_splines += splines_bytes;
+        total_clips += clip_bytes;
+        total_compressed += compressed_bytes;
+
+        std::printf("%s, %.3f s\n", name.c_str(), clip.duration);
+        std::printf("    splines %8zu bytes, clip %8zu bytes, compressed %7zu bytes (%.1fx smaller than the splines), %zu of %zu keys kept\n",
+            splines_bytes, clip_bytes, compressed_bytes, double(splines_bytes) / compressed_bytes,
+            compressed.times.size(), clip.times.size());
+
+        // Accuracy over a few passes through the clip
+        {
+            animation_sampler sampler;
+            animation_cursor expected_cursor, actual_cursor;
+            skeleton_pose expected, actual;
+            float max_translation = 0.f, max_scale = 0.f, max_angle = 0.f;
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                float const time = std::fmod(frame * frame_time, clip.duration);
+                sampler.sample(clip, expected_cursor, time, expected);
+                sampler.sample(compressed, actual_cursor, time, actual);
+                for (std::size_t i = 0; i < expected.size(); ++i)
+                {
+                    max_translation = std::max(max_translation, glm::length(expected.translation(i) - actual.translation(i)));
+                    max_scale = std::max(max_scale, glm::length(expected.scale(i) - actual.scale(i)));
+                    max_angle = std::max(max_angle, rotation_angle(expected.rotation(i), actual.rotation(i)));
+                }
+            }
+            std::printf("    largest difference: translation %g, scale %g, rotation %g radians\n",
+                max_translation, max_scale, max_angle);
+        }
+
+        std::vector<float> start_times(instances);
+        std::uniform_real_distribution<float> start_time(0.f, 10.f);
+        for (auto & time : start_times)
+            time = start_time(random);
+
+        std::size_t const samples = clip.bone_count * instances * frames;
+        float sum = 0.f;
+        double const clip_seconds = measure_sampling(clip, start_times, sum);
+        double const compressed_seconds = measure_sampling(compressed, start_times, sum);
+        std::printf("    %zu instances: clip %8.0f bones/ms, compressed %8.0f bones/ms (%.2fx)%s\n", instances,
+            samples / clip_seconds / 1e3, samples / compressed_seconds / 1e3, clip_seconds / compressed_seconds,
+            std::isfinite(sum) ? "" : ", non-finite pose");
+    }
+
+    std::printf("all clips: splines %zu bytes, clips %zu bytes, compressed %zu bytes (%.1fx smaller than the splines)\n",
+        total_splines, total_clips, total_compressed, double(total_splines) / total_compressed);
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+// Skeleton sampling throughput, in bones x clips x instances sampled per
+// millisecond: gltf_model::spline (a binary search and a glm::slerp per
+// channel) against animation_sampler (cursors and the SIMD pass). Every
+// instance plays every clip of the model at 60 frames per second from its
+// own starting time, wrapping at the end of the clip, so the cursors see the
+// occasional backwards jump a looped clip makes. Also reports how far the
+// sampler's poses are from the splines'.
+//
+// Usage: animation_sampler_benchmark [file.gltf]
+// Without a file the wolf is used.
+
+#include "animation_sampler.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr int frames = 600;
+    constexpr float frame_time = 1.f / 60.f;
+
+    template <typename Step>
+    double measure(Step && step)
+    {
+        auto start = std::chrono::steady_clock::now();
+        step();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void store(skeleton_pose & pose, std::size_t bone, glm::vec3 const & translation, glm::quat const & rotation, glm::vec3 const & scale)
+    {
+        pose.tx[bone] = translation.x; pose.ty[bone] = translation.y; pose.tz[bone] = translation.z;
+        pose.sx[bone] = scale.x; pose.sy[bone] = scale.y; pose.sz[bone] = scale.z;
+        pose.rx[bone] = rotation.x; pose.ry[bone] = rotation.y; pose.rz[bone] = rotation.z; pose.rw[bone] = rotation.w;
+    }
+
+    void sample_splines(gltf_model::animation const & animation, float time, skeleton_pose & pose)
+    {
+        pose.resize(animation.bones.size());
+        for (std::size_t i = 0; i < animation.bones.size(); ++i)
+        {
+            auto const & bone = animation.bones[i];
+            store(pose, i, bone.translation(time), bone.rotation(time), bone.scale(time));
+        }
+    }
+
+    // The angle of the rotation between two unit quaternions, from the chord
+    // between them rather than from their dot product, which is too close to
+    // 1 for acos to resolve small angles in float
+    float rotation_angle(glm::quat const & a, glm::quat b)
+    {
+        if (glm::dot(a, b) < 0.f)
+            b = -b;
+        glm::vec4 const chord(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w);
+        return 4.f * std::asin(std::min(1.f, glm::length(chord) / 2.f));
+    }
+
+    // Keeps the compiler from dropping the sampling
+    float checksum(skeleton_pose const & pose)
+    {
+        return pose.tx[0] + pose.sx[0] + pose.rw[0];
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::string const path = argc > 1 ? argv[1] : PROJECT_ROOT "/wolf/Wolf-Blender-2.82a.gltf";
+    auto const model = load_gltf(path);
+
+    std::vector<gltf_model::animation const *> animations;
+    std::vector<animation_clip> clips;
+    for (auto const & [name, animation] : model.animations)
+    {
+        animations.push_back(&animation);
+        clips.push_back(make_animation_clip(animation));
+    }
+    if (clips.empty())
+        throw std::runtime_error(path + " has no animations");
+
+    std::size_t keys = 0;
+    for (auto const & clip : clips)
+        keys += clip.times.size();
+    std::printf("%zu bones, %zu clips, %zu keys\n", model.bones.size(), clips.size(), keys);
+
+    // Accuracy over a few passes through every clip
+    {
+        animation_sampler sampler;
+        skeleton_pose expected, actual;
+        float max_translation = 0.f, max_scale = 0.f, max_angle = 0.f;
+        for (std::size_t c = 0; c < clips.size(); ++c)
+        {
+            animation_cursor cursor;
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                float const time = std::fmod(frame * frame_time, clips[c].duration);
+                sample_splines(*animations[c], time, expected);
+                sampler.sample(clips[c], cursor, time, actual);
+                for (std::size_t i = 0; i < expected.size(); ++i)
+                {
+                    max_translation = std::max(max_translation, glm::length(expected.translation(i) - actual.translation(i)));
+                    max_scale = std::max(max_scale, glm::length(expected.scale(i) - actual.scale(i)));
+                    max_angle = std::max(max_angle, rotation_angle(expected.rotation(i), actual.rotation(i)));
+                }
+            }
+        }
+        std::printf("largest difference from the splines: translation %g, scale %g, rotation %g radians\n",
+            max_translation, max_scale, max_angle);
+    }
+
+    std::default_random_engine random;
+    for (std::size_t instances : {1, 16, 256, 1024})
+    {
+        std::vector<float> start_times(instances);
+        std::uniform_real_distribution<float> start_time(0.f, 10.f);
+        for (auto & time : start_times)
+            time = start_time(random);
+
+        std::size_t const samples = model.bones.size() * clips.size() * instances * frames;
+        skeleton_pose pose;
+        float sum = 0.f;
+
+        double const spline_seconds = measure([&]{
+            for (int frame = 0; frame < frames; ++frame)
+                for (std::size_t i = 0; i < instances; ++i)
+                    for (std::size_t c = 0; c < clips.size(); ++c)
+                    {
+                        float const time = std::fmod(start_times[i] + frame * frame_time, clips[c].duration);
+                        sample_splines(*animations[c], time, pose);
+                        sum += checksum(pose);
+                    }
+        });
+
+        animation_sampler sampler;
+        std::vector<animation_cursor> cursors(instances * clips.size());
+        double const sampler_seconds = measure([&]{
+            for (int frame = 0; frame < frames; ++frame)
+                for (std::size_t i = 0; i < instances; ++i)
+                    for (std::size_t c = 0; c < clips.size(); ++c)
+                    {
+                        float const time = std::fmod(start_times[i] + frame * frame_time, clips[c].duration);
+                        sampler.sample(clips[c], cursors[i * clips.size() + c], time, pose);
+                        sum += checksum(pose);
+                    }
+        });
+
+        std::printf("%5zu instances: splines %8.0f bones/ms, sampler %8.0f bones/ms (%.2fx)%s\n", instances,
+            samples / spline_seconds / 1e3, samples / sampler_seconds / 1e3, spline_seconds / sampler_seconds,
+            std::isfinite(sum) ? "" : ", non-finite pose");
+    }
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,103 @@
+// CPU cost of animating a crowd of wolves, everything the game does per
+// frame before uploading the bone palette: sampling two clips per wolf,
+// blending them and skinning, for crowds of a few sizes. Every wolf has its
+// own time offset. Runs once with every wolf updated each frame and once
+// with the animation LOD main.cpp uses for a spread-out crowd: a quarter of
+// the wolves every frame, a quarter every second frame, the rest every
+// fourth. Every crowd is animated from the plain clips and again from
+// compressed ones, as main.cpp plays them.
+//
+// Usage: crowd_benchmark [wolf count ...]
+// Without counts 100, 1000 and 4000 wolves are animated.
+
+#include "skinned_crowd.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr int frames = 240;
+    constexpr float frame_time = 1.f / 60.f;
+
+    double measure_frames(skinned_crowd & crowd, std::size_t & updated)
+    {
+        // The first update samples everyone
+        crowd.update(0.f);
+
+        updated = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 1; frame <= frames; ++frame)
+            updated += crowd.update(frame * frame_time);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    template <typename Clip>
+    void run_crowd(char const * name, std::vector<gltf_model::bone> const & bones, std::vector<Clip> const & clips,
+        std::size_t count)
+    {
+        std::default_random_engine random;
+        std::uniform_real_distribution<float> time_offset(0.f, 10.f);
+        std::uniform_real_distribution<float> blend(0.f, 1.f);
+
+        skinned_crowd crowd(bones, clips);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            float const f = blend(random);
+            crowd.add({time_offset(random), {1.f - f, f}, 1});
+        }
+
+        std::size_t updated = 0;
+        double const full_seconds = measure_frames(crowd, updated);
+        std::printf("    %-10s every frame   %7.3f ms per frame, %6.0f wolves/ms\n", name, full_seconds / frames * 1e3,
+            updated / full_seconds / 1e3);
+
+        for (std::size_t i = 0; i < count; ++i)
+            crowd[i].update_interval = (i % 4 == 0) ? 1 : (i % 4 == 1) ? 2 : 4;
+
+        double const lod_seconds = measure_frames(crowd, updated);
+        std::printf("    %-10s LOD 1/2/4     %7.3f ms per frame, %6.0f wolves/ms, %.0f wolves updated per frame\n",
+            name, lod_seconds / frames * 1e3, updated / lod_seconds / 1e3, double(updated) / frames);
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::vector<std::size_t> counts;
+    for (int i = 1; i < argc; ++i)
+        counts.push_back(std::stoul(argv[i]));
+    if (counts.empty())
+        counts = {100, 1000, 4000};
+
+    auto const model = load_gltf(PROJECT_ROOT "/wolf/Wolf-Blender-2.82a.gltf");
+    std::vector<animation_clip> clips{
+        make_animation_clip(model.animations.at("01_Run")),
+        make_animation_clip(model.animations.at("02_walk")),
+    };
+
+    std::vector<compressed_clip> compressed_clips;
+    for (auto const & clip : clips)
+        compressed_clips.push_back(compress_animation_clip(clip));
+
+    std::printf("%zu bones, 2 clips blended, %d frames\n", model.bones.size(), frames);
+
+    for (std::size_t count : counts)
+    {
+        std::printf("%5zu wolves, %.1f MB palette\n", count, count * model.bones.size() * sizeof(glm::mat4x3) / 1e6);
+        run_crowd("plain", model.bones, clips, count);
+        run_crowd("compressed", model.bones, compressed_clips, count);
+    }
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
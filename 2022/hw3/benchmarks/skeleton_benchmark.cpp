@@ -0,0 +1,140 @@
+// Skinning matrices per millisecond from already sampled poses: the loop
+// main.cpp had (a fresh std::vector of matrices every frame, glm matrices
+// built per bone, a second pass for the inverse bind matrices) against
+// skeleton::update blending two clips, and skeleton::update blending every
+// clip of the model. Also reports how far the two-clip skinning matrices are
+// from the old loop's.
+//
+// Usage: skeleton_benchmark [file.gltf]
+// Without a file the wolf is used.
+
+#include "skeleton.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+    constexpr int frames = 240;
+    constexpr int repetitions = 200;
+    constexpr float frame_time = 1.f / 60.f;
+    constexpr float blend = 0.3f;
+
+    template <typename Step>
+    double measure(Step && step)
+    {
+        auto start = std::chrono::steady_clock::now();
+        step();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // What main.cpp did, with the poses sampled beforehand
+    std::vector<glm::mat4x3> old_skinning(gltf_model const & model, skeleton_pose const & pose1, skeleton_pose const & pose2, float f)
+    {
+        std::vector<glm::mat4x3> bones(model.bones.size(), glm::mat4x3(0.0));
+        for (int i = 0; i < bones.size(); ++i)
+        {
+            glm::mat4 translation = glm::translate(glm::mat4(1.f), glm::lerp(pose1.translation(i), pose2.translation(i), f));
+            glm::mat4 scale = glm::scale(glm::mat4(1.f), glm::lerp(pose1.scale(i), pose2.scale(i), f));
+            glm::mat4 rotation = glm::toMat4(glm::slerp(pose1.rotation(i), pose2.rotation(i), f));
+
+            glm::mat4 transform = translation * rotation * scale;
+            if (model.bones[i].parent != -1)
+                transform = bones[model.bones[i].parent] * transform;
+            bones[i] = transform;
+        }
+
+        for (int i = 0; i < bones.size(); ++i)
+            bones[i] = bones[i] * model.bones[i].inverse_bind_matrix;
+        return bones;
+    }
+
+}
+
+int main(int argc, char ** argv) try
+{
+    std::string const path = argc > 1 ? argv[1] : PROJECT_ROOT "/wolf/Wolf-Blender-2.82a.gltf";
+    auto const model = load_gltf(path);
+
+    std::vector<animation_clip> clips;
+    for (auto const & [name, animation] : model.animations)
+        clips.push_back(make_animation_clip(animation));
+    if (clips.size() < 2)
+        throw std::runtime_error(path + " has less than two animations");
+
+    // poses[frame * clips + clip]
+    animation_sampler sampler;
+    std::vector<animation_cursor> cursors(clips.size());
+    std::vector<skeleton_pose> poses(frames * clips.size());
+    for (int frame = 0; frame < frames; ++frame)
+        for (std::size_t c = 0; c < clips.size(); ++c)
+            sampler.sample(clips[c], cursors[c], std::fmod(frame * frame_time, clips[c].duration), poses[frame * clips.size() + c]);
+
+    skeleton bones(model.bones);
+    std::printf("%zu bones, %zu clips\n", bones.size(), clips.size());
+
+    float max_difference = 0.f;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        skeleton_pose const * two[] = {&poses[frame * clips.size()], &poses[frame * clips.size() + 1]};
+        float const weights[] = {1.f - blend, blend};
+        bones.update(two, weights);
+
+        auto const expected = old_skinning(model, *two[0], *two[1], blend);
+        for (std::size_t i = 0; i < bones.size(); ++i)
+            for (int column = 0; column < 4; ++column)
+                max_difference = std::max(max_difference,
+                    glm::length(expected[i][column] - bones.skinning_matrices()[i][column]));
+    }
+    std::printf("largest difference from the old loop: %g\n", max_difference);
+
+    std::size_t const samples = bones.size() * frames * repetitions;
+    float sum = 0.f;
+
+    double const old_seconds = measure([&]{
+        for (int r = 0; r < repetitions; ++r)
+            for (int frame = 0; frame < frames; ++frame)
+                sum += old_skinning(model, poses[frame * clips.size()], poses[frame * clips.size() + 1], blend)[0][3][0];
+    });
+
+    double const two_seconds = measure([&]{
+        float const weights[] = {1.f - blend, blend};
+        for (int r = 0; r < repetitions; ++r)
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                skeleton_pose const * two[] = {&poses[frame * clips.size()], &poses[frame * clips.size() + 1]};
+                bones.update(two, weights);
+                sum += bones.skinning_matrices()[0][3][0];
+            }
+    });
+
+    double const all_seconds = measure([&]{
+        std::vector<skeleton_pose const *> all(clips.size());
+        std::vector<float> const weights(clips.size(), 1.f);
+        for (int r = 0; r < repetitions; ++r)
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                for (std::size_t c = 0; c < clips.size(); ++c)
+                    all[c] = &poses[frame * clips.size() + c];
+                bones.update(all, weights);
+                sum += bones.skinning_matrices()[0][3][0];
+            }
+    });
+
+    std::printf("    old loop, 2 clips   %8.0f bones/ms\n", samples / old_seconds / 1e3);
+    std::printf("    skeleton, 2 clips   %8.0f bones/ms (%.2fx)\n", samples / two_seconds / 1e3, old_seconds / two_seconds);
+    std::printf("    skeleton, %zu clips   %8.0f bones/ms%s\n", clips.size(), samples / all_seconds / 1e3,
+        std::isfinite(sum) ? "" : ", non-finite matrices");
+
+    return EXIT_SUCCESS;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
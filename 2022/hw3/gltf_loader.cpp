@@ -1,9 +1,10 @@
 #include "gltf_loader.hpp"
 
 #include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/error/en.h>
 
-#include <fstream>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
 
 static unsigned int attribute_type_to_size(std::string const & type)
@@ -16,29 +17,101 @@ static unsigned int attribute_type_to_size(std::string const & type)
     throw std::runtime_error("Unknown attribute type: " + type);
 }
 
-gltf_model load_gltf(std::filesystem::path const & path)
+namespace
 {
-    rapidjson::Document document;
 
+    constexpr std::uint32_t glb_magic = 0x46546C67; // "glTF"
+    constexpr std::uint32_t glb_json_chunk = 0x4E4F534A; // "JSON"
+    constexpr std::uint32_t glb_bin_chunk = 0x004E4942; // "BIN\0"
+
+    std::uint32_t read_u32(char const * data)
+    {
+        std::uint32_t result;
+        std::memcpy(&result, data, sizeof(result));
+        return result;
+    }
+
+    struct glb_chunks
+    {
+        std::string_view json;
+        std::span<char const> bin;
+    };
+
+    // The container is a 12-byte header (magic, version, length) followed by
+    // chunks of (length, type, data), the JSON one first
+    glb_chunks split_glb(std::filesystem::path const & path, std::string_view file)
     {
-        std::ifstream input(path, std::ios::binary);
-        rapidjson::IStreamWrapper stream(input);
-        document.ParseStream(stream);
+        if (file.size() < 12 || read_u32(file.data() + 4) != 2 || read_u32(file.data() + 8) > file.size())
+            throw std::runtime_error("Unsupported GLB file " + path.string());
+
+        glb_chunks result;
+        file = file.substr(0, read_u32(file.data() + 8));
+        for (std::size_t offset = 12; offset + 8 <= file.size();)
+        {
+            std::size_t const length = read_u32(file.data() + offset);
+            std::uint32_t const type = read_u32(file.data() + offset + 4);
+            offset += 8;
+            if (length > file.size() - offset)
+                throw std::runtime_error("Truncated GLB chunk in " + path.string());
+
+            if (type == glb_json_chunk && result.json.empty())
+                result.json = file.substr(offset, length);
+            else if (type == glb_bin_chunk && result.bin.empty())
+                result.bin = {file.data() + offset, length};
+
+            offset += length;
+        }
+
+        if (result.json.empty())
+            throw std::runtime_error("No JSON chunk in " + path.string());
+        return result;
     }
 
+}
+
+gltf_model load_gltf(std::filesystem::path const & path)
+{
     gltf_model result;
 
+    auto file = std::make_shared<mapped_file const>(path);
+    bool const is_glb = file->size() >= 4 && read_u32(file->data()) == glb_magic;
+
+    glb_chunks chunks;
+    if (is_glb)
+        chunks = split_glb(path, file->view());
+    else
+        chunks.json = file->view();
+
+    // Parsed in situ, which unescapes the strings in place: the text is
+    // copied, but only the JSON, the binary data stays in the mapping
+    std::vector<char> json(chunks.json.size() + 1, '\0');
+    std::copy(chunks.json.begin(), chunks.json.end(), json.begin());
+
+    rapidjson::Document document;
+    document.ParseInsitu(json.data());
+    if (document.HasParseError())
+        throw std::runtime_error("Failed to parse " + path.string() + ": " + rapidjson::GetParseError_En(document.GetParseError()));
+
     {
         auto buffers = document["buffers"].GetArray();
         assert(buffers.Size() == 1);
 
-        auto const buffer_uri = buffers[0]["uri"].GetString();
-
-        auto const buffer_path = path.parent_path() / buffer_uri;
+        if (buffers[0].HasMember("uri"))
+        {
+            auto const buffer_path = path.parent_path() / buffers[0]["uri"].GetString();
+            result.buffer_file = std::make_shared<mapped_file const>(buffer_path);
+            result.buffer = {result.buffer_file->data(), result.buffer_file->size()};
+        }
+        else
+        {
+            if (!is_glb)
+                throw std::runtime_error("Buffer without a uri in " + path.string());
+            result.buffer_file = std::move(file);
+            result.buffer = chunks.bin;
+        }
 
-        result.buffer.resize(std::filesystem::file_size(buffer_path));
-        std::ifstream buffer(buffer_path, std::ios::binary);
-        buffer.read(result.buffer.data(), result.buffer.size());
+        if (result.buffer.size() < buffers[0]["byteLength"].GetUint())
+            throw std::runtime_error("Buffer is shorter than its byteLength in " + path.string());
     }
 
     auto parse_buffer_view = [&](int index) -> gltf_model::buffer_view
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
 #include <optional>
@@ -14,6 +16,8 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/compatibility.hpp>
 
+#include "mapped_file.hpp"
+
 struct gltf_model
 {
     struct buffer_view
@@ -81,12 +85,19 @@ struct gltf_model
         accessor weights;
     };
 
-    std::vector<char> buffer;
+    // The binary buffer, straight from a memory mapping of the .bin file or
+    // of the .glb's BIN chunk; buffer_file keeps the mapping alive
+    std::span<char const> buffer;
+    std::shared_ptr<mapped_file const> buffer_file;
+
     std::vector<mesh> meshes;
     std::vector<bone> bones;
     std::unordered_map<std::string, animation> animations;
 };
 
+// Loads a .gltf file with one external buffer, or a binary .glb container
+// with its buffer in the BIN chunk (recognized by its magic, whatever the
+// extension)
 gltf_model load_gltf(std::filesystem::path const & path);
 
 template <>
@@ -32,12 +32,27 @@
 #include <numeric>
 
 #include "gltf_loader.hpp"
+#include "skinned_crowd.hpp"
 #include "texture_holder.hpp"
 #include <fstream>
 #include <random>
 #include "utils.hpp"
 
-int main() try {
+// With --wolves N the wolf is joined by a crowd of N - 1 more, on rings
+// around the tree; with --compressed-clips the wolves play compressed
+// animation clips, which take a fraction of the memory but are slower to
+// sample
+int main(int argc, char **argv) try {
+    std::size_t wolf_count = 1;
+    bool compressed_clips = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--wolves" && i + 1 < argc)
+            wolf_count = std::max<std::size_t>(1, std::stoul(argv[++i]));
+        else if (arg == "--compressed-clips")
+            compressed_clips = true;
+    }
+
     auto *window = create_window("Homework 3");
     auto gl_context = create_context(window);
     int width, height;
@@ -65,7 +80,8 @@ int main() try {
     GLint alpha_texture_location = glGetUniformLocation(shadow_program, "alpha_texture");
     GLint have_alpha_location = glGetUniformLocation(shadow_program, "have_alpha");
     GLint use_bones_location = glGetUniformLocation(shadow_program, "use_bones");
-    GLuint _bones_location = glGetUniformLocation(shadow_program, "bones");
+    GLuint _bone_palette_location = glGetUniformLocation(shadow_program, "bone_palette");
+    GLuint _bone_count_location = glGetUniformLocation(shadow_program, "bone_count");
 
     auto christmas_tree_vertex_shader = create_shader(GL_VERTEX_SHADER, project_root + "/shaders/christmas_tree.vert");
     auto christmas_tree_fragment_shader = create_shader(GL_FRAGMENT_SHADER, project_root + "/shaders/christmas_tree.frag");
@@ -116,16 +132,19 @@ int main() try {
     christmas_tree_model = glm::scale(christmas_tree_model, glm::vec3(0.007f));
     christmas_tree_model = glm::translate(christmas_tree_model, glm::vec3(0.f, 0.f, -44.f));
 
-    auto christmas_vertices = get_vertices(attrib, shapes);
+    auto [christmas_vertices, christmas_indices] = get_indexed_vertices(attrib, shapes);
     bounding_box bounding_box;
     glm::vec3 c;
 
-    GLuint vao, vbo;
+    GLuint vao, vbo, ebo;
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
     glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, christmas_vertices.size() * sizeof(vertex), christmas_vertices.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, christmas_indices.size() * sizeof(std::uint32_t), christmas_indices.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, position));
     glEnableVertexAttribArray(1);
@@ -241,13 +260,13 @@ int main() try {
     auto wolf_fragment_shader = create_shader(GL_FRAGMENT_SHADER, project_root + "/shaders/wolf.frag");
     auto wolf_program = create_program(wolf_vertex_shader, wolf_fragment_shader);
 
-    GLuint ___model_location = glGetUniformLocation(wolf_program, "model");
     GLuint ___view_location = glGetUniformLocation(wolf_program, "view");
     GLuint ___projection_location = glGetUniformLocation(wolf_program, "projection");
     GLuint color_location = glGetUniformLocation(wolf_program, "color");
     GLuint use_texture_location = glGetUniformLocation(wolf_program, "use_texture");
     GLuint ___light_direction_location = glGetUniformLocation(wolf_program, "light_direction");
-    GLuint bones_location = glGetUniformLocation(wolf_program, "bones");
+    GLuint bone_palette_location = glGetUniformLocation(wolf_program, "bone_palette");
+    GLuint bone_count_location = glGetUniformLocation(wolf_program, "bone_count");
     GLuint albedo_location = glGetUniformLocation(wolf_program, "albedo");
     GLuint _light_color_location = glGetUniformLocation(wolf_program, "light_color");
     GLuint ___shadow_map_location = glGetUniformLocation(wolf_program, "shadow_map");
@@ -265,6 +284,47 @@ int main() try {
     const gltf_model::animation& animation1 = input_model.animations.at("01_Run");
     const gltf_model::animation& animation2 = input_model.animations.at("02_walk");
 
+    float f = 1.f, wolf_speed = 0.5f;
+
+    // The first wolf runs where the single wolf always did, the others get
+    // random time offsets
+    auto make_wolves = [&] {
+        std::vector<animation_clip> clips{make_animation_clip(animation1), make_animation_clip(animation2)};
+        if (!compressed_clips)
+            return skinned_crowd(input_model.bones, std::move(clips));
+        return skinned_crowd(input_model.bones, {compress_animation_clip(clips[0]), compress_animation_clip(clips[1])});
+    };
+    skinned_crowd wolves = make_wolves();
+    std::default_random_engine wolf_rng;
+    for (std::size_t i = 0; i < wolf_count; ++i) {
+        float time_offset = i == 0 ? 0.f : std::uniform_real_distribution<float>{0.f, 10.f}(wolf_rng);
+        wolves.add({time_offset, {1.f - f, f}, 1});
+    }
+    std::size_t const wolf_rings = std::max<std::size_t>(1, std::ceil(std::sqrt(wolf_count / 8.f)));
+    float const wolf_scale = 0.7f / wolf_rings;
+
+    GLint max_texture_buffer_size;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texture_buffer_size);
+    if (wolves.palette().size() * 3 > std::size_t(max_texture_buffer_size))
+        throw std::runtime_error("Too many wolves for the bone palette texture buffer");
+
+    // Skinning matrices of all wolves, three RGBA texels per matrix
+    GLuint bone_palette_buffer, bone_palette_texture;
+    glGenBuffers(1, &bone_palette_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, bone_palette_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, wolves.palette().size_bytes(), nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &bone_palette_texture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, bone_palette_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bone_palette_buffer);
+
+    std::vector<glm::mat4> wolf_models(wolf_count);
+    GLuint wolf_models_vbo;
+    glGenBuffers(1, &wolf_models_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, wolf_models_vbo);
+    glBufferData(GL_ARRAY_BUFFER, wolf_models.size() * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, wolf_vbo);
+
     struct mesh {
         GLuint vao;
         gltf_model::accessor indices;
@@ -294,6 +354,14 @@ int main() try {
         setup_attribute(3, mesh.joints, true);
         setup_attribute(4, mesh.weights);
 
+        glBindBuffer(GL_ARRAY_BUFFER, wolf_models_vbo);
+        for (int column = 0; column < 4; ++column) {
+            glEnableVertexAttribArray(5 + column);
+            glVertexAttribPointer(5 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), reinterpret_cast<void *>(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + column, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, wolf_vbo);
+
         result.material = mesh.material;
     }
 
@@ -353,8 +421,6 @@ int main() try {
     float view_azimuth = 0.f;
     float camera_distance = 2.f;
 
-    float f = 1.f, wolf_speed = 0.5f;
-
     bool running = true;
     while (running)
     {
@@ -473,33 +539,30 @@ int main() try {
             particles.back().angular_velocity = std::uniform_real_distribution<float>{0.0f, 0.5f}(rng);
         }
 
-        glm::mat4 wolf_model(1.f);
-        wolf_model = glm::scale(wolf_model, glm::vec3(0.7f));
-        wolf_model = glm::rotate(wolf_model, -wolf_speed * time, glm::vec3(0.f, 1.f, 0.f));
-        wolf_model = glm::translate(wolf_model, glm::vec3(0.9f, -0.45f, 0.f));
-        wolf_model = glm::rotate(wolf_model, 0.18f, glm::vec3(1.f, 0.f, 0.f));
-
-        std::vector<glm::mat4x3> bones(input_model.bones.size(), glm::mat4x3(0.0));
-        float t1 = std::fmod(time, animation1.max_time);
-        float t2 = std::fmod(time, animation2.max_time);
-        for(int i = 0; i < bones.size(); ++i) {
-            glm::mat4 translation = glm::translate(glm::mat4(1.f),
-                                                   glm::lerp(animation1.bones[i].translation(t1),
-                                                             animation2.bones[i].translation(t2), f));
-            glm::mat4 scale = glm::scale(glm::mat4(1.f),
-                                         glm::lerp(animation1.bones[i].scale(t1),
-                                                   animation2.bones[i].scale(t2), f));
-            glm::mat4 rotation = glm::toMat4(glm::slerp(animation1.bones[i].rotation(t1),
-                                                        animation2.bones[i].rotation(t2), f));
-
-            glm::mat4 _transform = translation * rotation * scale;
-            if(input_model.bones[i].parent != -1)
-                _transform = bones[input_model.bones[i].parent] * _transform;
-            bones[i] = _transform;
+        // Wolves on outer rings are further apart; the ones that look small
+        // from the camera are animated less often
+        for (std::size_t i = 0; i < wolf_count; ++i) {
+            std::size_t ring = i % wolf_rings;
+            std::size_t ring_size = (wolf_count + wolf_rings - 1 - ring) / wolf_rings;
+            float radius = 0.63f * (wolf_rings - ring) / wolf_rings;
+            float angle = 2.f * glm::pi<float>() * (i / wolf_rings) / ring_size;
+
+            glm::mat4 wolf_model(1.f);
+            wolf_model = glm::rotate(wolf_model, -wolf_speed * time - angle, glm::vec3(0.f, 1.f, 0.f));
+            wolf_model = glm::translate(wolf_model, glm::vec3(radius, -0.315f, 0.f));
+            wolf_model = glm::scale(wolf_model, glm::vec3(wolf_scale));
+            wolf_model = glm::rotate(wolf_model, 0.18f, glm::vec3(1.f, 0.f, 0.f));
+            wolf_models[i] = wolf_model;
+
+            float apparent_size = wolf_scale / glm::distance(camera_position, glm::vec3(wolf_model[3]));
+            wolves[i].update_interval = apparent_size > 0.2f ? 1 : apparent_size > 0.1f ? 2 : 4;
         }
+        wolves.update(time);
 
-        for(int i = 0; i < bones.size(); ++i)
-            bones[i] = bones[i] * input_model.bones[i].inverse_bind_matrix;
+        glBindBuffer(GL_TEXTURE_BUFFER, bone_palette_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, wolves.palette().size_bytes(), wolves.palette().data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, wolf_models_vbo);
+        glBufferData(GL_ARRAY_BUFFER, wolf_models.size() * sizeof(glm::mat4), wolf_models.data(), GL_STREAM_DRAW);
 
         auto draw_meshes_to_shadow = [&](bool transparent) {
             for (auto const & mesh : meshes) {
@@ -514,7 +577,7 @@ int main() try {
                 else
                     glDisable(GL_BLEND);
                 glBindVertexArray(mesh.vao);
-                glDrawElements(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset));
+                glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset), GLsizei(wolf_count));
             }
         };
 
@@ -540,7 +603,7 @@ int main() try {
                 }
                 else continue;
                 glBindVertexArray(mesh.vao);
-                glDrawElements(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset));
+                glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset), GLsizei(wolf_count));
             }
         };
 
@@ -565,13 +628,14 @@ int main() try {
             std::replace(texture_path.begin(), texture_path.end(), '\\', '/');
             glUniform1i(have_alpha_location, !material.alpha_texname.empty());
             glUniform1i(alpha_texture_location, textures.get_texture(texture_path));
-            glDrawArrays(GL_TRIANGLES, current_block, (GLint)shape.mesh.indices.size());
+            glDrawElements(GL_TRIANGLES, (GLsizei)shape.mesh.indices.size(), GL_UNSIGNED_INT,
+                           (void *)(current_block * sizeof(std::uint32_t)));
             current_block += (GLint)shape.mesh.indices.size();
         }
 
         glUniform1i(use_bones_location, 1);
-        glUniformMatrix4x3fv(_bones_location, input_model.bones.size(), GL_FALSE, (float*)bones.data());
-        glUniformMatrix4fv(shadow_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&wolf_model));
+        glUniform1i(_bone_palette_location, 2);
+        glUniform1i(_bone_count_location, wolves.bone_count());
         draw_meshes_to_shadow(false);
         glDepthMask(GL_FALSE);
         draw_meshes_to_shadow(true);
@@ -628,7 +692,8 @@ int main() try {
             glUniform1i(have_ambient_texture_location, !material.ambient_texname.empty());
             glUniform1i(_have_alpha_location, !material.alpha_texname.empty());
             glUniform1i(_alpha_texture_location, textures.get_texture(texture_path));
-            glDrawArrays(GL_TRIANGLES, current_block, (GLint)shape.mesh.indices.size());
+            glDrawElements(GL_TRIANGLES, (GLsizei)shape.mesh.indices.size(), GL_UNSIGNED_INT,
+                           (void *)(current_block * sizeof(std::uint32_t)));
             current_block += (GLint)shape.mesh.indices.size();
         }
 
@@ -651,7 +716,6 @@ int main() try {
         glDrawElements(GL_TRIANGLES, floor_index_count, GL_UNSIGNED_INT, nullptr);
 
         glUseProgram(wolf_program);
-        glUniformMatrix4fv(___model_location, 1, GL_FALSE, reinterpret_cast<float *>(&wolf_model));
         glUniformMatrix4fv(___view_location, 1, GL_FALSE, reinterpret_cast<float *>(&view));
         glUniformMatrix4fv(___projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
         glUniform3fv(___light_direction_location, 1, reinterpret_cast<float *>(&light_direction));
@@ -659,7 +723,8 @@ int main() try {
         glUniform1i(___shadow_map_location, 1);
         glUniform3fv(__ambient_location, 1, reinterpret_cast<float *>(&ambient_color));
         glUniformMatrix4fv(__transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&transform));
-        glUniformMatrix4x3fv(bones_location, input_model.bones.size(), GL_FALSE, (float*)bones.data());
+        glUniform1i(bone_palette_location, 2);
+        glUniform1i(bone_count_location, wolves.bone_count());
 
         draw_meshes(false);
         glDepthMask(GL_FALSE);
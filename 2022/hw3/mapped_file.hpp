@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the
+// object does; data() is nullptr for an empty file.
+class mapped_file
+{
+public:
+    explicit mapped_file(std::filesystem::path const & path);
+    ~mapped_file();
+
+    mapped_file(mapped_file && other) noexcept;
+    mapped_file & operator = (mapped_file && other) noexcept;
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file & operator = (mapped_file const &) = delete;
+
+    char const * data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    std::string_view view() const { return {m_data, m_size}; }
+
+    // Hint that [offset, offset + size) is no longer needed, so its pages can
+    // leave the resident set; they are read again from the file if touched
+    void discard(std::size_t offset, std::size_t size) const;
+
+private:
+    void reset();
+
+    char const * m_data = nullptr;
+    std::size_t m_size = 0;
+#ifdef WIN32
+    void * m_file = nullptr;
+    void * m_mapping = nullptr;
+#endif
+};
@@ -140,13 +140,13 @@ obj_data parse_obj(std::filesystem::path const & path)
                 else
                     index[2] = -1;
 
-                if (index[0] >= positions.size())
+                if (std::size_t(index[0]) >= positions.size())
                     fail("bad position index (", index[0], ")");
 
-                if (index[1] != -1 && index[1] >= texcoords.size())
+                if (index[1] != -1 && std::size_t(index[1]) >= texcoords.size())
                     fail("bad texcoord index (", index[1], ")");
 
-                if (index[2] != -1 && index[2] >= normals.size())
+                if (index[2] != -1 && std::size_t(index[2]) >= normals.size())
                     fail("bad normal index (", index[2], ")");
 
                 auto it = index_map.find(index);
@@ -1,8 +1,10 @@
 #version 330 core
 uniform mat4 model;
 uniform mat4 transform;
-uniform mat4x3 bones[64];
 uniform int use_bones;
+// Used with use_bones, see wolf.vert
+uniform samplerBuffer bone_palette;
+uniform int bone_count;
 
 layout (location = 0) in vec3 in_position;
 //layout (location = 1) in vec3 in_tangent;
@@ -10,17 +12,26 @@ layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_tex_coord;
 layout (location = 3) in ivec4 in_joints;
 layout (location = 4) in vec4 in_weights;
+layout (location = 5) in mat4 in_model;
 
 out vec2 tex_coord;
 
+mat4x3 bone(int joint) {
+    int texel = (gl_InstanceID * bone_count + joint) * 3;
+    vec4 a = texelFetch(bone_palette, texel);
+    vec4 b = texelFetch(bone_palette, texel + 1);
+    vec4 c = texelFetch(bone_palette, texel + 2);
+    return mat4x3(a.xyz, vec3(a.w, b.xy), vec3(b.zw, c.x), c.yzw);
+}
+
 void main() {
     if(use_bones == 1) {
         mat4x3 average = mat4x3(0.0);
-        average += bones[in_joints.x] * in_weights.x;
-        average += bones[in_joints.y] * in_weights.y;
-        average += bones[in_joints.z] * in_weights.z;
-        average += bones[in_joints.w] * in_weights.w;
-        gl_Position = transform * model * mat4(average) * vec4(in_position, 1.0);
+        average += bone(in_joints.x) * in_weights.x;
+        average += bone(in_joints.y) * in_weights.y;
+        average += bone(in_joints.z) * in_weights.z;
+        average += bone(in_joints.w) * in_weights.w;
+        gl_Position = transform * in_model * mat4(average) * vec4(in_position, 1.0);
     }
     else {
         gl_Position = transform * model * vec4(in_position, 1.0);
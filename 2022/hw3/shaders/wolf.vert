@@ -1,28 +1,39 @@
 #version 330 core
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
-uniform mat4x3 bones[64];
+// The skinning matrices of every instance, bone_count per instance, each
+// matrix in three texels
+uniform samplerBuffer bone_palette;
+uniform int bone_count;
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
 layout (location = 2) in vec2 in_texcoord;
 layout (location = 3) in ivec4 in_joints;
 layout (location = 4) in vec4 in_weights;
+layout (location = 5) in mat4 in_model;
 
 out vec3 position;
 out vec3 normal;
 out vec2 texcoord;
 
+mat4x3 bone(int joint) {
+    int texel = (gl_InstanceID * bone_count + joint) * 3;
+    vec4 a = texelFetch(bone_palette, texel);
+    vec4 b = texelFetch(bone_palette, texel + 1);
+    vec4 c = texelFetch(bone_palette, texel + 2);
+    return mat4x3(a.xyz, vec3(a.w, b.xy), vec3(b.zw, c.x), c.yzw);
+}
+
 void main() {
     mat4x3 average = mat4x3(0.0);
-    average += bones[in_joints.x] * in_weights.x;
-    average += bones[in_joints.y] * in_weights.y;
-    average += bones[in_joints.z] * in_weights.z;
-    average += bones[in_joints.w] * in_weights.w;
-    position = (model * vec4(in_position, 1.0)).xyz;
-    gl_Position = projection * view * model * mat4(average) * vec4(in_position, 1.0);
-    normal = mat3(model) * mat3(average) * in_normal;
+    average += bone(in_joints.x) * in_weights.x;
+    average += bone(in_joints.y) * in_weights.y;
+    average += bone(in_joints.z) * in_weights.z;
+    average += bone(in_joints.w) * in_weights.w;
+    position = (in_model * vec4(in_position, 1.0)).xyz;
+    gl_Position = projection * view * in_model * mat4(average) * vec4(in_position, 1.0);
+    normal = mat3(in_model) * mat3(average) * in_normal;
     texcoord = in_texcoord;
 }
\ No newline at end of file
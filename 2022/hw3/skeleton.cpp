@@ -0,0 +1,241 @@
+#include "skeleton.hpp"
+#include "simd_batch.hpp"
+
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+
+    constexpr std::uint32_t no_parent = -1;
+
+    // Number of ancestors of every bone
+    std::vector<std::size_t> bone_depths(std::vector<gltf_model::bone> const & bones)
+    {
+        constexpr std::size_t unknown = -1;
+        std::vector<std::size_t> depth(bones.size(), unknown);
+        std::vector<std::uint32_t> chain;
+
+        for (std::uint32_t i = 0; i < bones.size(); ++i)
+        {
+            // Walks up to a root or to a bone of known depth, then assigns the
+            // depths back down
+            std::uint32_t bone = i;
+            while (bone != no_parent && depth[bone] == unknown)
+            {
+                if (chain.size() == bones.size())
+                    throw std::runtime_error("Bone hierarchy has a cycle");
+                chain.push_back(bone);
+                bone = bones[bone].parent;
+                if (bone != no_parent && bone >= bones.size())
+                    throw std::runtime_error("Bone parent out of range");
+            }
+
+            std::size_t d = (bone == no_parent) ? 0 : depth[bone] + 1;
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+                depth[*it] = d++;
+            chain.clear();
+        }
+
+        return depth;
+    }
+
+    template <typename Batch>
+    struct affine
+    {
+        // Column-major, m[column * 3 + row]
+        Batch m[12];
+
+        friend affine operator * (affine const & a, affine const & b)
+        {
+            affine result;
+            for (int column = 0; column < 4; ++column)
+                for (int row = 0; row < 3; ++row)
+                {
+                    Batch sum = a.m[row] * b.m[column * 3] + a.m[3 + row] * b.m[column * 3 + 1] + a.m[6 + row] * b.m[column * 3 + 2];
+                    if (column == 3)
+                        sum = sum + a.m[9 + row];
+                    result.m[column * 3 + row] = sum;
+                }
+            return result;
+        }
+    };
+
+    // translation * rotation * scale, the rotation a unit quaternion
+    template <typename Batch>
+    affine<Batch> compose(Batch const t[3], Batch const q[4], Batch const s[3])
+    {
+        Batch const one = Batch::broadcast(1.f);
+        Batch const two = Batch::broadcast(2.f);
+        Batch const xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+        Batch const xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+        Batch const wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+        return {{
+            (one - two * (yy + zz)) * s[0], two * (xy + wz) * s[0], two * (xz - wy) * s[0],
+            two * (xy - wz) * s[1], (one - two * (xx + zz)) * s[1], two * (yz + wx) * s[1],
+            two * (xz + wy) * s[2], two * (yz - wx) * s[2], (one - two * (xx + yy)) * s[2],
+            t[0], t[1], t[2],
+        }};
+    }
+
+    // Pointers to the ten component arrays, translation, scale, rotation
+    template <typename Pose>
+    auto components(Pose & pose)
+    {
+        return std::array{pose.tx.data(), pose.ty.data(), pose.tz.data(), pose.sx.data(), pose.sy.data(), pose.sz.data(),
+            pose.rx.data(), pose.ry.data(), pose.rz.data(), pose.rw.data()};
+    }
+
+}
+
+skeleton::skeleton(std::vector<gltf_model::bone> const & bones)
+{
+    std::size_t const count = bones.size();
+    auto const depth = bone_depths(bones);
+
+    m_bone.resize(count);
+    std::iota(m_bone.begin(), m_bone.end(), 0);
+    std::stable_sort(m_bone.begin(), m_bone.end(), [&](std::uint32_t a, std::uint32_t b){ return depth[a] < depth[b]; });
+
+    std::vector<std::uint32_t> slot(count);
+    for (std::uint32_t s = 0; s < count; ++s)
+        slot[m_bone[s]] = s;
+
+    m_parent.resize(count);
+    m_skinning_offset.resize(count);
+    for (auto & component : m_inverse_bind)
+        component.resize(count);
+    for (std::uint32_t s = 0; s < count; ++s)
+    {
+        auto const & bone = bones[m_bone[s]];
+        m_parent[s] = (bone.parent == no_parent) ? 0 : 1 + slot[bone.parent];
+        m_skinning_offset[s] = m_bone[s] * 12;
+        for (int column = 0; column < 4; ++column)
+            for (int row = 0; row < 3; ++row)
+                m_inverse_bind[column * 3 + row][s] = bone.inverse_bind_matrix[column][row];
+
+        if (s == 0 || depth[m_bone[s]] != depth[m_bone[s - 1]])
+            m_depth_begin.push_back(s);
+    }
+    m_depth_begin.push_back(count);
+
+    for (int c = 0; c < 12; ++c)
+        m_model[c].assign(count + 1, (c == 0 || c == 4 || c == 8) ? 1.f : 0.f);
+
+    m_local.resize(count);
+    m_skinning.resize(count);
+}
+
+void skeleton::update(std::span<skeleton_pose const * const> poses, std::span<float const> weights)
+{
+    update(poses, weights, m_skinning);
+}
+
+void skeleton::update(std::span<skeleton_pose const * const> poses, std::span<float const> weights, std::span<glm::mat4x3> output)
+{
+    if (output.size() != size())
+        throw std::runtime_error("Skinning output does not match the skeleton");
+    blend(poses, weights);
+
+    float * const skinning = reinterpret_cast<float *>(output.data());
+    for (std::size_t d = 0; d + 1 < m_depth_begin.size(); ++d)
+    {
+        for_lanes(m_depth_begin[d], m_depth_begin[d + 1], [&](auto batch, std::size_t s){
+            using Batch = decltype(batch);
+            std::uint32_t const * bone = m_bone.data() + s;
+
+            Batch const t[3] = {gather<Batch>(m_local.tx.data(), bone), gather<Batch>(m_local.ty.data(), bone),
+                gather<Batch>(m_local.tz.data(), bone)};
+            Batch const q[4] = {gather<Batch>(m_local.rx.data(), bone), gather<Batch>(m_local.ry.data(), bone),
+                gather<Batch>(m_local.rz.data(), bone), gather<Batch>(m_local.rw.data(), bone)};
+            Batch const sc[3] = {gather<Batch>(m_local.sx.data(), bone), gather<Batch>(m_local.sy.data(), bone),
+                gather<Batch>(m_local.sz.data(), bone)};
+
+            affine<Batch> parent, inverse_bind;
+            for (int c = 0; c < 12; ++c)
+            {
+                parent.m[c] = gather<Batch>(m_model[c].data(), m_parent.data() + s);
+                inverse_bind.m[c] = Batch::load(m_inverse_bind[c].data() + s);
+            }
+
+            affine<Batch> const model = parent * compose(t, q, sc);
+            affine<Batch> const skin = model * inverse_bind;
+            for (int c = 0; c < 12; ++c)
+            {
+                model.m[c].store(m_model[c].data() + 1 + s);
+                scatter(skin.m[c], skinning + c, m_skinning_offset.data() + s);
+            }
+        });
+    }
+}
+
+void skeleton::blend(std::span<skeleton_pose const * const> poses, std::span<float const> weights)
+{
+    if (poses.empty() || poses.size() != weights.size())
+        throw std::runtime_error("Skeleton needs one weight per pose");
+    for (auto const * pose : poses)
+        if (pose->size() != size())
+            throw std::runtime_error("Pose does not match the skeleton");
+
+    float const total = std::accumulate(weights.begin(), weights.end(), 0.f);
+    if (!(total > 0.f))
+        throw std::runtime_error("Pose weights must have a positive sum");
+
+    auto const first = components(*poses[0]);
+    auto const local = components(m_local);
+
+    for_lanes(0, size(), [&](auto batch, std::size_t i){
+        using Batch = decltype(batch);
+        Batch const zero = Batch::broadcast(0.f);
+
+        Batch first_rotation[4];
+        for (int c = 0; c < 4; ++c)
+            first_rotation[c] = Batch::load(first[6 + c] + i);
+
+        auto dot = [](Batch const a[4], Batch const b[4]){ return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]; };
+
+        // Two poses follow slerp between the rotations, as the blending of
+        // two clips always did
+        Batch slerp_t = zero;
+        if (poses.size() == 2)
+        {
+            Batch second_rotation[4];
+            for (int c = 0; c < 4; ++c)
+                second_rotation[c] = Batch::load(components(*poses[1])[6 + c] + i);
+            slerp_t = slerp_parameter(abs(dot(first_rotation, second_rotation)), Batch::broadcast(weights[1] / total));
+        }
+
+        Batch sum[10];
+        for (auto & s : sum)
+            s = zero;
+
+        for (std::size_t p = 0; p < poses.size(); ++p)
+        {
+            auto const pose = components(*poses[p]);
+            Batch const weight = Batch::broadcast(weights[p] / total);
+
+            for (int c = 0; c < 6; ++c)
+                sum[c] = sum[c] + Batch::load(pose[c] + i) * weight;
+
+            Batch rotation[4];
+            for (int c = 0; c < 4; ++c)
+                rotation[c] = Batch::load(pose[6 + c] + i);
+            Batch rotation_weight = weight;
+            if (poses.size() == 2)
+                rotation_weight = (p == 0) ? Batch::broadcast(1.f) - slerp_t : slerp_t;
+            rotation_weight = select(less(dot(rotation, first_rotation), zero), zero - rotation_weight, rotation_weight);
+            for (int c = 0; c < 4; ++c)
+                sum[6 + c] = sum[6 + c] + rotation[c] * rotation_weight;
+        }
+
+        Batch const length = sqrt(sum[6] * sum[6] + sum[7] * sum[7] + sum[8] * sum[8] + sum[9] * sum[9]);
+        for (int c = 6; c < 10; ++c)
+            sum[c] = sum[c] / length;
+
+        for (int c = 0; c < 10; ++c)
+            sum[c].store(local[c] + i);
+    });
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "animation_sampler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// The per-frame half of skinning: blends the poses sampled from any number
+// of clips, composes every bone with its parents and with its inverse bind
+// matrix, and keeps the result as the 4x3 matrices the vertex shaders fetch,
+// three texels per bone, from their bone_palette texture buffer.
+//
+// The bones are sorted by their depth in the hierarchy once, at
+// construction, so that parents come before their children whatever order
+// the model lists them in. Bones of the same depth do not depend on each
+// other, so the local -> model -> skinning pass runs over each depth in SIMD
+// batches, without storing the local matrices in between. Every array is
+// allocated at construction; update() does not allocate.
+class skeleton
+{
+public:
+    explicit skeleton(std::vector<gltf_model::bone> const & bones);
+
+    std::size_t size() const { return m_skinning.size(); }
+
+    // Blends the poses, each holding every bone in the model's order, with
+    // the weights normalized by their sum. Translations and scales are
+    // averaged; rotations are summed, each flipped into the hemisphere of the
+    // first pose's, and normalized, except that two poses are slerped within
+    // 1e-4 radians. Then updates the skinning matrices.
+    void update(std::span<skeleton_pose const * const> poses, std::span<float const> weights);
+
+    // The same, but writes the skinning matrices to skinning, which holds
+    // size() of them, rather than to skinning_matrices()
+    void update(std::span<skeleton_pose const * const> poses, std::span<float const> weights, std::span<glm::mat4x3> skinning);
+
+    // Model transform times inverse bind matrix of every bone, in the model's
+    // bone order
+    std::span<glm::mat4x3 const> skinning_matrices() const { return m_skinning; }
+
+private:
+    void blend(std::span<skeleton_pose const * const> poses, std::span<float const> weights);
+
+    // Per sorted slot: the bone, its parent's slot in m_model (0 is the
+    // identity transform of the roots, bone slots start at 1), and the
+    // offset of its skinning matrix in floats
+    std::vector<std::uint32_t> m_bone;
+    std::vector<std::uint32_t> m_parent;
+    std::vector<std::uint32_t> m_skinning_offset;
+    // The slots of depth d are m_depth_begin[d] up to m_depth_begin[d + 1]
+    std::vector<std::size_t> m_depth_begin;
+
+    // 3x4 affine matrices as 12 arrays, component column * 3 + row: the
+    // inverse bind matrices of the sorted slots, and the model transforms
+    std::vector<float> m_inverse_bind[12];
+    std::vector<float> m_model[12];
+
+    // The blended local transforms, in the model's bone order
+    skeleton_pose m_local;
+
+    std::vector<glm::mat4x3> m_skinning;
+};
@@ -0,0 +1,105 @@
+#include "skinned_crowd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+    bool has_positive_weight(crowd_instance const & instance)
+    {
+        return std::any_of(instance.weights.begin(), instance.weights.end(), [](float weight){ return weight > 0.f; });
+    }
+
+}
+
+skinned_crowd::skinned_crowd(std::vector<gltf_model::bone> const & bones, std::vector<animation_clip> clips)
+    : skinned_crowd(bones, std::move(clips), {})
+{}
+
+skinned_crowd::skinned_crowd(std::vector<gltf_model::bone> const & bones, std::vector<compressed_clip> clips)
+    : skinned_crowd(bones, {}, std::move(clips))
+{}
+
+skinned_crowd::skinned_crowd(std::vector<gltf_model::bone> const & bones, std::vector<animation_clip> clips,
+    std::vector<compressed_clip> compressed_clips)
+    : m_clips(std::move(clips))
+    , m_compressed_clips(std::move(compressed_clips))
+    , m_skeleton(bones)
+    , m_poses(m_clips.size() + m_compressed_clips.size())
+{
+    if (m_poses.empty())
+        throw std::runtime_error("Crowd needs at least one clip");
+    for (auto const & clip : m_clips)
+        if (clip.bone_count != bones.size())
+            throw std::runtime_error("Clip does not match the skeleton");
+    for (auto const & clip : m_compressed_clips)
+        if (clip.bone_count != bones.size())
+            throw std::runtime_error("Clip does not match the skeleton");
+
+    for (auto & pose : m_poses)
+        pose.resize(bones.size());
+    m_blend_poses.reserve(clip_count());
+    m_blend_weights.reserve(clip_count());
+}
+
+std::size_t skinned_crowd::add(crowd_instance instance)
+{
+    if (instance.weights.size() != clip_count())
+        throw std::runtime_error("Crowd instance needs one weight per clip");
+    if (!has_positive_weight(instance))
+        throw std::runtime_error("Crowd instance needs a positive weight");
+    if (instance.update_interval == 0)
+        instance.update_interval = 1;
+
+    auto & state = m_instances.emplace_back();
+    state.settings = std::move(instance);
+    state.cursors.resize(clip_count());
+    m_palette.resize(m_instances.size() * bone_count());
+    return m_instances.size() - 1;
+}
+
+std::size_t skinned_crowd::update(float time)
+{
+    std::size_t updated = 0;
+    for (std::size_t i = 0; i < m_instances.size(); ++i)
+    {
+        auto & state = m_instances[i];
+        std::uint32_t const interval = std::max<std::uint32_t>(state.settings.update_interval, 1);
+        if (state.sampled && (m_update_count + i) % interval != 0)
+            continue;
+
+        m_blend_poses.clear();
+        m_blend_weights.clear();
+        for (std::size_t c = 0; c < clip_count(); ++c)
+        {
+            float const weight = state.settings.weights[c];
+            if (weight <= 0.f)
+                continue;
+
+            float const duration = m_clips.empty() ? m_compressed_clips[c].duration : m_clips[c].duration;
+            float clip_time = (duration > 0.f) ? std::fmod(time + state.settings.time_offset, duration) : 0.f;
+            if (clip_time < 0.f)
+                clip_time += duration;
+
+            if (m_clips.empty())
+                m_sampler.sample(m_compressed_clips[c], state.cursors[c], clip_time, m_poses[c]);
+            else
+                m_sampler.sample(m_clips[c], state.cursors[c], clip_time, m_poses[c]);
+            m_blend_poses.push_back(&m_poses[c]);
+            m_blend_weights.push_back(weight);
+        }
+
+        // Weights changed through operator[] may leave nothing to blend
+        if (m_blend_poses.empty())
+            continue;
+
+        m_skeleton.update(m_blend_poses, m_blend_weights, std::span(m_palette).subspan(i * bone_count(), bone_count()));
+        state.sampled = true;
+        ++updated;
+    }
+
+    ++m_update_count;
+    return updated;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "animation_sampler.hpp"
+#include "skeleton.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// The animation of many instances of one skinned model, drawn together with
+// one instanced draw call: the skinning matrices of all instances are kept
+// in a single palette, instance i's bones starting at i * bone_count(), which
+// the renderer uploads to a texture buffer for the vertex shader to index
+// with gl_InstanceID.
+//
+// Every instance plays the crowd's clips from its own time offset with its
+// own blend weights. Distant instances can be given a longer update interval
+// (animation LOD): an instance with interval n is only sampled on every n-th
+// update and keeps its matrices in between. The updates of instances with
+// the same interval are spread by their index, so that the work per frame
+// stays even.
+struct crowd_instance
+{
+    // Added to the time of every update, so that instances are not in step
+    float time_offset = 0.f;
+    // One weight per clip of the crowd, at least one of them positive;
+    // clips of zero or negative weight are not sampled
+    std::vector<float> weights;
+    std::uint32_t update_interval = 1;
+};
+
+class skinned_crowd
+{
+public:
+    skinned_crowd(std::vector<gltf_model::bone> const & bones, std::vector<animation_clip> clips);
+    // Plays compressed clips, which take a fraction of the memory but are
+    // slower to sample
+    skinned_crowd(std::vector<gltf_model::bone> const & bones, std::vector<compressed_clip> clips);
+
+    // Returns the index of the new instance; throws if it has not one weight
+    // per clip, or none of them is positive
+    std::size_t add(crowd_instance instance);
+
+    crowd_instance & operator[](std::size_t index) { return m_instances[index].settings; }
+    crowd_instance const & operator[](std::size_t index) const { return m_instances[index].settings; }
+
+    std::size_t size() const { return m_instances.size(); }
+    std::size_t bone_count() const { return m_skeleton.size(); }
+    std::size_t clip_count() const { return m_poses.size(); }
+
+    // Samples and skins the instances due at this update, and those never
+    // sampled yet; clips loop. An instance left without a positive weight
+    // is skipped and keeps its previous matrices. Returns the number of
+    // instances updated. Does not allocate.
+    std::size_t update(float time);
+
+    std::span<glm::mat4x3 const> palette() const { return m_palette; }
+
+private:
+    skinned_crowd(std::vector<gltf_model::bone> const & bones, std::vector<animation_clip> clips,
+        std::vector<compressed_clip> compressed_clips);
+
+    struct instance_state
+    {
+        crowd_instance settings;
+        std::vector<animation_cursor> cursors;
+        bool sampled = false;
+    };
+
+    // One of the two is empty
+    std::vector<animation_clip> m_clips;
+    std::vector<compressed_clip> m_compressed_clips;
+    skeleton m_skeleton;
+    animation_sampler m_sampler;
+
+    // One pose per clip and the blend inputs, shared by all instances
+    std::vector<skeleton_pose> m_poses;
+    std::vector<skeleton_pose const *> m_blend_poses;
+    std::vector<float> m_blend_weights;
+
+    std::vector<instance_state> m_instances;
+    std::vector<glm::mat4x3> m_palette;
+    std::uint64_t m_update_count = 0;
+};
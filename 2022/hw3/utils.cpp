@@ -1,4 +1,5 @@
 #include "utils.hpp"
+#include "vertex_index_map.hpp"
 #include <stdexcept>
 #include <fstream>
 
@@ -140,14 +141,28 @@ SDL_GLContext create_context(SDL_Window *window) {
     return gl_context;
 }
 
-std::vector<vertex> get_vertices(
+std::pair<std::vector<vertex>, std::vector<std::uint32_t>> get_indexed_vertices(
         const tinyobj::attrib_t &attrib,
         const std::vector<tinyobj::shape_t> &shapes) {
 
-    std::vector<vertex> res;
+    std::size_t index_count = 0;
+    for(auto &shape : shapes)
+        index_count += shape.mesh.indices.size();
+
+    std::vector<vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    vertices.reserve(attrib.vertices.size() / 3);
+    indices.reserve(index_count);
+
+    vertex_index_map index_map(attrib.vertices.size() / 3);
     for(auto &shape : shapes) {
         for (auto &i: shape.mesh.indices) {
-            res.push_back({{
+            auto [index, inserted] = index_map.insert({i.vertex_index, i.normal_index, i.texcoord_index},
+                                                      (std::uint32_t)vertices.size());
+            indices.push_back(index);
+            if(!inserted)
+                continue;
+            vertices.push_back({{
                     attrib.vertices[3 * i.vertex_index],
                     attrib.vertices[3 * i.vertex_index + 1],
                     attrib.vertices[3 * i.vertex_index + 2]
@@ -162,7 +177,7 @@ std::vector<vertex> get_vertices(
             });
         }
     }
-    return res;
+    return {std::move(vertices), std::move(indices)};
 }
 
 bounding_box get_bounding_box(const std::vector<vertex> &scene) {
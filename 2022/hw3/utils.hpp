@@ -67,7 +67,10 @@ GLuint create_program(Shaders ... shaders)
 
 SDL_Window *create_window(const std::string &window_title);
 SDL_GLContext create_context(SDL_Window *window);
-std::vector<vertex> get_vertices(
+// Shapes are kept in order, so the indices of a shape start where the
+// previous shape's end, as with the de-indexed layout; identical corners
+// (same position, normal and texcoord index) share one vertex
+std::pair<std::vector<vertex>, std::vector<std::uint32_t>> get_indexed_vertices(
         const tinyobj::attrib_t &attrib,
         const std::vector<tinyobj::shape_t> &shapes);
 bounding_box get_bounding_box(const std::vector<vertex> &scene);
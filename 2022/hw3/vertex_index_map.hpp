@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+// Flat open-addressing (linear probing) hash map from a position/texcoord/normal
+// index triple to an output vertex index, used to deduplicate face corners.
+// Keys with a negative position index are reserved as the empty marker.
+class vertex_index_map
+{
+public:
+    using key_type = std::array<std::int32_t, 3>;
+
+    explicit vertex_index_map(std::size_t expected_size = 0)
+    {
+        reserve(expected_size);
+    }
+
+    // Makes room for expected_size keys without rehashing
+    void reserve(std::size_t expected_size)
+    {
+        std::size_t capacity = 16;
+        while (capacity < expected_size * 2)
+            capacity *= 2;
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+    // Returns the value stored for the key, inserting the given one if the
+    // key is new; the flag tells whether the insertion happened
+    std::pair<std::uint32_t, bool> insert(key_type const & key, std::uint32_t value)
+    {
+        if ((m_size + 1) * 2 > m_slots.size())
+            rehash(std::max<std::size_t>(16, m_slots.size() * 2));
+
+        std::size_t const mask = m_slots.size() - 1;
+        for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask)
+        {
+            auto & s = m_slots[i];
+            if (s.key[0] < 0)
+            {
+                s.key = key;
+                s.value = value;
+                ++m_size;
+                return {value, true};
+            }
+            if (s.key == key)
+                return {s.value, false};
+        }
+    }
+
+    // Removes all keys but keeps the allocated table
+    void clear()
+    {
+        std::fill(m_slots.begin(), m_slots.end(), slot{});
+        m_size = 0;
+    }
+
+    std::size_t size() const { return m_size; }
+
+private:
+    struct slot
+    {
+        key_type key{-1, -1, -1};
+        std::uint32_t value = 0;
+    };
+
+    static std::size_t hash(key_type const & key)
+    {
+        std::uint64_t h = std::uint64_t(std::uint32_t(key[0])) | (std::uint64_t(std::uint32_t(key[1])) << 32);
+        h ^= std::uint64_t(std::uint32_t(key[2])) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+
+    void rehash(std::size_t capacity)
+    {
+        std::vector<slot> old(capacity);
+        std::swap(old, m_slots);
+
+        std::size_t const mask = capacity - 1;
+        for (auto const & s : old)
+        {
+            if (s.key[0] < 0) continue;
+            std::size_t i = hash(s.key) & mask;
+            while (m_slots[i].key[0] >= 0)
+                i = (i + 1) & mask;
+            m_slots[i] = s;
+        }
+    }
+
+    std::vector<slot> m_slots;
+    std::size_t m_size = 0;
+};
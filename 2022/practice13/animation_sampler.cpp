@@ -0,0 +1,181 @@
+#include "animation_sampler.hpp"
+#include "simd_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+    // Past this many keys since the previous sample, the cursor gives up
+    // stepping and searches the rest of the channel
+    constexpr std::uint32_t max_cursor_steps = 4;
+
+    // a * (1 - t) + b * t, the same expression glm::lerp evaluates
+    template <typename Batch>
+    void lerp_lanes(std::size_t i, float const * const a[3], float const * const b[3], float const * t, float * const result[3])
+    {
+        Batch const tt = Batch::load(t + i);
+        Batch const st = Batch::broadcast(1.f) - tt;
+        for (int c = 0; c < 3; ++c)
+            (Batch::load(a[c] + i) * st + Batch::load(b[c] + i) * tt).store(result[c] + i);
+    }
+
+    // Normalized lerp along the shorter arc, with t corrected to follow slerp
+    template <typename Batch>
+    void nlerp_lanes(std::size_t i, float const * const a[4], float const * const b[4], float const * t, float * const result[4])
+    {
+        Batch qa[4], qb[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            qa[c] = Batch::load(a[c] + i);
+            qb[c] = Batch::load(b[c] + i);
+        }
+
+        Batch const d = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2] + qa[3] * qb[3];
+        Batch const flip = less(d, Batch::broadcast(0.f));
+        for (int c = 0; c < 4; ++c)
+            qb[c] = select(flip, Batch::broadcast(0.f) - qb[c], qb[c]);
+
+        Batch const ct = slerp_parameter(abs(d), Batch::load(t + i));
+        Batch const st = Batch::broadcast(1.f) - ct;
+
+        Batch q[4];
+        for (int c = 0; c < 4; ++c)
+            q[c] = qa[c] * st + qb[c] * ct;
+        Batch const length = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int c = 0; c < 4; ++c)
+            (q[c] / length).store(result[c] + i);
+    }
+
+}
+
+animation_clip make_animation_clip(gltf_model::animation const & animation)
+{
+    animation_clip result;
+    result.bone_count = animation.bones.size();
+    result.duration = animation.max_time;
+    result.first_key.reserve(3 * result.bone_count + 1);
+
+    auto add_key = [&](float time, float x, float y, float z, float w)
+    {
+        result.times.push_back(time);
+        result.x.push_back(x);
+        result.y.push_back(y);
+        result.z.push_back(z);
+        result.w.push_back(w);
+    };
+
+    auto add_vec3_channel = [&](gltf_model::spline<glm::vec3> const & spline, glm::vec3 const & identity)
+    {
+        result.first_key.push_back(result.times.size());
+        if (spline.values.empty())
+            add_key(0.f, identity.x, identity.y, identity.z, 0.f);
+        for (std::size_t i = 0; i < spline.values.size(); ++i)
+            add_key(spline.timestamps[i], spline.values[i].x, spline.values[i].y, spline.values[i].z, 0.f);
+    };
+
+    for (auto const & bone : animation.bones)
+        add_vec3_channel(bone.translation, glm::vec3(0.f));
+    for (auto const & bone : animation.bones)
+        add_vec3_channel(bone.scale, glm::vec3(1.f));
+    for (auto const & bone : animation.bones)
+    {
+        result.first_key.push_back(result.times.size());
+        if (bone.rotation.values.empty())
+            add_key(0.f, 0.f, 0.f, 0.f, 1.f);
+        for (std::size_t i = 0; i < bone.rotation.values.size(); ++i)
+        {
+            auto const & q = bone.rotation.values[i];
+            add_key(bone.rotation.timestamps[i], q.x, q.y, q.z, q.w);
+        }
+    }
+    result.first_key.push_back(result.times.size());
+
+    return result;
+}
+
+void skeleton_pose::resize(std::size_t bone_count)
+{
+    for (auto * component : {&tx, &ty, &tz, &sx, &sy, &sz, &rx, &ry, &rz, &rw})
+        component->resize(bone_count);
+}
+
+void animation_sampler::sample(animation_clip const & clip, animation_cursor & cursor, float time, skeleton_pose & pose)
+{
+    std::size_t const channels = clip.channel_count();
+    std::size_t const bones = clip.bone_count;
+
+    bool const restart = cursor.keys.size() != channels || time < cursor.time;
+    if (cursor.keys.size() != channels)
+        cursor.keys.assign(channels, 0);
+    cursor.time = time;
+
+    for (auto * scratch : {&m_ax, &m_ay, &m_az, &m_aw, &m_bx, &m_by, &m_bz, &m_bw, &m_t})
+        if (scratch->size() < channels)
+            scratch->resize(channels);
+    pose.resize(bones);
+
+    // Moves the cursors and gathers the keys around the time
+    for (std::size_t c = 0; c < channels; ++c)
+    {
+        float const * first = clip.times.data() + clip.first_key[c];
+        float const * last = clip.times.data() + clip.first_key[c + 1];
+        std::uint32_t const count = last - first;
+
+        std::uint32_t key = cursor.keys[c];
+        if (restart)
+            key = std::lower_bound(first, last, time) - first;
+        else
+        {
+            for (std::uint32_t steps = 0; key < count && first[key] < time; ++key)
+            {
+                if (++steps == max_cursor_steps)
+                {
+                    key = std::lower_bound(first + key, last, time) - first;
+                    break;
+                }
+            }
+        }
+        cursor.keys[c] = key;
+
+        std::size_t a, b;
+        if (key == 0 || key == count)
+        {
+            a = b = clip.first_key[c] + count - 1;
+            m_t[c] = 0.f;
+        }
+        else
+        {
+            a = clip.first_key[c] + key - 1;
+            b = a + 1;
+            m_t[c] = (time - first[key - 1]) / (first[key] - first[key - 1]);
+        }
+
+        m_ax[c] = clip.x[a]; m_ay[c] = clip.y[a]; m_az[c] = clip.z[a]; m_aw[c] = clip.w[a];
+        m_bx[c] = clip.x[b]; m_by[c] = clip.y[b]; m_bz[c] = clip.z[b]; m_bw[c] = clip.w[b];
+    }
+
+    // Interpolates all channels of a kind at once
+    float const * const a[4] = {m_ax.data(), m_ay.data(), m_az.data(), m_aw.data()};
+    float const * const b[4] = {m_bx.data(), m_by.data(), m_bz.data(), m_bw.data()};
+
+    float * const translation[3] = {pose.tx.data(), pose.ty.data(), pose.tz.data()};
+    for_lanes(0, bones, [&](auto batch, std::size_t i){
+        lerp_lanes<decltype(batch)>(i, a, b, m_t.data(), translation);
+    });
+
+    float const * const scale_a[3] = {a[0] + bones, a[1] + bones, a[2] + bones};
+    float const * const scale_b[3] = {b[0] + bones, b[1] + bones, b[2] + bones};
+    float * const scale[3] = {pose.sx.data(), pose.sy.data(), pose.sz.data()};
+    for_lanes(0, bones, [&](auto batch, std::size_t i){
+        lerp_lanes<decltype(batch)>(i, scale_a, scale_b, m_t.data() + bones, scale);
+    });
+
+    float const * const rotation_a[4] = {a[0] + 2 * bones, a[1] + 2 * bones, a[2] + 2 * bones, a[3] + 2 * bones};
+    float const * const rotation_b[4] = {b[0] + 2 * bones, b[1] + 2 * bones, b[2] + 2 * bones, b[3] + 2 * bones};
+    float * const rotation[4] = {pose.rx.data(), pose.ry.data(), pose.rz.data(), pose.rw.data()};
+    for_lanes(0, bones, [&](auto batch, std::size_t i){
+        nlerp_lanes<decltype(batch)>(i, rotation_a, rotation_b, m_t.data() + 2 * bones, rotation);
+    });
+}
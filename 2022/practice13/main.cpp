@@ -28,6 +28,8 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "gltf_loader.hpp"
+#include "animation_sampler.hpp"
+#include "skeleton.hpp"
 #include "stb_image.h"
 
 std::string to_string(std::string_view str)
@@ -207,6 +209,13 @@ int main() try
     const gltf_model::animation& animation1 = input_model.animations.at("01_Run");
     const gltf_model::animation& animation2 = input_model.animations.at("02_walk");
 
+    const animation_clip clip1 = make_animation_clip(animation1);
+    const animation_clip clip2 = make_animation_clip(animation2);
+    animation_sampler sampler;
+    animation_cursor cursor1, cursor2;
+    skeleton_pose pose1, pose2;
+    skeleton wolf_skeleton(input_model.bones);
+
     struct mesh
     {
         GLuint vao;
@@ -369,30 +378,17 @@ int main() try
         glUniformMatrix4fv(projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
         glUniform3fv(light_direction_location, 1, reinterpret_cast<float *>(&light_direction));
 
-        std::vector<glm::mat4x3> bones(input_model.bones.size(), glm::mat4x3(0.0));
         float t1 = std::fmod(time, animation1.max_time);
         float t2 = std::fmod(time, animation2.max_time);
-        for(int i = 0; i < bones.size(); ++i) {
-            glm::mat4 translation = glm::translate(glm::mat4(1.f),
-                                                   glm::lerp(animation1.bones[i].translation(t1),
-                                                             animation2.bones[i].translation(t2), f));
-            glm::mat4 scale = glm::scale(glm::mat4(1.f),
-                                         glm::lerp(animation1.bones[i].scale(t1),
-                                                   animation2.bones[i].scale(t2), f));
-            glm::mat4 rotation = glm::toMat4(glm::slerp(animation1.bones[i].rotation(t1),
-                                                        animation2.bones[i].rotation(t2), f));
-
-            glm::mat4 transform = translation * rotation * scale;
-            if(input_model.bones[i].parent != -1)
-                transform = bones[input_model.bones[i].parent] * transform;
-            bones[i] = transform;
-        }
+        sampler.sample(clip1, cursor1, t1, pose1);
+        sampler.sample(clip2, cursor2, t2, pose2);
 
-        for(int i = 0; i < bones.size(); ++i) {
-            bones[i] = bones[i] * input_model.bones[i].inverse_bind_matrix;
-        }
+        const skeleton_pose *poses[] = {&pose1, &pose2};
+        const float weights[] = {1.f - f, f};
+        wolf_skeleton.update(poses, weights);
+        auto bones = wolf_skeleton.skinning_matrices();
 
-        glUniformMatrix4x3fv(bones_location, input_model.bones.size(), GL_FALSE, (float*)bones.data());
+        glUniformMatrix4x3fv(bones_location, input_model.bones.size(), GL_FALSE, (const float*)bones.data());
 
 
         auto draw_meshes = [&](bool transparent)
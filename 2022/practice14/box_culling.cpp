@@ -0,0 +1,88 @@
+#include "box_culling.hpp"
+#include "simd_batch.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <limits>
+
+void box_set::clear()
+{
+    for (auto * component : {&center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z})
+        component->clear();
+}
+
+std::size_t box_set::add(glm::vec3 const & min, glm::vec3 const & max)
+{
+    for (auto * component : {&center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z})
+        component->emplace_back();
+    set(size() - 1, min, max);
+    return size() - 1;
+}
+
+std::size_t box_set::add(glm::vec3 const & min, glm::vec3 const & max, glm::mat4 const & transform)
+{
+    auto const [world_min, world_max] = transform_box(min, max, transform);
+    return add(world_min, world_max);
+}
+
+void box_set::set(std::size_t index, glm::vec3 const & min, glm::vec3 const & max)
+{
+    glm::vec3 const center = (min + max) * 0.5f;
+    glm::vec3 const extent = (max - min) * 0.5f;
+    center_x[index] = center.x; center_y[index] = center.y; center_z[index] = center.z;
+    extent_x[index] = extent.x; extent_y[index] = extent.y; extent_z[index] = extent.z;
+}
+
+std::pair<glm::vec3, glm::vec3> transform_box(glm::vec3 const & min, glm::vec3 const & max, glm::mat4 const & transform)
+{
+    // The transformed half extents along each world axis sum the absolute
+    // values of the matrix's rows (Arvo, "Transforming axis-aligned bounding
+    // boxes", 1990)
+    glm::vec3 const center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.f));
+    glm::vec3 const extent = (max - min) * 0.5f;
+    glm::vec3 world_extent(0.f);
+    for (int column = 0; column < 3; ++column)
+        world_extent += glm::abs(glm::vec3(transform[column])) * extent[column];
+    return {center - world_extent, center + world_extent};
+}
+
+std::array<glm::vec4, 6> frustum_planes(glm::mat4 const & view_projection)
+{
+    // -w <= x, y, z <= w in clip space (Gribb, Hartmann, "Fast extraction of
+    // viewing frustum planes from the world-view-projection matrix", 2001)
+    auto row = [&](int i){ return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+    glm::vec4 const w = row(3);
+    return {w + row(0), w - row(0), w + row(1), w - row(1), w + row(2), w - row(2)};
+}
+
+void cull_boxes(box_set const & boxes, std::array<glm::vec4, 6> const & planes, visibility_bits & bits)
+{
+    bits.assign((boxes.size() + 63) / 64, 0);
+
+    for_lanes(0, boxes.size(), [&](auto batch, std::size_t i){
+        using Batch = decltype(batch);
+        Batch const cx = Batch::load(boxes.center_x.data() + i);
+        Batch const cy = Batch::load(boxes.center_y.data() + i);
+        Batch const cz = Batch::load(boxes.center_z.data() + i);
+        Batch const ex = Batch::load(boxes.extent_x.data() + i);
+        Batch const ey = Batch::load(boxes.extent_y.data() + i);
+        Batch const ez = Batch::load(boxes.extent_z.data() + i);
+
+        // The signed distance of the box's corner furthest along each
+        // plane's normal; the box is outside if any is negative
+        Batch furthest = Batch::broadcast(std::numeric_limits<float>::infinity());
+        for (auto const & plane : planes)
+        {
+            Batch const distance = cx * Batch::broadcast(plane.x) + cy * Batch::broadcast(plane.y)
+                + cz * Batch::broadcast(plane.z) + Batch::broadcast(plane.w);
+            Batch const radius = ex * Batch::broadcast(std::abs(plane.x)) + ey * Batch::broadcast(std::abs(plane.y))
+                + ez * Batch::broadcast(std::abs(plane.z));
+            furthest = min(furthest, distance + radius);
+        }
+
+        unsigned int const outside = movemask(less(furthest, Batch::broadcast(0.f)));
+        unsigned int const inside = ~outside & ((1u << Batch::size) - 1);
+        // Batches start at multiples of their size, so they never straddle a word
+        bits[i / 64] |= std::uint64_t(inside) << (i % 64);
+    });
+}
@@ -16,6 +16,7 @@
 #include <random>
 #include <map>
 #include <cmath>
+#include <cstring>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -27,9 +28,8 @@
 
 #include "gltf_loader.hpp"
 #include "stb_image.h"
-#include "aabb.hpp"
-#include "frustum.hpp"
-#include "intersect.hpp"
+#include "scene_bvh.hpp"
+#include "mesh_simplifier.hpp"
 
 std::string to_string(std::string_view str)
 {
@@ -200,15 +200,52 @@ int main() try
     glBindBuffer(GL_ARRAY_BUFFER, shifts_vbo);
     glBufferData(GL_ARRAY_BUFFER, shifts.size() * sizeof(glm::vec3), shifts.data(), GL_STATIC_DRAW);
 
-    std::vector<GLuint> vaos;
-    for(const auto &mesh : input_model.meshes)
-    {
-        GLuint vao;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+    // Levels of detail are generated from the full-resolution bunny instead
+    // of using the ones stored in the file: every level indexes the vertices
+    // of meshes[0], so all of them share its attributes and one index buffer
+    auto const & base_mesh = input_model.meshes[0];
+
+    std::vector<std::uint32_t> base_indices(base_mesh.indices.count);
+    for(std::size_t i = 0; i < base_indices.size(); i++) {
+        auto const data = input_model.buffer.data() + base_mesh.indices.view.offset;
+        if(base_mesh.indices.type == GL_UNSIGNED_SHORT) {
+            std::uint16_t index;
+            std::memcpy(&index, data + i * sizeof(index), sizeof(index));
+            base_indices[i] = index;
+        } else {
+            std::memcpy(&base_indices[i], data + i * sizeof(std::uint32_t), sizeof(std::uint32_t));
+        }
+    }
+
+    std::vector<std::size_t> lod_targets;
+    for(std::size_t count = base_indices.size() / 6; lod_targets.size() < 5; count /= 2)
+        lod_targets.push_back(count);
+
+    auto lods = build_lod_chain(base_indices,
+        reinterpret_cast<float const *>(input_model.buffer.data() + base_mesh.position.view.offset),
+        base_mesh.position.count, sizeof(glm::vec3), lod_targets);
+    lods.insert(lods.begin(), lod_level{base_indices, 0.f});
+
+    std::vector<std::uint32_t> lod_indices;
+    std::vector<std::size_t> lod_first_index;
+    for(const auto &level : lods) {
+        lod_first_index.push_back(lod_indices.size());
+        lod_indices.insert(lod_indices.end(), level.indices.begin(), level.indices.end());
+        std::cout << "lod " << lod_first_index.size() - 1 << ": " << level.indices.size() / 3
+                  << " triangles, error " << level.error << std::endl;
+    }
+
+    GLuint lod_ebo;
+    glGenBuffers(1, &lod_ebo);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
 
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, lod_indices.size() * sizeof(std::uint32_t), lod_indices.data(), GL_STATIC_DRAW);
+
+    {
         auto setup_attribute = [](int index, gltf_model::accessor const & accessor)
         {
             glEnableVertexAttribArray(index);
@@ -216,16 +253,14 @@ int main() try
         };
 
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        setup_attribute(0, mesh.position);
-        setup_attribute(1, mesh.normal);
-        setup_attribute(2, mesh.texcoord);
+        setup_attribute(0, base_mesh.position);
+        setup_attribute(1, base_mesh.normal);
+        setup_attribute(2, base_mesh.texcoord);
 
         glEnableVertexAttribArray(3);
         glBindBuffer(GL_ARRAY_BUFFER, shifts_vbo);
         glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void *>(0));
         glVertexAttribDivisor(3, 1);
-
-        vaos.push_back(vao);
     }
 
     GLuint texture;
@@ -248,6 +283,14 @@ int main() try
         stbi_image_free(data);
     }
 
+    // The instances never move, so the tree is built once
+    box_set instance_boxes;
+    for (auto const & shift : shifts)
+        instance_boxes.add(base_mesh.min + shift, base_mesh.max + shift);
+    scene_bvh instances;
+    instances.build(instance_boxes);
+    std::vector<std::uint32_t> visible_instances;
+
     auto last_frame_start = std::chrono::high_resolution_clock::now();
 
     float time = 0.f;
@@ -400,16 +443,21 @@ int main() try
         glm::mat4 model(1.f);
         glUniformMatrix4fv(model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
 
-        frustum f(projection * view);
-        std::vector<glm::vec3> groups[6];
-        for(int x = -16; x <= 16; ++x) {
-            for(int z = -16; z <= 16; ++z) {
-                glm::vec3 shift(x, 0.f, z);
-                int lod = std::min(5, (int)(glm::length(shift - camera_position) / 3.f));
-                aabb box = aabb(input_model.meshes[lod].min + shift, input_model.meshes[lod].max + shift);
-                if (intersect(box, f))
-                    groups[lod].push_back(shift);
-            }
+        // The coarsest level whose error covers at most max_screen_error
+        // pixels; the error is an RMS distance, roughly half of the largest
+        // deviation, hence the threshold below one pixel
+        float const max_screen_error = 0.5f;
+
+        instances.cull(frustum_planes(projection * view), visible_instances);
+        std::vector<std::vector<glm::vec3>> groups(lods.size());
+        for(auto instance : visible_instances) {
+            glm::vec3 shift = shifts[instance];
+            float distance = glm::length(shift - camera_position);
+            int lod = 0;
+            while(lod + 1 < lods.size()
+                  && projected_error(lods[lod + 1].error, distance, glm::pi<float>() / 2.f, height) <= max_screen_error)
+                lod++;
+            groups[lod].push_back(shift);
         }
         /*
         glBindBuffer(GL_ARRAY_BUFFER, shifts_vbo);
@@ -419,13 +467,13 @@ int main() try
         std::cout << "intersections: " << shifts_.size() << std::endl;
         */
 
-        std::cout << groups[5].size() << std::endl;
-        for(int i = 0; i <= 5; i++) {
-            auto const &mesh = input_model.meshes[i];
+        std::cout << groups.back().size() << std::endl;
+        glBindVertexArray(vao);
+        for(int i = 0; i < lods.size(); i++) {
             glBindBuffer(GL_ARRAY_BUFFER, shifts_vbo);
             glBufferData(GL_ARRAY_BUFFER, groups[i].size() * sizeof(glm::vec3), groups[i].data(), GL_STATIC_DRAW);
-            glBindVertexArray(vaos[i]);
-            glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.count, mesh.indices.type, reinterpret_cast<void *>(mesh.indices.view.offset), groups[i].size());
+            glDrawElementsInstanced(GL_TRIANGLES, lods[i].indices.size(), GL_UNSIGNED_INT,
+                                    reinterpret_cast<void *>(lod_first_index[i] * sizeof(std::uint32_t)), groups[i].size());
         }
 
         glEndQuery(GL_TIME_ELAPSED);
@@ -0,0 +1,400 @@
+#include "mesh_simplifier.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include <array>
+#include <cmath>
+#include <queue>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+
+    constexpr float border_weight = 10.f;
+
+    struct position_reader
+    {
+        char const * data;
+        std::size_t stride;
+
+        glm::dvec3 operator()(std::uint32_t vertex) const
+        {
+            glm::vec3 result;
+            std::memcpy(&result, data + vertex * stride, sizeof(result));
+            return result;
+        }
+    };
+
+    // Sum of squared distances to weighted planes, as the upper half of a
+    // symmetric 4x4 matrix: xx xy xz xw yy yz yw zz zw ww
+    struct quadric
+    {
+        std::array<double, 10> m{};
+        double weight = 0.0;
+
+        static quadric plane(glm::dvec3 const & n, double d, double weight)
+        {
+            quadric q;
+            q.m = {n.x * n.x, n.x * n.y, n.x * n.z, n.x * d, n.y * n.y, n.y * n.z, n.y * d, n.z * n.z, n.z * d, d * d};
+            for (auto & v : q.m)
+                v *= weight;
+            q.weight = weight;
+            return q;
+        }
+
+        quadric & operator += (quadric const & other)
+        {
+            for (int i = 0; i < 10; ++i)
+                m[i] += other.m[i];
+            weight += other.weight;
+            return *this;
+        }
+
+        double evaluate(glm::dvec3 const & p) const
+        {
+            return m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+                + m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+                + m[7] * p.z * p.z + 2.0 * m[8] * p.z
+                + m[9];
+        }
+    };
+
+    // Area-weighted RMS distance to the planes of a quadric
+    float quadric_error(quadric const & a, quadric const & b, glm::dvec3 const & p)
+    {
+        double const weight = a.weight + b.weight;
+        if (weight <= 0.0)
+            return 0.f;
+        return std::sqrt(std::max(0.0, (a.evaluate(p) + b.evaluate(p)) / weight));
+    }
+
+    std::uint64_t edge_key(std::uint32_t a, std::uint32_t b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return (std::uint64_t(a) << 32) | b;
+    }
+
+    struct collapse
+    {
+        float error;
+        std::uint32_t from;
+        std::uint32_t to;
+
+        bool operator < (collapse const & other) const
+        {
+            return error > other.error;
+        }
+    };
+
+    class simplifier
+    {
+    public:
+        simplifier(std::span<std::uint32_t const> indices, float const * positions, std::size_t vertex_count, std::size_t stride)
+            : m_position{reinterpret_cast<char const *>(positions), stride}
+            , m_corners(indices.begin(), indices.begin() + indices.size() / 3 * 3)
+            , m_triangle_alive(indices.size() / 3, true)
+            , m_remaining(indices.size() / 3)
+            , m_remap(vertex_count)
+            , m_alive(vertex_count, true)
+            , m_border(vertex_count, false)
+            , m_locked(vertex_count, false)
+            , m_quadrics(vertex_count)
+            , m_triangles(vertex_count)
+        {
+            // Vertices sharing a position become one, represented by the first
+            struct position_hash
+            {
+                std::size_t operator()(glm::vec3 const & p) const
+                {
+                    std::array<std::uint32_t, 3> bits;
+                    std::memcpy(bits.data(), &p, sizeof(bits));
+                    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+                }
+            };
+
+            std::unordered_map<glm::vec3, std::uint32_t, position_hash> first;
+            for (std::uint32_t v = 0; v < vertex_count; ++v)
+                m_remap[v] = first.emplace(glm::vec3(m_position(v)), v).first->second;
+
+            std::unordered_map<std::uint64_t, std::pair<std::uint32_t, std::uint32_t>> edges;
+            for (std::uint32_t t = 0; t < m_triangle_alive.size(); ++t)
+            {
+                auto const p = corner_positions(t);
+                for (int k = 0; k < 3; ++k)
+                    m_triangles[p[k]].push_back(t);
+
+                auto const n = glm::cross(m_position(p[1]) - m_position(p[0]), m_position(p[2]) - m_position(p[0]));
+                double const length = glm::length(n);
+                if (length > 0.0)
+                {
+                    auto const q = quadric::plane(n / length, -glm::dot(n / length, m_position(p[0])), length * 0.5);
+                    for (int k = 0; k < 3; ++k)
+                        m_quadrics[p[k]] += q;
+                }
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    auto & edge = edges[edge_key(p[k], p[(k + 1) % 3])];
+                    ++edge.first;
+                    edge.second = t;
+                }
+            }
+
+            // Planes through the border edges, perpendicular to their
+            // triangle, keep the border in place
+            for (auto const & [key, edge] : edges)
+            {
+                std::uint32_t const a = key >> 32;
+                std::uint32_t const b = key & 0xffffffffu;
+                if (edge.first > 2)
+                {
+                    m_locked[a] = m_locked[b] = true;
+                    continue;
+                }
+                if (edge.first != 1)
+                    continue;
+
+                m_border[a] = m_border[b] = true;
+
+                auto const p = corner_positions(edge.second);
+                auto const face = glm::cross(m_position(p[1]) - m_position(p[0]), m_position(p[2]) - m_position(p[0]));
+                auto const direction = m_position(b) - m_position(a);
+                auto n = glm::cross(direction, face);
+                double const length = glm::length(n);
+                if (length == 0.0)
+                    continue;
+                n /= length;
+
+                auto const q = quadric::plane(n, -glm::dot(n, m_position(a)), border_weight * glm::dot(direction, direction));
+                m_quadrics[a] += q;
+                m_quadrics[b] += q;
+            }
+
+            for (std::uint32_t t = 0; t < m_triangle_alive.size(); ++t)
+            {
+                auto const p = corner_positions(t);
+                for (int k = 0; k < 3; ++k)
+                {
+                    push(p[k], p[(k + 1) % 3]);
+                    push(p[(k + 1) % 3], p[k]);
+                }
+            }
+        }
+
+        std::size_t remaining() const { return m_remaining; }
+        float error() const { return m_error; }
+
+        // Performs the cheapest possible collapse; false if there is none
+        // within max_error
+        bool step(float max_error)
+        {
+            while (!m_queue.empty())
+            {
+                auto const c = m_queue.top();
+                m_queue.pop();
+
+                if (!m_alive[c.from] || !m_alive[c.to] || m_locked[c.from])
+                    continue;
+
+                // Quadrics only grow, so a stale entry is never too expensive
+                float const error = quadric_error(m_quadrics[c.from], m_quadrics[c.to], m_position(c.to));
+                if (error > c.error * (1.f + 1e-5f) + 1e-30f)
+                {
+                    m_queue.push({error, c.from, c.to});
+                    continue;
+                }
+
+                if (error > max_error)
+                    return false;
+
+                if (try_collapse(c.from, c.to))
+                {
+                    m_error = std::max(m_error, error);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::vector<std::uint32_t> indices() const
+        {
+            std::vector<std::uint32_t> result;
+            result.reserve(m_remaining * 3);
+            for (std::size_t t = 0; t < m_triangle_alive.size(); ++t)
+                if (m_triangle_alive[t])
+                    result.insert(result.end(), m_corners.begin() + 3 * t, m_corners.begin() + 3 * t + 3);
+            return result;
+        }
+
+    private:
+        position_reader m_position;
+        std::vector<std::uint32_t> m_corners;
+        std::vector<bool> m_triangle_alive;
+        std::size_t m_remaining;
+
+        // Per vertex, only meaningful for the representative of a position
+        std::vector<std::uint32_t> m_remap;
+        std::vector<bool> m_alive;
+        std::vector<bool> m_border;
+        std::vector<bool> m_locked;
+        std::vector<quadric> m_quadrics;
+        std::vector<std::vector<std::uint32_t>> m_triangles;
+
+        std::priority_queue<collapse> m_queue;
+        float m_error = 0.f;
+
+        std::array<std::uint32_t, 3> corner_positions(std::uint32_t t) const
+        {
+            return {m_remap[m_corners[3 * t]], m_remap[m_corners[3 * t + 1]], m_remap[m_corners[3 * t + 2]]};
+        }
+
+        void push(std::uint32_t from, std::uint32_t to)
+        {
+            if (from == to || m_locked[from])
+                return;
+            m_queue.push({quadric_error(m_quadrics[from], m_quadrics[to], m_position(to)), from, to});
+        }
+
+        bool try_collapse(std::uint32_t from, std::uint32_t to)
+        {
+            auto & around = m_triangles[from];
+            std::erase_if(around, [this](std::uint32_t t){ return !m_triangle_alive[t]; });
+
+            // The vertex of 'to' replacing each vertex of 'from', taken from
+            // the triangles on the collapsed edge so that seams stay intact
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> wedges;
+            auto replacement = [&](std::uint32_t vertex) -> std::uint32_t const *
+            {
+                for (auto const & w : wedges)
+                    if (w.first == vertex)
+                        return &w.second;
+                return nullptr;
+            };
+
+            std::size_t shared = 0;
+            for (auto t : around)
+            {
+                std::uint32_t from_vertex = 0, to_vertex = 0;
+                bool has_to = false;
+                for (int k = 0; k < 3; ++k)
+                {
+                    auto const v = m_corners[3 * t + k];
+                    if (m_remap[v] == from)
+                        from_vertex = v;
+                    else if (m_remap[v] == to)
+                    {
+                        to_vertex = v;
+                        has_to = true;
+                    }
+                }
+                if (!has_to)
+                    continue;
+                ++shared;
+                if (!replacement(from_vertex))
+                    wedges.emplace_back(from_vertex, to_vertex);
+            }
+
+            // Borders only collapse along themselves, everything else along
+            // manifold edges
+            if (shared != (m_border[from] ? 1 : 2))
+                return false;
+
+            for (auto t : around)
+            {
+                std::array<glm::dvec3, 3> before, after;
+                bool has_to = false;
+                for (int k = 0; k < 3; ++k)
+                {
+                    auto const v = m_corners[3 * t + k];
+                    has_to |= m_remap[v] == to;
+                    before[k] = m_position(m_remap[v]);
+                    after[k] = m_remap[v] == from ? m_position(to) : before[k];
+
+                    // A vertex only on one side of a seam can't be moved
+                    // across it
+                    if (m_remap[v] == from && !replacement(v))
+                        return false;
+                }
+                if (has_to)
+                    continue;
+
+                auto const n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                auto const n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(n0, n1) <= 0.0)
+                    return false;
+            }
+
+            auto & target = m_triangles[to];
+            for (auto t : around)
+            {
+                bool has_to = false;
+                for (int k = 0; k < 3; ++k)
+                    has_to |= m_remap[m_corners[3 * t + k]] == to;
+
+                if (has_to)
+                {
+                    m_triangle_alive[t] = false;
+                    --m_remaining;
+                    continue;
+                }
+
+                for (int k = 0; k < 3; ++k)
+                    if (auto const v = m_corners[3 * t + k]; m_remap[v] == from)
+                        m_corners[3 * t + k] = *replacement(v);
+                target.push_back(t);
+            }
+
+            m_quadrics[to] += m_quadrics[from];
+            m_alive[from] = false;
+            around.clear();
+            around.shrink_to_fit();
+
+            std::erase_if(target, [this](std::uint32_t t){ return !m_triangle_alive[t]; });
+            for (auto t : target)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    auto const v = m_remap[m_corners[3 * t + k]];
+                    push(to, v);
+                    push(v, to);
+                }
+            }
+
+            return true;
+        }
+    };
+
+}
+
+std::vector<lod_level> build_lod_chain(std::span<std::uint32_t const> indices, float const * positions,
+    std::size_t vertex_count, std::size_t stride, std::span<std::size_t const> target_triangle_counts, float max_error)
+{
+    simplifier s(indices, positions, vertex_count, stride);
+
+    std::vector<lod_level> result;
+    for (auto target : target_triangle_counts)
+    {
+        while (s.remaining() > target && s.step(max_error))
+            ;
+        result.push_back({s.indices(), s.error()});
+    }
+    return result;
+}
+
+lod_level simplify(std::span<std::uint32_t const> indices, float const * positions, std::size_t vertex_count,
+    std::size_t stride, std::size_t target_triangle_count, float max_error)
+{
+    return std::move(build_lod_chain(indices, positions, vertex_count, stride, {&target_triangle_count, 1}, max_error).front());
+}
+
+float projected_error(float error, float distance, float fov_y, float viewport_height)
+{
+    if (distance <= 0.f)
+        return std::numeric_limits<float>::infinity();
+    return error / (distance * std::tan(fov_y * 0.5f)) * viewport_height * 0.5f;
+}